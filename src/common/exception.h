@@ -34,7 +34,9 @@ class OOIException : public exception {
                 if(m_msg.length())
                     os << " (" << m_msg << ")";
                     
-                return os.str().c_str();
+                // Keep the text alive after we return
+                m_what = os.str();
+                return m_what.c_str();
         }
         
         int errcode() { return m_errno; }
@@ -45,6 +47,9 @@ class OOIException : public exception {
         string m_type;
         string m_msg;
         int m_errno;
+
+    private:
+        mutable string m_what;
 };
 
 class DaemonStartupException : public OOIException {
@@ -169,6 +174,11 @@ class SocketNotInitialized : public OOIException {
         OOIException("Socket Not Initialized:", 310, msg) {}
 };
 
+class EventLoopFailure : public OOIException {
+    public: EventLoopFailure(const string & msg = "") :
+        OOIException("Event Loop Failure:", 311, msg) {}
+};
+
 /*******************************************************************************
  * Processes Launch Exceptions
  ******************************************************************************/
@@ -243,6 +253,11 @@ class NotInitialized : public OOIException {
         OOIException("Uninitialized socket operation", 802, msg) {}
 };
 
+class PipelineFailure : public OOIException {
+    public: PipelineFailure(const string & msg = "") :
+        OOIException("Packet pipeline failure", 803, msg) {}
+};
+
 /*******************************************************************************
  * Device Exceptions
  ******************************************************************************/
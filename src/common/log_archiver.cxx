@@ -0,0 +1,525 @@
+/*******************************************************************************
+ * Class: LogArchiver
+ * Filename: log_archiver.cxx
+ * License: Apache 2.0
+ *
+ * Background compression and retention for rolled log files.  See
+ * log_archiver.h for usage.
+ ******************************************************************************/
+#include "log_archiver.h"
+#include "log_index.h"
+#include "logger.h"
+#include "exception.h"
+
+#include <algorithm>
+#include <sstream>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <zlib.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+using namespace std;
+using namespace logger;
+
+// Compression is background work, keep it behind the threads moving data
+#define LOG_ARCHIVER_NICE 10
+
+#define LOG_ARCHIVER_BUFFER_SIZE 65536
+
+/******************************************************************************
+ * Function: unzipped
+ * Description: The name of a file without its .gz suffix.
+ ******************************************************************************/
+static string unzipped(const string &name) {
+    if(name.length() > 3 && name.compare(name.length() - 3, 3, ".gz") == 0)
+        return name.substr(0, name.length() - 3);
+
+    return name;
+}
+
+/******************************************************************************
+ *   PUBLIC METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ * Description: Nothing to look after, no compression and no retention.  The
+ * thread isn't started until start() is called.
+ ******************************************************************************/
+LogArchiver::LogArchiver() {
+    m_iLevel = 0;
+    m_iMaxAge = 0;
+    m_iMaxBytes = 0;
+
+    m_bRunning = false;
+    m_bStopping = false;
+
+    m_iCompressed = 0;
+    m_iBytesIn = 0;
+    m_iBytesOut = 0;
+    m_iRemoved = 0;
+    m_iFailed = 0;
+
+    m_iWakeFD = eventfd(0, EFD_NONBLOCK);
+    if(m_iWakeFD < 0)
+        throw LoggerWriteError(strerror(errno));
+}
+
+/******************************************************************************
+ * Method: Destructor
+ * Description: Stop the thread.
+ ******************************************************************************/
+LogArchiver::~LogArchiver() {
+    stop();
+
+    if(m_iWakeFD >= 0)
+        close(m_iWakeFD);
+}
+
+/******************************************************************************
+ * Method: setBase
+ * Description: Set the rolled files to look after, the same base and
+ * extension given to the LogFile.  A new base forgets the open file until
+ * the LogFile opens one.
+ ******************************************************************************/
+void LogArchiver::setBase(const string &filebase, const string &fileext) {
+    MutexLock lock(m_oLock);
+    string directory = ".";
+    string prefix = filebase;
+    size_t slash = filebase.rfind('/');
+
+    if(slash != string::npos) {
+        directory = slash ? filebase.substr(0, slash) : "/";
+        prefix = filebase.substr(slash + 1);
+    }
+
+    prefix += ".";
+
+    if(directory == m_sDirectory && prefix == m_sPrefix && fileext == m_sExtention)
+        return;
+
+    m_sDirectory = directory;
+    m_sPrefix = prefix;
+    m_sExtention = fileext;
+    m_sCurrent = "";
+}
+
+/******************************************************************************
+ * Method: setCompression
+ * Description: Set the gzip level for finished files.
+ *
+ * Parameters:
+ *   level - 1 (fastest) to 9 (smallest), 0 to leave files as they are
+ ******************************************************************************/
+void LogArchiver::setCompression(int level) {
+    MutexLock lock(m_oLock);
+
+    if(level < 0 || level > LOG_ARCHIVER_MAX_LEVEL)
+        level = 0;
+
+    if(level && !m_iLevel && m_bRunning)
+        eventfd_write(m_iWakeFD, 1);
+
+    m_iLevel = level;
+}
+
+/******************************************************************************
+ * Method: setRetention
+ * Description: Set when old files are removed.
+ *
+ * Parameters:
+ *   maxAge - remove files last written more than this many seconds ago
+ *   maxBytes - remove the oldest files while they add up to more than this
+ ******************************************************************************/
+void LogArchiver::setRetention(uint32_t maxAge, uint64_t maxBytes) {
+    MutexLock lock(m_oLock);
+
+    m_iMaxAge = maxAge;
+    m_iMaxBytes = maxBytes;
+}
+
+/******************************************************************************
+ * Method: start
+ * Description: Start the archiver thread.
+ * Return:
+ *   true if the thread is running
+ ******************************************************************************/
+bool LogArchiver::start() {
+    if(m_bRunning)
+        return true;
+
+    __atomic_store_n(&m_bStopping, false, __ATOMIC_RELEASE);
+
+    if(pthread_create(&m_oThread, NULL, archiverMain, this)) {
+        LOG(ERROR) << "failed to start log archiver thread";
+        return false;
+    }
+
+    LOG(INFO) << "log archiver started";
+    m_bRunning = true;
+    return true;
+}
+
+/******************************************************************************
+ * Method: stop
+ * Description: Stop and join the thread.  A file being compressed is left
+ * as it was, it is picked up again next time.
+ ******************************************************************************/
+void LogArchiver::stop() {
+    if(!m_bRunning)
+        return;
+
+    __atomic_store_n(&m_bStopping, true, __ATOMIC_RELEASE);
+    eventfd_write(m_iWakeFD, 1);
+    pthread_join(m_oThread, NULL);
+
+    m_bRunning = false;
+    LOG(INFO) << "log archiver stopped";
+}
+
+/******************************************************************************
+ * Method: logFileOpened
+ * Description: The LogFile has opened file, so any file before it is
+ * finished.  Wake the thread if that is news.
+ ******************************************************************************/
+void LogArchiver::logFileOpened(const string &file) {
+    MutexLock lock(m_oLock);
+    string name = file.substr(file.rfind('/') + 1);
+
+    if(name == m_sCurrent)
+        return;
+
+    m_sCurrent = name;
+    eventfd_write(m_iWakeFD, 1);
+}
+
+/******************************************************************************
+ * Method: archive
+ * Description: Compress every finished file that isn't already, then apply
+ * the retention policy.  Nothing is done until the LogFile has told us
+ * which file is open.
+ ******************************************************************************/
+void LogArchiver::archive() {
+    vector<string> files;
+    string directory, current;
+    int level;
+    bool retention;
+
+    {
+        MutexLock lock(m_oLock);
+        directory = m_sDirectory;
+        current = m_sCurrent;
+        level = m_iLevel;
+        retention = m_iMaxAge || m_iMaxBytes;
+    }
+
+    if(!current.length() || !listFiles(files))
+        return;
+
+    for(vector<string>::iterator i = files.begin(); level && i != files.end(); i++) {
+        if(stopping())
+            return;
+
+        if(*i < current && unzipped(*i) == *i)
+            compress(directory + "/" + *i, level);
+    }
+
+    if(retention && listFiles(files))
+        expire(files, current);
+}
+
+/******************************************************************************
+ * Method: compress
+ * Description: gzip file into file.gz.tmp, rename it to file.gz once it is
+ * complete and on disk, then remove file.  Gives up part way if the thread
+ * is stopped.
+ *
+ * Parameters:
+ *   file - path of the file to compress
+ *   level - gzip level
+ * Return:
+ *   true if the file was compressed
+ ******************************************************************************/
+bool LogArchiver::compress(const string &file, int level) {
+    string target = file + ".gz";
+    string temp = target + ".tmp";
+    char buffer[LOG_ARCHIVER_BUFFER_SIZE];
+    char mode[8];
+    uint64_t bytesIn = 0;
+    ssize_t count = 0;
+    bool ok = true;
+    struct stat info;
+
+    int in = open(file.c_str(), O_RDONLY);
+    if(in < 0) {
+        LOG(ERROR) << "failed to open " << file << " to compress: " << strerror(errno);
+        __atomic_add_fetch(&m_iFailed, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    snprintf(mode, sizeof(mode), "wb%d", level);
+    gzFile out = gzopen(temp.c_str(), mode);
+    if(!out) {
+        LOG(ERROR) << "failed to create " << temp << ": " << strerror(errno);
+        __atomic_add_fetch(&m_iFailed, 1, __ATOMIC_RELAXED);
+        close(in);
+        return false;
+    }
+
+    while(ok && !stopping() && (count = read(in, buffer, sizeof(buffer))) > 0) {
+        ok = gzwrite(out, buffer, count) == count;
+        bytesIn += count;
+    }
+
+    close(in);
+
+    if(count < 0 || !ok) {
+        LOG(ERROR) << "failed to compress " << file << ": " << strerror(errno);
+        ok = false;
+    }
+
+    if(gzclose(out) != Z_OK)
+        ok = false;
+
+    if(!ok || stopping()) {
+        unlink(temp.c_str());
+        if(!ok)
+            __atomic_add_fetch(&m_iFailed, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    // On disk before the original goes
+    int fd = open(temp.c_str(), O_RDONLY);
+    if(fd < 0 || fsync(fd) < 0 || fstat(fd, &info) < 0 ||
+       rename(temp.c_str(), target.c_str()) < 0) {
+        LOG(ERROR) << "failed to write " << target << ": " << strerror(errno);
+        __atomic_add_fetch(&m_iFailed, 1, __ATOMIC_RELAXED);
+        if(fd >= 0)
+            close(fd);
+        unlink(temp.c_str());
+        return false;
+    }
+
+    close(fd);
+    unlink(file.c_str());
+
+    LOG(DEBUG) << "compressed " << file << " " << bytesIn << " to " << info.st_size << " bytes";
+    __atomic_add_fetch(&m_iCompressed, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&m_iBytesIn, bytesIn, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&m_iBytesOut, (uint64_t)info.st_size, __ATOMIC_RELAXED);
+    return true;
+}
+
+/******************************************************************************
+ * Method: stats
+ * Description: Snapshot of the archiver counters.
+ ******************************************************************************/
+LogArchiverStats LogArchiver::stats() {
+    LogArchiverStats result;
+
+    result.compressed = __atomic_load_n(&m_iCompressed, __ATOMIC_RELAXED);
+    result.bytesIn = __atomic_load_n(&m_iBytesIn, __ATOMIC_RELAXED);
+    result.bytesOut = __atomic_load_n(&m_iBytesOut, __ATOMIC_RELAXED);
+    result.removed = __atomic_load_n(&m_iRemoved, __ATOMIC_RELAXED);
+    result.failed = __atomic_load_n(&m_iFailed, __ATOMIC_RELAXED);
+
+    return result;
+}
+
+/******************************************************************************
+ * Method: statsAsString
+ * Description: Counters formatted for a status packet.
+ ******************************************************************************/
+string LogArchiver::statsAsString() {
+    LogArchiverStats current = stats();
+    ostringstream out;
+
+    out << "log_archive_compressed " << current.compressed << endl
+        << "log_archive_bytes_in " << current.bytesIn << endl
+        << "log_archive_bytes_out " << current.bytesOut << endl
+        << "log_archive_removed " << current.removed << endl
+        << "log_archive_failed " << current.failed << endl;
+
+    return out.str();
+}
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: archiverMain
+ * Description: pthread entry point for the archiver thread.
+ ******************************************************************************/
+void * LogArchiver::archiverMain(void *arg) {
+    ((LogArchiver *)arg)->archiveLoop();
+    return NULL;
+}
+
+/******************************************************************************
+ * Method: archiveLoop
+ * Description: Archive when woken by a new file, and every so often anyway
+ * so the age limit is applied while the file name stays the same.
+ ******************************************************************************/
+void LogArchiver::archiveLoop() {
+    struct pollfd fds;
+    eventfd_t value;
+
+    if(setpriority(PRIO_PROCESS, syscall(SYS_gettid), LOG_ARCHIVER_NICE) < 0)
+        LOG(DEBUG) << "failed to lower log archiver priority: " << strerror(errno);
+
+    while(!stopping()) {
+        archive();
+
+        fds.fd = m_iWakeFD;
+        fds.events = POLLIN;
+        fds.revents = 0;
+
+        if(::poll(&fds, 1, LOG_ARCHIVER_WAIT_TIMEOUT) < 0 && errno != EINTR)
+            LOG(ERROR) << "log archiver poll error: " << strerror(errno);
+
+        if(fds.revents)
+            eventfd_read(m_iWakeFD, &value);
+    }
+}
+
+/******************************************************************************
+ * Method: listFiles
+ * Description: Names of the files we look after, compressed or not, in the
+ * order they were written.  A .gz.tmp left when a crash cut a compression
+ * short is removed, only this thread writes them so none are in progress.
+ * Return:
+ *   false if the directory can't be read
+ ******************************************************************************/
+bool LogArchiver::listFiles(vector<string> &files) {
+    string directory, prefix, suffix;
+    struct dirent *entry;
+
+    {
+        MutexLock lock(m_oLock);
+        directory = m_sDirectory;
+        prefix = m_sPrefix;
+        suffix = m_sExtention.length() ? "." + m_sExtention : "";
+    }
+
+    files.clear();
+
+    if(!prefix.length())
+        return false;
+
+    DIR *dir = opendir(directory.c_str());
+    if(!dir) {
+        LOG(ERROR) << "failed to read " << directory << ": " << strerror(errno);
+        return false;
+    }
+
+    while((entry = readdir(dir)) != NULL) {
+        string name = entry->d_name;
+        bool stale = name.length() > 7 && name.compare(name.length() - 7, 7, ".gz.tmp") == 0;
+        string base = unzipped(stale ? name.substr(0, name.length() - 4) : name);
+
+        if(base.compare(0, prefix.length(), prefix) != 0 ||
+           base.length() <= prefix.length() + suffix.length())
+            continue;
+
+        if(base.compare(base.length() - suffix.length(), suffix.length(), suffix) != 0)
+            continue;
+
+        if(stale) {
+            string path = directory + "/" + name;
+            if(unlink(path.c_str()) == 0)
+                LOG(WARNING) << "removed unfinished " << path;
+            continue;
+        }
+
+        if(name.length() > 4 && name.compare(name.length() - 4, 4, ".tmp") == 0)
+            continue;
+
+        if(name.length() > 4 && name.compare(name.length() - 4, 4, LOG_INDEX_EXTENTION) == 0)
+            continue;
+
+        size_t marker = strlen(LOG_FILE_PREALLOC_EXTENTION);
+        if(name.length() > marker &&
+           name.compare(name.length() - marker, marker, LOG_FILE_PREALLOC_EXTENTION) == 0)
+            continue;
+
+        files.push_back(name);
+    }
+
+    closedir(dir);
+    sort(files.begin(), files.end());
+    return true;
+}
+
+/******************************************************************************
+ * Method: expire
+ * Description: Remove the oldest finished files while they are past the max
+ * age or everything adds up to more than max bytes.  A file's time index
+ * and preallocation marker go with it.
+ *
+ * Parameters:
+ *   files - names from listFiles, oldest first
+ *   current - the open file, counted but never removed
+ ******************************************************************************/
+void LogArchiver::expire(const vector<string> &files, const string &current) {
+    vector<struct stat> info(files.size());
+    vector<bool> found(files.size());
+    string directory;
+    uint32_t maxAge;
+    uint64_t maxBytes, total = 0;
+    time_t now = time(NULL);
+
+    {
+        MutexLock lock(m_oLock);
+        directory = m_sDirectory;
+        maxAge = m_iMaxAge;
+        maxBytes = m_iMaxBytes;
+    }
+
+    for(size_t i = 0; i < files.size(); i++) {
+        found[i] = stat((directory + "/" + files[i]).c_str(), &info[i]) == 0;
+        if(found[i])
+            total += info[i].st_size;
+    }
+
+    for(size_t i = 0; i < files.size(); i++) {
+        if(!found[i] || unzipped(files[i]) >= current)
+            continue;
+
+        bool old = maxAge && now - info[i].st_mtime > (time_t)maxAge;
+        bool over = maxBytes && total > maxBytes;
+
+        if(!old && !over)
+            continue;
+
+        string path = directory + "/" + files[i];
+        if(unlink(path.c_str()) < 0) {
+            LOG(ERROR) << "failed to remove " << path << ": " << strerror(errno);
+            __atomic_add_fetch(&m_iFailed, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        unlink((directory + "/" + unzipped(files[i]) + LOG_INDEX_EXTENTION).c_str());
+        unlink((directory + "/" + unzipped(files[i]) + LOG_FILE_PREALLOC_EXTENTION).c_str());
+
+        LOG(INFO) << "removed " << path << (old ? ", past max age" : ", over max bytes");
+        __atomic_add_fetch(&m_iRemoved, 1, __ATOMIC_RELAXED);
+        total -= info[i].st_size;
+    }
+}
+
+/******************************************************************************
+ * Method: stopping
+ * Description: Has stop() been called?
+ ******************************************************************************/
+bool LogArchiver::stopping() {
+    return __atomic_load_n(&m_bStopping, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * Class: LogArchiver
+ * Filename: log_archiver.h
+ * License: Apache 2.0
+ *
+ * Compresses rolled log files and expires old ones on a thread of its own,
+ * so the thread writing the log never waits on it.
+ *
+ * The archiver looks after the files of one rolled LogFile, those named
+ * base.<date>[_<time>].ext in the base's directory.  It is the LogFile's
+ * listener, so it hears about each file as it is opened.  A LogFile closes
+ * the old file before it opens the new one, and the names sort in time
+ * order, so everything that sorts before the newest open file is finished
+ * with and safe to touch.
+ *
+ * Finished files are gzipped to <file>.gz, written to a temporary file and
+ * renamed so a half compressed file is never mistaken for a whole one.  A
+ * time index, <file>.idx, is left as it is, see log_index.h.  The
+ * retention policy then removes the oldest files, compressed or not, while
+ * they are older than the max age or the files add up to more than the max
+ * bytes.  The open file counts towards the total but is never removed.
+ *
+ * Usage:
+ *
+ * LogArchiver archiver;
+ * archiver.setBase("/tmp/port_agent_4001", "data");
+ * archiver.setCompression(6);
+ * archiver.setRetention(30 * 86400, 0);
+ * archiver.start();
+ *
+ * LogFile log("/tmp/port_agent_4001", "data", HOURLY);
+ * log.setListener(&archiver);
+ *
+ * archiver.stop();
+ ******************************************************************************/
+
+#ifndef __LOG_ARCHIVER_H_
+#define __LOG_ARCHIVER_H_
+
+#include "log_file.h"
+#include "mutex.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// How long the thread waits before scanning again if it isn't woken (ms)
+#define LOG_ARCHIVER_WAIT_TIMEOUT 60000
+
+// Highest gzip level
+#define LOG_ARCHIVER_MAX_LEVEL 9
+
+namespace logger {
+
+    typedef struct LogArchiverStats
+    {
+        uint64_t compressed;
+        uint64_t bytesIn;
+        uint64_t bytesOut;
+        uint64_t removed;
+        uint64_t failed;
+    } LogArchiverStats;
+
+    class LogArchiver : public LogFileListener {
+        public:
+            LogArchiver();
+            virtual ~LogArchiver();
+
+            // The rolled files to look after
+            void setBase(const string &filebase, const string &fileext = "");
+
+            // gzip level 1-9, 0 leaves files uncompressed
+            void setCompression(int level);
+            int compression() { return m_iLevel; }
+
+            // Remove files older than maxAge seconds or past maxBytes in
+            // total, 0 for no limit
+            void setRetention(uint32_t maxAge, uint64_t maxBytes);
+            uint32_t maxAge() { return m_iMaxAge; }
+            uint64_t maxBytes() { return m_iMaxBytes; }
+
+            bool start();
+            void stop();
+            bool running() { return m_bRunning; }
+
+            // Called by the LogFile, from the writing thread
+            virtual void logFileOpened(const string &file);
+
+            // One pass over the files.  The thread calls this, it is
+            // public so it can be run without one.
+            void archive();
+
+            // gzip file to file.gz and remove the original
+            bool compress(const string &file, int level);
+
+            LogArchiverStats stats();
+            string statsAsString();
+
+        private:
+            LogArchiver(const LogArchiver &rhs);
+            LogArchiver & operator=(const LogArchiver &rhs);
+
+            static void * archiverMain(void *arg);
+            void archiveLoop();
+
+            bool listFiles(vector<string> &files);
+            void expire(const vector<string> &files, const string &current);
+            bool stopping();
+
+        /////
+        // Members
+        /////
+
+        private:
+            // Settings and the newest open file, set from other threads
+            // with the lock held
+            Mutex m_oLock;
+            string m_sDirectory;
+            string m_sPrefix;
+            string m_sExtention;
+            string m_sCurrent;
+            int m_iLevel;
+            uint32_t m_iMaxAge;
+            uint64_t m_iMaxBytes;
+
+            // eventfd used to wake the thread
+            int m_iWakeFD;
+
+            pthread_t m_oThread;
+            bool m_bRunning;
+            bool m_bStopping;
+
+            // Counters, written by the archiver thread and read by any
+            uint64_t m_iCompressed;
+            uint64_t m_iBytesIn;
+            uint64_t m_iBytesOut;
+            uint64_t m_iRemoved;
+            uint64_t m_iFailed;
+    };
+}
+
+#endif //__LOG_ARCHIVER_H_
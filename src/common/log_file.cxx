@@ -16,6 +16,10 @@
  *
  * This class also overloads the stream insertion operator << so logs can
  * simply use this object to write to the log.
+ *
+ * Writes are flushed one at a time unless a commit policy is set, then they
+ * are committed in groups.  With preallocation set writes go through a
+ * memory mapped window of the file instead of the stream.  See log_file.h.
  * 
  * Usage:
  *
@@ -52,19 +56,46 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <limits>
 
 
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 using namespace std;
 using namespace logger;
 
+// Room in the stream buffer past the commit byte limit, so the write that
+// reaches the limit is still held
+#define LOG_FILE_BUFFER_SLACK 65536
+
+#define USEC_PER_MSEC 1000
+
+// Seconds between checks that the open file hasn't been removed or renamed
+#define LOG_FILE_CHECK_INTERVAL 1
+
+// Size of the mapped window, segments are rounded up to a multiple of it
+#define LOG_FILE_MAP_WINDOW (1024 * 1024)
+
+/******************************************************************************
+ * Function: monotonicNow
+ * Description: Monotonic time in microseconds for commit deadlines.
+ ******************************************************************************/
+static uint64_t monotonicNow() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 /******************************************************************************
  * Method: Default Constructor
  * Description: Default constructor.
  ******************************************************************************/
 LogFile::LogFile() {
-	m_pOutStream = NULL;
+	initialize();
 	m_eRotationType = DAILY;
 }
 
@@ -73,7 +104,7 @@ LogFile::LogFile() {
  * Description: Constructor to set log filename
  ******************************************************************************/
 LogFile::LogFile(string filename) {
-	m_pOutStream = NULL;
+	initialize();
 	setFile(filename);
 }
 
@@ -82,7 +113,7 @@ LogFile::LogFile(string filename) {
  * Description: Constructor to set log basename
  ******************************************************************************/
 LogFile::LogFile(string filebase, string extention, RotationType type) {
-	m_pOutStream = NULL;
+	initialize();
 	setBase(filebase, extention);
     setRotation(type);
 }
@@ -93,7 +124,7 @@ LogFile::LogFile(string filebase, string extention, RotationType type) {
  * lazily open.
  ******************************************************************************/
 LogFile::LogFile(const LogFile & rhs) {
-	m_pOutStream = NULL;
+	initialize();
 	copy(rhs);
 }
 
@@ -121,17 +152,54 @@ bool LogFile::operator==(const LogFile & rhs) const {
 		   m_eRotationType == rhs.m_eRotationType;
 }
 
+/******************************************************************************
+ * Method: initialize
+ * Description: Nothing open, writes flushed one at a time.
+ ******************************************************************************/
+void LogFile::initialize() {
+	m_pOutStream = NULL;
+	m_iSyncFD = -1;
+
+	m_iOpenDevice = 0;
+	m_iOpenInode = 0;
+	m_tRotateAt = 0;
+	m_tNextCheck = 0;
+
+	m_iSegmentSize = 0;
+	m_pListener = NULL;
+	m_iMapFD = -1;
+	m_pMap = NULL;
+	m_iMapOffset = 0;
+	m_iLength = 0;
+	m_iAllocated = 0;
+
+	m_iCommitDelay = 0;
+	m_iCommitBytes = 0;
+	m_iSyncInterval = 0;
+
+	m_iPendingBytes = 0;
+	m_iFirstPending = 0;
+	m_bSyncPending = false;
+	m_iLastSync = 0;
+}
+
 /******************************************************************************
  * Method: copy
  * Description: Copy one LogFile object to another.
  ******************************************************************************/
 void LogFile::copy(const LogFile & rhs) {
+	close();
+
 	m_sFileName = rhs.m_sFileName;
 	m_sFileBase = rhs.m_sFileBase;
 	m_sFileExtention = rhs.m_sFileExtention;
 	m_eRotationType = rhs.m_eRotationType;
 
-	m_pOutStream = NULL;
+	m_iCommitDelay = rhs.m_iCommitDelay;
+	m_iCommitBytes = rhs.m_iCommitBytes;
+	m_iSyncInterval = rhs.m_iSyncInterval;
+	m_iSegmentSize = rhs.m_iSegmentSize;
+	m_pListener = rhs.m_pListener;
 }
 
 /******************************************************************************
@@ -145,7 +213,10 @@ LogFile::~LogFile() {
 
 /******************************************************************************
  * Method: close
- * Description: Force the log file handle to close if it is open.
+ * Description: Force the log file handle to close if it is open.  Held
+ * writes go out first, and are synced if there is a sync interval.  A mapped
+ * file is truncated to the length written, dropping the preallocated tail,
+ * and its marker is removed once that has worked.
  ******************************************************************************/
 void LogFile::close()
 {
@@ -154,6 +225,36 @@ void LogFile::close()
     	delete m_pOutStream;
     	m_pOutStream = NULL;
     }
+
+    if(m_pMap) {
+        munmap(m_pMap, LOG_FILE_MAP_WINDOW);
+        m_pMap = NULL;
+    }
+
+    if(m_iMapFD >= 0) {
+        if(m_iAllocated != m_iLength && ftruncate(m_iMapFD, m_iLength) < 0)
+            LOG(ERROR) << "failed to truncate " << m_sOpenFile << ": " << strerror(errno);
+        else
+            unlink((m_sOpenFile + LOG_FILE_PREALLOC_EXTENTION).c_str());
+    }
+
+    if(m_iSyncInterval && (m_bSyncPending || m_iPendingBytes))
+        sync();
+
+    if(m_iSyncFD >= 0)
+        ::close(m_iSyncFD);
+
+    if(m_iMapFD >= 0)
+        ::close(m_iMapFD);
+
+    m_iSyncFD = -1;
+    m_iMapFD = -1;
+    m_iLength = 0;
+    m_iAllocated = 0;
+    m_iPendingBytes = 0;
+    m_bSyncPending = false;
+    m_sOpenFile = "";
+    m_tRotateAt = 0;
 }
 
 /******************************************************************************
@@ -164,6 +265,124 @@ void LogFile::flush()
 {
     if(m_pOutStream)
         m_pOutStream->flush();
+
+    if(m_iPendingBytes && m_iSyncInterval)
+        m_bSyncPending = true;
+
+    m_iPendingBytes = 0;
+}
+
+/******************************************************************************
+ * Method: setCommitPolicy
+ * Description: Set when held writes are committed.  The stream buffer is
+ * sized when the file is opened, so a changed policy commits and closes the
+ * file, the next write opens it again.
+ *
+ * Parameter:
+ *   maxDelay - longest a write is held, milliseconds.  0 flushes each write.
+ *   maxBytes - commit once this many bytes are held, 0 for no limit
+ *   syncInterval - fdatasync at most this often, milliseconds.  0 is never.
+ ******************************************************************************/
+void LogFile::setCommitPolicy(uint32_t maxDelay, uint32_t maxBytes, uint32_t syncInterval) {
+    if(m_iCommitDelay == maxDelay && m_iCommitBytes == maxBytes &&
+       m_iSyncInterval == syncInterval)
+        return;
+
+    close();
+
+    m_iCommitDelay = maxDelay;
+    m_iCommitBytes = maxBytes;
+    m_iSyncInterval = syncInterval;
+}
+
+/******************************************************************************
+ * Method: setPreallocation
+ * Description: Write through a memory mapped window, growing the file with
+ * fallocate segmentSize bytes at a time.  The segment is rounded up to a
+ * whole number of windows.  Switching backends closes the file, the next
+ * write opens it again.
+ *
+ * Parameter:
+ *   segmentSize - bytes to allocate at a time, 0 writes through the stream
+ ******************************************************************************/
+void LogFile::setPreallocation(uint32_t segmentSize) {
+    uint64_t size = segmentSize;
+
+    if(size % LOG_FILE_MAP_WINDOW)
+        size += LOG_FILE_MAP_WINDOW - size % LOG_FILE_MAP_WINDOW;
+
+    if(size > numeric_limits<uint32_t>::max())
+        size -= LOG_FILE_MAP_WINDOW;
+
+    if(m_iSegmentSize == size)
+        return;
+
+    close();
+    m_iSegmentSize = size;
+}
+
+/******************************************************************************
+ * Method: setListener
+ * Description: Set who is told about each file we open.  A new listener is
+ * told about the file that is open now.
+ *
+ * Parameter:
+ *   listener - not owned, NULL for no one
+ ******************************************************************************/
+void LogFile::setListener(LogFileListener *listener) {
+    if(m_pListener == listener)
+        return;
+
+    m_pListener = listener;
+
+    if(m_pListener && m_sOpenFile.length())
+        m_pListener->logFileOpened(m_sOpenFile);
+}
+
+/******************************************************************************
+ * Method: commitDelay
+ * Description: How long until held writes should be flushed or committed
+ * data synced.
+ *
+ * Parameter:
+ *   now - current monotonic time in microseconds
+ * Return:
+ *   microseconds to wait, 0 if a commit is due now or nothing is pending
+ ******************************************************************************/
+uint64_t LogFile::commitDelay(uint64_t now) {
+    uint64_t due = 0;
+    bool found = false;
+
+    if(m_iPendingBytes) {
+        due = m_iFirstPending + (uint64_t)m_iCommitDelay * USEC_PER_MSEC;
+        found = true;
+    }
+
+    if(m_bSyncPending) {
+        uint64_t sync = m_iLastSync + (uint64_t)m_iSyncInterval * USEC_PER_MSEC;
+        if(!found || sync < due)
+            due = sync;
+        found = true;
+    }
+
+    if(!found || due <= now)
+        return 0;
+
+    return due - now;
+}
+
+/******************************************************************************
+ * Method: commit
+ * Description: Flush held writes, then fdatasync if it has been a sync
+ * interval since the last one.
+ ******************************************************************************/
+void LogFile::commit() {
+    if(m_iPendingBytes)
+        flush();
+
+    if(m_bSyncPending &&
+       monotonicNow() >= m_iLastSync + (uint64_t)m_iSyncInterval * USEC_PER_MSEC)
+        sync();
 }
 
 /******************************************************************************
@@ -175,6 +394,16 @@ void LogFile::flush()
  *   string path to a log file.
  ******************************************************************************/
 string LogFile::getFilename() {
+    return getFilename(time(NULL));
+}
+
+/******************************************************************************
+ * Method: getLogFilename
+ * Description: Get the filename to write logs too at a given time.
+ * Return:
+ *   string path to a log file.
+ ******************************************************************************/
+string LogFile::getFilename(time_t now) {
     ostringstream out;
     
     // Explicit filename is set, no rolling
@@ -183,10 +412,10 @@ string LogFile::getFilename() {
     
 	// A file base is set, so return a rolled filename
     if(m_sFileBase.length()) {
-        out << m_sFileBase << "." << fileDate();
+        out << m_sFileBase << "." << fileDate(now);
 
         if(m_eRotationType != DAILY)
-		    out << "_" << fileTime();
+		    out << "_" << fileTime(now);
 			
 		if(m_sFileExtention.length())
         	out << "." << m_sFileExtention;
@@ -208,12 +437,15 @@ string LogFile::getFilename() {
  *   string serialized date YYYYMMDD
  ******************************************************************************/
 string LogFile::fileDate()
+{
+    return fileDate(time(NULL));
+}
+
+string LogFile::fileDate(time_t now)
 {
     char buffer[11];
-    time_t t;
-    time(&t);
     tm r = {0};
-    strftime(buffer, sizeof(buffer), "%Y%m%d", localtime_r(&t, &r));
+    strftime(buffer, sizeof(buffer), "%Y%m%d", localtime_r(&now, &r));
     return buffer;
 }
 
@@ -225,15 +457,19 @@ string LogFile::fileDate()
  *   string serialized time HH:MM:SS
  ******************************************************************************/
 string LogFile::fileTime()
+{
+    return fileTime(time(NULL));
+}
+
+string LogFile::fileTime(time_t now)
 {
     char buffer[7];
-	time_t ts;
-    time (&ts);
-    struct tm * timeinfo = localtime(&ts);
+    tm timeinfo = {0};
+    localtime_r(&now, &timeinfo);
   
-	int hour = timeinfo->tm_hour;
-	int min = timeinfo->tm_min;
-	int sec = timeinfo->tm_sec;
+	int hour = timeinfo.tm_hour;
+	int min = timeinfo.tm_min;
+	int sec = timeinfo.tm_sec;
 	
 	if(m_eRotationType == HOURLY) {
 		min = 0;
@@ -246,7 +482,7 @@ string LogFile::fileTime()
 	}
 	
 	if(m_eRotationType == MINUTE) {
-	    min = timeinfo->tm_min;
+	    min = timeinfo.tm_min;
 		sec = 0;
 	}
 	
@@ -254,11 +490,56 @@ string LogFile::fileTime()
 	return buffer;
 }
 
+/******************************************************************************
+ * Method: rotationDeadline
+ * Description: The first second after now that getFilename() returns a
+ * different name, the start of the next rotation period in local time.  An
+ * explicit file name never changes.
+ * Return:
+ *   time_t the deadline
+ ******************************************************************************/
+time_t LogFile::rotationDeadline(time_t now)
+{
+    tm t = {0};
+
+    if(m_sFileName.length() || !m_sFileBase.length())
+        return numeric_limits<time_t>::max();
+
+    localtime_r(&now, &t);
+
+    switch(m_eRotationType) {
+        case DAILY:
+            t.tm_mday++;
+            t.tm_hour = t.tm_min = t.tm_sec = 0;
+            break;
+        case HOURLY:
+            t.tm_hour++;
+            t.tm_min = t.tm_sec = 0;
+            break;
+        case QUARTER_HOURLY:
+            t.tm_min = (t.tm_min / 15) * 15 + 15;
+            t.tm_sec = 0;
+            break;
+        case MINUTE:
+            t.tm_min++;
+            t.tm_sec = 0;
+            break;
+        default:
+            t.tm_sec++;
+            break;
+    }
+
+    // Let mktime work out daylight saving for the new time
+    t.tm_isdst = -1;
+    time_t deadline = mktime(&t);
+
+    return deadline > now ? deadline : now + 1;
+}
+
 /******************************************************************************
  * Method: getLogStream
  * Description: return a pointer to an ofstream object for writing to a log
- * file (in append mode).  If the failure bit is set, or the log file no longer
- * exists we will create a new ofstream object.
+ * file (in append mode).  See openCurrent for when the file is reopened.
  * 
  * Return:
  *   ofstream reference to an ofstream object appending to the log file.
@@ -266,42 +547,277 @@ string LogFile::fileTime()
  * Exceptions:
  *   LoggerOpenFailure
  *   LoggerFileNotSet
+ *   NotImplemented - a preallocated file has no stream
  ******************************************************************************/
 ofstream * LogFile::getStreamObject() {
-	string file = getFilename();
+    if(mapped())
+        throw NotImplemented("preallocated log files have no stream");
 
-	// If we have a log file to write to then lets work on getting the ostream
-    if(! file.length())
-        throw LoggerFileNotSet();
+    openCurrent();
+    return m_pOutStream;
+}
+
+/******************************************************************************
+ * Method: openCurrent
+ * Description: Make sure the file we should be writing to is open.  Until
+ * the rotation deadline the open file is used as is, checking only every
+ * LOG_FILE_CHECK_INTERVAL seconds that it is still there.  If the stream
+ * failed, the log file no longer exists or it's time to roll we open it
+ * again, and tell the listener.
+ *
+ * Exceptions:
+ *   LoggerOpenFailure
+ *   LoggerFileNotSet
+ ******************************************************************************/
+void LogFile::openCurrent() {
+    time_t now = time(NULL);
+    bool open = mapped() ? m_iMapFD >= 0 : m_pOutStream && m_pOutStream->good();
+
+    if(open && now < m_tRotateAt) {
+        if(now < m_tNextCheck)
+            return;
 
-    // If we don't have an output stream create one.
-    if(!m_pOutStream) {
-    	m_pOutStream = new ofstream(file.c_str(), ios::out | ios::app);
+        m_tNextCheck = now + LOG_FILE_CHECK_INTERVAL;
+        if(!openFileMoved())
+            return;
 
-    	if(!m_pOutStream || m_pOutStream->fail())
-	        throw LoggerOpenFailure(strerror( errno ));
+        LOG(DEBUG) << m_sOpenFile << " removed or renamed, reopening";
+        close();
+        open = false;
     }
 
-    // Close the file if we have detected an error
-    else if(m_pOutStream->fail())
-    	close();
+	string file = getFilename(now);
+
+	// If we have a log file to write to then lets work on getting the ostream
+    if(! file.length())
+        throw LoggerFileNotSet();
 
-    // Explicitly check to see if the file still exists.  This will
-    // protect us if the file is removed or the file name has changed
-    // because it's time to roll.
-    if(! file_exists(file.c_str()))
-		close();
+    // Close the file if we have detected an error, it was removed or the
+    // file name has changed because it's time to roll.
+    if((m_pOutStream || m_iMapFD >= 0) &&
+       (!open || file != m_sOpenFile || openFileMoved())) {
+        close();
+        open = false;
+    }
 	
     // We can fall into this if the logfile was closed above OR this is
 	// our first call to this method.
-	if(!m_pOutStream || !m_pOutStream->good() ) {
-    	m_pOutStream = new ofstream(file.c_str(), ios::out | ios::app);
-	    
-	    if(m_pOutStream->fail())
-	        throw LoggerOpenFailure();
-	}
-	    
-    return m_pOutStream;
+	if(!open) {
+        if(mapped())
+            openMapped(file);
+        else
+    	    openStream(file);
+
+        if(m_pListener)
+            m_pListener->logFileOpened(file);
+    }
+
+    m_tRotateAt = rotationDeadline(now);
+    m_tNextCheck = now + LOG_FILE_CHECK_INTERVAL;
+}
+
+/******************************************************************************
+ * Method: openStream
+ * Description: Open an ofstream appending to file.  With group commit the
+ * stream gets a buffer big enough to hold everything until the commit.
+ *
+ * Exceptions:
+ *   LoggerOpenFailure
+ ******************************************************************************/
+void LogFile::openStream(const string &file) {
+    if(m_pOutStream)
+        close();
+
+    m_pOutStream = new ofstream();
+
+    if(groupCommit()) {
+        m_oStreamBuffer.resize(m_iCommitBytes + LOG_FILE_BUFFER_SLACK);
+        m_pOutStream->rdbuf()->pubsetbuf(&m_oStreamBuffer[0], m_oStreamBuffer.size());
+    }
+
+    m_pOutStream->open(file.c_str(), ios::out | ios::app);
+
+    if(m_pOutStream->fail()) {
+        int error = errno;
+        delete m_pOutStream;
+        m_pOutStream = NULL;
+        throw LoggerOpenFailure(strerror(error));
+    }
+
+    struct stat info;
+    if(stat(file.c_str(), &info) == 0) {
+        m_iOpenDevice = info.st_dev;
+        m_iOpenInode = info.st_ino;
+        m_iLength = info.st_size;
+    }
+
+    m_sOpenFile = file;
+}
+
+/******************************************************************************
+ * Method: openMapped
+ * Description: Open file for mapped writes, appending to what is there.  A
+ * file we didn't close cleanly still has its preallocated zeros, they are
+ * trimmed so the next write follows the data.  Only files with a marker are
+ * trimmed, a file closed cleanly or written by the stream keeps any zeros it
+ * ends with.  Unclean files are always a whole number of windows long, and
+ * the zeros are within the last segment.
+ *
+ * Exceptions:
+ *   LoggerOpenFailure
+ ******************************************************************************/
+void LogFile::openMapped(const string &file) {
+    struct stat info;
+
+    close();
+
+    m_iMapFD = ::open(file.c_str(), O_RDWR | O_CREAT, 0644);
+    if(m_iMapFD < 0 || fstat(m_iMapFD, &info) < 0) {
+        int error = errno;
+        close();
+        throw LoggerOpenFailure(strerror(error));
+    }
+
+    m_iOpenDevice = info.st_dev;
+    m_iOpenInode = info.st_ino;
+    m_sOpenFile = file;
+
+    m_iAllocated = info.st_size;
+    m_iLength = info.st_size;
+
+    if(m_iLength && m_iLength % LOG_FILE_MAP_WINDOW == 0 &&
+       stat((file + LOG_FILE_PREALLOC_EXTENTION).c_str(), &info) == 0) {
+        char buffer[4096];
+        uint64_t floor = m_iLength > m_iSegmentSize ? m_iLength - m_iSegmentSize : 0;
+
+        while(m_iLength > floor) {
+            uint64_t size = min((uint64_t)sizeof(buffer), m_iLength - floor);
+            if(pread(m_iMapFD, buffer, size, m_iLength - size) != (ssize_t)size)
+                break;
+
+            uint64_t i = size;
+            while(i && !buffer[i-1])
+                i--;
+
+            m_iLength -= size - i;
+            if(i)
+                break;
+        }
+
+        if(m_iLength != m_iAllocated)
+            LOG(WARNING) << file << " was not closed cleanly, trimmed "
+                         << m_iAllocated - m_iLength << " bytes of preallocation";
+    }
+}
+
+/******************************************************************************
+ * Method: mapWindow
+ * Description: Map the window holding offset, allocating another segment if
+ * the window runs past the end of the file.
+ *
+ * Exceptions:
+ *   LoggerWriteError
+ ******************************************************************************/
+void LogFile::mapWindow(uint64_t offset) {
+    uint64_t start = offset - offset % LOG_FILE_MAP_WINDOW;
+    uint64_t end = start + LOG_FILE_MAP_WINDOW;
+
+    if(m_pMap) {
+        munmap(m_pMap, LOG_FILE_MAP_WINDOW);
+        m_pMap = NULL;
+    }
+
+    if(end > m_iAllocated) {
+        markPreallocated();
+
+        uint64_t size = end + m_iSegmentSize - end % m_iSegmentSize;
+        if(end % m_iSegmentSize == 0)
+            size = end;
+
+        int error = posix_fallocate(m_iMapFD, m_iAllocated, size - m_iAllocated);
+        if(error)
+            throw LoggerWriteError(strerror(error));
+
+        m_iAllocated = size;
+    }
+
+    void *map = mmap(NULL, LOG_FILE_MAP_WINDOW, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, m_iMapFD, start);
+    if(map == MAP_FAILED)
+        throw LoggerWriteError(strerror(errno));
+
+    m_pMap = (char *)map;
+    m_iMapOffset = start;
+}
+
+/******************************************************************************
+ * Method: markPreallocated
+ * Description: Create the marker saying the open file has a preallocated
+ * tail, before the file is grown, so a crash never leaves zeros unmarked.
+ *
+ * Exceptions:
+ *   LoggerWriteError
+ ******************************************************************************/
+void LogFile::markPreallocated() {
+    string marker = m_sOpenFile + LOG_FILE_PREALLOC_EXTENTION;
+
+    int fd = ::open(marker.c_str(), O_WRONLY | O_CREAT, 0644);
+    if(fd < 0)
+        throw LoggerWriteError(strerror(errno));
+
+    ::close(fd);
+}
+
+/******************************************************************************
+ * Method: writeMapped
+ * Description: Copy into the mapped window at the end of the data, moving
+ * the window along as it fills.
+ ******************************************************************************/
+void LogFile::writeMapped(const char *buffer, uint32_t size) {
+    while(size) {
+        if(!m_pMap || m_iLength < m_iMapOffset ||
+           m_iLength >= m_iMapOffset + LOG_FILE_MAP_WINDOW)
+            mapWindow(m_iLength);
+
+        uint64_t offset = m_iLength - m_iMapOffset;
+        uint32_t count = min((uint64_t)size, LOG_FILE_MAP_WINDOW - offset);
+
+        memcpy(m_pMap + offset, buffer, count);
+        m_iLength += count;
+        buffer += count;
+        size -= count;
+    }
+}
+
+/******************************************************************************
+ * Method: writeData
+ * Description: Write to whichever backend is in use and account for it.
+ ******************************************************************************/
+void LogFile::writeData(const char *buffer, uint32_t size) {
+    openCurrent();
+
+    if(mapped())
+        writeMapped(buffer, size);
+    else {
+        m_pOutStream->write(buffer, size);
+        m_iLength += size;
+    }
+
+    written(size);
+}
+
+/******************************************************************************
+ * Method: openFileMoved
+ * Description: Has the open file been removed or renamed?  Another file
+ * may have taken its name, so compare the inode too.
+ ******************************************************************************/
+bool LogFile::openFileMoved() {
+    struct stat info;
+
+    if(stat(m_sOpenFile.c_str(), &info) < 0)
+        return true;
+
+    return info.st_dev != m_iOpenDevice || info.st_ino != m_iOpenInode;
 }
 
 /******************************************************************************
@@ -312,6 +828,7 @@ ofstream * LogFile::getStreamObject() {
  ******************************************************************************/
 void LogFile::setFile(string path) {
 	m_sFileName = path;
+	m_tRotateAt = 0;
 }
 
 /******************************************************************************
@@ -325,6 +842,7 @@ void LogFile::setBase(string path, string ext) {
 	m_sFileBase = path;
 	if(ext.length())
 		m_sFileExtention = ext;
+	m_tRotateAt = 0;
 }
 
 /******************************************************************************
@@ -335,6 +853,7 @@ void LogFile::setBase(string path, string ext) {
  ******************************************************************************/
 void LogFile::setRotation(RotationType type) {
 	m_eRotationType = type;
+	m_tRotateAt = 0;
 }
 
 /******************************************************************************
@@ -345,14 +864,22 @@ void LogFile::setRotation(RotationType type) {
  *   size - how big the buffer is
  ******************************************************************************/
 bool LogFile::write(const char *buffer, uint16_t size) {
-    ofstream *out = getStreamObject();
-    
-	out->write(buffer, size);
-	this->flush();
-	
+	writeData(buffer, size);
 	return true;
 }
 
+/******************************************************************************
+ * Method: position
+ * Description: The offset the next write lands at.  The file is opened, or
+ * rolled if it is time, first so this is the file the write goes to.
+ * Return:
+ *   bytes already in the file
+ ******************************************************************************/
+uint64_t LogFile::position() {
+    openCurrent();
+    return m_iLength;
+}
+
 /******************************************************************************
  * Method: operator<<
  * Description: overloaded stream operator so we can do logfile << "out";
@@ -360,18 +887,66 @@ bool LogFile::write(const char *buffer, uint16_t size) {
  *   a  - what we need to write.
  ******************************************************************************/
 LogFile & LogFile::operator<<(const string & a) {
-	ofstream *out = getStreamObject();
-    
-	*out << a;
-	out->flush();
-	
+	writeData(a.data(), a.length());
     return *this;
 }
 
 LogFile & LogFile::operator<<(std::ostream& (*pf) (std::ostream&)){
-	ofstream *out = getStreamObject();
-    *out << pf;
+	ostringstream out;
+    out << pf;
 	
-	out->flush();
+	writeData(out.str().data(), out.str().length());
     return *this;
 }
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: written
+ * Description: Account for bytes just written to the stream.  Without group
+ * commit they are flushed straight away, otherwise once max bytes are held.
+ * Mapped writes are already in the page cache, so there is nothing to hold.
+ ******************************************************************************/
+void LogFile::written(uint32_t size) {
+    if(!groupCommit() || mapped()) {
+        m_iPendingBytes = size;
+        flush();
+        return;
+    }
+
+    if(!m_iPendingBytes)
+        m_iFirstPending = monotonicNow();
+
+    m_iPendingBytes += size;
+
+    if(m_iCommitBytes && m_iPendingBytes >= m_iCommitBytes)
+        flush();
+}
+
+/******************************************************************************
+ * Method: sync
+ * Description: fdatasync the open file.  The stream doesn't give up its file
+ * descriptor, so we keep our own on the same file.  Failures are logged, the
+ * data is still written.
+ ******************************************************************************/
+void LogFile::sync() {
+    m_bSyncPending = false;
+    m_iLastSync = monotonicNow();
+
+    if(!m_sOpenFile.length())
+        return;
+
+    if(m_iMapFD >= 0) {
+        if(fdatasync(m_iMapFD) < 0)
+            LOG(ERROR) << "failed to sync " << m_sOpenFile << ": " << strerror(errno);
+        return;
+    }
+
+    if(m_iSyncFD < 0)
+        m_iSyncFD = ::open(m_sOpenFile.c_str(), O_WRONLY | O_APPEND);
+
+    if(m_iSyncFD < 0 || fdatasync(m_iSyncFD) < 0)
+        LOG(ERROR) << "failed to sync " << m_sOpenFile << ": " << strerror(errno);
+}
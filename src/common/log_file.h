@@ -9,13 +9,31 @@
  * roll files daily.
  *
  * A useful feature of this class is that it will store the ofstream object in
- * the class so the file isn't reopened for every write.  It checks to see if
- * the file we should be writting too still exists, if not it will reopen the
- * file.  We are attempting to put all the safe file handling code in this
- * object.
+ * the class so the file isn't reopened for every write.  The time the file
+ * name next changes is worked out when the file is opened, until then writes
+ * go straight to the open stream.  Once a second or so it checks the file we
+ * are writting too still exists, if it was removed or renamed it will reopen
+ * the file.  We are attempting to put all the safe file handling code in
+ * this object.
  *
  * This class also overloads the stream insertion operator << so logs can
  * simply use this object to write to the log.
+ *
+ * By default every write is flushed to the file.  With a commit policy set
+ * writes are held in the stream buffer and committed together once the
+ * oldest has waited the max delay or max bytes are waiting (group commit).
+ * A sync interval adds an fdatasync at most that often, bounding how much a
+ * crash can lose.  Like PublishBatch there is no timer here, the owner
+ * checks commitDelay() and calls commit().
+ *
+ * With preallocation set the stream isn't used.  The file is grown with
+ * fallocate a segment at a time and written through a memory mapped window,
+ * so appends don't update file metadata.  It is truncated to the length
+ * written when it is closed or rolled.  While the file has a preallocated
+ * tail a marker file, <file>.prealloc, sits next to it.  If the process dies
+ * first the file is left with zeros after the data and the marker says so,
+ * the zeros are trimmed when it is reopened.  A file without the marker is
+ * never trimmed, its data may end in zeros.
  * 
  * Usage:
  *
@@ -39,6 +57,15 @@
  *   // Or just use the stream insertion operator
  *   file << "Write something to the file";
  *
+ *   // Commit at least once a second or every 64k, sync every 10 seconds
+ *   file.setCommitPolicy(1000, 65536, 10000);
+ *
+ *   // Or write through mmap, allocating 16M at a time
+ *   file.setPreallocation(16 * 1024 * 1024);
+ *
+ *   if(file.pending())
+ *       // call file.commit() in file.commitDelay(now) us
+ *
  ******************************************************************************/
 
 #ifndef __LOG_FILE_H__
@@ -47,15 +74,21 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/types.h>
 
 #include "exception.h"
 
 using namespace std;
 
+// Marks a mapped file that still has its preallocated tail
+#define LOG_FILE_PREALLOC_EXTENTION ".prealloc"
+
 namespace logger {
 	/* Log rotation types */
 	enum RotationType {
@@ -66,6 +99,13 @@ namespace logger {
 		SECOND // for testing
 	};
 	
+	/* Told about each file a LogFile opens, see LogArchiver */
+	class LogFileListener {
+		public:
+			virtual ~LogFileListener() {}
+			virtual void logFileOpened(const string &file) = 0;
+	};
+
 	class LogFile
 	{
 		public:
@@ -123,14 +163,65 @@ namespace logger {
 			// Raw write to the output file
 			bool write(const char *buffer, uint16_t size);
 
+			// Where the next write goes in the file it goes to, rolling or
+			// opening it first
+			uint64_t position();
+			const string & openFile() { return m_sOpenFile; }
+
+			// Group commit writes, delays are in milliseconds.  A max delay
+			// of 0 flushes every write, max bytes of 0 means no byte limit
+			// and a sync interval of 0 never calls fdatasync.
+			void setCommitPolicy(uint32_t maxDelay, uint32_t maxBytes, uint32_t syncInterval = 0);
+			bool groupCommit() { return m_iCommitDelay > 0; }
+			uint32_t maxDelay() { return m_iCommitDelay; }
+			uint32_t maxBytes() { return m_iCommitBytes; }
+			uint32_t syncInterval() { return m_iSyncInterval; }
+
+			// Preallocate segments of this many bytes and write through
+			// mmap instead of the stream.  0 uses the stream.
+			void setPreallocation(uint32_t segmentSize);
+			uint32_t preallocation() { return m_iSegmentSize; }
+			bool mapped() { return m_iSegmentSize > 0; }
+
+			// Tell listener about each file opened, NULL for no one.  The
+			// listener isn't owned.
+			void setListener(LogFileListener *listener);
+			LogFileListener * listener() { return m_pListener; }
+
+			// Is written data waiting to be committed or synced?
+			bool pending() { return m_iPendingBytes > 0 || m_bSyncPending; }
+
+			// Microseconds from now until a commit is due
+			uint64_t commitDelay(uint64_t now);
+
+			// Flush held writes, and fdatasync if the sync interval is up
+			void commit();
+
 			// Get a date to use for file rotation.
 			string fileDate();
+			string fileDate(time_t now);
 
 			// Get a time to use for file rotation.
 			string fileTime();
+			string fileTime(time_t now);
+
+			// When the rolled file name next changes
+			time_t rotationDeadline(time_t now);
 
 		private:
+			void initialize();
 			void copy(const LogFile & rhs);
+			void openCurrent();
+			void openStream(const string &file);
+			void openMapped(const string &file);
+			void mapWindow(uint64_t offset);
+			void writeMapped(const char *buffer, uint32_t size);
+			void writeData(const char *buffer, uint32_t size);
+			void markPreallocated();
+			string getFilename(time_t now);
+			bool openFileMoved();
+			void written(uint32_t size);
+			void sync();
 
 			/******************
 			 * Public Members *
@@ -147,6 +238,44 @@ namespace logger {
 		    string m_sFileBase;
 		    string m_sFileExtention;
 
+		    // The file the stream has open, and its identity so we notice it
+		    // being removed or renamed
+		    string m_sOpenFile;
+		    dev_t m_iOpenDevice;
+		    ino_t m_iOpenInode;
+
+		    // The open file is used until the rotation deadline, checking it
+		    // is still there at the next check time
+		    time_t m_tRotateAt;
+		    time_t m_tNextCheck;
+		    vector<char> m_oStreamBuffer;
+		    int m_iSyncFD;
+
+		    // Length of the data in the open file.  For preallocated, mapped
+		    // output allocated is the file size.
+		    uint32_t m_iSegmentSize;
+		    int m_iMapFD;
+		    char *m_pMap;
+		    uint64_t m_iMapOffset;
+		    uint64_t m_iLength;
+		    uint64_t m_iAllocated;
+
+		    LogFileListener *m_pListener;
+
+		    // Commit policy
+		    uint32_t m_iCommitDelay;
+		    uint32_t m_iCommitBytes;
+		    uint32_t m_iSyncInterval;
+
+		    // Bytes written since the last commit, and when the first of
+		    // them was written (monotonic microseconds)
+		    uint32_t m_iPendingBytes;
+		    uint64_t m_iFirstPending;
+
+		    // Committed data not synced yet
+		    bool m_bSyncPending;
+		    uint64_t m_iLastSync;
+
 	};
 
     // overload the output operator
@@ -0,0 +1,203 @@
+/*******************************************************************************
+ * Class: LogIndexWriter, LogIndexReader
+ * Filename: log_index.cxx
+ * License: Apache 2.0
+ *
+ * Time index sidecar files for data logs.  See log_index.h for the format
+ * and usage.
+ ******************************************************************************/
+#include "log_index.h"
+#include "logger.h"
+#include "exception.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string.h>
+#include <endian.h>
+
+using namespace std;
+using namespace logger;
+
+/******************************************************************************
+ * Function: ntpTime
+ * Description: Seconds and fraction as one number that orders by time.
+ ******************************************************************************/
+uint64_t logger::ntpTime(Timestamp ts) {
+    return (uint64_t)ts.seconds() << 32 | ts.fraction();
+}
+
+/******************************************************************************
+ * Function: timeBefore
+ * Description: Order entries by timestamp for the binary searches.
+ ******************************************************************************/
+static bool timeBefore(uint64_t timestamp, const LogIndexEntry &entry) {
+    return timestamp < entry.timestamp;
+}
+
+/******************************************************************************
+ *   LogIndexWriter
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ * Description: Off until a policy is set.
+ ******************************************************************************/
+LogIndexWriter::LogIndexWriter() {
+    m_iPackets = 0;
+    m_iInterval = 0;
+    m_iCount = 0;
+    m_iLast = 0;
+}
+
+/******************************************************************************
+ * Method: setPolicy
+ * Description: Set how often entries are written.
+ *
+ * Parameters:
+ *   packets - an entry at least every this many packets, 0 for no limit
+ *   interval - an entry at least every this many seconds, 0 for no limit
+ ******************************************************************************/
+void LogIndexWriter::setPolicy(uint32_t packets, uint32_t interval) {
+    m_iPackets = packets;
+    m_iInterval = interval;
+
+    if(!enabled())
+        close();
+}
+
+/******************************************************************************
+ * Method: record
+ * Description: Called before each packet is written.  The first packet in a
+ * data file always gets an entry, after that one is written once the packet
+ * or time limit is reached.  A packet stamped before the last entry is
+ * counted but never indexed, so entries stay in time order.
+ *
+ * Parameters:
+ *   dataFile - the data log the packet is going into
+ *   offset - where it will start in that file
+ *   ts - the packet's timestamp
+ * Exceptions:
+ *   LoggerOpenFailure
+ ******************************************************************************/
+void LogIndexWriter::record(const string &dataFile, uint64_t offset, Timestamp ts) {
+    uint64_t timestamp = ntpTime(ts);
+    LogIndexEntry entry;
+
+    if(!enabled())
+        return;
+
+    if(dataFile != m_sDataFile) {
+        m_sDataFile = dataFile;
+        m_oIndex.setFile(dataFile + LOG_INDEX_EXTENTION);
+        m_iLast = 0;
+    }
+    else {
+        m_iCount++;
+
+        bool due = (m_iPackets && m_iCount >= m_iPackets) ||
+                   (m_iInterval && timestamp >= m_iLast + ((uint64_t)m_iInterval << 32));
+
+        if(!due || timestamp < m_iLast)
+            return;
+    }
+
+    entry.timestamp = htobe64(timestamp);
+    entry.offset = htobe64(offset);
+    m_oIndex.write((const char *)&entry, LOG_INDEX_ENTRY_SIZE);
+
+    m_iCount = 0;
+    m_iLast = timestamp;
+}
+
+/******************************************************************************
+ * Method: close
+ * Description: Close the index file, the next record starts a new one.
+ ******************************************************************************/
+void LogIndexWriter::close() {
+    m_oIndex.close();
+    m_sDataFile = "";
+}
+
+/******************************************************************************
+ *   LogIndexReader
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ * Description: Reader for the index of dataFile, nothing is read until
+ * load() is called.  A compressed file.gz uses the index of file.
+ ******************************************************************************/
+LogIndexReader::LogIndexReader(const string &dataFile) {
+    string name = dataFile;
+
+    if(name.length() > 3 && name.compare(name.length() - 3, 3, ".gz") == 0)
+        name.erase(name.length() - 3);
+
+    m_sIndexFile = name + LOG_INDEX_EXTENTION;
+}
+
+/******************************************************************************
+ * Method: load
+ * Description: Read every entry.  A partial entry at the end, from a write
+ * cut short, is ignored.
+ * Return:
+ *   false if the index can't be read
+ ******************************************************************************/
+bool LogIndexReader::load() {
+    ifstream in(m_sIndexFile.c_str(), ios::in | ios::binary);
+    LogIndexEntry entry;
+
+    m_oEntries.clear();
+
+    if(!in.good())
+        return false;
+
+    while(in.read((char *)&entry, LOG_INDEX_ENTRY_SIZE)) {
+        entry.timestamp = be64toh(entry.timestamp);
+        entry.offset = be64toh(entry.offset);
+        m_oEntries.push_back(entry);
+    }
+
+    LOG(DEBUG) << "loaded " << m_oEntries.size() << " index entries from " << m_sIndexFile;
+    return true;
+}
+
+/******************************************************************************
+ * Method: seek
+ * Description: Binary search for the last entry at or before start.  Reading
+ * from its offset, packets before start still have to be skipped but none
+ * at or after start are missed.
+ * Return:
+ *   byte offset, 0 if start is before the first entry
+ ******************************************************************************/
+uint64_t LogIndexReader::seek(uint64_t start) {
+    vector<LogIndexEntry>::iterator i =
+        upper_bound(m_oEntries.begin(), m_oEntries.end(), start, timeBefore);
+
+    if(i == m_oEntries.begin())
+        return 0;
+
+    return (i - 1)->offset;
+}
+
+/******************************************************************************
+ * Method: range
+ * Description: The bytes to read for packets from start to end.  The range
+ * ends at the first entry after end.
+ *
+ * Parameters:
+ *   start, end - NTP timestamps, see ntpTime()
+ *   from - set to the offset to start reading at
+ *   to - set to the offset to stop at, 0 for the end of the file
+ * Return:
+ *   false if the file starts after end
+ ******************************************************************************/
+bool LogIndexReader::range(uint64_t start, uint64_t end, uint64_t &from, uint64_t &to) {
+    vector<LogIndexEntry>::iterator i =
+        upper_bound(m_oEntries.begin(), m_oEntries.end(), end, timeBefore);
+
+    from = seek(start);
+    to = i == m_oEntries.end() ? 0 : i->offset;
+
+    return i != m_oEntries.begin() || i == m_oEntries.end() || i->offset != 0;
+}
@@ -0,0 +1,123 @@
+/*******************************************************************************
+ * Class: LogIndexWriter, LogIndexReader
+ * Filename: log_index.h
+ * License: Apache 2.0
+ *
+ * A sidecar index for data log files, so a time range can be found without
+ * decoding the whole file.  Each data file gets <file>.idx next to it, a
+ * list of fixed size entries mapping a packet's NTP timestamp to the byte
+ * offset it was written at:
+ *
+ * timestamp        64 bits, NTP seconds and fraction as in the packet header
+ * offset           64 bits, bytes from the start of the data file
+ *
+ * both big endian.  An entry is written for the first packet in each file,
+ * then every N packets or M seconds of packet time, whichever comes first.
+ * Entries only ever go forward in time, a packet stamped before the last
+ * entry doesn't get one, so the reader can binary search them.
+ *
+ * The index is flushed with each entry but the data log may hold writes, so
+ * after a crash the last entries can point past the end of the data.
+ *
+ * When the LogArchiver compresses file to file.gz the index stays as
+ * file.idx and its offsets still count bytes of the uncompressed data.  A
+ * reader given file.gz loads file.idx, read the data through gzip and
+ * gzseek() to the offsets.
+ *
+ * Usage:
+ *
+ * LogIndexWriter index;
+ * index.setPolicy(1000, 1);
+ *
+ * // before writing each packet
+ * index.record(log.openFile(), log.position(), packet->timestamp());
+ *
+ * LogIndexReader reader("/tmp/port_agent_4001.20260101.data");
+ * // or "/tmp/port_agent_4001.20260101.data.gz"
+ * uint64_t from, to;
+ * if(reader.load() && reader.range(start, end, from, to))
+ *     // read from..to, to of 0 is the end of the file
+ ******************************************************************************/
+
+#ifndef __LOG_INDEX_H_
+#define __LOG_INDEX_H_
+
+#include "log_file.h"
+#include "timestamp.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define LOG_INDEX_EXTENTION  ".idx"
+#define LOG_INDEX_ENTRY_SIZE 16
+
+namespace logger {
+
+    typedef struct LogIndexEntry
+    {
+        uint64_t timestamp;
+        uint64_t offset;
+    } LogIndexEntry;
+
+    // NTP timestamp as a single number, seconds in the high 32 bits
+    uint64_t ntpTime(Timestamp ts);
+
+    class LogIndexWriter {
+        public:
+            LogIndexWriter();
+
+            // Index every packets packets or interval seconds, 0 for no
+            // limit.  Both 0 turns the index off.
+            void setPolicy(uint32_t packets, uint32_t interval);
+            bool enabled() { return m_iPackets || m_iInterval; }
+            uint32_t packets() { return m_iPackets; }
+            uint32_t interval() { return m_iInterval; }
+
+            // A packet stamped ts is about to be written to dataFile at
+            // offset.  Adds an entry if one is due.
+            void record(const string &dataFile, uint64_t offset, Timestamp ts);
+
+            void close();
+
+        private:
+            LogFile m_oIndex;
+            string m_sDataFile;
+
+            uint32_t m_iPackets;
+            uint32_t m_iInterval;
+
+            // Packets since the last entry, and its timestamp
+            uint32_t m_iCount;
+            uint64_t m_iLast;
+    };
+
+    class LogIndexReader {
+        public:
+            // dataFile may be compressed, see above
+            LogIndexReader(const string &dataFile);
+
+            // Read the whole index, false if there isn't one
+            bool load();
+
+            size_t size() { return m_oEntries.size(); }
+            const LogIndexEntry & entry(size_t i) { return m_oEntries[i]; }
+
+            // Offset to start reading at to see everything from start on
+            uint64_t seek(uint64_t start);
+            uint64_t seek(Timestamp start) { return seek(ntpTime(start)); }
+
+            // Byte range holding everything from start to end.  to is 0 if
+            // the range runs to the end of the file.  False if the whole
+            // file is after end.
+            bool range(uint64_t start, uint64_t end, uint64_t &from, uint64_t &to);
+
+        private:
+            string m_sIndexFile;
+            vector<LogIndexEntry> m_oEntries;
+    };
+}
+
+#endif //__LOG_INDEX_H_
@@ -50,6 +50,7 @@
 #include "logger.h"
 #include "util.h"
 #include "exception.h"
+#include "mutex.h"
 
 #include <sstream>
 #include <iostream>
@@ -68,6 +69,9 @@ using namespace logger;
 // Global static pointer used to ensure a single instance of the class.
 Logger* Logger::m_pInstance = NULL;
 
+// Serialize writes when messages are logged from more than one thread.
+static Mutex s_oWriteLock;
+
 /******************************************************************************
  *   PUBLIC METHODS
  ******************************************************************************/
@@ -147,6 +151,7 @@ string Logger::getLogFilename() {
  * Description: Write a log message to the log file
  ******************************************************************************/
 void Logger::WriteLog(string message, TLogLevel level, string file, int line) {
+    MutexLock lock(s_oWriteLock);
     Logger* instance = Logger::Instance();
     
     instance->clearError();
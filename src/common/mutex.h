@@ -0,0 +1,51 @@
+/*******************************************************************************
+ * Class: Mutex, MutexLock
+ * Filename: mutex.h
+ * License: Apache 2.0
+ *
+ * Thin wrapper around a pthread mutex and a scoped lock to go with it.
+ *
+ * Usage:
+ *
+ * Mutex lock;
+ *
+ * {
+ *     MutexLock guard(lock);
+ *     // lock is held until guard goes out of scope
+ * }
+ ******************************************************************************/
+
+#ifndef __MUTEX_H_
+#define __MUTEX_H_
+
+#include <pthread.h>
+
+class Mutex {
+    public:
+        Mutex() { pthread_mutex_init(&m_oMutex, NULL); }
+        ~Mutex() { pthread_mutex_destroy(&m_oMutex); }
+
+        void lock() { pthread_mutex_lock(&m_oMutex); }
+        void unlock() { pthread_mutex_unlock(&m_oMutex); }
+        bool tryLock() { return pthread_mutex_trylock(&m_oMutex) == 0; }
+
+    private:
+        Mutex(const Mutex &rhs);
+        Mutex & operator=(const Mutex &rhs);
+
+        pthread_mutex_t m_oMutex;
+};
+
+class MutexLock {
+    public:
+        MutexLock(Mutex &mutex) : m_oMutex(mutex) { m_oMutex.lock(); }
+        ~MutexLock() { m_oMutex.unlock(); }
+
+    private:
+        MutexLock(const MutexLock &rhs);
+        MutexLock & operator=(const MutexLock &rhs);
+
+        Mutex &m_oMutex;
+};
+
+#endif //__MUTEX_H_
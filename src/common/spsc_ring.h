@@ -0,0 +1,105 @@
+/*******************************************************************************
+ * Class: SPSCRing
+ * Filename: spsc_ring.h
+ * License: Apache 2.0
+ *
+ * Bounded, lock-free ring buffer for handing items from exactly one producer
+ * thread to exactly one consumer thread.  Neither side ever blocks: push
+ * fails when the ring is full and pop fails when it is empty.
+ *
+ * The head index is only written by the consumer and the tail index only by
+ * the producer.  Each side publishes its index with a release store and reads
+ * the other side's with an acquire load, so a slot is never read before it
+ * has been written.
+ *
+ * The capacity is rounded up to a power of two.
+ *
+ * Usage:
+ *
+ * SPSCRing<Packet *> ring(1024);
+ *
+ * // Producer thread
+ * if(!ring.push(packet))
+ *     delete packet;    // full, drop it
+ *
+ * // Consumer thread
+ * Packet *packet;
+ * while(ring.pop(packet))
+ *     publish(packet);
+ ******************************************************************************/
+
+#ifndef __SPSC_RING_H_
+#define __SPSC_RING_H_
+
+#include <stdint.h>
+
+template <class T>
+class SPSCRing {
+    public:
+        SPSCRing(uint32_t capacity) : m_iHead(0), m_iTail(0) {
+            m_iCapacity = 1;
+            while(m_iCapacity < capacity)
+                m_iCapacity <<= 1;
+
+            m_iMask = m_iCapacity - 1;
+            m_pSlots = new T[m_iCapacity];
+        }
+
+        ~SPSCRing() { delete [] m_pSlots; }
+
+        uint32_t capacity() { return m_iCapacity; }
+
+        // Approximate when called from a thread other than the producer or
+        // consumer, exact otherwise.
+        uint32_t size() {
+            uint32_t tail = __atomic_load_n(&m_iTail, __ATOMIC_ACQUIRE);
+            uint32_t head = __atomic_load_n(&m_iHead, __ATOMIC_ACQUIRE);
+            return tail - head;
+        }
+
+        bool empty() { return size() == 0; }
+
+        // Producer only
+        bool push(const T &item) {
+            uint32_t tail = m_iTail;
+            uint32_t head = __atomic_load_n(&m_iHead, __ATOMIC_ACQUIRE);
+
+            if(tail - head >= m_iCapacity)
+                return false;
+
+            m_pSlots[tail & m_iMask] = item;
+            __atomic_store_n(&m_iTail, tail + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        // Consumer only
+        bool pop(T &item) {
+            uint32_t head = m_iHead;
+            uint32_t tail = __atomic_load_n(&m_iTail, __ATOMIC_ACQUIRE);
+
+            if(head == tail)
+                return false;
+
+            item = m_pSlots[head & m_iMask];
+            __atomic_store_n(&m_iHead, head + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+    private:
+        SPSCRing(const SPSCRing &rhs);
+        SPSCRing & operator=(const SPSCRing &rhs);
+
+        T *m_pSlots;
+        uint32_t m_iCapacity;
+        uint32_t m_iMask;
+
+        // Keep the indexes on separate cache lines so the producer and
+        // consumer don't bounce a shared line on every operation.
+        char m_aPad0[64];
+        uint32_t m_iHead;
+        char m_aPad1[64];
+        uint32_t m_iTail;
+        char m_aPad2[64];
+};
+
+#endif //__SPSC_RING_H_
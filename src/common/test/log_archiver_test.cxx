@@ -0,0 +1,256 @@
+#include "common/logger.h"
+#include "common/log_file.h"
+#include "common/log_archiver.h"
+#include "common/log_index.h"
+#include "common/util.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <zlib.h>
+#include <sys/stat.h>
+
+using namespace std;
+using namespace logger;
+
+#define ARCHIVE_DIR  "/tmp/gtest_archiver"
+#define ARCHIVE_BASE ARCHIVE_DIR "/data"
+
+class LogArchiverTest : public testing::Test {
+
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile("/tmp/gtest.log");
+            Logger::SetLogLevel("DEBUG");
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "            LogArchiverTest Start Up";
+            LOG(INFO) << "************************************************";
+
+            clean();
+            mkdir(ARCHIVE_DIR, 0755);
+        }
+
+        virtual void TearDown() {
+            clean();
+        }
+
+        void clean() {
+            DIR *dir = opendir(ARCHIVE_DIR);
+            struct dirent *entry;
+
+            if(!dir)
+                return;
+
+            while((entry = readdir(dir)) != NULL)
+                unlink((string(ARCHIVE_DIR) + "/" + entry->d_name).c_str());
+
+            closedir(dir);
+            rmdir(ARCHIVE_DIR);
+        }
+
+        string path(const string &name) {
+            return string(ARCHIVE_DIR) + "/" + name;
+        }
+
+        bool exists(const string &name) {
+            struct stat info;
+            return stat(path(name).c_str(), &info) == 0;
+        }
+
+        vector<string> list() {
+            vector<string> files;
+            DIR *dir = opendir(ARCHIVE_DIR);
+            struct dirent *entry;
+
+            while(dir && (entry = readdir(dir)) != NULL)
+                if(entry->d_name[0] != '.')
+                    files.push_back(entry->d_name);
+
+            if(dir)
+                closedir(dir);
+
+            sort(files.begin(), files.end());
+            return files;
+        }
+
+        string gunzip(const string &name) {
+            string result;
+            char buffer[1024];
+            int count;
+
+            gzFile in = gzopen(path(name).c_str(), "rb");
+            if(!in)
+                return result;
+
+            while((count = gzread(in, buffer, sizeof(buffer))) > 0)
+                result.append(buffer, count);
+
+            gzclose(in);
+            return result;
+        }
+};
+
+/* Only finished files are compressed, and only once the open file is known */
+TEST_F(LogArchiverTest, Compress) {
+    LogArchiver archiver;
+    string content(100000, 'a');
+
+    create_file(path("data.20260101.data").c_str(), content.c_str());
+    create_file(path("data.20260102.data").c_str(), "second");
+    create_file(path("data.20260103.data").c_str(), "current");
+    create_file(path("data.20260101.log").c_str(), "other");
+    create_file(path("other.20260101.data").c_str(), "other");
+    create_file(path("data.20251231.data.gz.tmp").c_str(), "partial");
+    create_file(path("other.20251231.data.gz.tmp").c_str(), "partial");
+
+    archiver.setBase(ARCHIVE_BASE, "data");
+    archiver.setCompression(6);
+    EXPECT_EQ(archiver.compression(), 6);
+
+    archiver.archive();
+    EXPECT_TRUE(exists("data.20260101.data"));
+
+    archiver.logFileOpened(path("data.20260103.data"));
+    archiver.archive();
+
+    EXPECT_FALSE(exists("data.20260101.data"));
+    EXPECT_FALSE(exists("data.20260102.data"));
+    EXPECT_EQ(gunzip("data.20260101.data.gz"), content);
+    EXPECT_EQ(gunzip("data.20260102.data.gz"), "second");
+
+    EXPECT_EQ(read_file(path("data.20260103.data").c_str()), "current");
+    EXPECT_TRUE(exists("data.20260101.log"));
+    EXPECT_TRUE(exists("other.20260101.data"));
+
+    // A compression cut short by a crash is cleaned up, others' are left
+    EXPECT_FALSE(exists("data.20251231.data.gz.tmp"));
+    EXPECT_TRUE(exists("other.20251231.data.gz.tmp"));
+
+    LogArchiverStats stats = archiver.stats();
+    EXPECT_EQ(stats.compressed, 2);
+    EXPECT_EQ(stats.bytesIn, content.length() + 6);
+    EXPECT_LT(stats.bytesOut, stats.bytesIn);
+    EXPECT_EQ(stats.failed, 0);
+}
+
+/* The time index of a compressed file still finds its packets */
+TEST_F(LogArchiverTest, CompressIndexed) {
+    LogArchiver archiver;
+    LogIndexWriter writer;
+    char buffer[16];
+    gzFile in;
+
+    create_file(path("data.20260101.data").c_str(), "first packet second");
+    writer.setPolicy(1, 0);
+    writer.record(path("data.20260101.data"), 0, Timestamp(100, 0));
+    writer.record(path("data.20260101.data"), 13, Timestamp(200, 0));
+    writer.close();
+
+    archiver.setBase(ARCHIVE_BASE, "data");
+    archiver.setCompression(6);
+    archiver.logFileOpened(path("data.20260102.data"));
+    archiver.archive();
+
+    ASSERT_TRUE(exists("data.20260101.data.gz"));
+    EXPECT_TRUE(exists("data.20260101.data" LOG_INDEX_EXTENTION));
+    EXPECT_FALSE(exists("data.20260101.data.gz" LOG_INDEX_EXTENTION));
+
+    LogIndexReader reader(path("data.20260101.data.gz"));
+    ASSERT_TRUE(reader.load());
+    ASSERT_EQ(reader.size(), 2);
+
+    in = gzopen(path("data.20260101.data.gz").c_str(), "rb");
+    ASSERT_TRUE(in != NULL);
+    EXPECT_EQ(gzseek(in, reader.seek(Timestamp(250, 0)), SEEK_SET), 13);
+    EXPECT_EQ(gzread(in, buffer, sizeof(buffer)), 6);
+    EXPECT_EQ(string(buffer, 6), "second");
+    gzclose(in);
+}
+
+/* The oldest files go first until the total fits, the open file stays */
+TEST_F(LogArchiverTest, RetentionBytes) {
+    LogArchiver archiver;
+
+    create_file(path("data.20260101.data").c_str(), "1111111111");
+    create_file(path("data.20260102.data.gz").c_str(), "2222222222");
+    create_file(path("data.20260103.data").c_str(), "3333333333");
+    create_file(path("data.20260104.data").c_str(), "4444444444");
+    create_file(path("data.20260101.data.idx").c_str(), "index");
+
+    archiver.setBase(ARCHIVE_BASE, "data");
+    archiver.setRetention(0, 25);
+    archiver.logFileOpened(path("data.20260104.data"));
+    archiver.archive();
+
+    EXPECT_FALSE(exists("data.20260101.data"));
+    EXPECT_FALSE(exists("data.20260101.data.idx"));
+    EXPECT_FALSE(exists("data.20260102.data.gz"));
+    EXPECT_TRUE(exists("data.20260103.data"));
+    EXPECT_TRUE(exists("data.20260104.data"));
+    EXPECT_EQ(archiver.stats().removed, 2);
+
+    // Even over the limit the open file is kept
+    archiver.setRetention(0, 1);
+    archiver.archive();
+    EXPECT_FALSE(exists("data.20260103.data"));
+    EXPECT_TRUE(exists("data.20260104.data"));
+}
+
+/* Files last written before the max age are removed */
+TEST_F(LogArchiverTest, RetentionAge) {
+    LogArchiver archiver;
+    struct utimbuf old;
+
+    create_file(path("data.20260101.data").c_str(), "old");
+    create_file(path("data.20260102.data").c_str(), "new");
+    create_file(path("data.20260103.data").c_str(), "current");
+
+    old.actime = old.modtime = time(NULL) - 7200;
+    utime(path("data.20260101.data").c_str(), &old);
+    utime(path("data.20260103.data").c_str(), &old);
+
+    archiver.setBase(ARCHIVE_BASE, "data");
+    archiver.setRetention(3600, 0);
+    archiver.logFileOpened(path("data.20260103.data"));
+    archiver.archive();
+
+    EXPECT_FALSE(exists("data.20260101.data"));
+    EXPECT_TRUE(exists("data.20260102.data"));
+    EXPECT_TRUE(exists("data.20260103.data"));
+}
+
+/* A rolling LogFile has its finished files compressed by the thread */
+TEST_F(LogArchiverTest, Thread) {
+    LogArchiver archiver;
+    LogFile log(ARCHIVE_BASE, "data", SECOND);
+
+    archiver.setBase(ARCHIVE_BASE, "data");
+    archiver.setCompression(1);
+    ASSERT_TRUE(archiver.start());
+    EXPECT_TRUE(archiver.running());
+
+    log.setListener(&archiver);
+    log << "first";
+
+    sleep(2);
+    log << "second";
+
+    for(int i = 0; i < 50 && !archiver.stats().compressed; i++)
+        usleep(100000);
+
+    archiver.stop();
+    EXPECT_FALSE(archiver.running());
+    log.close();
+
+    // The first file compressed, the open one left alone
+    vector<string> files = list();
+    ASSERT_EQ(files.size(), 2);
+    EXPECT_EQ(gunzip(files[0]), "first");
+    EXPECT_EQ(files[0].substr(files[0].length() - 3), ".gz");
+    EXPECT_EQ(read_file(path(files[1]).c_str()), "second");
+}
@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 using namespace std;
 using namespace logger;
@@ -363,3 +364,192 @@ TEST_F(LogFileTest, LogFileRotation) {
 }
 
 
+
+// test group commit holds writes until a commit is due
+TEST_F(LogFileTest, GroupCommit) {
+	LogFile log(LOGFILE);
+	string result;
+
+	EXPECT_FALSE(log.groupCommit());
+	log.setCommitPolicy(1000, 10, 0);
+	EXPECT_TRUE(log.groupCommit());
+	EXPECT_EQ(log.maxDelay(), 1000);
+	EXPECT_EQ(log.maxBytes(), 10);
+
+	EXPECT_FALSE(log.pending());
+	log.write("abcd", 4);
+	EXPECT_TRUE(log.pending());
+	EXPECT_EQ(read_file(LOGFILE), "");
+
+	// Not due for a second
+	EXPECT_GT(log.commitDelay(0), 0);
+
+	// Max bytes reached
+	log << "efghij";
+	EXPECT_FALSE(log.pending());
+	EXPECT_EQ(read_file(LOGFILE), "abcdefghij");
+
+	log.write("k", 1);
+	log.commit();
+	EXPECT_FALSE(log.pending());
+	EXPECT_EQ(read_file(LOGFILE), "abcdefghijk");
+
+	// Closing commits what is held
+	log.write("l", 1);
+	log.close();
+	EXPECT_EQ(read_file(LOGFILE), "abcdefghijkl");
+
+	// Copies keep the policy
+	LogFile copy(log);
+	EXPECT_EQ(copy.maxDelay(), 1000);
+
+	// Turned off every write is flushed
+	log.setCommitPolicy(0, 0, 0);
+	log.write("m", 1);
+	EXPECT_FALSE(log.pending());
+	EXPECT_EQ(read_file(LOGFILE), "abcdefghijklm");
+}
+
+// test the sync interval keeps a commit pending until data is synced
+TEST_F(LogFileTest, GroupCommitSync) {
+	LogFile log(LOGFILE);
+
+	log.setCommitPolicy(0, 0, 60000);
+	log.write("abcd", 4);
+	EXPECT_EQ(read_file(LOGFILE), "abcd");
+
+	// The first sync is due straight away, the next in a minute
+	EXPECT_TRUE(log.pending());
+	log.commit();
+	EXPECT_FALSE(log.pending());
+
+	log.write("efgh", 4);
+	EXPECT_TRUE(log.pending());
+	EXPECT_GT(log.commitDelay(0), 0);
+	log.close();
+	EXPECT_FALSE(log.pending());
+}
+
+// test the rotation deadline is the start of the next period
+TEST_F(LogFileTest, RotationDeadline) {
+	LogFile log;
+	time_t now = time(NULL);
+	tm t = {0};
+
+	log.setBase(LOGBASE, LOGEXT);
+
+	log.setRotation(SECOND);
+	EXPECT_EQ(log.rotationDeadline(now), now + 1);
+
+	log.setRotation(MINUTE);
+	localtime_r(&now, &t);
+	EXPECT_EQ(log.rotationDeadline(now), now + 60 - t.tm_sec);
+	EXPECT_NE(log.getFilename(), "");
+
+	// The name changes at the deadline, not before
+	time_t deadline = log.rotationDeadline(now);
+	EXPECT_EQ(log.fileTime(deadline - 1), log.fileTime(now));
+	EXPECT_NE(log.fileTime(deadline), log.fileTime(now));
+
+	log.setRotation(DAILY);
+	deadline = log.rotationDeadline(now);
+	EXPECT_GT(deadline, now);
+	EXPECT_LE(deadline, now + 25 * 3600);
+	EXPECT_EQ(log.fileDate(deadline - 1), log.fileDate(now));
+	EXPECT_NE(log.fileDate(deadline), log.fileDate(now));
+
+	// An explicit file never rolls
+	LogFile file(LOGFILE);
+	EXPECT_GT(file.rotationDeadline(now), now + 365 * 24 * 3600);
+}
+
+// test the open file is reopened if it is removed from under us
+TEST_F(LogFileTest, RemovedOpenFileTest) {
+	LogFile log(LOGFILE);
+
+	log << "test message";
+	EXPECT_EQ(read_file(LOGFILE), "test message");
+	remove_file(LOGFILE);
+
+	// Noticed at the next check
+	sleep(2);
+	log << "after remove";
+	EXPECT_EQ(read_file(LOGFILE), "after remove");
+	log.close();
+}
+
+// test preallocated logs are written through mmap and truncated on close
+TEST_F(LogFileTest, PreallocatedFile) {
+	LogFile log(LOGFILE);
+	struct stat info;
+
+	EXPECT_FALSE(log.mapped());
+	log.setPreallocation(1000);
+	EXPECT_TRUE(log.mapped());
+	EXPECT_EQ(log.preallocation(), 1024 * 1024);
+	EXPECT_THROW(log.getStreamObject(), NotImplemented);
+
+	log << "abcd";
+	log.write("efgh", 4);
+
+	// A whole segment is allocated while the file is open
+	ASSERT_EQ(stat(LOGFILE, &info), 0);
+	EXPECT_EQ(info.st_size, 1024 * 1024);
+
+	log.close();
+	EXPECT_EQ(read_file(LOGFILE), "abcdefgh");
+
+	// Reopened it appends, across windows and segments
+	string big(1536 * 1024, 'x');
+	for(int i = 0; i < 24; i++)
+		log << big.substr(0, 65536);
+	log << "end";
+	log.close();
+	EXPECT_EQ(read_file(LOGFILE), "abcdefgh" + big + "end");
+
+	// Copies keep the segment
+	LogFile copy(log);
+	EXPECT_EQ(copy.preallocation(), 1024 * 1024);
+}
+
+// test the zeros left by a crash are trimmed when the file is reopened
+TEST_F(LogFileTest, PreallocatedCrashTest) {
+	LogFile log(LOGFILE);
+
+	create_file(LOGFILE, "abcd");
+	create_file(LOGFILE LOG_FILE_PREALLOC_EXTENTION, "");
+	ASSERT_EQ(truncate(LOGFILE, 1024 * 1024), 0);
+
+	log.setPreallocation(1024 * 1024);
+	log << "efgh";
+	log.close();
+	EXPECT_EQ(read_file(LOGFILE), "abcdefgh");
+
+	// A clean close removes the marker
+	struct stat info;
+	EXPECT_NE(stat(LOGFILE LOG_FILE_PREALLOC_EXTENTION, &info), 0);
+}
+
+// test a clean file that happens to end in zeros is left alone
+TEST_F(LogFileTest, PreallocatedZerosKept) {
+	LogFile log(LOGFILE);
+	string zeros(1024 * 1024, '\0');
+	zeros.replace(0, 4, "abcd");
+
+	remove_file(LOGFILE LOG_FILE_PREALLOC_EXTENTION);
+	FILE *file = fopen(LOGFILE, "w");
+	ASSERT_TRUE(file != NULL);
+	ASSERT_EQ(fwrite(zeros.data(), 1, zeros.length(), file), zeros.length());
+	fclose(file);
+
+	log.setPreallocation(1024 * 1024);
+	log << "efgh";
+
+	// The marker is there while the tail is preallocated
+	struct stat info;
+	EXPECT_EQ(stat(LOGFILE LOG_FILE_PREALLOC_EXTENTION, &info), 0);
+
+	log.close();
+	EXPECT_EQ(read_file(LOGFILE), zeros + "efgh");
+	EXPECT_NE(stat(LOGFILE LOG_FILE_PREALLOC_EXTENTION, &info), 0);
+}
@@ -0,0 +1,193 @@
+#include "common/logger.h"
+#include "common/log_file.h"
+#include "common/log_index.h"
+#include "common/timestamp.h"
+#include "common/util.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+using namespace logger;
+
+#define INDEX_DATA_FILE  "/tmp/gtest_index.data"
+#define INDEX_DATA_FILE2 "/tmp/gtest_index2.data"
+
+class LogIndexTest : public testing::Test {
+
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile("/tmp/gtest.log");
+            Logger::SetLogLevel("DEBUG");
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "            LogIndexTest Start Up";
+            LOG(INFO) << "************************************************";
+
+            clean();
+        }
+
+        virtual void TearDown() {
+            clean();
+        }
+
+        void clean() {
+            unlink(INDEX_DATA_FILE);
+            unlink(INDEX_DATA_FILE LOG_INDEX_EXTENTION);
+            unlink(INDEX_DATA_FILE2);
+            unlink(INDEX_DATA_FILE2 LOG_INDEX_EXTENTION);
+        }
+
+        off_t size(const string &file) {
+            struct stat info;
+            return stat(file.c_str(), &info) ? -1 : info.st_size;
+        }
+};
+
+/* The first packet is indexed, then every N packets */
+TEST_F(LogIndexTest, PacketPolicy) {
+    LogIndexWriter writer;
+
+    EXPECT_FALSE(writer.enabled());
+    writer.record(INDEX_DATA_FILE, 0, Timestamp(100, 0));
+    EXPECT_EQ(size(INDEX_DATA_FILE LOG_INDEX_EXTENTION), -1);
+
+    writer.setPolicy(3, 0);
+    EXPECT_TRUE(writer.enabled());
+    EXPECT_EQ(writer.packets(), 3);
+    EXPECT_EQ(writer.interval(), 0);
+
+    for(int i = 0; i < 7; i++)
+        writer.record(INDEX_DATA_FILE, i * 10, Timestamp(100 + i, 0));
+    writer.close();
+
+    LogIndexReader reader(INDEX_DATA_FILE);
+    ASSERT_TRUE(reader.load());
+    ASSERT_EQ(reader.size(), 3);
+
+    EXPECT_EQ(reader.entry(0).offset, 0);
+    EXPECT_EQ(reader.entry(0).timestamp, ntpTime(Timestamp(100, 0)));
+    EXPECT_EQ(reader.entry(1).offset, 30);
+    EXPECT_EQ(reader.entry(2).offset, 60);
+    EXPECT_EQ(reader.entry(2).timestamp, ntpTime(Timestamp(106, 0)));
+}
+
+/* Entries every M seconds of packet time, never going backwards, and a new
+ * data file starts a new index */
+TEST_F(LogIndexTest, IntervalPolicy) {
+    LogIndexWriter writer;
+    writer.setPolicy(0, 2);
+
+    writer.record(INDEX_DATA_FILE, 0, Timestamp(100, 0));
+    writer.record(INDEX_DATA_FILE, 10, Timestamp(101, 0));
+    writer.record(INDEX_DATA_FILE, 20, Timestamp(102, 0));
+    writer.record(INDEX_DATA_FILE, 30, Timestamp(90, 0));
+    writer.record(INDEX_DATA_FILE, 40, Timestamp(103, 0));
+    writer.record(INDEX_DATA_FILE, 50, Timestamp(104, 1));
+
+    writer.record(INDEX_DATA_FILE2, 0, Timestamp(105, 0));
+    writer.close();
+
+    LogIndexReader reader(INDEX_DATA_FILE);
+    ASSERT_TRUE(reader.load());
+    ASSERT_EQ(reader.size(), 3);
+    EXPECT_EQ(reader.entry(0).offset, 0);
+    EXPECT_EQ(reader.entry(1).offset, 20);
+    EXPECT_EQ(reader.entry(2).offset, 50);
+
+    for(size_t i = 1; i < reader.size(); i++)
+        EXPECT_GT(reader.entry(i).timestamp, reader.entry(i - 1).timestamp);
+
+    LogIndexReader second(INDEX_DATA_FILE2);
+    ASSERT_TRUE(second.load());
+    ASSERT_EQ(second.size(), 1);
+    EXPECT_EQ(second.entry(0).offset, 0);
+
+    // Turning it off closes the index
+    writer.setPolicy(0, 0);
+    EXPECT_FALSE(writer.enabled());
+}
+
+/* Binary search for the start and end of a time range */
+TEST_F(LogIndexTest, SeekAndRange) {
+    LogIndexWriter writer;
+    uint64_t from, to;
+
+    writer.setPolicy(1, 0);
+    for(int i = 0; i < 10; i++)
+        writer.record(INDEX_DATA_FILE, 1000 + i * 100, Timestamp(200 + i * 10, 0));
+    writer.close();
+
+    LogIndexReader reader(INDEX_DATA_FILE);
+    EXPECT_EQ(reader.size(), 0);
+    ASSERT_TRUE(reader.load());
+    ASSERT_EQ(reader.size(), 10);
+
+    EXPECT_EQ(reader.seek(Timestamp(100, 0)), 0);
+    EXPECT_EQ(reader.seek(Timestamp(200, 0)), 1000);
+    EXPECT_EQ(reader.seek(Timestamp(235, 0)), 1300);
+    EXPECT_EQ(reader.seek(Timestamp(999, 0)), 1900);
+
+    ASSERT_TRUE(reader.range(ntpTime(Timestamp(215, 0)), ntpTime(Timestamp(240, 0)), from, to));
+    EXPECT_EQ(from, 1100);
+    EXPECT_EQ(to, 1500);
+
+    ASSERT_TRUE(reader.range(ntpTime(Timestamp(280, 0)), ntpTime(Timestamp(999, 0)), from, to));
+    EXPECT_EQ(from, 1800);
+    EXPECT_EQ(to, 0);
+
+    // Data before the first entry might be in the file, it isn't skipped
+    ASSERT_TRUE(reader.range(ntpTime(Timestamp(100, 0)), ntpTime(Timestamp(150, 0)), from, to));
+    EXPECT_EQ(from, 0);
+    EXPECT_EQ(to, 1000);
+
+    LogIndexReader missing("/tmp/gtest_index_missing.data");
+    EXPECT_FALSE(missing.load());
+}
+
+/* The file starts after the range */
+TEST_F(LogIndexTest, RangeAfterEnd) {
+    LogIndexWriter writer;
+    uint64_t from, to;
+
+    writer.setPolicy(1, 0);
+    writer.record(INDEX_DATA_FILE, 0, Timestamp(200, 0));
+    writer.record(INDEX_DATA_FILE, 100, Timestamp(210, 0));
+    writer.close();
+
+    LogIndexReader reader(INDEX_DATA_FILE);
+    ASSERT_TRUE(reader.load());
+    EXPECT_FALSE(reader.range(ntpTime(Timestamp(100, 0)), ntpTime(Timestamp(150, 0)), from, to));
+}
+
+/* Offsets from LogFile::position() point at the packet in the data file */
+TEST_F(LogIndexTest, LogFilePosition) {
+    LogFile log;
+    LogIndexWriter writer;
+    string packet1 = "first packet";
+    string packet2 = "second";
+
+    log.setFile(INDEX_DATA_FILE);
+    writer.setPolicy(1, 0);
+
+    EXPECT_EQ(log.position(), 0);
+    writer.record(log.openFile(), log.position(), Timestamp(300, 0));
+    log << packet1;
+
+    EXPECT_EQ(log.position(), packet1.length());
+    writer.record(log.openFile(), log.position(), Timestamp(301, 0));
+    log << packet2;
+
+    log.close();
+    writer.close();
+
+    LogIndexReader reader(INDEX_DATA_FILE);
+    ASSERT_TRUE(reader.load());
+    ASSERT_EQ(reader.size(), 2);
+    EXPECT_EQ(reader.entry(1).offset, packet1.length());
+
+    string data = read_file(INDEX_DATA_FILE);
+    EXPECT_EQ(data.substr(reader.entry(1).offset), packet2);
+}
@@ -0,0 +1,113 @@
+#include "common/logger.h"
+#include "common/spsc_ring.h"
+#include "gtest/gtest.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+using namespace std;
+using namespace logger;
+
+#define THREAD_TEST_COUNT 50000
+
+class SPSCRingTest : public testing::Test {
+
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile("/tmp/gtest.log");
+            Logger::SetLogLevel("DEBUG");
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "            SPSCRingTest Start Up";
+            LOG(INFO) << "************************************************";
+        }
+};
+
+/* Capacity is rounded up to a power of two */
+TEST_F(SPSCRingTest, Capacity) {
+    SPSCRing<int> one(1);
+    SPSCRing<int> three(3);
+    SPSCRing<int> eight(8);
+    SPSCRing<int> odd(1000);
+
+    EXPECT_EQ(one.capacity(), 1);
+    EXPECT_EQ(three.capacity(), 4);
+    EXPECT_EQ(eight.capacity(), 8);
+    EXPECT_EQ(odd.capacity(), 1024);
+}
+
+/* Items come out in the order they went in, and a full ring refuses more */
+TEST_F(SPSCRingTest, PushPop) {
+    SPSCRing<int> ring(4);
+    int value;
+
+    EXPECT_TRUE(ring.empty());
+    EXPECT_FALSE(ring.pop(value));
+
+    for(int i = 0; i < 4; i++)
+        EXPECT_TRUE(ring.push(i));
+
+    EXPECT_EQ(ring.size(), 4);
+    EXPECT_FALSE(ring.push(99));
+
+    for(int i = 0; i < 4; i++) {
+        EXPECT_TRUE(ring.pop(value));
+        EXPECT_EQ(value, i);
+    }
+
+    EXPECT_TRUE(ring.empty());
+    EXPECT_FALSE(ring.pop(value));
+}
+
+/* The indexes keep working as they wrap around the slots */
+TEST_F(SPSCRingTest, WrapAround) {
+    SPSCRing<int> ring(4);
+    int value;
+
+    for(int i = 0; i < 1000; i++) {
+        EXPECT_TRUE(ring.push(i));
+        EXPECT_TRUE(ring.push(i + 1));
+        EXPECT_TRUE(ring.pop(value));
+        EXPECT_EQ(value, i);
+        EXPECT_TRUE(ring.pop(value));
+        EXPECT_EQ(value, i + 1);
+    }
+
+    EXPECT_TRUE(ring.empty());
+}
+
+static void * producer(void *arg) {
+    SPSCRing<uint32_t> *ring = (SPSCRing<uint32_t> *)arg;
+
+    for(uint32_t i = 1; i <= THREAD_TEST_COUNT; i++) {
+        // Wait for the consumer to make room
+        while(!ring->push(i))
+            sched_yield();
+    }
+
+    return NULL;
+}
+
+/* One producer thread and one consumer thread see every item in order */
+TEST_F(SPSCRingTest, Threaded) {
+    SPSCRing<uint32_t> ring(64);
+    pthread_t thread;
+    uint32_t expected = 1;
+    uint32_t value;
+
+    ASSERT_EQ(pthread_create(&thread, NULL, producer, &ring), 0);
+
+    while(expected <= THREAD_TEST_COUNT) {
+        if(ring.pop(value)) {
+            ASSERT_EQ(value, expected);
+            expected++;
+        }
+        else {
+            sched_yield();
+        }
+    }
+
+    pthread_join(thread, NULL);
+    EXPECT_TRUE(ring.empty());
+}
@@ -14,7 +14,9 @@
 #include "common/logger.h"
 #include "common/exception.h"
 
-
+#include <errno.h>
+#include <unistd.h>
+#include <vector>
 
 using namespace std;
 using namespace logger;
@@ -68,3 +70,84 @@ bool CommBase::operator==(CommBase &rhs) {
 	throw NotImplemented();
 }
 
+
+/******************************************************************************
+ * Method: writeVector
+ * Description: write several buffers in order as if they were one.  This
+ * version calls writeData for each buffer, classes with a file descriptor
+ * overload it to use a single writev.
+ *
+ * Parameters:
+ *   iov - the buffers to write
+ *   count - number of buffers
+ * Return:
+ *   returns the actual number of bytes written.
+ ******************************************************************************/
+uint32_t CommBase::writeVector(const struct iovec *iov, int count) {
+    uint32_t total = 0;
+
+    for(int i = 0; i < count; i++) {
+        if(iov[i].iov_len)
+            total += writeData((const char *)iov[i].iov_base, iov[i].iov_len);
+    }
+
+    return total;
+}
+
+
+/******************************************************************************
+ *   PROTECTED METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: writeVectorToFD
+ * Description: writev until every buffer is written.  A short write picks up
+ * where it left off, so it takes one system call in the normal case.
+ *
+ * Parameters:
+ *   fd - descriptor to write to
+ *   iov - the buffers to write
+ *   count - number of buffers
+ *   partial - stop when a non-blocking descriptor is full instead of failing
+ * Return:
+ *   returns the number of bytes written, or -1 with errno set on failure.
+ ******************************************************************************/
+int CommBase::writeVectorToFD(int fd, const struct iovec *iov, int count, bool partial) {
+    if(count <= 0)
+        return 0;
+
+    vector<struct iovec> remaining(iov, iov + count);
+    struct iovec *next = &remaining[0];
+    int total = 0;
+    int written;
+
+    while(count > 0) {
+        written = writev(fd, next, count);
+        if(written < 0 && errno == EINTR)
+            continue;
+
+        if(written < 0 && partial && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+
+        if(written < 0)
+            return -1;
+
+        total += written;
+
+        // Skip what was written, the last buffer may be partly done
+        while(count > 0 && (size_t)written >= next->iov_len) {
+            written -= next->iov_len;
+            next++;
+            count--;
+        }
+
+        if(count > 0) {
+            next->iov_base = (char *)next->iov_base + written;
+            next->iov_len -= written;
+        }
+
+        LOG(DEBUG2) << "wrote bytes: " << total << " buffers remaining: " << count;
+    }
+
+    return total;
+}
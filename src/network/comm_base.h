@@ -15,6 +15,7 @@
 #include "common/logger.h"
 
 #include <stdint.h>
+#include <sys/uio.h>
 
 using namespace std;
 using namespace logger;
@@ -25,7 +26,8 @@ namespace network {
         COMM_TCP_LISTENER,
         COMM_TCP_SOCKET,
         COMM_UDP_SOCKET,
-        COMM_SERIAL_SOCKET
+        COMM_SERIAL_SOCKET,
+        COMM_SHARED_MEMORY
     } CommType;
     
     class CommBase {
@@ -60,6 +62,19 @@ namespace network {
 	    
             virtual uint32_t writeData(const char *buffer, uint32_t size) = 0;
             virtual uint32_t readData(char *buffer, uint32_t size) = 0;
+
+            // Write several buffers as one, a single writev where possible
+            virtual uint32_t writeVector(const struct iovec *iov, int count);
+
+            // Write each buffer as its own message, the same as writeVector
+            // unless the socket keeps message boundaries
+            virtual uint32_t writeMessages(const struct iovec *iov, int count) { return writeVector(iov, count); }
+
+            // Data accepted by a write but still waiting for the socket to
+            // become writable.  flushOutput() writes what it can without
+            // blocking, false if the connection failed.
+            virtual bool outputPending() { return false; }
+            virtual bool flushOutput() { return true; }
             
             virtual uint16_t getListenPort() { return 0; }
 
@@ -67,6 +82,8 @@ namespace network {
 
 
         protected:
+            static int writeVectorToFD(int fd, const struct iovec *iov, int count,
+                                       bool partial = false);
 
         private:
         
@@ -162,6 +162,33 @@ uint32_t CommSocket::writeData(const char *buffer, const uint32_t size) {
 }
 
 
+/******************************************************************************
+ * Method: writeVector
+ * Description: write several buffers to the socket connection with writev.
+ *
+ * Parameters:
+ *   iov - the buffers to write
+ *   count - number of buffers
+ * Return:
+ *   returns the actual number of bytes written.
+ * Exceptions:
+ *   SocketWriteFailure
+ ******************************************************************************/
+uint32_t CommSocket::writeVector(const struct iovec *iov, int count) {
+    if(! connected())
+        throw(SocketWriteFailure("not connected"));
+
+    int bytesWritten = writeVectorToFD(m_pSocketFD, iov, count);
+    if(bytesWritten < 0) {
+        m_pSocketFD = 0;
+        LOG(ERROR) << strerror(errno) << "(errno: " << errno << ")";
+        throw(SocketWriteFailure(strerror(errno)));
+    }
+
+    return bytesWritten;
+}
+
+
 /******************************************************************************
  * Method: read
  * Description: read a number of bytes to the socket connection.
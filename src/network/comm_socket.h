@@ -53,6 +53,7 @@ namespace network {
 
             virtual uint32_t writeData(const char *buffer, uint32_t size);
             virtual uint32_t readData(char *buffer, uint32_t size);
+            virtual uint32_t writeVector(const struct iovec *iov, int count);
 
         protected:
 
@@ -0,0 +1,298 @@
+/*******************************************************************************
+ * Class: EventLoop
+ * Filename: event_loop.cxx
+ * License: Apache 2.0
+ *
+ * Readiness notification for file descriptors using epoll, and timers.  See
+ * event_loop.h for usage.
+ ******************************************************************************/
+
+#include "event_loop.h"
+#include "common/logger.h"
+#include "common/exception.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+using namespace std;
+using namespace logger;
+using namespace network;
+
+/******************************************************************************
+ *   PUBLIC METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ * Description: Create the epoll instance and the timerfd used to wake up
+ * for timer deadlines.  The timerfd is watched internally and is not in the
+ * handler map.
+ * Exceptions:
+ *   EventLoopFailure
+ ******************************************************************************/
+EventLoop::EventLoop() {
+    struct epoll_event ev;
+
+    m_iArmedDeadline = 0;
+    m_iTimerFD = -1;
+
+    m_iPollFD = epoll_create(EVENT_LOOP_MAX_EVENTS);
+
+    if(m_iPollFD < 0)
+        throw EventLoopFailure(strerror(errno));
+
+    m_iTimerFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if(m_iTimerFD < 0) {
+        close(m_iPollFD);
+        throw EventLoopFailure(strerror(errno));
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EVENT_READ;
+    ev.data.fd = m_iTimerFD;
+
+    if(epoll_ctl(m_iPollFD, EPOLL_CTL_ADD, m_iTimerFD, &ev) < 0) {
+        close(m_iTimerFD);
+        close(m_iPollFD);
+        throw EventLoopFailure(strerror(errno));
+    }
+
+    LOG(DEBUG2) << "event loop poll fd: " << m_iPollFD << " timer fd: " << m_iTimerFD;
+}
+
+/******************************************************************************
+ * Method: Destructor
+ * Description: Close the epoll instance.  The registered descriptors are not
+ * owned by the loop and are left open.
+ ******************************************************************************/
+EventLoop::~EventLoop() {
+    if(m_iTimerFD >= 0)
+        close(m_iTimerFD);
+
+    if(m_iPollFD >= 0)
+        close(m_iPollFD);
+}
+
+/******************************************************************************
+ * Method: registered
+ * Description: Is a handler registered for the file descriptor?
+ ******************************************************************************/
+bool EventLoop::registered(int fd) {
+    return m_oHandlers.find(fd) != m_oHandlers.end();
+}
+
+/******************************************************************************
+ * Method: handler
+ * Description: Return the handler registered for a file descriptor or NULL.
+ ******************************************************************************/
+EventHandler * EventLoop::handler(int fd) {
+    map<int, EventHandler *>::iterator i = m_oHandlers.find(fd);
+    return i == m_oHandlers.end() ? NULL : i->second;
+}
+
+/******************************************************************************
+ * Method: addHandler
+ * Description: Watch a file descriptor and call handler when it is ready.
+ * Adding a descriptor that is already registered replaces the handler and
+ * the event mask.
+ *
+ * A descriptor that is closed is silently dropped by the kernel, so a new
+ * socket that reuses the number may still be in our map.  Fall back between
+ * ADD and MOD so both cases end up registered.
+ *
+ * Parameters:
+ *   fd - file descriptor to watch
+ *   handler - object notified when fd is ready
+ *   events - mask of EVENT_READ and/or EVENT_WRITE
+ * Return:
+ *   true if the descriptor is registered.
+ ******************************************************************************/
+bool EventLoop::addHandler(int fd, EventHandler *handler, uint32_t events) {
+    struct epoll_event ev;
+    int op = registered(fd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    int result;
+
+    if(fd < 0 || !handler)
+        return false;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+
+    result = epoll_ctl(m_iPollFD, op, fd, &ev);
+    if(result < 0 && op == EPOLL_CTL_MOD && errno == ENOENT)
+        result = epoll_ctl(m_iPollFD, EPOLL_CTL_ADD, fd, &ev);
+    else if(result < 0 && op == EPOLL_CTL_ADD && errno == EEXIST)
+        result = epoll_ctl(m_iPollFD, EPOLL_CTL_MOD, fd, &ev);
+
+    if(result < 0) {
+        LOG(ERROR) << "failed to register fd " << fd << ": " << strerror(errno);
+        m_oHandlers.erase(fd);
+        return false;
+    }
+
+    LOG(DEBUG2) << "event loop watching fd: " << fd;
+    m_oHandlers[fd] = handler;
+    return true;
+}
+
+/******************************************************************************
+ * Method: removeHandler
+ * Description: Stop watching a file descriptor.  It isn't an error if the
+ * descriptor has already been closed, even if the number now belongs to
+ * something epoll can't watch (EPERM).
+ ******************************************************************************/
+bool EventLoop::removeHandler(int fd) {
+    struct epoll_event ev;
+
+    if(!registered(fd))
+        return false;
+
+    m_oHandlers.erase(fd);
+
+    // Kernels before 2.6.9 require a non-NULL event pointer for DEL
+    memset(&ev, 0, sizeof(ev));
+    if(epoll_ctl(m_iPollFD, EPOLL_CTL_DEL, fd, &ev) < 0 &&
+       errno != ENOENT && errno != EBADF && errno != EPERM) {
+        LOG(ERROR) << "failed to unregister fd " << fd << ": " << strerror(errno);
+    }
+
+    LOG(DEBUG2) << "event loop removed fd: " << fd;
+    return true;
+}
+
+/******************************************************************************
+ * Method: clear
+ * Description: Stop watching all file descriptors.
+ ******************************************************************************/
+void EventLoop::clear() {
+    while(m_oHandlers.size())
+        removeHandler(m_oHandlers.begin()->first);
+}
+
+/******************************************************************************
+ * Method: addTimer
+ * Description: Start a timer that is run by dispatch.
+ *
+ * Parameters:
+ *   delay - microseconds until the timer first fires
+ *   handler - object notified when the timer fires
+ *   interval - if non-zero the timer repeats every interval microseconds
+ * Return:
+ *   timer id, or 0 on failure.
+ ******************************************************************************/
+TimerId EventLoop::addTimer(uint64_t delay, TimerHandler *handler, uint64_t interval) {
+    return m_oTimers.add(delay, handler, interval);
+}
+
+/******************************************************************************
+ * Method: cancelTimer
+ * Description: Stop a timer.
+ * Return:
+ *   true if the timer was pending.
+ ******************************************************************************/
+bool EventLoop::cancelTimer(TimerId id) {
+    return m_oTimers.cancel(id);
+}
+
+/******************************************************************************
+ * Method: dispatch
+ * Description: Wait for registered descriptors to become ready or the next
+ * timer to expire, then call the handlers.  Descriptor handlers are looked up
+ * when each event is delivered so a handler may safely remove other
+ * descriptors.  Timers that are due are run once the descriptors have been
+ * handled.
+ *
+ * Parameters:
+ *   timeout - maximum time to wait in milliseconds.  -1 waits until a
+ *             descriptor is ready or a timer is due.
+ * Return:
+ *   number of ready descriptors, or -1 on error with errno set.
+ ******************************************************************************/
+int EventLoop::dispatch(int timeout) {
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+    int readyCount;
+    int handledCount = 0;
+
+    timeout = armTimer(timeout);
+
+    readyCount = epoll_wait(m_iPollFD, events, EVENT_LOOP_MAX_EVENTS, timeout);
+    if(readyCount < 0)
+        return readyCount;
+
+    for(int i = 0; i < readyCount; i++) {
+        int fd = events[i].data.fd;
+        EventHandler *pHandler;
+
+        if(fd == m_iTimerFD) {
+            uint64_t expirations;
+
+            // Drain it, the deadline it was armed for has passed
+            if(read(m_iTimerFD, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                LOG(ERROR) << "timer fd read failed: " << strerror(errno);
+
+            m_iArmedDeadline = 0;
+            continue;
+        }
+
+        handledCount++;
+        pHandler = handler(fd);
+
+        if(pHandler) {
+            LOG(DEBUG3) << "event on fd: " << fd << " events: " << hex << events[i].events;
+            pHandler->handleEvent(fd, events[i].events);
+        }
+    }
+
+    m_oTimers.expire(TimerQueue::now());
+
+    return handledCount;
+}
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: armTimer
+ * Description: Arm the timerfd for the nearest timer deadline.  The timerfd
+ * is only reprogrammed when the deadline changes.
+ *
+ * Parameters:
+ *   timeout - the caller's dispatch timeout in milliseconds
+ * Return:
+ *   the timeout to pass to epoll_wait.  0 if a timer is already due.
+ ******************************************************************************/
+int EventLoop::armTimer(int timeout) {
+    struct itimerspec spec;
+    uint64_t deadline = m_oTimers.nextDeadline();
+
+    if(deadline && deadline <= TimerQueue::now())
+        return 0;
+
+    if(deadline == m_iArmedDeadline)
+        return timeout;
+
+    // A zero it_value disarms the timer when there are no deadlines
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = deadline / USEC_PER_SEC;
+    spec.it_value.tv_nsec = (deadline % USEC_PER_SEC) * 1000;
+
+    if(timerfd_settime(m_iTimerFD, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+        LOG(ERROR) << "failed to arm timer: " << strerror(errno);
+        m_iArmedDeadline = 0;
+
+        // Fall back to the millisecond resolution of epoll_wait
+        if(deadline) {
+            int wait = (deadline - TimerQueue::now() + USEC_PER_MSEC - 1) / USEC_PER_MSEC;
+            return timeout < 0 || wait < timeout ? wait : timeout;
+        }
+
+        return timeout;
+    }
+
+    m_iArmedDeadline = deadline;
+    return timeout;
+}
@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * Class: EventLoop
+ * Filename: event_loop.h
+ * License: Apache 2.0
+ *
+ * Readiness notification for file descriptors using epoll.  File descriptors
+ * are registered once with a handler and stay registered until they are
+ * removed, so the cost of a dispatch depends on the number of ready
+ * descriptors, not the number being watched.  There is also no FD_SETSIZE
+ * ceiling on the descriptor values.
+ *
+ * The loop also runs timers.  A dispatch only blocks until the nearest timer
+ * deadline, which is tracked with a timerfd so deadlines are honored to the
+ * microsecond rather than the millisecond resolution of epoll_wait.  Expired
+ * timer handlers are called after the descriptor handlers.
+ *
+ * Usage:
+ *
+ * class MyHandler : public EventHandler {
+ *     void handleEvent(int fd, uint32_t events) { ... }
+ * };
+ *
+ * MyHandler handler;
+ * EventLoop loop;
+ *
+ * // Watch a descriptor for reading
+ * loop.addHandler(fd, &handler);
+ *
+ * // Wait up to 1000 ms and call the handler for each ready descriptor
+ * int readyCount = loop.dispatch(1000);
+ *
+ * // Stop watching
+ * loop.removeHandler(fd);
+ *
+ * // Call timerHandler in 500 us, then wait until it fires
+ * loop.addTimer(500, &timerHandler);
+ * loop.dispatch(-1);
+ ******************************************************************************/
+
+#ifndef __EVENT_LOOP_H_
+#define __EVENT_LOOP_H_
+
+#include "common/logger.h"
+#include "timer_queue.h"
+
+#include <sys/epoll.h>
+#include <stdint.h>
+#include <map>
+
+#define EVENT_READ  EPOLLIN
+#define EVENT_WRITE EPOLLOUT
+
+#define EVENT_LOOP_MAX_EVENTS 64
+
+using namespace std;
+using namespace logger;
+
+namespace network {
+
+    /////
+    // Interface for objects that want to be notified when a descriptor is
+    // ready.  events is a mask of EVENT_READ, EVENT_WRITE and the epoll
+    // error flags (EPOLLERR, EPOLLHUP).
+    /////
+    class EventHandler {
+        public:
+            virtual ~EventHandler() {}
+            virtual void handleEvent(int fd, uint32_t events) = 0;
+    };
+
+    class EventLoop {
+        /********************
+         *      METHODS     *
+         ********************/
+
+        public:
+            ///////////////////////
+            // Public Methods
+            EventLoop();
+            virtual ~EventLoop();
+
+            /* Accessors */
+            int pollFD() { return m_iPollFD; }
+            size_t handlerCount() { return m_oHandlers.size(); }
+            bool registered(int fd);
+            EventHandler * handler(int fd);
+            size_t timerCount() { return m_oTimers.size(); }
+            bool timerPending(TimerId id) { return m_oTimers.pending(id); }
+
+            /* Commands */
+            bool addHandler(int fd, EventHandler *handler, uint32_t events = EVENT_READ);
+            bool removeHandler(int fd);
+            void clear();
+
+            TimerId addTimer(uint64_t delay, TimerHandler *handler, uint64_t interval = 0);
+            bool cancelTimer(TimerId id);
+
+            int dispatch(int timeout);
+
+        protected:
+
+        private:
+            EventLoop(const EventLoop &rhs);
+            EventLoop & operator=(const EventLoop &rhs);
+
+            int armTimer(int timeout);
+
+        /********************
+         *      MEMBERS     *
+         ********************/
+
+        protected:
+
+        private:
+            int m_iPollFD;
+            map<int, EventHandler *> m_oHandlers;
+
+            TimerQueue m_oTimers;
+            int m_iTimerFD;
+            uint64_t m_iArmedDeadline;
+    };
+}
+
+#endif //__EVENT_LOOP_H_
@@ -0,0 +1,204 @@
+/*******************************************************************************
+ * Class: OutputBuffer
+ * Filename: output_buffer.cxx
+ * License: Apache 2.0
+ *
+ * Bounded queue of data for a slow socket.  See output_buffer.h for usage.
+ ******************************************************************************/
+
+#include "output_buffer.h"
+#include "common/logger.h"
+
+using namespace std;
+using namespace logger;
+using namespace network;
+
+/******************************************************************************
+ *   PUBLIC METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ *
+ * Parameters:
+ *   limit - most unwritten bytes to hold
+ *   policy - what to do when a message doesn't fit
+ ******************************************************************************/
+OutputBuffer::OutputBuffer(uint32_t limit, OutputPolicy policy) {
+    m_iLimit = limit;
+    m_ePolicy = policy;
+
+    m_iOffset = 0;
+    m_iSize = 0;
+    m_iHighWater = 0;
+
+    m_iDroppedOldest = 0;
+    m_iDroppedNewest = 0;
+    m_iDisconnects = 0;
+}
+
+/******************************************************************************
+ * Method: add
+ * Description: Queue what is left of a write as one message.  If some of it
+ * was already written to an empty buffer the whole message is kept as the
+ * partly written first message.  The rest has to follow or the stream loses
+ * its framing, so it is queued whatever the policy, even over the limit.
+ *
+ * Parameters:
+ *   iov - the buffers that were being written
+ *   count - number of buffers
+ *   skip - bytes at the start that were already written
+ * Return:
+ *   false if the message doesn't fit and the policy is OUTPUT_DISCONNECT,
+ *   otherwise true, even if the message was dropped.
+ ******************************************************************************/
+bool OutputBuffer::add(const struct iovec *iov, int count, uint32_t skip) {
+    uint32_t size = 0;
+    bool partial = skip && m_oMessages.empty();
+
+    for(int i = 0; i < count; i++)
+        size += iov[i].iov_len;
+
+    if(size <= skip)
+        return true;
+
+    size -= skip;
+
+    if(partial) {
+        m_iOffset = skip;
+        skip = 0;
+    }
+
+    else if(!makeRoom(size)) {
+        if(m_ePolicy == OUTPUT_DISCONNECT) {
+            LOG(DEBUG) << "output buffer full, disconnect";
+            m_iDisconnects++;
+            return false;
+        }
+
+        LOG(DEBUG2) << "output buffer full, drop " << size << " bytes";
+        m_iDroppedNewest++;
+        return true;
+    }
+
+    string message;
+    message.reserve(size);
+
+    for(int i = 0; i < count; i++) {
+        uint32_t length = iov[i].iov_len;
+
+        if(skip >= length) {
+            skip -= length;
+            continue;
+        }
+
+        message.append((const char *)iov[i].iov_base + skip, length - skip);
+        skip = 0;
+    }
+
+    m_oMessages.push_back(message);
+    m_iSize += size;
+
+    if(partial)
+        LOG(DEBUG2) << "output buffer holding rest of partly written message, "
+                    << size << " bytes";
+
+    if(m_iSize > m_iHighWater)
+        m_iHighWater = m_iSize;
+
+    return true;
+}
+
+/******************************************************************************
+ * Method: iov
+ * Description: Point at the queued data, up to OUTPUT_BUFFER_MAX_IOV
+ * messages.  The buffers stay valid until the next add, consume or clear.
+ *
+ * Parameters:
+ *   result - set to the buffers to write
+ ******************************************************************************/
+void OutputBuffer::iov(vector<struct iovec> &result) {
+    struct iovec buffer;
+
+    result.clear();
+
+    for(deque<string>::iterator i = m_oMessages.begin();
+        i != m_oMessages.end() && result.size() < OUTPUT_BUFFER_MAX_IOV; i++) {
+        uint32_t offset = result.empty() ? m_iOffset : 0;
+
+        buffer.iov_base = (void *)(i->data() + offset);
+        buffer.iov_len = i->length() - offset;
+        result.push_back(buffer);
+    }
+}
+
+/******************************************************************************
+ * Method: consume
+ * Description: Drop written bytes from the front of the queue.
+ *
+ * Parameters:
+ *   bytes - how many bytes were written
+ ******************************************************************************/
+void OutputBuffer::consume(uint32_t bytes) {
+    while(bytes && !m_oMessages.empty()) {
+        uint32_t remaining = m_oMessages.front().length() - m_iOffset;
+
+        if(bytes < remaining) {
+            m_iOffset += bytes;
+            m_iSize -= bytes;
+            return;
+        }
+
+        bytes -= remaining;
+        m_iSize -= remaining;
+        m_iOffset = 0;
+        m_oMessages.pop_front();
+    }
+}
+
+/******************************************************************************
+ * Method: clear
+ * Description: Drop everything queued.
+ ******************************************************************************/
+void OutputBuffer::clear() {
+    m_oMessages.clear();
+    m_iOffset = 0;
+    m_iSize = 0;
+}
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: makeRoom
+ * Description: Make sure a new message fits, dropping old messages if that is
+ * the policy.  A partly written message can't be dropped.
+ *
+ * Parameters:
+ *   size - bytes in the new message
+ * Return:
+ *   true if the message fits
+ ******************************************************************************/
+bool OutputBuffer::makeRoom(uint32_t size) {
+    if(size > m_iLimit)
+        return false;
+
+    if(m_iSize + size <= m_iLimit)
+        return true;
+
+    if(m_ePolicy != OUTPUT_DROP_OLDEST)
+        return false;
+
+    deque<string>::iterator oldest = m_oMessages.begin();
+    if(m_iOffset)
+        oldest++;
+
+    while(m_iSize + size > m_iLimit && oldest != m_oMessages.end()) {
+        m_iSize -= oldest->length();
+        oldest = m_oMessages.erase(oldest);
+        m_iDroppedOldest++;
+    }
+
+    return m_iSize + size <= m_iLimit;
+}
@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * Class: OutputBuffer
+ * Filename: output_buffer.h
+ * License: Apache 2.0
+ *
+ * Bounded queue of data waiting for a non-blocking socket to become
+ * writable.  Each write that couldn't go out in full is kept as one message
+ * so a full buffer can drop whole packets without breaking the stream.  The
+ * first message may be partly written already, it is never dropped, and
+ * the rest of a message the socket only took part of is always queued.
+ *
+ * When a new message doesn't fit the policy decides what happens:
+ *
+ *   OUTPUT_DROP_OLDEST - drop queued messages, oldest first, to make room
+ *   OUTPUT_DROP_NEWEST - drop the new message
+ *   OUTPUT_DISCONNECT  - refuse the message, the owner drops the client
+ *
+ * A message bigger than the whole buffer is always dropped.  Each outcome
+ * has a counter.  The buffer does no I/O, the owner writes iov() and reports
+ * how much went out with consume().
+ *
+ * Usage:
+ *
+ * OutputBuffer output(65536, OUTPUT_DROP_OLDEST);
+ *
+ * // Keep what writev didn't take
+ * if(!output.add(iov, count, written))
+ *     // disconnect the client
+ *
+ * // When the socket is writable
+ * vector<struct iovec> pending;
+ * output.iov(pending);
+ * output.consume(writev(fd, &pending[0], pending.size()));
+ ******************************************************************************/
+
+#ifndef __OUTPUT_BUFFER_H_
+#define __OUTPUT_BUFFER_H_
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#define DEFAULT_OUTPUT_BUFFER_SIZE 1048576
+
+// Most messages handed back by iov() at once
+#define OUTPUT_BUFFER_MAX_IOV 64
+
+using namespace std;
+
+namespace network {
+    typedef enum OutputPolicy {
+        OUTPUT_DROP_OLDEST,
+        OUTPUT_DROP_NEWEST,
+        OUTPUT_DISCONNECT
+    } OutputPolicy;
+
+    class OutputBuffer {
+        /********************
+         *      METHODS     *
+         ********************/
+
+        public:
+            OutputBuffer(uint32_t limit = DEFAULT_OUTPUT_BUFFER_SIZE,
+                         OutputPolicy policy = OUTPUT_DROP_OLDEST);
+
+            /* Accessors */
+            uint32_t limit() const { return m_iLimit; }
+            OutputPolicy policy() const { return m_ePolicy; }
+            bool empty() { return m_oMessages.empty(); }
+            uint32_t size() { return m_iSize; }
+            uint32_t messages() { return m_oMessages.size(); }
+            uint32_t highWater() { return m_iHighWater; }
+
+            uint64_t droppedOldest() { return m_iDroppedOldest; }
+            uint64_t droppedNewest() { return m_iDroppedNewest; }
+            uint64_t disconnects() { return m_iDisconnects; }
+
+            /* Commands */
+            void setLimit(uint32_t limit) { m_iLimit = limit; }
+            void setPolicy(OutputPolicy policy) { m_ePolicy = policy; }
+
+            // Queue the iovec data after the first skip bytes as one message.
+            // A partly written message is always kept.  Returns false if
+            // the policy says to disconnect.
+            bool add(const struct iovec *iov, int count, uint32_t skip = 0);
+
+            // The queued data, oldest first
+            void iov(vector<struct iovec> &result);
+
+            // Forget bytes that have been written
+            void consume(uint32_t bytes);
+
+            // Drop everything queued, the counters are kept
+            void clear();
+
+        private:
+            bool makeRoom(uint32_t size);
+
+        /********************
+         *      MEMBERS     *
+         ********************/
+
+        private:
+            uint32_t m_iLimit;
+            OutputPolicy m_ePolicy;
+
+            deque<string> m_oMessages;
+
+            // Bytes of the first message already written
+            uint32_t m_iOffset;
+
+            // Unwritten bytes queued
+            uint32_t m_iSize;
+            uint32_t m_iHighWater;
+
+            uint64_t m_iDroppedOldest;
+            uint64_t m_iDroppedNewest;
+            uint64_t m_iDisconnects;
+    };
+}
+
+#endif //__OUTPUT_BUFFER_H_
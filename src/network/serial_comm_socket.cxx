@@ -129,10 +129,8 @@ bool SerialCommSocket::initialize() {
         os << "Failed to open device: " << m_sDevicePath << ": " << strerror(errno);
         infoString = os.str();
         LOG(ERROR) << infoString;
-        // DHE: I've noticed that without this, CPU runs to 99/100 percent.
-        // Doesn't seem like the select() sleep is working.  This definitely
-        // helps; leaving it in until select() sleep is resolved.
-        sleep(OPEN_FAIL_SLEEP_TIME);
+        // The caller decides when to retry, we don't wait here.
+        m_pSocketFD = 0;
         throw DeviceOpenFailure(infoString);
         bReturnCode = false;
     }
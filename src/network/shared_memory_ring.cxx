@@ -0,0 +1,595 @@
+/*******************************************************************************
+ * Class: SharedMemoryRing, SharedMemoryReader
+ * Filename: shared_memory_ring.cxx
+ * License: Apache 2.0
+ *
+ * Ring of records in POSIX shared memory.  See shared_memory_ring.h for the
+ * layout and usage.
+ ******************************************************************************/
+
+#include "shared_memory_ring.h"
+#include "common/logger.h"
+#include "common/exception.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace logger;
+using namespace network;
+
+// Records start and end on 8 byte boundaries
+#define SHM_RING_ALIGN(size) (((size) + 7) & ~((uint64_t)7))
+
+/******************************************************************************
+ *   WRITER
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ * Description: Default constructor.
+ ******************************************************************************/
+SharedMemoryRing::SharedMemoryRing() : CommBase() {
+    m_iCapacity = SHM_RING_DEFAULT_CAPACITY;
+    m_pHeader = NULL;
+    m_pData = NULL;
+    m_iMapSize = 0;
+}
+
+/******************************************************************************
+ * Method: Copy Constructor
+ * Description: Copies the configuration, not the segment.
+ ******************************************************************************/
+SharedMemoryRing::SharedMemoryRing(const SharedMemoryRing &rhs) : CommBase(rhs) {
+    m_sName = rhs.m_sName;
+    m_iCapacity = rhs.m_iCapacity;
+    m_pHeader = NULL;
+    m_pData = NULL;
+    m_iMapSize = 0;
+}
+
+/******************************************************************************
+ * Method: Destructor
+ * Description: Remove the segment.
+ ******************************************************************************/
+SharedMemoryRing::~SharedMemoryRing() {
+    close();
+}
+
+/******************************************************************************
+ * Method: copy
+ * Description: return a new object deep copied.
+ ******************************************************************************/
+CommBase * SharedMemoryRing::copy() {
+    return new SharedMemoryRing(*this);
+}
+
+/******************************************************************************
+ * Method: assignment operator
+ * Description: Copies the configuration, not the segment.
+ ******************************************************************************/
+SharedMemoryRing & SharedMemoryRing::operator=(const SharedMemoryRing &rhs) {
+    m_sName = rhs.m_sName;
+    m_iCapacity = rhs.m_iCapacity;
+
+    return *this;
+}
+
+/******************************************************************************
+ * Method: compare
+ * Description: Two rings are the same if they use the same segment.
+ ******************************************************************************/
+bool SharedMemoryRing::compare(CommBase *rhs) {
+    if(rhs->type() != COMM_SHARED_MEMORY)
+        return false;
+
+    return m_sName == ((SharedMemoryRing *)rhs)->m_sName;
+}
+
+/******************************************************************************
+ * Method: setCapacity
+ * Description: Set the size of the data area, rounded up to a power of two.
+ * Takes effect the next time the segment is created.
+ ******************************************************************************/
+void SharedMemoryRing::setCapacity(uint64_t capacity) {
+    m_iCapacity = roundCapacity(capacity);
+}
+
+/******************************************************************************
+ * Method: roundCapacity
+ * Description: Round a configured size up to a power of two, no smaller than
+ * SHM_RING_MIN_CAPACITY.
+ ******************************************************************************/
+uint64_t SharedMemoryRing::roundCapacity(uint64_t capacity) {
+    uint64_t result = SHM_RING_MIN_CAPACITY;
+    while(result < capacity)
+        result <<= 1;
+    return result;
+}
+
+/******************************************************************************
+ * Method: sequence
+ * Description: Sequence of the next record written.
+ ******************************************************************************/
+uint64_t SharedMemoryRing::sequence() {
+    return m_pHeader ? m_pHeader->sequence : 0;
+}
+
+/******************************************************************************
+ * Method: initialize
+ * Description: Create and map the segment.  Anything already using the name
+ * is unlinked first; readers still mapping it see no more records and
+ * should open the segment again.
+ *
+ * Exceptions:
+ *   SocketMissingConfig
+ *   SocketCreateFailure
+ ******************************************************************************/
+bool SharedMemoryRing::initialize() {
+    LOG(DEBUG) << "shared memory ring initialize(): " << m_sName;
+
+    if(!m_sName.length())
+        throw SocketMissingConfig("missing shared memory name");
+
+    close();
+    shm_unlink(m_sName.c_str());
+
+    int fd = shm_open(m_sName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0)
+        throw SocketCreateFailure(m_sName + ": " + strerror(errno));
+
+    size_t size = sizeof(SharedRingHeader) + m_iCapacity;
+
+    if(ftruncate(fd, size) < 0) {
+        string message = strerror(errno);
+        ::close(fd);
+        shm_unlink(m_sName.c_str());
+        throw SocketCreateFailure(m_sName + ": " + message);
+    }
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if(map == MAP_FAILED) {
+        string message = strerror(errno);
+        shm_unlink(m_sName.c_str());
+        throw SocketCreateFailure(m_sName + ": " + message);
+    }
+
+    m_pHeader = (SharedRingHeader *)map;
+    m_pData = (char *)map + sizeof(SharedRingHeader);
+    m_iMapSize = size;
+
+    m_pHeader->version = SHM_RING_VERSION;
+    m_pHeader->capacity = m_iCapacity;
+    m_pHeader->head = 0;
+    m_pHeader->tail = 0;
+    m_pHeader->sequence = 0;
+
+    // Readers check the magic last
+    __atomic_store_n(&m_pHeader->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+
+    LOG(DEBUG) << "shared memory ring " << m_sName << " capacity: " << m_iCapacity;
+
+    return true;
+}
+
+/******************************************************************************
+ * Method: close
+ * Description: Mark the segment closed for readers, unmap and remove it.
+ ******************************************************************************/
+void SharedMemoryRing::close() {
+    if(!m_pHeader)
+        return;
+
+    __atomic_store_n(&m_pHeader->magic, 0, __ATOMIC_RELEASE);
+
+    munmap(m_pHeader, m_iMapSize);
+    shm_unlink(m_sName.c_str());
+
+    m_pHeader = NULL;
+    m_pData = NULL;
+    m_iMapSize = 0;
+}
+
+/******************************************************************************
+ * Method: writeData
+ * Description: Add a buffer to the ring as one record.
+ *
+ * Return:
+ *   size, or 0 if the record is bigger than the ring
+ * Exceptions:
+ *   SocketNotInitialized
+ ******************************************************************************/
+uint32_t SharedMemoryRing::writeData(const char *buffer, uint32_t size) {
+    struct iovec iov;
+
+    iov.iov_base = (void *)buffer;
+    iov.iov_len = size;
+
+    return writeVector(&iov, 1);
+}
+
+/******************************************************************************
+ * Method: writeVector
+ * Description: Add several buffers to the ring as one record.
+ *
+ * Return:
+ *   bytes written, 0 if the record is bigger than the ring
+ * Exceptions:
+ *   SocketNotInitialized
+ ******************************************************************************/
+uint32_t SharedMemoryRing::writeVector(const struct iovec *iov, int count) {
+    uint32_t size = 0;
+
+    if(!connected())
+        throw SocketNotInitialized();
+
+    for(int i = 0; i < count; i++)
+        size += iov[i].iov_len;
+
+    return append(iov, count) ? size : 0;
+}
+
+/******************************************************************************
+ * Method: writeMessages
+ * Description: Add each buffer to the ring as its own record.
+ *
+ * Return:
+ *   bytes written, records too big for the ring are left out
+ * Exceptions:
+ *   SocketNotInitialized
+ ******************************************************************************/
+uint32_t SharedMemoryRing::writeMessages(const struct iovec *iov, int count) {
+    uint32_t bytesWritten = 0;
+
+    if(!connected())
+        throw SocketNotInitialized();
+
+    for(int i = 0; i < count; i++)
+        if(append(&iov[i], 1))
+            bytesWritten += iov[i].iov_len;
+
+    return bytesWritten;
+}
+
+/******************************************************************************
+ * Method: readData
+ * Description: The writer doesn't read, see SharedMemoryReader.
+ *
+ * Exceptions:
+ *   NotImplemented
+ ******************************************************************************/
+uint32_t SharedMemoryRing::readData(char *, uint32_t) {
+    throw NotImplemented();
+}
+
+/******************************************************************************
+ * Method: append
+ * Description: Write one record at the head, moving the tail past anything
+ * it overwrites first.
+ *
+ * Parameters:
+ *   iov - the record's buffers
+ *   count - number of buffers
+ * Return:
+ *   false if the record won't fit in the ring at all
+ ******************************************************************************/
+bool SharedMemoryRing::append(const struct iovec *iov, int count) {
+    uint64_t size = 0;
+
+    for(int i = 0; i < count; i++)
+        size += iov[i].iov_len;
+
+    uint64_t recordSize = SHM_RING_ALIGN(sizeof(SharedRingRecord) + size);
+    if(recordSize > m_iCapacity) {
+        LOG(ERROR) << "record of " << size << " bytes doesn't fit shared memory ring "
+                   << m_sName;
+        return false;
+    }
+
+    uint64_t head = m_pHeader->head;
+    uint64_t offset = head & (m_iCapacity - 1);
+    uint64_t remaining = m_iCapacity - offset;
+    bool wrap = recordSize > remaining;
+
+    makeRoom(head, wrap ? remaining + recordSize : recordSize);
+
+    if(wrap) {
+        *(uint32_t *)(m_pData + offset) = SHM_RING_WRAP;
+        head += remaining;
+        offset = 0;
+    }
+
+    SharedRingRecord *record = (SharedRingRecord *)(m_pData + offset);
+    record->length = size;
+    record->reserved = 0;
+    record->sequence = m_pHeader->sequence;
+
+    char *data = (char *)(record + 1);
+    for(int i = 0; i < count; i++) {
+        memcpy(data, iov[i].iov_base, iov[i].iov_len);
+        data += iov[i].iov_len;
+    }
+
+    __atomic_store_n(&m_pHeader->sequence, record->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&m_pHeader->head, head + recordSize, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/******************************************************************************
+ * Method: makeRoom
+ * Description: Move the tail past the oldest records until size bytes at the
+ * head are free.  The new tail is published before any of those bytes are
+ * written, so a reader that copied one of them can tell.
+ *
+ * Parameters:
+ *   head - where the write starts
+ *   size - bytes about to be written
+ ******************************************************************************/
+void SharedMemoryRing::makeRoom(uint64_t head, uint64_t size) {
+    uint64_t tail = m_pHeader->tail;
+
+    if(head + size - tail <= m_iCapacity)
+        return;
+
+    while(head + size - tail > m_iCapacity) {
+        uint64_t offset = tail & (m_iCapacity - 1);
+        uint64_t remaining = m_iCapacity - offset;
+
+        if(remaining < sizeof(SharedRingRecord)) {
+            tail += remaining;
+            continue;
+        }
+
+        uint32_t length = ((SharedRingRecord *)(m_pData + offset))->length;
+
+        if(length == SHM_RING_WRAP)
+            tail += remaining;
+        else
+            tail += SHM_RING_ALIGN(sizeof(SharedRingRecord) + length);
+    }
+
+    __atomic_store_n(&m_pHeader->tail, tail, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+
+/******************************************************************************
+ *   READER
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ ******************************************************************************/
+SharedMemoryReader::SharedMemoryReader() {
+    m_iCapacity = 0;
+    m_pHeader = NULL;
+    m_pData = NULL;
+    m_iMapSize = 0;
+
+    m_iCursor = 0;
+    m_iNextSequence = 0;
+    m_bSynced = false;
+
+    m_iReceived = 0;
+    m_iLost = 0;
+    m_iOverruns = 0;
+}
+
+/******************************************************************************
+ * Method: Destructor
+ ******************************************************************************/
+SharedMemoryReader::~SharedMemoryReader() {
+    close();
+}
+
+/******************************************************************************
+ * Method: initialize
+ * Description: Map the segment read only and start at the head.
+ *
+ * Exceptions:
+ *   SocketMissingConfig
+ *   SocketConnectFailure
+ ******************************************************************************/
+bool SharedMemoryReader::initialize() {
+    struct stat info;
+
+    if(!m_sName.length())
+        throw SocketMissingConfig("missing shared memory name");
+
+    close();
+
+    int fd = shm_open(m_sName.c_str(), O_RDONLY, 0);
+    if(fd < 0)
+        throw SocketConnectFailure(m_sName + ": " + strerror(errno));
+
+    if(fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(SharedRingHeader)) {
+        ::close(fd);
+        throw SocketConnectFailure(m_sName + ": segment too small");
+    }
+
+    void *map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if(map == MAP_FAILED)
+        throw SocketConnectFailure(m_sName + ": " + strerror(errno));
+
+    const SharedRingHeader *header = (const SharedRingHeader *)map;
+
+    if(__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHM_RING_MAGIC ||
+       header->version != SHM_RING_VERSION ||
+       sizeof(SharedRingHeader) + header->capacity > (uint64_t)info.st_size) {
+        munmap(map, info.st_size);
+        throw SocketConnectFailure(m_sName + ": not a port agent ring");
+    }
+
+    m_pHeader = header;
+    m_pData = (const char *)map + sizeof(SharedRingHeader);
+    m_iMapSize = info.st_size;
+    m_iCapacity = header->capacity;
+
+    m_iCursor = __atomic_load_n(&m_pHeader->head, __ATOMIC_ACQUIRE);
+    m_iNextSequence = __atomic_load_n(&m_pHeader->sequence, __ATOMIC_RELAXED);
+    m_bSynced = true;
+
+    m_iReceived = 0;
+    m_iLost = 0;
+    m_iOverruns = 0;
+
+    LOG(DEBUG) << "shared memory reader " << m_sName << " capacity: " << m_iCapacity;
+
+    return true;
+}
+
+/******************************************************************************
+ * Method: close
+ ******************************************************************************/
+void SharedMemoryReader::close() {
+    if(m_pHeader)
+        munmap((void *)m_pHeader, m_iMapSize);
+
+    m_pHeader = NULL;
+    m_pData = NULL;
+    m_iMapSize = 0;
+}
+
+/******************************************************************************
+ * Method: rewind
+ * Description: Move the cursor back to the oldest record in the ring.
+ ******************************************************************************/
+void SharedMemoryReader::rewind() {
+    if(!connected())
+        return;
+
+    m_iCursor = __atomic_load_n(&m_pHeader->tail, __ATOMIC_ACQUIRE);
+
+    // Whatever came before the oldest record isn't lost to us
+    m_bSynced = false;
+}
+
+/******************************************************************************
+ * Method: closed
+ * Description: The writer clears the magic when it closes the segment.  A
+ * writer that died without closing isn't noticed here.
+ ******************************************************************************/
+bool SharedMemoryReader::closed() {
+    if(!connected())
+        return true;
+
+    return __atomic_load_n(&m_pHeader->magic, __ATOMIC_ACQUIRE) != SHM_RING_MAGIC;
+}
+
+/******************************************************************************
+ * Method: available
+ * Description: Bytes of records waiting for this reader.  The writer may be
+ * adding more while we look.
+ ******************************************************************************/
+uint64_t SharedMemoryReader::available() {
+    if(!connected())
+        return 0;
+
+    return __atomic_load_n(&m_pHeader->head, __ATOMIC_ACQUIRE) - m_iCursor;
+}
+
+/******************************************************************************
+ * Method: readData
+ * Description: Copy the record at the cursor and move past it.  Every copy
+ * is checked against the tail afterwards; if the writer got there first the
+ * copy is dropped and we carry on from the tail.
+ *
+ * Parameters:
+ *   buffer - where to put the record
+ *   size - bytes available in buffer
+ * Return:
+ *   bytes copied, 0 if there is nothing new
+ * Exceptions:
+ *   SocketNotInitialized
+ ******************************************************************************/
+uint32_t SharedMemoryReader::readData(char *buffer, uint32_t size) {
+    SharedRingRecord record;
+
+    if(!connected())
+        throw SocketNotInitialized();
+
+    while(true) {
+        uint64_t head = __atomic_load_n(&m_pHeader->head, __ATOMIC_ACQUIRE);
+        if(m_iCursor == head)
+            return 0;
+
+        if(m_iCursor < __atomic_load_n(&m_pHeader->tail, __ATOMIC_ACQUIRE)) {
+            overrun();
+            continue;
+        }
+
+        uint64_t offset = m_iCursor & (m_iCapacity - 1);
+        uint64_t remaining = m_iCapacity - offset;
+
+        if(remaining < sizeof(SharedRingRecord)) {
+            m_iCursor += remaining;
+            continue;
+        }
+
+        memcpy(&record, m_pData + offset, sizeof(record));
+
+        bool valid = record.length != SHM_RING_WRAP &&
+                     sizeof(SharedRingRecord) + record.length <= remaining;
+        uint32_t copied = 0;
+
+        if(valid) {
+            copied = record.length < size ? record.length : size;
+            memcpy(buffer, m_pData + offset + sizeof(SharedRingRecord), copied);
+        }
+
+        // Was any of that overwritten while we copied it?
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if(m_iCursor < __atomic_load_n(&m_pHeader->tail, __ATOMIC_RELAXED)) {
+            overrun();
+            continue;
+        }
+
+        if(record.length == SHM_RING_WRAP) {
+            m_iCursor += remaining;
+            continue;
+        }
+
+        if(!valid) {
+            LOG(ERROR) << "bad record in " << m_sName << ", skip to head";
+            m_iCursor = head;
+            m_iOverruns++;
+            continue;
+        }
+
+        if(m_bSynced && record.sequence > m_iNextSequence)
+            m_iLost += record.sequence - m_iNextSequence;
+
+        m_bSynced = true;
+        m_iNextSequence = record.sequence + 1;
+        m_iCursor += SHM_RING_ALIGN(sizeof(SharedRingRecord) + record.length);
+        m_iReceived++;
+
+        return copied;
+    }
+}
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: overrun
+ * Description: The writer lapped us, carry on from the oldest record.  The
+ * records skipped are counted as lost from the gap in sequence numbers.
+ ******************************************************************************/
+void SharedMemoryReader::overrun() {
+    LOG(DEBUG) << "shared memory reader overrun at " << m_iCursor;
+
+    m_iCursor = __atomic_load_n(&m_pHeader->tail, __ATOMIC_ACQUIRE);
+    m_iOverruns++;
+}
@@ -0,0 +1,228 @@
+/*******************************************************************************
+ * Class: SharedMemoryRing, SharedMemoryReader
+ * Filename: shared_memory_ring.h
+ * License: Apache 2.0
+ *
+ * Ring of records in POSIX shared memory for consumers on the same host.
+ * The port agent is the only writer, any number of readers map the segment
+ * read only and keep their own cursor, so nobody ever waits on anybody and
+ * a read costs no system calls.
+ *
+ * The segment is a header followed by the data area:
+ *
+ *   magic, version, capacity
+ *   head      byte position after the newest record
+ *   tail      byte position of the oldest record still intact
+ *   sequence  sequence of the next record written
+ *
+ * Positions only ever grow, the offset in the data area is position modulo
+ * capacity.  Each record is a length, a sequence and the data, padded to 8
+ * bytes.  A record never wraps; if it doesn't fit at the end of the data
+ * area a SHM_RING_WRAP marker is left there and it goes at the start.
+ *
+ * Before overwriting old records the writer moves the tail past them, and
+ * it moves the head once a new record is complete.  A reader takes a record
+ * between its cursor and the head, then checks the tail again.  If the tail
+ * has passed its cursor the writer lapped it: the copy may be torn, so it is
+ * thrown away and the reader starts again from the tail.  Records skipped
+ * that way show up as a gap in the sequence numbers.
+ *
+ * The capacity is rounded up to a power of two.
+ *
+ * Usage:
+ *
+ * // Writer
+ * SharedMemoryRing ring;
+ * ring.setName("/port_agent_4001");
+ * ring.setCapacity(4 * 1024 * 1024);
+ * ring.initialize();
+ * ring.writeData(buffer, size);
+ *
+ * // Reader, in another process
+ * SharedMemoryReader reader;
+ * reader.setName("/port_agent_4001");
+ * reader.initialize();
+ *
+ * char buffer[65536];
+ * uint32_t size;
+ * while((size = reader.readData(buffer, sizeof(buffer))))
+ *     handle(buffer, size);
+ *
+ * if(reader.closed())
+ *     reader.initialize();
+ *
+ * if(reader.lost())
+ *     LOG(ERROR) << "reader too slow, lost " << reader.lost() << " records";
+ ******************************************************************************/
+
+#ifndef __SHARED_MEMORY_RING_H_
+#define __SHARED_MEMORY_RING_H_
+
+#include "common/logger.h"
+#include "network/comm_base.h"
+
+#include <stdint.h>
+#include <string>
+
+#define SHM_RING_MAGIC   0x50415253
+#define SHM_RING_VERSION 1
+
+// Length of the marker left where a record didn't fit
+#define SHM_RING_WRAP    0xFFFFFFFF
+
+#define SHM_RING_DEFAULT_CAPACITY (4 * 1024 * 1024)
+#define SHM_RING_MIN_CAPACITY     4096
+
+using namespace std;
+using namespace logger;
+
+namespace network {
+    // The start of the segment.  Head and tail are on their own cache lines
+    // so readers polling the head don't share a line with the tail.
+    typedef struct SharedRingHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t capacity;
+        char pad0[48];
+        uint64_t head;
+        uint64_t sequence;
+        char pad1[48];
+        uint64_t tail;
+        char pad2[56];
+    } SharedRingHeader;
+
+    typedef struct SharedRingRecord {
+        uint32_t length;
+        uint32_t reserved;
+        uint64_t sequence;
+    } SharedRingRecord;
+
+    class SharedMemoryRing : public CommBase {
+        /********************
+         *      METHODS     *
+         ********************/
+
+        public:
+            ///////////////////////
+            // Public Methods
+            SharedMemoryRing();
+            SharedMemoryRing(const SharedMemoryRing &rhs);
+            virtual ~SharedMemoryRing();
+
+            virtual CommBase *copy();
+
+            /* Operators */
+            virtual SharedMemoryRing & operator=(const SharedMemoryRing &rhs);
+
+            /* Accessors */
+            bool connected() { return m_pHeader != NULL; }
+            CommType type() { return COMM_SHARED_MEMORY; }
+            bool compare(CommBase *rhs);
+
+            const string & name() { return m_sName; }
+            uint64_t capacity() { return m_iCapacity; }
+
+            // Sequence of the next record written
+            uint64_t sequence();
+
+            void setName(const string &name) { m_sName = name; }
+            void setCapacity(uint64_t capacity);
+
+            // Capacity a ring configured with this size would have
+            static uint64_t roundCapacity(uint64_t capacity);
+
+            /* Commands */
+
+            // Create the segment, a new one replaces any left behind
+            bool initialize();
+            bool connectClient() { return initialize(); }
+            void close();
+
+            virtual uint32_t writeData(const char *buffer, uint32_t size);
+            virtual uint32_t readData(char *buffer, uint32_t size);
+            virtual uint32_t writeVector(const struct iovec *iov, int count);
+            virtual uint32_t writeMessages(const struct iovec *iov, int count);
+
+        private:
+            bool append(const struct iovec *iov, int count);
+            void makeRoom(uint64_t head, uint64_t size);
+
+        /********************
+         *      MEMBERS     *
+         ********************/
+
+        private:
+            string m_sName;
+            uint64_t m_iCapacity;
+
+            SharedRingHeader *m_pHeader;
+            char *m_pData;
+            size_t m_iMapSize;
+    };
+
+    class SharedMemoryReader {
+        /********************
+         *      METHODS     *
+         ********************/
+
+        public:
+            SharedMemoryReader();
+            virtual ~SharedMemoryReader();
+
+            void setName(const string &name) { m_sName = name; }
+
+            // Map the segment, reading starts with the next record written
+            bool initialize();
+            void close();
+
+            // Start again from the oldest record still in the ring
+            void rewind();
+
+            // Copy the next record to buffer, 0 if there isn't one.  A record
+            // bigger than buffer is cut off.
+            uint32_t readData(char *buffer, uint32_t size);
+
+            /* Accessors */
+            bool connected() { return m_pHeader != NULL; }
+            uint64_t capacity() { return m_iCapacity; }
+
+            // The writer closed or replaced the segment, initialize again
+            bool closed();
+
+            // Bytes of records waiting for this reader, roughly
+            uint64_t available();
+
+            uint64_t received() { return m_iReceived; }
+
+            // Records overwritten before we read them
+            uint64_t lost() { return m_iLost; }
+
+            // Times the writer lapped us
+            uint64_t overruns() { return m_iOverruns; }
+
+        private:
+            void overrun();
+
+        /********************
+         *      MEMBERS     *
+         ********************/
+
+        private:
+            string m_sName;
+            uint64_t m_iCapacity;
+
+            const SharedRingHeader *m_pHeader;
+            const char *m_pData;
+            size_t m_iMapSize;
+
+            uint64_t m_iCursor;
+            uint64_t m_iNextSequence;
+            bool m_bSynced;
+
+            uint64_t m_iReceived;
+            uint64_t m_iLost;
+            uint64_t m_iOverruns;
+    };
+}
+
+#endif //__SHARED_MEMORY_RING_H_
@@ -23,6 +23,9 @@
  * // random ports.
  * uint16_t port = ts.getListenPort();
  * 
+ * // Allow several clients at once.  The default is one.
+ * ts.setMaxClients(4);
+ *
  * // Accept client connections
  * ts.acceptClient();
  *
@@ -30,7 +33,7 @@
  * char buffer[128];
  * int bytes_read = ts.readData(buffer, 128);
  *
- * // Write data to the client.
+ * // Write data to every client.
  * int bytes_written = ts.writeData("Hello World", strlen("Hello World"));
  *
  * // When using non-blocking you may want to use a select read loop to monitor
@@ -55,6 +58,7 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <vector>
 
 
 using namespace std;
@@ -73,7 +77,14 @@ TCPCommListener::TCPCommListener() : CommBase() {
     m_iPort = 0;
 	    
     m_pServerFD = 0;
-    m_pClientFD = 0;
+    m_iMaxClients = 1;
+
+    m_iOutputLimit = DEFAULT_OUTPUT_BUFFER_SIZE;
+    m_eOutputPolicy = OUTPUT_DROP_OLDEST;
+
+    m_iDroppedOldest = 0;
+    m_iDroppedNewest = 0;
+    m_iDisconnects = 0;
 }
 
 
@@ -86,7 +97,24 @@ TCPCommListener::TCPCommListener(const TCPCommListener &rhs) : CommBase(rhs) {
     m_iPort = rhs.m_iPort;
 	    
     m_pServerFD = rhs.m_pServerFD;
-    m_pClientFD = rhs.m_pClientFD;
+    m_iMaxClients = rhs.m_iMaxClients;
+
+    m_iOutputLimit = rhs.m_iOutputLimit;
+    m_eOutputPolicy = rhs.m_eOutputPolicy;
+
+    m_iDroppedOldest = 0;
+    m_iDroppedNewest = 0;
+    m_iDisconnects = 0;
+
+    // Queued output stays with the original
+    for(ListenerClientList::const_iterator i = rhs.m_oClients.begin();
+        i != rhs.m_oClients.end(); i++) {
+        ListenerClient client;
+        client.fd = i->fd;
+        client.output.setLimit(m_iOutputLimit);
+        client.output.setPolicy(m_eOutputPolicy);
+        m_oClients.push_back(client);
+    }
 }
 
 
@@ -159,23 +187,43 @@ bool TCPCommListener::disconnect() {
 
 /******************************************************************************
  * Method: disconnectClient
- * Description: Disconnect a client
+ * Description: Disconnect all clients
  ******************************************************************************/
 bool TCPCommListener::disconnectClient(bool server_shutdown) {
-    if(connected()) {
-        LOG(DEBUG2) << "Disconnecting client";
-	    //shutdown(m_pClientFD,2);
-	    close(m_pClientFD);
-	    m_pClientFD = 0;
+    ListenerClientList::iterator i = m_oClients.begin();
+
+    while(i != m_oClients.end()) {
+        LOG(DEBUG2) << "Disconnecting client FD: " << i->fd;
+        i = dropClient(i);
     }
 	
-	if(!server_shutdown) {
+	if(!server_shutdown && !listening()) {
 		LOG(DEBUG) << "Re-initalize tcp listener";
 	    initialize();
 	}
     
     return true;
 }
+
+/******************************************************************************
+ * Method: disconnectClient
+ * Description: Disconnect one client.  If it held command authority the next
+ * oldest client takes it over.
+ *
+ * Parameters:
+ *   fd - the client's file descriptor
+ ******************************************************************************/
+bool TCPCommListener::disconnectClient(int fd) {
+    ListenerClientList::iterator i = findClient(fd);
+
+    if(i == m_oClients.end())
+        return false;
+
+    dropClient(i);
+    restartServer();
+
+    return true;
+}
 /******************************************************************************
  * Method: disconnectServer
  * Description: Disconnect a server
@@ -207,12 +255,12 @@ bool TCPCommListener::acceptClient() {
     if(!listening())
         throw SocketNotInitialized();
 
-    if(connected()) {
+    if(m_oClients.size() >= m_iMaxClients) {
         clilen = sizeof(cli_addr);
         newsockfd = accept(m_pServerFD, 
                     (struct sockaddr *) &cli_addr, 
                     &clilen);
-		if(newsockfd) close(newsockfd);
+		if(newsockfd >= 0) close(newsockfd);
         throw SocketAlreadyConnected();
 	}
 
@@ -243,14 +291,65 @@ bool TCPCommListener::acceptClient() {
     }
     
     LOG(DEBUG) << "Storing new FD: " << newsockfd;
-	m_pClientFD = newsockfd;
+    ListenerClient client;
+    client.fd = newsockfd;
+    client.output.setLimit(m_iOutputLimit);
+    client.output.setPolicy(m_eOutputPolicy);
+	m_oClients.push_back(client);
+
+    if(m_oClients.size() > 1)
+        LOG(INFO) << "client FD: " << newsockfd << " connected, " << m_oClients.size()
+                  << " clients, FD: " << clientFD() << " has command authority";
 	
-    LOG(DEBUG) << "Disconnect server";
-	disconnectServer();
+    // Refuse more connections until a client leaves
+    if(m_oClients.size() >= m_iMaxClients) {
+        LOG(DEBUG) << "Disconnect server";
+	    disconnectServer();
+    }
 	
     return true;
 }
 
+/******************************************************************************
+ * Method: clientFDs
+ * Description: The file descriptors of every client, oldest first.
+ *
+ * Parameters:
+ *   fds - set to the client FDs
+ ******************************************************************************/
+void TCPCommListener::clientFDs(vector<int> &fds) {
+    fds.clear();
+
+    for(ListenerClientList::iterator i = m_oClients.begin(); i != m_oClients.end(); i++)
+        fds.push_back(i->fd);
+}
+
+/******************************************************************************
+ * Method: setMaxClients
+ * Description: How many clients may be connected at once.  Clients already
+ * connected are kept if the limit goes down, but no more are accepted.  If
+ * the limit goes up on a full listener it starts listening again.
+ *
+ * Parameters:
+ *   maxClients - most clients, at least 1
+ ******************************************************************************/
+void TCPCommListener::setMaxClients(uint32_t maxClients) {
+    if(maxClients < 1)
+        maxClients = 1;
+
+    if(maxClients == m_iMaxClients)
+        return;
+
+    LOG(DEBUG) << "max clients: " << maxClients;
+    m_iMaxClients = maxClients;
+
+    // A listener without clients is started by its owner
+    if(m_oClients.size() >= m_iMaxClients)
+        disconnectServer();
+    else if(connected())
+        restartServer();
+}
+
 /******************************************************************************
  * Method: getListenPort
  * Description: Return the port the server is actually listening on.
@@ -333,7 +432,7 @@ bool TCPCommListener::initialize() {
 	}
 	    
 	LOG(DEBUG2) << "Starting server";
-	retval = listen(newsock, 0);
+	retval = listen(newsock, m_iMaxClients > 1 ? m_iMaxClients : 0);
 	LOG(DEBUG3) << "listen return value: " << retval;
 	
 	if (retval < 0)
@@ -364,52 +463,232 @@ bool TCPCommListener::initialize() {
 
 /******************************************************************************
  * Method: write
- * Description: write a number of bytes to the socket connection.  Currently we
- * try to write three times before we fail.  We might want to update this retry
- * so that it keeps retrying if it see progress being made?
+ * Description: write a number of bytes to the client.  See writeVector.
  *
  * Parameters:
  *   buffer - the data to write
  *   size - the size of the buffer array
  * Return:
- *   returns the actual number of bytes written.
+ *   returns the number of bytes written or queued, 0 if no client is
+ *   connected.
  * Exceptions:
- *   SocketNotInitialized
- *   SocketNotConnected
  *   SocketWriteFailure
  ******************************************************************************/
 uint32_t TCPCommListener::writeData(const char *buffer, const uint32_t size) {
-    int bytesWritten = 0;
-    int bytesRemaining = size;
-    int count;
+    struct iovec iov;
+
+    iov.iov_base = (void *)buffer;
+    iov.iov_len = size;
+
+    return writeVector(&iov, 1);
+}
+
+
+/******************************************************************************
+ * Method: writeVector
+ * Description: write several buffers to every client with writev.  Client
+ * sockets don't block, what one won't take now is queued in its output
+ * buffer and written by flushOutput() once the socket is writable.  While
+ * anything is queued new data goes behind it so the order is kept.
+ *
+ * A client whose write fails, or that is too slow under the disconnect
+ * policy, is dropped.  The others still get the data, then the drop is
+ * reported with an exception.
+ *
+ * Parameters:
+ *   iov - the buffers to write
+ *   count - number of buffers
+ * Return:
+ *   returns the number of bytes written or queued, 0 if no client is
+ *   connected.  Data dropped by the output buffer policy is counted as
+ *   written.
+ * Exceptions:
+ *   SocketWriteFailure
+ ******************************************************************************/
+uint32_t TCPCommListener::writeVector(const struct iovec *iov, int count) {
+    ListenerClientList::iterator i = m_oClients.begin();
+    uint32_t size = 0;
+    uint32_t dropped = 0;
+    string error;
 
     if(! connected()) {
-		LOG(DEBUG) << "Socket (FD: " << m_pClientFD << ") not connected";
+		LOG(DEBUG) << "Socket not connected, no clients";
 		return 0;
     }
-    
-    while( bytesRemaining > 0 ) {
-        LOG(DEBUG) << "WRITE DEVICE: " << buffer << "FD: " << m_pClientFD;
-        count = write(m_pClientFD, buffer + bytesWritten, bytesRemaining );
-        LOG(DEBUG1) << "bytes written: " << count << " remaining: " << bytesRemaining;
-        if(count < 0) {
-            LOG(ERROR) << strerror(errno) << "(errno: " << errno << ")";
-            throw(SocketWriteFailure(strerror(errno)));
+
+    for(int j = 0; j < count; j++)
+        size += iov[j].iov_len;
+
+    while(i != m_oClients.end()) {
+        if(writeClient(*i, iov, count, size)) {
+            i++;
+            continue;
         }
 
-        bytesWritten += count;
-        bytesRemaining -= count;
+        error = errno ? strerror(errno) : "slow consumer disconnected";
+        i = dropClient(i);
+        dropped++;
+    }
 
-        LOG(DEBUG2) << "wrote bytes: " << count << " bytes remaining: " << bytesRemaining;
+    if(dropped) {
+        restartServer();
+        throw(SocketWriteFailure(error));
     }
 
-    return bytesWritten;
+    return size;
+}
+
+
+/******************************************************************************
+ * Method: flushOutput
+ * Description: write as much of each client's output buffer as it will take
+ * without blocking.  A client is dropped if the write fails.
+ *
+ * Return:
+ *   returns false if a client was disconnected, otherwise true.
+ ******************************************************************************/
+bool TCPCommListener::flushOutput() {
+    ListenerClientList::iterator i = m_oClients.begin();
+    vector<struct iovec> pending;
+    int bytesWritten;
+    bool result = true;
+
+    while(i != m_oClients.end()) {
+        if(i->output.empty()) {
+            i++;
+            continue;
+        }
+
+        i->output.iov(pending);
+
+        bytesWritten = writeVectorToFD(i->fd, &pending[0], pending.size(), true);
+        if(bytesWritten < 0) {
+            LOG(ERROR) << "flush output FD: " << i->fd << " " << strerror(errno)
+                       << "(errno: " << errno << ")";
+            i = dropClient(i);
+            result = false;
+            continue;
+        }
+
+        i->output.consume(bytesWritten);
+
+        LOG(DEBUG2) << "client FD: " << i->fd << " flushed bytes: " << bytesWritten
+                    << " still queued: " << i->output.size();
+        i++;
+    }
+
+    if(!result)
+        restartServer();
+
+    return result;
+}
+
+
+/******************************************************************************
+ * Method: outputPending
+ * Description: Does any client have output waiting?
+ ******************************************************************************/
+bool TCPCommListener::outputPending() {
+    for(ListenerClientList::iterator i = m_oClients.begin(); i != m_oClients.end(); i++)
+        if(!i->output.empty())
+            return true;
+
+    return false;
+}
+
+
+/******************************************************************************
+ * Method: outputPending
+ * Description: Does one client have output waiting?
+ *
+ * Parameters:
+ *   fd - the client's file descriptor
+ * Return:
+ *   false if the fd isn't a client
+ ******************************************************************************/
+bool TCPCommListener::outputPending(int fd) {
+    ListenerClientList::iterator i = findClient(fd);
+
+    return i != m_oClients.end() && !i->output.empty();
+}
+
+
+/******************************************************************************
+ * Method: setOutputBuffer
+ * Description: set the size of the output buffers and what to do when one is
+ * full.
+ ******************************************************************************/
+void TCPCommListener::setOutputBuffer(uint32_t limit, OutputPolicy policy) {
+    m_iOutputLimit = limit;
+    m_eOutputPolicy = policy;
+
+    for(ListenerClientList::iterator i = m_oClients.begin(); i != m_oClients.end(); i++) {
+        i->output.setLimit(limit);
+        i->output.setPolicy(policy);
+    }
+}
+
+
+/******************************************************************************
+ * Method: outputQueued
+ * Description: Bytes queued for all clients.
+ ******************************************************************************/
+uint64_t TCPCommListener::outputQueued() {
+    uint64_t result = 0;
+
+    for(ListenerClientList::iterator i = m_oClients.begin(); i != m_oClients.end(); i++)
+        result += i->output.size();
+
+    return result;
+}
+
+
+/******************************************************************************
+ * Method: outputDroppedOldest
+ * Description: Queued messages dropped to make room.
+ ******************************************************************************/
+uint64_t TCPCommListener::outputDroppedOldest() {
+    uint64_t result = m_iDroppedOldest;
+
+    for(ListenerClientList::iterator i = m_oClients.begin(); i != m_oClients.end(); i++)
+        result += i->output.droppedOldest();
+
+    return result;
+}
+
+
+/******************************************************************************
+ * Method: outputDroppedNewest
+ * Description: New messages dropped because they didn't fit.
+ ******************************************************************************/
+uint64_t TCPCommListener::outputDroppedNewest() {
+    uint64_t result = m_iDroppedNewest;
+
+    for(ListenerClientList::iterator i = m_oClients.begin(); i != m_oClients.end(); i++)
+        result += i->output.droppedNewest();
+
+    return result;
+}
+
+
+/******************************************************************************
+ * Method: slowDisconnects
+ * Description: Clients dropped for being too slow.
+ ******************************************************************************/
+uint64_t TCPCommListener::slowDisconnects() {
+    uint64_t result = m_iDisconnects;
+
+    for(ListenerClientList::iterator i = m_oClients.begin(); i != m_oClients.end(); i++)
+        result += i->output.disconnects();
+
+    return result;
 }
 
 
 /******************************************************************************
  * Method: read
- * Description: read a number of bytes to the socket connection.
+ * Description: read a number of bytes from the client with command
+ * authority.  See readClient.
  *
  * Parameters:
  *   buffer - where to store the read data
@@ -417,24 +696,48 @@ uint32_t TCPCommListener::writeData(const char *buffer, const uint32_t size) {
  * Return:
  *   returns the actual number of bytes read.
  * Exceptions:
- *   SocketNotInitialized
  *   SocketNotConnected
  *   SocketReadFailure
  ******************************************************************************/
 uint32_t TCPCommListener::readData(char *buffer, const uint32_t size) {
-    int bytesRead = 0;
-
     if(! connected()) {
 	    LOG(ERROR) << "Socket Not Connected in readData";
         throw(SocketNotConnected("in TCPCommListener readData"));
 	}
     
-    if ((bytesRead = read(m_pClientFD, buffer, size)) < 0) {
+    return readClient(clientFD(), buffer, size);
+}
+
+
+/******************************************************************************
+ * Method: readClient
+ * Description: read a number of bytes from one client.  The client is
+ * dropped if it has closed the connection.
+ *
+ * Parameters:
+ *   fd - the client's file descriptor
+ *   buffer - where to store the read data
+ *   size - max number of bytes to read
+ * Return:
+ *   returns the actual number of bytes read.
+ * Exceptions:
+ *   SocketNotConnected
+ *   SocketReadFailure
+ ******************************************************************************/
+uint32_t TCPCommListener::readClient(int fd, char *buffer, const uint32_t size) {
+    int bytesRead = 0;
+
+    if(! hasClient(fd)) {
+	    LOG(ERROR) << "Socket Not Connected in readClient, FD: " << fd;
+        throw(SocketNotConnected("in TCPCommListener readClient"));
+	}
+    
+    if ((bytesRead = read(fd, buffer, size)) < 0) {
         if (errno == EAGAIN || errno == EINPROGRESS) {
             LOG(DEBUG2) << "Error Ignored: " << strerror(errno);
         } else if( errno == ETIMEDOUT ) {
-            LOG(DEBUG) << " -- socket read timeout. disconnecting client FD:" << m_pClientFD;
-            disconnectClient();
+            LOG(DEBUG) << " -- socket read timeout. disconnecting client FD:" << fd;
+            disconnectClient(fd);
         } else {
             LOG(ERROR) << "bytes read: " << bytesRead << " read_device: " << strerror(errno) << "(errno: " << errno << ")";
             throw(SocketReadFailure(strerror(errno)));
@@ -443,11 +746,110 @@ uint32_t TCPCommListener::readData(char *buffer, const uint32_t size) {
         LOG(DEBUG2) << "read bytes: " << bytesRead;
     }
     else if(bytesRead == 0) {
-        LOG(INFO) << " -- Device connection closed; zero bytes received. port: " << m_iPort;
-        disconnectClient();
+        LOG(INFO) << " -- Device connection closed; zero bytes received. port: " << m_iPort
+                  << " FD: " << fd;
+        disconnectClient(fd);
     }
     else
         LOG(DEBUG) << "READ DEVICE: " << buffer;
 
     return bytesRead < 0 ? 0 : bytesRead;
 }
+
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: findClient
+ * Description: Find a client by file descriptor.
+ ******************************************************************************/
+ListenerClientList::iterator TCPCommListener::findClient(int fd) {
+    ListenerClientList::iterator i;
+
+    for(i = m_oClients.begin(); i != m_oClients.end(); i++)
+        if(i->fd == fd)
+            break;
+
+    return i;
+}
+
+
+/******************************************************************************
+ * Method: dropClient
+ * Description: Close a client and forget it, keeping its counters.  If it
+ * held command authority the next oldest client takes it over.  The server
+ * isn't restarted here, see restartServer.
+ *
+ * Return:
+ *   the client after the one dropped
+ ******************************************************************************/
+ListenerClientList::iterator TCPCommListener::dropClient(ListenerClientList::iterator client) {
+    bool authority = client == m_oClients.begin();
+
+    LOG(DEBUG2) << "Disconnecting client FD: " << client->fd;
+    close(client->fd);
+
+    m_iDroppedOldest += client->output.droppedOldest();
+    m_iDroppedNewest += client->output.droppedNewest();
+    m_iDisconnects += client->output.disconnects();
+
+    client = m_oClients.erase(client);
+
+    if(authority && connected())
+        LOG(INFO) << "client FD: " << clientFD() << " now has command authority";
+
+    return client;
+}
+
+
+/******************************************************************************
+ * Method: writeClient
+ * Description: write to one client, queueing what it won't take now.
+ *
+ * Return:
+ *   false if the client should be dropped, errno is 0 if it was too slow.
+ ******************************************************************************/
+bool TCPCommListener::writeClient(ListenerClient &client, const struct iovec *iov,
+                                  int count, uint32_t size) {
+    int bytesWritten = 0;
+
+    if(client.output.empty()) {
+        bytesWritten = writeVectorToFD(client.fd, iov, count, !blocking());
+        if(bytesWritten < 0) {
+            LOG(ERROR) << "client FD: " << client.fd << " " << strerror(errno)
+                       << "(errno: " << errno << ")";
+            return false;
+        }
+
+        if((uint32_t)bytesWritten == size)
+            return true;
+    }
+
+    LOG(DEBUG2) << "client FD: " << client.fd << " slow, queue "
+                << size - bytesWritten << " bytes";
+
+    if(!client.output.add(iov, count, bytesWritten)) {
+        LOG(ERROR) << "client (FD: " << client.fd << ") too slow, "
+                   << client.output.size() << " bytes waiting.  Disconnecting";
+        errno = 0;
+        return false;
+    }
+
+    return true;
+}
+
+
+/******************************************************************************
+ * Method: restartServer
+ * Description: Start listening again if the server was closed because the
+ * listener was full and there is room now.
+ ******************************************************************************/
+void TCPCommListener::restartServer() {
+    if(listening() || m_oClients.size() >= m_iMaxClients)
+        return;
+
+    LOG(DEBUG) << "Re-initalize tcp listener";
+    initialize();
+}
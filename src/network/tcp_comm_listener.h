@@ -23,6 +23,9 @@
  * // random ports.
  * uint16_t port = ts.getListenPort();
  * 
+ * // Allow several clients at once.  The default is one.
+ * ts.setMaxClients(4);
+ *
  * // Accept client connections
  * ts.acceptClient();
  *
@@ -30,13 +33,30 @@
  * char buffer[128];
  * int bytes_read = ts.readData(buffer, 128);
  *
- * // Write data to the client.
+ * // Write data to every client.
  * int bytes_written = ts.writeData("Hello World", strlen("Hello World"));
  *
+ * // A non-blocking client that can't keep up has its data queued, up to a
+ * // limit.  Write the rest when the client FD is writable.
+ * ts.setOutputBuffer(65536, OUTPUT_DROP_OLDEST);
+ * if(ts.outputPending())
+ *     ts.flushOutput();
+ *
  * // When using non-blocking you may want to use a select read loop to monitor
  * // the file descriptors.  They are exposed via accessors
  * int serverFD = ts.getServerFD();
  * int clientFD = ts.getServerFD();
+ *
+ * // With several clients each has its own FD.  Read from the one that is
+ * // ready.  The oldest client holds command authority, clientFD() is its FD.
+ * vector<int> fds;
+ * ts.clientFDs(fds);
+ * bytes_read = ts.readClient(fds[1], buffer, 128);
+ * bool commands = ts.isAuthority(fds[1]);
+ *
+ * The server socket is closed while the listener has all the clients it
+ * allows, so extra connections are refused, and opened again when a client
+ * leaves.
  ******************************************************************************/
 
 #ifndef __TCP_COMM_LISTENER_H_
@@ -44,6 +64,10 @@
 
 #include "common/logger.h"
 #include "network/comm_base.h"
+#include "network/output_buffer.h"
+
+#include <list>
+#include <vector>
 
 #define TCP_BIND_TIMEOUT 10
 
@@ -51,6 +75,15 @@ using namespace std;
 using namespace logger;
 
 namespace network {
+
+    // A connected client and the output it hasn't taken yet
+    typedef struct ListenerClient
+    {
+        int fd;
+        OutputBuffer output;
+    } ListenerClient;
+
+    typedef list<ListenerClient> ListenerClientList;
 	
     class TCPCommListener : public CommBase {
         /********************
@@ -74,12 +107,21 @@ namespace network {
 			CommType type() { return COMM_TCP_LISTENER; }
 
             bool listening() { return m_pServerFD > 0; }
-            bool connected() { LOG(DEBUG2) << "client fd: " << m_pClientFD << " addr: " << this; return m_pClientFD; }
+            bool connected() { LOG(DEBUG2) << "clients: " << m_oClients.size() << " addr: " << this; return !m_oClients.empty(); }
 			
 			bool connectClient() { return false; }
 	    
 	        int serverFD() { return m_pServerFD; }
-	        int clientFD() { return m_pClientFD; }
+
+	        // The client with command authority, 0 if there are no clients
+	        int clientFD() { return m_oClients.empty() ? 0 : m_oClients.front().fd; }
+	        void clientFDs(vector<int> &fds);
+	        uint32_t clientCount() { return m_oClients.size(); }
+	        bool hasClient(int fd) { return findClient(fd) != m_oClients.end(); }
+	        bool isAuthority(int fd) { return fd && fd == clientFD(); }
+
+	        uint32_t maxClients() { return m_iMaxClients; }
+	        void setMaxClients(uint32_t maxClients);
 			
 	        void setPort(const uint16_t port) { m_iPort = port; }
             virtual bool compare(CommBase *rhs);
@@ -91,6 +133,7 @@ namespace network {
 	        /* Commands */
 	        bool disconnect();
 	        bool disconnectClient(bool server_shutdown = false);
+	        bool disconnectClient(int fd);
 	        bool disconnectServer();
     	    
 	        bool acceptClient();
@@ -100,12 +143,30 @@ namespace network {
             
 	        virtual uint32_t writeData(const char *buffer, uint32_t size);
             virtual uint32_t readData(char *buffer, uint32_t size);
+            uint32_t readClient(int fd, char *buffer, uint32_t size);
+            virtual uint32_t writeVector(const struct iovec *iov, int count);
+
+            // Output the clients haven't taken yet
+            bool outputPending();
+            bool outputPending(int fd);
+            bool flushOutput();
+            void setOutputBuffer(uint32_t limit, OutputPolicy policy);
+
+            // Output buffer counters, including clients that have gone
+            uint64_t outputQueued();
+            uint64_t outputDroppedOldest();
+            uint64_t outputDroppedNewest();
+            uint64_t slowDisconnects();
 
             // Does this object have a complete configuration?
             bool isConfigured();
         protected:
 
         private:
+            ListenerClientList::iterator findClient(int fd);
+            ListenerClientList::iterator dropClient(ListenerClientList::iterator client);
+            bool writeClient(ListenerClient &client, const struct iovec *iov, int count, uint32_t size);
+            void restartServer();
 
         /********************
          *      MEMBERS     *
@@ -117,7 +178,18 @@ namespace network {
             uint16_t m_iPort;
 	    
 	        int m_pServerFD;
-	        int m_pClientFD;
+
+	        // Oldest first, the first holds command authority
+	        ListenerClientList m_oClients;
+	        uint32_t m_iMaxClients;
+
+	        uint32_t m_iOutputLimit;
+	        OutputPolicy m_eOutputPolicy;
+
+	        // Counters from clients that have been dropped
+	        uint64_t m_iDroppedOldest;
+	        uint64_t m_iDroppedNewest;
+	        uint64_t m_iDisconnects;
             
     };
 }
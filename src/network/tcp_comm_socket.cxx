@@ -9,6 +9,7 @@
  ******************************************************************************/
 
 #include "tcp_comm_socket.h"
+#include "timer_queue.h"
 #include "common/util.h"
 #include "common/logger.h"
 #include "common/exception.h"
@@ -22,6 +23,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <poll.h>
 
 using namespace std;
 using namespace logger;
@@ -38,6 +40,10 @@ using namespace network;
 TCPCommSocket::TCPCommSocket() {
 	m_sHostname = "";
 	m_iPort = 0;
+	m_bConnecting = false;
+	m_bAddressValid = false;
+	m_iResolveTime = 0;
+	m_bResolve = false;
 }
 
 
@@ -48,6 +54,10 @@ TCPCommSocket::TCPCommSocket() {
 TCPCommSocket::TCPCommSocket(const TCPCommSocket &rhs) {
 	m_sHostname = rhs.m_sHostname;
 	m_iPort = rhs.m_iPort;
+	m_bConnecting = false;
+	m_bAddressValid = false;
+	m_iResolveTime = 0;
+	m_bResolve = false;
 }
 
 
@@ -66,6 +76,7 @@ TCPCommSocket::~TCPCommSocket() {
 TCPCommSocket & TCPCommSocket::operator=(const TCPCommSocket &rhs) {
 	m_sHostname = rhs.m_sHostname;
 	m_iPort = rhs.m_iPort;
+	m_bAddressValid = false;
 
 	return *this;
 }
@@ -86,9 +97,7 @@ CommBase * TCPCommSocket::copy() {
  *   SocketMissingConfig
  ******************************************************************************/
 bool TCPCommSocket::initialize() {
-	int fflags;
 	struct sockaddr_in serv_addr;
-	struct hostent *server;
 
 	LOG(DEBUG) << "TCP Port Agent initialize()";
 
@@ -101,18 +110,7 @@ bool TCPCommSocket::initialize() {
 	if(!m_pSocketFD)
 		throw SocketCreateFailure("socket create failure");
 
-	LOG(DEBUG2) << "Looking up server name";
-	server = gethostbyname(m_sHostname.c_str());
-
-	if(!server)
-		throw SocketHostFailure(m_sHostname.c_str());
-
-	bzero((char *) &serv_addr, sizeof(serv_addr));
-	serv_addr.sin_family = AF_INET;
-	bcopy((char *)server->h_addr,
-		 (char *)&serv_addr.sin_addr.s_addr,
-		 server->h_length);
-	serv_addr.sin_port = htons(m_iPort);
+	serverAddress(serv_addr);
 
 	LOG(DEBUG2) << "Connecting to server";
 	int retval = connect(m_pSocketFD,(struct sockaddr *) &serv_addr,sizeof(serv_addr));
@@ -128,10 +126,122 @@ bool TCPCommSocket::initialize() {
 	}
 
 	m_bConnected = true;
+	m_bConnecting = false;
 	
 	return true;
 }
 
+/******************************************************************************
+ * Method: startConnect
+ * Description: Start a non-blocking connect to the server.  If the connect
+ * can't complete straight away the socket is left connecting, wait for it to
+ * become writable and call finishConnect().
+ *
+ * Return:
+ *   true if the connection completed immediately, false if it is in progress.
+ * Exceptions:
+ *   SocketMissingConfig
+ *   SocketCreateFailure
+ *   SocketHostFailure
+ *   SocketConnectFailure
+ ******************************************************************************/
+bool TCPCommSocket::startConnect() {
+	struct sockaddr_in serv_addr;
+	string error;
+
+	LOG(DEBUG) << "TCP start non-blocking connect";
+
+	if(!isConfigured())
+		throw SocketMissingConfig("missing port or hostname");
+
+	if(m_pSocketFD)
+		disconnect();
+
+	serverAddress(serv_addr);
+
+	m_pSocketFD = socket(AF_INET, SOCK_STREAM, 0);
+	if(m_pSocketFD < 0) {
+		m_pSocketFD = 0;
+		throw SocketCreateFailure(strerror(errno));
+	}
+
+	fcntl(m_pSocketFD, F_SETFL, fcntl(m_pSocketFD, F_GETFL) | O_NONBLOCK);
+
+	if(connect(m_pSocketFD, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) == 0) {
+		LOG(DEBUG2) << "connected immediately";
+		return finishConnect();
+	}
+
+	if(errno != EINPROGRESS) {
+		error = strerror(errno);
+		m_bResolve = true;
+		disconnect();
+		throw SocketConnectFailure(error);
+	}
+
+	LOG(DEBUG2) << "connect in progress, FD: " << m_pSocketFD;
+	m_bConnecting = true;
+
+	return false;
+}
+
+/******************************************************************************
+ * Method: finishConnect
+ * Description: Check if a connect started with startConnect() has finished.
+ * The result of the connect is read with SO_ERROR.  If the connect failed the
+ * socket is closed.
+ *
+ * Return:
+ *   true if the socket is connected, false if the connect is still in
+ *   progress.
+ * Exceptions:
+ *   SocketConnectFailure
+ ******************************************************************************/
+bool TCPCommSocket::finishConnect() {
+	struct pollfd pfd;
+	int error = 0;
+	socklen_t length = sizeof(error);
+
+	if(!m_pSocketFD)
+		throw SocketConnectFailure("not connecting");
+
+	if(m_bConnecting) {
+		pfd.fd = m_pSocketFD;
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+
+		if(::poll(&pfd, 1, 0) == 0)
+			return false;
+
+		if(getsockopt(m_pSocketFD, SOL_SOCKET, SO_ERROR, &error, &length) < 0)
+			error = errno;
+
+		if(error) {
+			m_bResolve = true;
+			disconnect();
+			throw SocketConnectFailure(strerror(error));
+		}
+	}
+
+	if(blocking())
+		fcntl(m_pSocketFD, F_SETFL, fcntl(m_pSocketFD, F_GETFL) & ~O_NONBLOCK);
+
+	LOG(DEBUG) << "connected to " << m_sHostname << ":" << m_iPort;
+	m_bConnecting = false;
+	m_bConnected = true;
+
+	return true;
+}
+
+/******************************************************************************
+ * Method: disconnect
+ * Description: Close the socket, abandoning a connect in progress.
+ ******************************************************************************/
+bool TCPCommSocket::disconnect() {
+	m_bConnecting = false;
+	return CommSocket::disconnect();
+}
+
 /******************************************************************************
  * Method: isConfigured
  * Description: Does this class have enough config info?
@@ -139,3 +249,55 @@ bool TCPCommSocket::initialize() {
 bool TCPCommSocket::isConfigured() {
     return m_sHostname.length() && m_iPort > 0;
 }
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: serverAddress
+ * Description: Look up the configured host and port.  An address is parsed
+ * without a lookup.  A hostname lookup blocks, so the result is kept and
+ * reused until it is due again.  If a lookup fails the old address is kept.
+ * Exceptions:
+ *   SocketHostFailure
+ ******************************************************************************/
+void TCPCommSocket::serverAddress(struct sockaddr_in &addr) {
+	struct addrinfo hints, *result;
+	uint64_t now = TimerQueue::now();
+	uint64_t interval = m_bResolve ? TCP_RESOLVE_RETRY : TCP_RESOLVE_INTERVAL;
+	int error;
+
+	if(!m_bAddressValid || now - m_iResolveTime >= interval * USEC_PER_SEC) {
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_NUMERICHOST;
+
+		error = getaddrinfo(m_sHostname.c_str(), NULL, &hints, &result);
+		if(error == EAI_NONAME) {
+			LOG(DEBUG2) << "Looking up server name";
+			hints.ai_flags = 0;
+			error = getaddrinfo(m_sHostname.c_str(), NULL, &hints, &result);
+		}
+
+		if(!error) {
+			memcpy(&m_oServerAddress, result->ai_addr, sizeof(m_oServerAddress));
+			freeaddrinfo(result);
+			m_bAddressValid = true;
+		}
+		else if(m_bAddressValid) {
+			LOG(ERROR) << "keeping old address for " << m_sHostname << ": " << gai_strerror(error);
+		}
+		else {
+			LOG(ERROR) << "resolve " << m_sHostname << ": " << gai_strerror(error);
+			throw SocketHostFailure(m_sHostname.c_str());
+		}
+
+		m_iResolveTime = now;
+		m_bResolve = false;
+	}
+
+	addr = m_oServerAddress;
+	addr.sin_port = htons(m_iPort);
+}
@@ -6,6 +6,19 @@
  *
  * Manage connections to TCP servers.
  *
+ * initialize() connects and returns once the connection is made.  A caller
+ * running an event loop can connect without waiting instead:
+ *
+ * if(!socket.startConnect()) {
+ *     // wait for socket.getSocketFD() to be writable, then
+ *     socket.finishConnect();
+ * }
+ *
+ * An address needs no lookup.  A hostname is looked up with getaddrinfo()
+ * and the address is kept for TCP_RESOLVE_INTERVAL seconds, so reconnecting
+ * doesn't wait on DNS every time.  After a failed connect the name is looked
+ * up again once the address is TCP_RESOLVE_RETRY seconds old.
+ *
  ******************************************************************************/
 
 #ifndef __TCP_COMM_SOCKET_H_
@@ -14,6 +27,15 @@
 #include "common/logger.h"
 #include "comm_socket.h"
 
+#include <netinet/in.h>
+#include <stdint.h>
+
+// Seconds a looked up server address is used before it is looked up again
+#define TCP_RESOLVE_INTERVAL 300
+
+// Seconds before looking up again after a connect to the address failed
+#define TCP_RESOLVE_RETRY 10
+
 using namespace std;
 using namespace logger;
 
@@ -36,15 +58,25 @@ namespace network {
             virtual TCPCommSocket & operator=(const TCPCommSocket &rhs);
 
             /* Accessors */
-            void setHostname(const string &hostname) {m_sHostname = hostname;}
+            void setHostname(const string &hostname) {m_sHostname = hostname; m_bAddressValid = false;}
             void setPort(const uint16_t port) {m_iPort = port;}
 			CommType type() { return COMM_TCP_SOCKET; }
 	    
 	        uint16_t port() { return m_iPort; }
 	        const string & hostname() { return m_sHostname; }
             
+            // A non-blocking connect has been started but hasn't finished
+            bool connecting() { return m_pSocketFD > 0 && m_bConnecting; }
+            bool connected() { return m_pSocketFD > 0 && !m_bConnecting; }
+
             // Connect to the network host
             bool initialize();
+
+            // Connect without waiting
+            bool startConnect();
+            bool finishConnect();
+
+            bool disconnect();
 			
             // Does this object have a complete configuration?
             bool isConfigured();
@@ -52,6 +84,7 @@ namespace network {
         protected:
 
         private:
+            void serverAddress(struct sockaddr_in &addr);
 
         /********************
          *      MEMBERS     *
@@ -60,6 +93,14 @@ namespace network {
         protected:
             
         private:
+            bool m_bConnecting;
+
+            // Last server address looked up and when, monotonic
+            // microseconds, and has a connect to it failed since
+            struct sockaddr_in m_oServerAddress;
+            bool m_bAddressValid;
+            uint64_t m_iResolveTime;
+            bool m_bResolve;
     };
 }
 
@@ -0,0 +1,196 @@
+#include "common/exception.h"
+#include "common/logger.h"
+#include "network/comm_socket.h"
+#include "network/udp_comm_socket.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+//
+// List all tests
+//
+// comm_socket_test --gtest_list_tests
+
+
+//
+// Running individual tests
+//
+// comm_socket_test --gtest_filter=CommSocketTest.WriteVector
+
+using namespace std;
+using namespace logger;
+using namespace network;
+
+const char* TEST_LOG="/tmp/gtest.log";
+const char* LOG_LEVEL="DEBUG3";
+
+/////
+// A comm socket writing to a pipe so we can read back what was written.
+/////
+class PipeSocket : public CommSocket {
+    public:
+        PipeSocket() { m_iReadFD = 0; }
+        ~PipeSocket() { disconnect(); }
+
+        CommBase *copy() { return NULL; }
+        CommType type() { return COMM_UNKNOWN; }
+
+        bool initialize() {
+            int fds[2];
+            if(pipe(fds))
+                return false;
+
+            m_iReadFD = fds[0];
+            setSocket(fds[1]);
+            return true;
+        }
+
+        bool disconnect() {
+            if(m_iReadFD)
+                close(m_iReadFD);
+            if(getSocketFD())
+                close(getSocketFD());
+
+            m_iReadFD = 0;
+            setSocket(0);
+            return true;
+        }
+
+        string readBack() {
+            char buffer[128];
+            int bytesRead = read(m_iReadFD, buffer, sizeof(buffer));
+            return string(buffer, bytesRead > 0 ? bytesRead : 0);
+        }
+
+    private:
+        int m_iReadFD;
+};
+
+/////
+// Only implements writeData, so writeVector falls back to the base class
+/////
+class RecordingComm : public CommBase {
+    public:
+        RecordingComm() : m_iWrites(0) {}
+
+        CommBase *copy() { return NULL; }
+        bool connected() { return true; }
+        CommType type() { return COMM_UNKNOWN; }
+        bool compare(CommBase *rhs) { return false; }
+        bool initialize() { return true; }
+        bool connectClient() { return true; }
+        uint32_t readData(char *buffer, uint32_t size) { return 0; }
+
+        uint32_t writeData(const char *buffer, uint32_t size) {
+            m_sWritten.append(buffer, size);
+            m_iWrites++;
+            return size;
+        }
+
+        string m_sWritten;
+        int m_iWrites;
+};
+
+class CommSocketTest : public testing::Test {
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile(TEST_LOG);
+            Logger::SetLogLevel(LOG_LEVEL);
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "            Comm Socket Test Start Up";
+            LOG(INFO) << "************************************************";
+        }
+
+        void setBuffer(struct iovec &iov, const char *buffer) {
+            iov.iov_base = (void *)buffer;
+            iov.iov_len = strlen(buffer);
+        }
+};
+
+/* Several buffers go out in order as one write */
+TEST_F(CommSocketTest, WriteVector) {
+    PipeSocket socket;
+    struct iovec iov[4];
+
+    setBuffer(iov[0], "<<");
+    setBuffer(iov[1], "data");
+    setBuffer(iov[2], "");
+    setBuffer(iov[3], ">>");
+
+    ASSERT_TRUE(socket.initialize());
+    EXPECT_EQ(socket.writeVector(iov, 4), 8);
+    EXPECT_EQ(socket.readBack(), "<<data>>");
+
+    // Nothing to write is fine too
+    EXPECT_EQ(socket.writeVector(iov, 0), 0);
+
+    socket.disconnect();
+    EXPECT_THROW(socket.writeVector(iov, 4), SocketWriteFailure);
+}
+
+/* Without an overload each buffer is a writeData call */
+TEST_F(CommSocketTest, WriteVectorFallback) {
+    RecordingComm comm;
+    struct iovec iov[3];
+
+    setBuffer(iov[0], "<<");
+    setBuffer(iov[1], "");
+    setBuffer(iov[2], "data");
+
+    EXPECT_EQ(comm.writeVector(iov, 3), 6);
+    EXPECT_EQ(comm.m_sWritten, "<<data");
+    EXPECT_EQ(comm.m_iWrites, 2);
+}
+
+/* Without an overload the messages are one vectored write */
+TEST_F(CommSocketTest, WriteMessagesFallback) {
+    RecordingComm comm;
+    struct iovec iov[2];
+
+    setBuffer(iov[0], "one");
+    setBuffer(iov[1], "two");
+
+    EXPECT_EQ(comm.writeMessages(iov, 2), 6);
+    EXPECT_EQ(comm.m_sWritten, "onetwo");
+}
+
+/* UDP sends each message as its own datagram */
+TEST_F(CommSocketTest, UDPWriteMessages) {
+    struct sockaddr_in addr;
+    socklen_t addrLength = sizeof(addr);
+    UDPCommSocket socket;
+    struct iovec iov[3];
+    char buffer[16];
+
+    int receiver = ::socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(receiver, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    ASSERT_EQ(bind(receiver, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    ASSERT_EQ(getsockname(receiver, (struct sockaddr *)&addr, &addrLength), 0);
+
+    setBuffer(iov[0], "one");
+    setBuffer(iov[1], "three");
+    setBuffer(iov[2], "four");
+
+    socket.setHostname("127.0.0.1");
+    socket.setPort(ntohs(addr.sin_port));
+    ASSERT_TRUE(socket.initialize());
+    EXPECT_EQ(socket.writeMessages(iov, 3), 12);
+
+    EXPECT_EQ(recv(receiver, buffer, sizeof(buffer), 0), 3);
+    EXPECT_EQ(recv(receiver, buffer, sizeof(buffer), 0), 5);
+    EXPECT_EQ(recv(receiver, buffer, sizeof(buffer), 0), 4);
+    EXPECT_EQ(string(buffer, 4), "four");
+
+    close(receiver);
+}
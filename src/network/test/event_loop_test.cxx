@@ -0,0 +1,254 @@
+#include "common/exception.h"
+#include "common/logger.h"
+#include "network/event_loop.h"
+#include "gtest/gtest.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+//
+// List all tests
+//
+// event_loop_test --gtest_list_tests
+
+
+//
+// Running individual tests
+//
+// event_loop_test --gtest_filter=EventLoopTest.DispatchReadable
+
+using namespace logger;
+using namespace network;
+
+const char* TEST_LOG="/tmp/gtest.log";
+const char* LOG_LEVEL="DEBUG3";
+
+/////
+// Record the last event delivered and optionally unregister another
+// descriptor from inside the callback.
+/////
+class TestHandler : public EventHandler {
+    public:
+        TestHandler() : m_iCount(0), m_iLastFD(-1), m_iLastEvents(0),
+                        m_pLoop(NULL), m_iRemoveFD(-1) {}
+
+        void handleEvent(int fd, uint32_t events) {
+            m_iCount++;
+            m_iLastFD = fd;
+            m_iLastEvents = events;
+
+            if(m_pLoop && m_iRemoveFD >= 0)
+                m_pLoop->removeHandler(m_iRemoveFD);
+        }
+
+        int m_iCount;
+        int m_iLastFD;
+        uint32_t m_iLastEvents;
+
+        EventLoop *m_pLoop;
+        int m_iRemoveFD;
+};
+
+class EventLoopTest : public testing::Test {
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile(TEST_LOG);
+            Logger::SetLogLevel(LOG_LEVEL);
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "            Event Loop Test Start Up";
+            LOG(INFO) << "************************************************";
+
+            ASSERT_EQ(pipe(m_aPipeA), 0);
+            ASSERT_EQ(pipe(m_aPipeB), 0);
+        }
+
+        virtual void TearDown() {
+            close(m_aPipeA[0]);
+            close(m_aPipeA[1]);
+            close(m_aPipeB[0]);
+            close(m_aPipeB[1]);
+        }
+
+        int m_aPipeA[2];
+        int m_aPipeB[2];
+};
+
+/* Register and remove descriptors */
+TEST_F(EventLoopTest, Registration) {
+    EventLoop loop;
+    TestHandler handler;
+
+    EXPECT_GT(loop.pollFD(), 0);
+    EXPECT_EQ(loop.handlerCount(), 0);
+
+    EXPECT_TRUE(loop.addHandler(m_aPipeA[0], &handler));
+    EXPECT_TRUE(loop.registered(m_aPipeA[0]));
+    EXPECT_EQ(loop.handler(m_aPipeA[0]), &handler);
+    EXPECT_EQ(loop.handlerCount(), 1);
+
+    // Re-adding the same descriptor modifies the registration
+    EXPECT_TRUE(loop.addHandler(m_aPipeA[0], &handler));
+    EXPECT_EQ(loop.handlerCount(), 1);
+
+    EXPECT_TRUE(loop.addHandler(m_aPipeB[0], &handler));
+    EXPECT_EQ(loop.handlerCount(), 2);
+
+    EXPECT_TRUE(loop.removeHandler(m_aPipeA[0]));
+    EXPECT_FALSE(loop.registered(m_aPipeA[0]));
+    EXPECT_FALSE(loop.removeHandler(m_aPipeA[0]));
+    EXPECT_TRUE(loop.handler(m_aPipeA[0]) == NULL);
+
+    loop.clear();
+    EXPECT_EQ(loop.handlerCount(), 0);
+
+    // Bad parameters
+    EXPECT_FALSE(loop.addHandler(-1, &handler));
+    EXPECT_FALSE(loop.addHandler(m_aPipeA[0], NULL));
+}
+
+/* Only ready descriptors are dispatched */
+TEST_F(EventLoopTest, DispatchReadable) {
+    EventLoop loop;
+    TestHandler handler;
+    char buffer[16];
+
+    loop.addHandler(m_aPipeA[0], &handler);
+    loop.addHandler(m_aPipeB[0], &handler);
+
+    // Nothing ready, we should time out
+    EXPECT_EQ(loop.dispatch(0), 0);
+    EXPECT_EQ(handler.m_iCount, 0);
+
+    ASSERT_EQ(write(m_aPipeB[1], "x", 1), 1);
+    EXPECT_EQ(loop.dispatch(1000), 1);
+    EXPECT_EQ(handler.m_iCount, 1);
+    EXPECT_EQ(handler.m_iLastFD, m_aPipeB[0]);
+    EXPECT_TRUE(handler.m_iLastEvents & EVENT_READ);
+
+    // Level triggered, so we are notified until the data is read.
+    EXPECT_EQ(loop.dispatch(0), 1);
+    EXPECT_EQ(read(m_aPipeB[0], buffer, sizeof(buffer)), 1);
+    EXPECT_EQ(loop.dispatch(0), 0);
+    EXPECT_EQ(handler.m_iCount, 2);
+
+    // Removed descriptors are not dispatched
+    loop.removeHandler(m_aPipeB[0]);
+    ASSERT_EQ(write(m_aPipeB[1], "x", 1), 1);
+    EXPECT_EQ(loop.dispatch(0), 0);
+}
+
+/* Watch for writable descriptors */
+TEST_F(EventLoopTest, DispatchWritable) {
+    EventLoop loop;
+    TestHandler handler;
+
+    loop.addHandler(m_aPipeA[1], &handler, EVENT_WRITE);
+    EXPECT_EQ(loop.dispatch(0), 1);
+    EXPECT_EQ(handler.m_iLastFD, m_aPipeA[1]);
+    EXPECT_TRUE(handler.m_iLastEvents & EVENT_WRITE);
+}
+
+/* A handler can remove a descriptor that is ready in the same dispatch */
+TEST_F(EventLoopTest, RemoveDuringDispatch) {
+    EventLoop loop;
+    TestHandler handler;
+
+    loop.addHandler(m_aPipeA[0], &handler);
+    loop.addHandler(m_aPipeB[0], &handler);
+
+    handler.m_pLoop = &loop;
+    handler.m_iRemoveFD = m_aPipeB[0];
+
+    ASSERT_EQ(write(m_aPipeA[1], "x", 1), 1);
+    ASSERT_EQ(write(m_aPipeB[1], "x", 1), 1);
+
+    // Whichever fires first removes pipe B, so we see one or two callbacks
+    // but never a callback for B after it was removed.
+    loop.dispatch(1000);
+    EXPECT_FALSE(loop.registered(m_aPipeB[0]));
+    EXPECT_GE(handler.m_iCount, 1);
+    EXPECT_LE(handler.m_iCount, 2);
+}
+
+/* A closed and reused descriptor number can be registered again */
+TEST_F(EventLoopTest, ReusedDescriptor) {
+    EventLoop loop;
+    TestHandler handler;
+    int fds[2];
+
+    ASSERT_EQ(pipe(fds), 0);
+    loop.addHandler(fds[0], &handler);
+    close(fds[0]);
+    close(fds[1]);
+
+    // The kernel dropped the closed fd; the same number comes back
+    ASSERT_EQ(pipe(fds), 0);
+    EXPECT_TRUE(loop.registered(fds[0]));
+    EXPECT_TRUE(loop.addHandler(fds[0], &handler));
+
+    ASSERT_EQ(write(fds[1], "x", 1), 1);
+    EXPECT_EQ(loop.dispatch(1000), 1);
+    EXPECT_EQ(handler.m_iLastFD, fds[0]);
+
+    loop.removeHandler(fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/////
+// Count timer expiries
+/////
+class TestTimerHandler : public TimerHandler {
+    public:
+        TestTimerHandler() : m_iCount(0) {}
+        void handleTimer(TimerId id) { m_iCount++; }
+        int m_iCount;
+};
+
+/* An infinite dispatch returns when the next timer is due */
+TEST_F(EventLoopTest, TimerWakesDispatch) {
+    EventLoop loop;
+    TestTimerHandler timerHandler;
+    uint64_t start = TimerQueue::now();
+
+    TimerId id = loop.addTimer(500, &timerHandler);
+    EXPECT_TRUE(loop.timerPending(id));
+    EXPECT_EQ(loop.timerCount(), 1);
+
+    // Only the timer can wake us, so no descriptors are ready
+    while(!timerHandler.m_iCount)
+        EXPECT_EQ(loop.dispatch(-1), 0);
+
+    EXPECT_GE(TimerQueue::now() - start, 500);
+    EXPECT_LT(TimerQueue::now() - start, USEC_PER_SEC);
+    EXPECT_FALSE(loop.timerPending(id));
+    EXPECT_EQ(loop.timerCount(), 0);
+}
+
+/* Descriptor events and timers are both delivered */
+TEST_F(EventLoopTest, TimerAndDescriptor) {
+    EventLoop loop;
+    TestHandler handler;
+    TestTimerHandler timerHandler;
+
+    loop.addHandler(m_aPipeA[0], &handler);
+    TimerId id = loop.addTimer(2000, &timerHandler, 2000);
+
+    ASSERT_EQ(write(m_aPipeA[1], "x", 1), 1);
+    EXPECT_EQ(loop.dispatch(1000), 1);
+    EXPECT_EQ(handler.m_iCount, 1);
+
+    while(timerHandler.m_iCount < 3)
+        loop.dispatch(1000);
+
+    EXPECT_TRUE(loop.cancelTimer(id));
+    EXPECT_FALSE(loop.cancelTimer(id));
+
+    // With no timers left an empty dispatch just times out
+    char buffer[16];
+    EXPECT_EQ(read(m_aPipeA[0], buffer, sizeof(buffer)), 1);
+    EXPECT_EQ(loop.dispatch(10), 0);
+    EXPECT_EQ(timerHandler.m_iCount, 3);
+}
@@ -0,0 +1,225 @@
+#include "common/exception.h"
+#include "common/logger.h"
+#include "network/output_buffer.h"
+#include "network/tcp_comm_listener.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+//
+// List all tests
+//
+// output_buffer_test --gtest_list_tests
+
+
+//
+// Running individual tests
+//
+// output_buffer_test --gtest_filter=OutputBufferTest.DropOldest
+
+using namespace std;
+using namespace logger;
+using namespace network;
+
+const char* TEST_LOG="/tmp/gtest.log";
+const char* LOG_LEVEL="DEBUG3";
+
+class OutputBufferTest : public testing::Test {
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile(TEST_LOG);
+            Logger::SetLogLevel(LOG_LEVEL);
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "           Output Buffer Test Start Up";
+            LOG(INFO) << "************************************************";
+        }
+
+        void setBuffer(struct iovec &iov, const char *buffer) {
+            iov.iov_base = (void *)buffer;
+            iov.iov_len = strlen(buffer);
+        }
+
+        bool add(OutputBuffer &output, const char *buffer, uint32_t skip = 0) {
+            struct iovec iov;
+            setBuffer(iov, buffer);
+            return output.add(&iov, 1, skip);
+        }
+
+        string contents(OutputBuffer &output) {
+            vector<struct iovec> pending;
+            string result;
+
+            output.iov(pending);
+            for(size_t i = 0; i < pending.size(); i++)
+                result.append((char *)pending[i].iov_base, pending[i].iov_len);
+
+            return result;
+        }
+};
+
+/* Unwritten data comes back in order and consume keeps the rest */
+TEST_F(OutputBufferTest, QueueAndConsume) {
+    OutputBuffer output(100);
+    struct iovec iov[2];
+
+    setBuffer(iov[0], "<<");
+    setBuffer(iov[1], "abcd");
+
+    // The first three bytes were written
+    EXPECT_TRUE(output.add(iov, 2, 3));
+    EXPECT_TRUE(add(output, "efg"));
+
+    EXPECT_EQ(output.size(), 6);
+    EXPECT_EQ(output.messages(), 2);
+    EXPECT_EQ(contents(output), "bcdefg");
+
+    output.consume(4);
+    EXPECT_EQ(contents(output), "fg");
+    EXPECT_EQ(output.messages(), 1);
+
+    output.consume(2);
+    EXPECT_TRUE(output.empty());
+    EXPECT_EQ(output.size(), 0);
+    EXPECT_EQ(output.highWater(), 6);
+}
+
+/* Old whole messages make room, a partly written one is kept */
+TEST_F(OutputBufferTest, DropOldest) {
+    OutputBuffer output(10, OUTPUT_DROP_OLDEST);
+
+    EXPECT_TRUE(add(output, "aaaa"));
+    EXPECT_TRUE(add(output, "bbb"));
+    EXPECT_TRUE(add(output, "ccc"));
+    output.consume(1);
+
+    EXPECT_TRUE(add(output, "ddd"));
+    EXPECT_EQ(contents(output), "aaacccddd");
+    EXPECT_EQ(output.droppedOldest(), 1);
+
+    // Too big for the buffer at all
+    EXPECT_TRUE(add(output, "eeeeeeeeeee"));
+    EXPECT_EQ(output.droppedNewest(), 1);
+    EXPECT_EQ(contents(output), "aaacccddd");
+}
+
+/* The rest of a partly written message is never dropped */
+TEST_F(OutputBufferTest, PartlyWritten) {
+    OutputBuffer output(10, OUTPUT_DROP_OLDEST);
+
+    // Two bytes went out before the socket filled
+    EXPECT_TRUE(add(output, "aaaaaa", 2));
+    EXPECT_TRUE(add(output, "bbbbb"));
+    EXPECT_EQ(output.size(), 9);
+
+    EXPECT_TRUE(add(output, "ccc"));
+    EXPECT_EQ(contents(output), "aaaaccc");
+    EXPECT_EQ(output.droppedOldest(), 1);
+
+    // Kept even when it doesn't fit, whatever the policy
+    OutputBuffer newest(4, OUTPUT_DROP_NEWEST);
+    EXPECT_TRUE(add(newest, "dddddddddd", 2));
+    EXPECT_EQ(contents(newest), "dddddddd");
+    EXPECT_EQ(newest.droppedNewest(), 0);
+
+    EXPECT_TRUE(add(newest, "e"));
+    EXPECT_EQ(newest.droppedNewest(), 1);
+
+    newest.consume(8);
+    EXPECT_TRUE(newest.empty());
+    EXPECT_EQ(newest.size(), 0);
+
+    OutputBuffer disconnect(4, OUTPUT_DISCONNECT);
+    EXPECT_TRUE(add(disconnect, "ffffffffff", 2));
+    EXPECT_EQ(disconnect.size(), 8);
+    EXPECT_FALSE(add(disconnect, "g"));
+}
+
+/* A full buffer drops new messages */
+TEST_F(OutputBufferTest, DropNewest) {
+    OutputBuffer output(6, OUTPUT_DROP_NEWEST);
+
+    EXPECT_TRUE(add(output, "aaa"));
+    EXPECT_TRUE(add(output, "bbb"));
+    EXPECT_TRUE(add(output, "c"));
+
+    EXPECT_EQ(contents(output), "aaabbb");
+    EXPECT_EQ(output.droppedNewest(), 1);
+    EXPECT_EQ(output.droppedOldest(), 0);
+}
+
+/* A full buffer asks for a disconnect */
+TEST_F(OutputBufferTest, Disconnect) {
+    OutputBuffer output(6, OUTPUT_DISCONNECT);
+
+    EXPECT_TRUE(add(output, "aaaaaa"));
+    EXPECT_FALSE(add(output, "b"));
+    EXPECT_EQ(output.disconnects(), 1);
+
+    output.clear();
+    EXPECT_TRUE(output.empty());
+    EXPECT_EQ(output.disconnects(), 1);
+}
+
+/* A client that stops reading doesn't block the writer */
+TEST_F(OutputBufferTest, SlowClient) {
+    TCPCommListener listener;
+    struct sockaddr_in addr;
+    char block[4096];
+    string received;
+    uint32_t sent = 0;
+    int receiveSize = 4096;
+
+    listener.setPort(0);
+    ASSERT_TRUE(listener.initialize());
+
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(client, 0);
+    setsockopt(client, SOL_SOCKET, SO_RCVBUF, &receiveSize, sizeof(receiveSize));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(listener.getListenPort());
+    ASSERT_EQ(connect(client, (struct sockaddr *)&addr, sizeof(addr)), 0);
+
+    for(int i = 0; i < 100 && !listener.connected(); i++) {
+        listener.acceptClient();
+        usleep(1000);
+    }
+    ASSERT_TRUE(listener.connected());
+
+    // Write until the socket is full and data is queued
+    for(int i = 0; i < 1000 && !listener.outputPending(); i++) {
+        memset(block, 'a' + i % 26, sizeof(block));
+        EXPECT_EQ(listener.writeData(block, sizeof(block)), sizeof(block));
+        sent += sizeof(block);
+    }
+    EXPECT_TRUE(listener.outputPending());
+
+    // Read everything back, flushing as the client drains
+    fcntl(client, F_SETFL, O_NONBLOCK);
+    for(int i = 0; i < 10000 && received.length() < sent; i++) {
+        int count = read(client, block, sizeof(block));
+        if(count > 0)
+            received.append(block, count);
+        else
+            usleep(100);
+
+        EXPECT_TRUE(listener.flushOutput());
+    }
+
+    EXPECT_FALSE(listener.outputPending());
+    ASSERT_EQ(received.length(), sent);
+    EXPECT_EQ(received[0], 'a');
+    EXPECT_EQ(received[sent - 1], 'a' + (sent / sizeof(block) - 1) % 26);
+
+    close(client);
+    listener.disconnect();
+}
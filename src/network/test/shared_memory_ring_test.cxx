@@ -0,0 +1,197 @@
+#include "common/exception.h"
+#include "common/logger.h"
+#include "network/shared_memory_ring.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <sstream>
+#include <string.h>
+#include <unistd.h>
+
+//
+// List all tests
+//
+// shared_memory_ring_test --gtest_list_tests
+
+
+//
+// Running individual tests
+//
+// shared_memory_ring_test --gtest_filter=SharedMemoryRingTest.Overrun
+
+using namespace std;
+using namespace logger;
+using namespace network;
+
+const char* TEST_LOG="/tmp/gtest.log";
+const char* LOG_LEVEL="DEBUG3";
+
+class SharedMemoryRingTest : public testing::Test {
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile(TEST_LOG);
+            Logger::SetLogLevel(LOG_LEVEL);
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "         Shared Memory Ring Test Start Up";
+            LOG(INFO) << "************************************************";
+
+            ostringstream name;
+            name << "/port_agent_test_" << getpid();
+            m_sName = name.str();
+        }
+
+        string record(int i) {
+            ostringstream out;
+            out << "record " << i << " " << string(200 + i % 50, 'x');
+            return out.str();
+        }
+
+        string read(SharedMemoryReader &reader) {
+            char buffer[1024];
+            uint32_t size = reader.readData(buffer, sizeof(buffer));
+            return string(buffer, size);
+        }
+
+        string m_sName;
+};
+
+/* Each write is one record, every reader sees all of them */
+TEST_F(SharedMemoryRingTest, WriteRead) {
+    SharedMemoryRing ring;
+    SharedMemoryReader reader, other;
+    struct iovec iov[2];
+
+    ring.setName(m_sName);
+    ASSERT_TRUE(ring.initialize());
+    EXPECT_EQ(ring.type(), COMM_SHARED_MEMORY);
+    EXPECT_EQ(ring.capacity(), SHM_RING_DEFAULT_CAPACITY);
+
+    reader.setName(m_sName);
+    ASSERT_TRUE(reader.initialize());
+    other.setName(m_sName);
+    ASSERT_TRUE(other.initialize());
+
+    EXPECT_EQ(read(reader), "");
+
+    EXPECT_EQ(ring.writeData("first", 5), 5);
+
+    iov[0].iov_base = (void *)"sec";
+    iov[0].iov_len = 3;
+    iov[1].iov_base = (void *)"ond";
+    iov[1].iov_len = 3;
+    EXPECT_EQ(ring.writeVector(iov, 2), 6);
+
+    // One record per buffer
+    EXPECT_EQ(ring.writeMessages(iov, 2), 6);
+    EXPECT_EQ(ring.sequence(), 4);
+
+    EXPECT_EQ(read(reader), "first");
+    EXPECT_EQ(read(reader), "second");
+    EXPECT_EQ(read(reader), "sec");
+    EXPECT_EQ(read(reader), "ond");
+    EXPECT_EQ(read(reader), "");
+    EXPECT_EQ(reader.received(), 4);
+    EXPECT_EQ(reader.lost(), 0);
+
+    EXPECT_EQ(read(other), "first");
+    EXPECT_GT(other.available(), 0);
+
+    // Starting over from the oldest record
+    reader.rewind();
+    EXPECT_EQ(read(reader), "first");
+    EXPECT_EQ(reader.lost(), 0);
+}
+
+/* Configured sizes round up to a power of two without creating a segment */
+TEST_F(SharedMemoryRingTest, RoundCapacity) {
+    EXPECT_EQ(SharedMemoryRing::roundCapacity(0), SHM_RING_MIN_CAPACITY);
+    EXPECT_EQ(SharedMemoryRing::roundCapacity(SHM_RING_MIN_CAPACITY), SHM_RING_MIN_CAPACITY);
+    EXPECT_EQ(SharedMemoryRing::roundCapacity(SHM_RING_MIN_CAPACITY + 1), 2 * SHM_RING_MIN_CAPACITY);
+    EXPECT_EQ(SharedMemoryRing::roundCapacity(3 * 1024 * 1024), SHM_RING_DEFAULT_CAPACITY);
+}
+
+/* Records wrap around a small ring without loss if the reader keeps up */
+TEST_F(SharedMemoryRingTest, Wrap) {
+    SharedMemoryRing ring;
+    SharedMemoryReader reader;
+
+    ring.setName(m_sName);
+    ring.setCapacity(1);
+    ASSERT_TRUE(ring.initialize());
+    EXPECT_EQ(ring.capacity(), SHM_RING_MIN_CAPACITY);
+
+    reader.setName(m_sName);
+    ASSERT_TRUE(reader.initialize());
+
+    for(int i = 0; i < 200; i++) {
+        string data = record(i);
+        ASSERT_EQ(ring.writeData(data.c_str(), data.length()), data.length());
+        ASSERT_EQ(read(reader), data);
+    }
+
+    EXPECT_EQ(reader.received(), 200);
+    EXPECT_EQ(reader.lost(), 0);
+    EXPECT_EQ(reader.overruns(), 0);
+}
+
+/* A slow reader is lapped and counts what it lost */
+TEST_F(SharedMemoryRingTest, Overrun) {
+    SharedMemoryRing ring;
+    SharedMemoryReader reader;
+    int count = 100;
+
+    ring.setName(m_sName);
+    ring.setCapacity(SHM_RING_MIN_CAPACITY);
+    ASSERT_TRUE(ring.initialize());
+
+    reader.setName(m_sName);
+    ASSERT_TRUE(reader.initialize());
+
+    for(int i = 0; i < count; i++) {
+        string data = record(i);
+        ring.writeData(data.c_str(), data.length());
+    }
+
+    string last;
+    string data;
+    while((data = read(reader)).length())
+        last = data;
+
+    EXPECT_EQ(last, record(count - 1));
+    EXPECT_GT(reader.overruns(), 0);
+    EXPECT_GT(reader.lost(), 0);
+    EXPECT_EQ(reader.lost() + reader.received(), count);
+}
+
+/* A record bigger than the ring isn't written */
+TEST_F(SharedMemoryRingTest, TooBig) {
+    SharedMemoryRing ring;
+    string data(SHM_RING_MIN_CAPACITY, 'x');
+
+    ring.setName(m_sName);
+    ring.setCapacity(SHM_RING_MIN_CAPACITY);
+    ASSERT_TRUE(ring.initialize());
+
+    EXPECT_EQ(ring.writeData(data.c_str(), data.length()), 0);
+    EXPECT_EQ(ring.sequence(), 0);
+}
+
+/* Readers see the writer go away */
+TEST_F(SharedMemoryRingTest, Closed) {
+    SharedMemoryRing ring;
+    SharedMemoryReader reader;
+
+    reader.setName(m_sName);
+    EXPECT_THROW(reader.initialize(), SocketConnectFailure);
+
+    ring.setName(m_sName);
+    ASSERT_TRUE(ring.initialize());
+    ASSERT_TRUE(reader.initialize());
+    EXPECT_FALSE(reader.closed());
+
+    ring.close();
+    EXPECT_FALSE(ring.connected());
+    EXPECT_TRUE(reader.closed());
+    EXPECT_THROW(ring.writeData("data", 4), SocketNotInitialized);
+}
@@ -525,6 +525,78 @@ TEST_F(TCPListenerTest, Reconnection) {
     }
 }
 
+/* Test several clients on one listener.  Data written goes to every client,
+ * the oldest has command authority and when it leaves the next takes over.
+*/
+TEST_F(TCPListenerTest, MultipleClients) {
+    try {
+	    char buffer[128];
+	    int clients[2];
+	    struct sockaddr_in addr;
+
+	    TCPCommListener server;
+	    server.setBlocking(true);
+	    server.setMaxClients(2);
+
+        server.initialize();
+        ASSERT_GT(server.getListenPort(), 0);
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(server.getListenPort());
+
+        for(int i = 0; i < 2; i++) {
+            clients[i] = socket(AF_INET, SOCK_STREAM, 0);
+            ASSERT_EQ(connect(clients[i], (struct sockaddr *)&addr, sizeof(addr)), 0);
+		    server.acceptClient();
+        }
+
+        // Full, so no longer listening
+		ASSERT_EQ(server.clientCount(), 2);
+		ASSERT_FALSE(server.listening());
+
+        vector<int> fds;
+        server.clientFDs(fds);
+        ASSERT_EQ(fds.size(), 2);
+        EXPECT_TRUE(server.isAuthority(fds[0]));
+        EXPECT_FALSE(server.isAuthority(fds[1]));
+
+        // Every client gets the data
+        EXPECT_EQ(server.writeData(TEST_DATA, 4), 4);
+        for(int i = 0; i < 2; i++) {
+		    zeroBuffer(buffer, 128);
+            EXPECT_EQ(read(clients[i], buffer, 128), 4);
+            EXPECT_STREQ(TEST_DATA, buffer);
+        }
+
+        // Reads come from the client asked for
+        ASSERT_EQ(write(clients[1], "Two", 3), 3);
+		zeroBuffer(buffer, 128);
+        EXPECT_EQ(server.readClient(fds[1], buffer, 128), 3);
+        EXPECT_STREQ("Two", buffer);
+
+        // The authority leaves, the other client takes over and there is
+        // room for another
+        close(clients[0]);
+        EXPECT_EQ(server.readClient(fds[0], buffer, 128), 0);
+		EXPECT_EQ(server.clientCount(), 1);
+        EXPECT_TRUE(server.isAuthority(fds[1]));
+		EXPECT_TRUE(server.listening());
+
+        server.disconnectClient(true);
+		EXPECT_FALSE(server.connected());
+        close(clients[1]);
+	}
+    catch(OOIException &e) {
+    	string errmsg = e.what();
+    	LOG(ERROR) << "EXCEPTION: " << errmsg;
+
+    	// We don't want to see exeptions here.
+    	ASSERT_FALSE(true);
+    }
+}
+
 
 /////////////////////
 /* Test Exceptions */
@@ -185,6 +185,46 @@ TEST_F(TCPSocketTest, DISABLED_NonBlockingConnection) {
     EXPECT_FALSE(socket.connected());
 }
 
+/* Test connecting without waiting for the connect to complete */
+TEST_F(TCPSocketTest, DISABLED_StartConnect) {
+    string testData = "Test";
+    char buffer[128];
+    TCPCommSocket socket;
+    int tries = 0;
+
+    socket.setHostname(TEST_HOST);
+    socket.setPort(TEST_PORT);
+
+    try{
+        if(!socket.startConnect()) {
+            EXPECT_TRUE(socket.connecting());
+            EXPECT_FALSE(socket.connected());
+
+            while(!socket.finishConnect() && tries++ < 100)
+                usleep(10000);
+        }
+
+        EXPECT_FALSE(socket.connecting());
+        EXPECT_TRUE(socket.connected());
+
+        EXPECT_EQ(socket.writeData(testData.c_str(), testData.length()), testData.length());
+        sleep(1);
+
+        zeroBuffer(buffer, 128);
+        EXPECT_EQ(socket.readData(buffer, 128), 4);
+        EXPECT_EQ(testData, buffer);
+    }
+    catch(exception &e) {
+    	string msg = e.what();
+    	LOG(ERROR) << "Unexepected exception: " << msg;
+    	EXPECT_EQ(msg, "");
+    };
+
+    socket.disconnect();
+    EXPECT_FALSE(socket.connecting());
+    EXPECT_FALSE(socket.connected());
+}
+
 /////////////////////
 /* Test Exceptions */
 /////////////////////
@@ -379,3 +419,28 @@ TEST_F(TCPSocketTest, DISABLED_ExceptionReadFailure) {
     EXPECT_TRUE(exceptionRaised);
 }
 
+/* Test a refused non-blocking connect */
+TEST_F(TCPSocketTest, DISABLED_ExceptionStartConnectRefused) {
+    bool exceptionRaised = false;
+    TCPCommSocket socket;
+    int tries = 0;
+
+    try {
+	socket.setHostname(TEST_HOST);
+	socket.setPort(PRIV_PORT);
+
+        if(!socket.startConnect())
+            while(!socket.finishConnect() && tries++ < 100)
+                usleep(10000);
+    }
+    catch(OOIException &e) {
+        exceptionRaised = true;
+	string errmsg = e.what();
+        LOG(INFO) << "Expected exception caught: " << errmsg;
+        EXPECT_EQ(e.errcode(), 304);
+    };
+
+    EXPECT_TRUE(exceptionRaised);
+    EXPECT_FALSE(socket.connecting());
+    EXPECT_FALSE(socket.connected());
+}
@@ -0,0 +1,145 @@
+#include "common/exception.h"
+#include "common/logger.h"
+#include "network/timer_queue.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+//
+// List all tests
+//
+// timer_queue_test --gtest_list_tests
+
+
+//
+// Running individual tests
+//
+// timer_queue_test --gtest_filter=TimerQueueTest.Order
+
+using namespace std;
+using namespace logger;
+using namespace network;
+
+const char* TEST_LOG="/tmp/gtest.log";
+const char* LOG_LEVEL="DEBUG3";
+
+/////
+// Record the order timers fire in and optionally cancel a timer from inside
+// the callback.
+/////
+class TestTimerHandler : public TimerHandler {
+    public:
+        TestTimerHandler() : m_pQueue(NULL), m_iCancelId(0) {}
+
+        void handleTimer(TimerId id) {
+            m_oFired.push_back(id);
+
+            if(m_pQueue && m_iCancelId)
+                m_pQueue->cancel(m_iCancelId);
+        }
+
+        vector<TimerId> m_oFired;
+
+        TimerQueue *m_pQueue;
+        TimerId m_iCancelId;
+};
+
+class TimerQueueTest : public testing::Test {
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile(TEST_LOG);
+            Logger::SetLogLevel(LOG_LEVEL);
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "            Timer Queue Test Start Up";
+            LOG(INFO) << "************************************************";
+        }
+};
+
+/* Add, cancel and look up timers */
+TEST_F(TimerQueueTest, AddCancel) {
+    TimerQueue timers;
+    TestTimerHandler handler;
+    TimerId id;
+
+    EXPECT_EQ(timers.size(), 0);
+    EXPECT_EQ(timers.nextDeadline(), 0);
+
+    id = timers.add(USEC_PER_SEC, &handler);
+    EXPECT_GT(id, 0);
+    EXPECT_TRUE(timers.pending(id));
+    EXPECT_EQ(timers.size(), 1);
+    EXPECT_GT(timers.nextDeadline(), TimerQueue::now());
+
+    EXPECT_TRUE(timers.cancel(id));
+    EXPECT_FALSE(timers.pending(id));
+    EXPECT_FALSE(timers.cancel(id));
+    EXPECT_EQ(timers.nextDeadline(), 0);
+
+    // No handler, no timer.  0 is never pending
+    EXPECT_EQ(timers.add(0, NULL), 0);
+    EXPECT_FALSE(timers.pending(0));
+}
+
+/* Timers fire in deadline order, not the order they were added */
+TEST_F(TimerQueueTest, Order) {
+    TimerQueue timers;
+    TestTimerHandler handler;
+    uint64_t now = TimerQueue::now();
+
+    TimerId late = timers.add(3000, &handler);
+    TimerId early = timers.add(1000, &handler);
+    TimerId middle = timers.add(2000, &handler);
+    TimerId never = timers.add(USEC_PER_SEC * 60, &handler);
+
+    // Nothing is due yet
+    EXPECT_EQ(timers.expire(now), 0);
+
+    EXPECT_EQ(timers.expire(now + 10000), 3);
+    ASSERT_EQ(handler.m_oFired.size(), 3);
+    EXPECT_EQ(handler.m_oFired[0], early);
+    EXPECT_EQ(handler.m_oFired[1], middle);
+    EXPECT_EQ(handler.m_oFired[2], late);
+
+    // One shot timers are gone once they fire
+    EXPECT_FALSE(timers.pending(early));
+    EXPECT_TRUE(timers.pending(never));
+    EXPECT_EQ(timers.size(), 1);
+}
+
+/* Repeating timers stay pending and skip expiries they missed */
+TEST_F(TimerQueueTest, Repeating) {
+    TimerQueue timers;
+    TestTimerHandler handler;
+    uint64_t now = TimerQueue::now();
+    TimerId id = timers.add(1000, &handler, 1000);
+
+    EXPECT_EQ(timers.expire(now + 1500), 1);
+    EXPECT_TRUE(timers.pending(id));
+
+    // We fell well behind, it only fires once
+    EXPECT_EQ(timers.expire(now + 100000), 1);
+    EXPECT_GT(timers.nextDeadline(), now + 100000);
+
+    timers.cancel(id);
+    EXPECT_EQ(timers.expire(now + USEC_PER_SEC), 0);
+    EXPECT_EQ(handler.m_oFired.size(), 2);
+}
+
+/* A handler can cancel a timer that is due in the same pass */
+TEST_F(TimerQueueTest, CancelFromHandler) {
+    TimerQueue timers;
+    TestTimerHandler handler;
+    uint64_t now = TimerQueue::now();
+
+    TimerId first = timers.add(1000, &handler);
+    TimerId second = timers.add(2000, &handler);
+
+    handler.m_pQueue = &timers;
+    handler.m_iCancelId = second;
+
+    EXPECT_EQ(timers.expire(now + 10000), 1);
+    ASSERT_EQ(handler.m_oFired.size(), 1);
+    EXPECT_EQ(handler.m_oFired[0], first);
+    EXPECT_EQ(timers.size(), 0);
+}
@@ -4,6 +4,7 @@
 #include "common/spawn_process.h"
 #include "common/util.h"
 #include "network/udp_comm_socket.h"
+#include "network/timer_queue.h"
 #include "gtest/gtest.h"
 
 #include <string>
@@ -166,6 +167,104 @@ TEST_F(UDPSocketTest, BlockingConnection) {
     }
 }
 
+/* Test the connected socket with a local receiver.  Each datagram written
+ * arrives, and writing when nobody is listening doesn't fail.
+*/
+TEST_F(UDPSocketTest, ConnectedSocket) {
+    try {
+	char buffer[128];
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	UDPCommSocket socket;
+	
+	int receiver = ::socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ASSERT_EQ(bind(receiver, (struct sockaddr *)&addr, sizeof(addr)), 0);
+	ASSERT_EQ(getsockname(receiver, (struct sockaddr *)&addr, &addrlen), 0);
+	
+	socket.setBlocking(true);
+	socket.setPort(ntohs(addr.sin_port));
+	socket.setHostname("127.0.0.1");
+	
+	socket.initialize();
+	ASSERT_TRUE(socket.connected());
+	
+	EXPECT_EQ(socket.writeData(TEST_DATA, 4), 4);
+	zeroBuffer(buffer, 128);
+	EXPECT_EQ(recv(receiver, buffer, 128, 0), 4);
+	EXPECT_STREQ(TEST_DATA, buffer);
+	
+	struct iovec iov[2];
+	iov[0].iov_base = (void *)"One";
+	iov[0].iov_len = 3;
+	iov[1].iov_base = (void *)"Two";
+	iov[1].iov_len = 3;
+	EXPECT_EQ(socket.writeMessages(iov, 2), 6);
+	
+	zeroBuffer(buffer, 128);
+	EXPECT_EQ(recv(receiver, buffer, 128, 0), 3);
+	EXPECT_STREQ("One", buffer);
+	zeroBuffer(buffer, 128);
+	EXPECT_EQ(recv(receiver, buffer, 128, 0), 3);
+	EXPECT_STREQ("Two", buffer);
+	
+	// Nobody listening, the refusals are ignored
+	close(receiver);
+	for(int i = 0; i < 3; i++)
+	    EXPECT_EQ(socket.writeData(TEST_DATA, 4), 4);
+	EXPECT_EQ(socket.writeMessages(iov, 2), 6);
+    }
+    catch(OOIException &e) {
+	string errmsg = e.what();
+	LOG(ERROR) << "EXCEPTION: " << errmsg;
+	
+	// We don't want to see exeptions here.
+	ASSERT_FALSE(true);
+    }
+}
+
+/* The hostname is only looked up again when the owner asks and it is due,
+ * writes never do it.
+*/
+TEST_F(UDPSocketTest, Resolve) {
+    try {
+	UDPCommSocket socket;
+	uint64_t now;
+	int fd;
+	
+	socket.setPort(TEST_PORT);
+	socket.setHostname("127.0.0.1");
+	socket.initialize();
+	ASSERT_TRUE(socket.connected());
+	
+	now = TimerQueue::now();
+	fd = socket.getSocketFD();
+	EXPECT_GT(socket.resolveDelay(now), (UDP_RESOLVE_INTERVAL - 1) * USEC_PER_SEC);
+	EXPECT_LE(socket.resolveDelay(now), UDP_RESOLVE_INTERVAL * USEC_PER_SEC);
+	
+	// Not due, nothing changes
+	socket.checkResolve(now);
+	EXPECT_EQ(socket.getSocketFD(), fd);
+	
+	// Due, a new socket is connected
+	now += UDP_RESOLVE_INTERVAL * USEC_PER_SEC;
+	EXPECT_EQ(socket.resolveDelay(now), 0);
+	socket.checkResolve(now);
+	ASSERT_TRUE(socket.connected());
+	EXPECT_NE(socket.getSocketFD(), fd);
+	EXPECT_GT(socket.resolveDelay(TimerQueue::now()), (UDP_RESOLVE_INTERVAL - 1) * USEC_PER_SEC);
+    }
+    catch(OOIException &e) {
+	string errmsg = e.what();
+	LOG(ERROR) << "EXCEPTION: " << errmsg;
+	
+	// We don't want to see exeptions here.
+	ASSERT_FALSE(true);
+    }
+}
+
 /* test read, should boom */
 // We didn't implment reading for UDP connections so a read should blow up.
 TEST_F(UDPSocketTest, ReadFailure) {
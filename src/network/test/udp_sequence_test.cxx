@@ -0,0 +1,229 @@
+#include "common/exception.h"
+#include "common/logger.h"
+#include "network/udp_sequence.h"
+#include "network/udp_comm_socket.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+//
+// List all tests
+//
+// udp_sequence_test --gtest_list_tests
+
+
+//
+// Running individual tests
+//
+// udp_sequence_test --gtest_filter=UDPSequenceTest.Tracker
+
+using namespace std;
+using namespace logger;
+using namespace network;
+
+const char* TEST_LOG="/tmp/gtest.log";
+const char* LOG_LEVEL="DEBUG3";
+
+#define TEST_PORT 4035
+
+class UDPSequenceTest : public testing::Test {
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile(TEST_LOG);
+            Logger::SetLogLevel(LOG_LEVEL);
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "           UDP Sequence Test Start Up";
+            LOG(INFO) << "************************************************";
+        }
+
+        void setTimeout(int fd) {
+            struct timeval timeout;
+            timeout.tv_sec = 2;
+            timeout.tv_usec = 0;
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        }
+};
+
+/* Header round trip */
+TEST_F(UDPSequenceTest, Header) {
+    char buffer[UDP_SEQUENCE_HEADER_SIZE];
+    uint64_t sequence = 0;
+
+    encodeSequenceHeader(buffer, 0x0102030405060708ULL);
+    EXPECT_TRUE(decodeSequenceHeader(buffer, sizeof(buffer), sequence));
+    EXPECT_EQ(sequence, 0x0102030405060708ULL);
+
+    // Big endian on the wire
+    EXPECT_EQ(buffer[4], 0x01);
+    EXPECT_EQ(buffer[11], 0x08);
+
+    EXPECT_FALSE(decodeSequenceHeader(buffer, sizeof(buffer) - 1, sequence));
+
+    buffer[0] = 0;
+    EXPECT_FALSE(decodeSequenceHeader(buffer, sizeof(buffer), sequence));
+}
+
+/* Gap accounting */
+TEST_F(UDPSequenceTest, Tracker) {
+    SequenceTracker tracker;
+
+    // Joined late, nothing before the first is lost
+    EXPECT_EQ(tracker.receive(100), SEQUENCE_IN_ORDER);
+    EXPECT_EQ(tracker.receive(101), SEQUENCE_IN_ORDER);
+    EXPECT_EQ(tracker.lost(), 0);
+
+    // 102 - 104 missing
+    EXPECT_EQ(tracker.receive(105), SEQUENCE_GAP);
+    EXPECT_EQ(tracker.lost(), 3);
+    EXPECT_EQ(tracker.expected(), 106);
+
+    // 103 shows up late, then again
+    EXPECT_EQ(tracker.receive(103), SEQUENCE_LATE);
+    EXPECT_EQ(tracker.lost(), 2);
+    EXPECT_EQ(tracker.late(), 1);
+    EXPECT_EQ(tracker.receive(103), SEQUENCE_DUPLICATE);
+    EXPECT_EQ(tracker.receive(105), SEQUENCE_DUPLICATE);
+    EXPECT_EQ(tracker.duplicates(), 2);
+
+    EXPECT_EQ(tracker.received(), 4);
+
+    // A jump bigger than the window
+    EXPECT_EQ(tracker.receive(300), SEQUENCE_GAP);
+    EXPECT_EQ(tracker.lost(), 2 + 194);
+
+    // Too old to be late, the sender started over
+    EXPECT_EQ(tracker.receive(0), SEQUENCE_RESTART);
+    EXPECT_EQ(tracker.restarts(), 1);
+    EXPECT_EQ(tracker.expected(), 1);
+    EXPECT_EQ(tracker.receive(1), SEQUENCE_IN_ORDER);
+    EXPECT_EQ(tracker.lost(), 196);
+
+    tracker.reset();
+    EXPECT_EQ(tracker.received(), 0);
+    EXPECT_EQ(tracker.lost(), 0);
+
+    // Reordered around the join, the one before the start was never lost
+    EXPECT_EQ(tracker.receive(50), SEQUENCE_IN_ORDER);
+    EXPECT_EQ(tracker.receive(49), SEQUENCE_EARLY);
+    EXPECT_EQ(tracker.lost(), 0);
+    EXPECT_EQ(tracker.late(), 0);
+    EXPECT_EQ(tracker.early(), 1);
+    EXPECT_EQ(tracker.receive(49), SEQUENCE_DUPLICATE);
+
+    // Same after a restart
+    EXPECT_EQ(tracker.receive(53), SEQUENCE_GAP);
+    EXPECT_EQ(tracker.lost(), 2);
+    EXPECT_EQ(tracker.receive(52), SEQUENCE_LATE);
+    EXPECT_EQ(tracker.lost(), 1);
+
+    EXPECT_EQ(tracker.receive(200), SEQUENCE_GAP);
+    EXPECT_EQ(tracker.lost(), 147);
+    EXPECT_EQ(tracker.receive(10), SEQUENCE_RESTART);
+    EXPECT_EQ(tracker.receive(9), SEQUENCE_EARLY);
+    EXPECT_EQ(tracker.lost(), 147);
+    EXPECT_EQ(tracker.early(), 2);
+    EXPECT_EQ(tracker.received(), 7);
+}
+
+/* Sequenced socket to a receiver, every write path */
+TEST_F(UDPSequenceTest, SequencedSocket) {
+    UDPSequenceReceiver receiver;
+    UDPCommSocket socket;
+    char buffer[128];
+    struct iovec iov[2];
+
+    receiver.setGroup("127.0.0.1");
+    receiver.setPort(TEST_PORT);
+    ASSERT_TRUE(receiver.initialize());
+    setTimeout(receiver.socketFD());
+
+    socket.setHostname("127.0.0.1");
+    socket.setPort(TEST_PORT);
+    socket.setSequenced(true);
+    socket.setBlocking(true);
+    ASSERT_TRUE(socket.initialize());
+
+    EXPECT_EQ(socket.writeData("first", 5), 5);
+    EXPECT_EQ(receiver.readData(buffer, sizeof(buffer)), 5);
+    EXPECT_EQ(string(buffer, 5), "first");
+
+    iov[0].iov_base = (void *)"sec";
+    iov[0].iov_len = 3;
+    iov[1].iov_base = (void *)"ond";
+    iov[1].iov_len = 3;
+    EXPECT_EQ(socket.writeVector(iov, 2), 6);
+    EXPECT_EQ(receiver.readData(buffer, sizeof(buffer)), 6);
+    EXPECT_EQ(string(buffer, 6), "second");
+
+    // Two datagrams from one call
+    iov[0].iov_base = (void *)"third";
+    iov[0].iov_len = 5;
+    iov[1].iov_base = (void *)"fourth";
+    iov[1].iov_len = 6;
+    EXPECT_EQ(socket.writeMessages(iov, 2), 11);
+    EXPECT_EQ(receiver.readData(buffer, sizeof(buffer)), 5);
+    EXPECT_EQ(string(buffer, 5), "third");
+    EXPECT_EQ(receiver.readData(buffer, sizeof(buffer)), 6);
+    EXPECT_EQ(string(buffer, 6), "fourth");
+
+    EXPECT_EQ(socket.sequence(), 4);
+    EXPECT_EQ(receiver.tracker().received(), 4);
+    EXPECT_EQ(receiver.tracker().lost(), 0);
+    EXPECT_EQ(receiver.tracker().expected(), 4);
+}
+
+/* Unsequenced datagrams are counted and dropped */
+TEST_F(UDPSequenceTest, Invalid) {
+    UDPSequenceReceiver receiver;
+    UDPCommSocket socket;
+    char buffer[128];
+
+    receiver.setGroup("127.0.0.1");
+    receiver.setPort(TEST_PORT);
+    ASSERT_TRUE(receiver.initialize());
+    setTimeout(receiver.socketFD());
+
+    socket.setHostname("127.0.0.1");
+    socket.setPort(TEST_PORT);
+    socket.setBlocking(true);
+    ASSERT_TRUE(socket.initialize());
+
+    socket.writeData("plain", 5);
+    EXPECT_EQ(receiver.readData(buffer, sizeof(buffer)), 0);
+    EXPECT_EQ(receiver.invalid(), 1);
+    EXPECT_EQ(receiver.tracker().received(), 0);
+}
+
+/* Multicast options on the sending side */
+TEST_F(UDPSequenceTest, MulticastOptions) {
+    UDPCommSocket socket;
+    unsigned char ttl = 0;
+    socklen_t size = sizeof(ttl);
+
+    socket.setHostname("239.255.42.1");
+    socket.setPort(TEST_PORT);
+    socket.setMulticastTTL(4);
+    socket.setMulticastInterface("lo");
+
+    try {
+        socket.initialize();
+    }
+    catch(OOIException &e) {
+        // No multicast route in this environment
+        LOG(INFO) << "multicast unavailable: " << e.what();
+        return;
+    }
+
+    ASSERT_EQ(getsockopt(socket.getSocketFD(), IPPROTO_IP, IP_MULTICAST_TTL, &ttl, &size), 0);
+    EXPECT_EQ(ttl, 4);
+
+    UDPCommSocket other;
+    other.setHostname("239.255.42.1");
+    other.setPort(TEST_PORT);
+    other.setMulticastInterface("no-such-interface");
+    EXPECT_THROW(other.initialize(), SocketCreateFailure);
+}
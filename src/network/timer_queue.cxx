@@ -0,0 +1,194 @@
+/*******************************************************************************
+ * Class: TimerQueue
+ * Filename: timer_queue.cxx
+ * License: Apache 2.0
+ *
+ * Deadline ordered timers.  See timer_queue.h for usage.
+ ******************************************************************************/
+
+#include "timer_queue.h"
+#include "common/logger.h"
+
+#include <time.h>
+
+using namespace std;
+using namespace logger;
+using namespace network;
+
+/******************************************************************************
+ *   PUBLIC METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ ******************************************************************************/
+TimerQueue::TimerQueue() {
+    m_iNextId = 1;
+}
+
+/******************************************************************************
+ * Method: now
+ * Description: Current monotonic time in microseconds.
+ ******************************************************************************/
+uint64_t TimerQueue::now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+/******************************************************************************
+ * Method: pending
+ * Description: Is the timer still waiting to fire?  Repeating timers stay
+ * pending until they are cancelled.
+ ******************************************************************************/
+bool TimerQueue::pending(TimerId id) {
+    return id && m_oTimers.find(id) != m_oTimers.end();
+}
+
+/******************************************************************************
+ * Method: nextDeadline
+ * Description: Deadline of the timer that fires next.
+ * Return:
+ *   absolute monotonic time in microseconds, or 0 if there are no timers.
+ ******************************************************************************/
+uint64_t TimerQueue::nextDeadline() {
+    discardStale();
+
+    if(m_oHeap.empty())
+        return 0;
+
+    return m_oHeap.top().first;
+}
+
+/******************************************************************************
+ * Method: add
+ * Description: Start a timer.
+ *
+ * Parameters:
+ *   delay - microseconds from now until the first expiry
+ *   handler - object notified when the timer fires
+ *   interval - if non-zero the timer repeats every interval microseconds
+ * Return:
+ *   id of the new timer, or 0 if handler is NULL.
+ ******************************************************************************/
+TimerId TimerQueue::add(uint64_t delay, TimerHandler *handler, uint64_t interval) {
+    Timer timer;
+    TimerId id;
+
+    if(!handler)
+        return 0;
+
+    // Skip 0 if we ever wrap
+    id = m_iNextId++;
+    if(!m_iNextId)
+        m_iNextId = 1;
+
+    timer.deadline = now() + delay;
+    timer.interval = interval;
+    timer.handler = handler;
+
+    m_oTimers[id] = timer;
+    m_oHeap.push(HeapEntry(timer.deadline, id));
+
+    LOG(DEBUG3) << "add timer " << id << " delay: " << delay << " interval: " << interval;
+    return id;
+}
+
+/******************************************************************************
+ * Method: cancel
+ * Description: Stop a timer.  It is safe to cancel a timer that has already
+ * fired, or to cancel a timer from inside a handler.
+ * Return:
+ *   true if the timer was pending.
+ ******************************************************************************/
+bool TimerQueue::cancel(TimerId id) {
+    if(!pending(id))
+        return false;
+
+    LOG(DEBUG3) << "cancel timer " << id;
+    m_oTimers.erase(id);
+    return true;
+}
+
+/******************************************************************************
+ * Method: clear
+ * Description: Cancel all timers.
+ ******************************************************************************/
+void TimerQueue::clear() {
+    m_oTimers.clear();
+
+    while(!m_oHeap.empty())
+        m_oHeap.pop();
+}
+
+/******************************************************************************
+ * Method: expire
+ * Description: Call the handler of every timer with a deadline at or before
+ * now.  A repeating timer is rescheduled before its handler is called, so the
+ * handler may cancel it.  If the loop fell behind, a repeating timer fires
+ * once and the missed expiries are skipped.
+ *
+ * Parameters:
+ *   now - current monotonic time in microseconds
+ * Return:
+ *   number of timers that fired.
+ ******************************************************************************/
+int TimerQueue::expire(uint64_t now) {
+    int count = 0;
+
+    discardStale();
+
+    while(!m_oHeap.empty() && m_oHeap.top().first <= now) {
+        TimerId id = m_oHeap.top().second;
+        map<TimerId, Timer>::iterator i = m_oTimers.find(id);
+        TimerHandler *handler;
+
+        m_oHeap.pop();
+
+        if(i == m_oTimers.end())
+            continue;
+
+        handler = i->second.handler;
+
+        if(i->second.interval) {
+            uint64_t deadline = i->second.deadline + i->second.interval;
+            if(deadline <= now)
+                deadline = now + i->second.interval;
+
+            i->second.deadline = deadline;
+            m_oHeap.push(HeapEntry(deadline, id));
+        }
+        else {
+            m_oTimers.erase(i);
+        }
+
+        LOG(DEBUG3) << "timer " << id << " expired";
+        count++;
+        handler->handleTimer(id);
+
+        discardStale();
+    }
+
+    return count;
+}
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: discardStale
+ * Description: Pop heap entries for timers that have been cancelled or
+ * rescheduled so the top of the heap is always a live deadline.
+ ******************************************************************************/
+void TimerQueue::discardStale() {
+    while(!m_oHeap.empty()) {
+        map<TimerId, Timer>::iterator i = m_oTimers.find(m_oHeap.top().second);
+
+        if(i != m_oTimers.end() && i->second.deadline == m_oHeap.top().first)
+            return;
+
+        m_oHeap.pop();
+    }
+}
@@ -0,0 +1,120 @@
+/*******************************************************************************
+ * Class: TimerQueue
+ * Filename: timer_queue.h
+ * License: Apache 2.0
+ *
+ * One-shot and repeating timers kept in a binary min-heap ordered by
+ * deadline.  Adding a timer is O(log n), finding the next deadline is O(1).
+ * Cancelled timers are dropped from the live set straight away and their
+ * heap entries are discarded when they reach the top.
+ *
+ * All times are in microseconds on the monotonic clock, so timers are not
+ * affected by changes to the wall clock.
+ *
+ * The queue doesn't wait on its own.  EventLoop uses nextDeadline() to decide
+ * how long to block and calls expire() when it wakes.
+ *
+ * Usage:
+ *
+ * class MyHandler : public TimerHandler {
+ *     void handleTimer(TimerId id) { ... }
+ * };
+ *
+ * MyHandler handler;
+ * TimerQueue timers;
+ *
+ * // Fire once in 250 ms, and every second after 1 second
+ * TimerId once = timers.add(250 * USEC_PER_MSEC, &handler);
+ * TimerId tick = timers.add(USEC_PER_SEC, &handler, USEC_PER_SEC);
+ *
+ * // Call the handler of every timer that is due
+ * timers.expire(TimerQueue::now());
+ *
+ * timers.cancel(tick);
+ ******************************************************************************/
+
+#ifndef __TIMER_QUEUE_H_
+#define __TIMER_QUEUE_H_
+
+#include <stdint.h>
+#include <map>
+#include <queue>
+#include <vector>
+#include <functional>
+
+#define USEC_PER_MSEC 1000ULL
+#define USEC_PER_SEC  1000000ULL
+
+using namespace std;
+
+namespace network {
+
+    // Timer ids are never reused.  0 is never a valid id so it can be used
+    // to mean "no timer".
+    typedef uint32_t TimerId;
+
+    /////
+    // Interface for objects that want to be told when a timer expires.
+    /////
+    class TimerHandler {
+        public:
+            virtual ~TimerHandler() {}
+            virtual void handleTimer(TimerId id) = 0;
+    };
+
+    typedef struct Timer
+    {
+        uint64_t deadline;
+        uint64_t interval;
+        TimerHandler *handler;
+    } Timer;
+
+    class TimerQueue {
+        /********************
+         *      METHODS     *
+         ********************/
+
+        public:
+            ///////////////////////
+            // Public Methods
+            TimerQueue();
+            virtual ~TimerQueue() {}
+
+            static uint64_t now();
+
+            /* Accessors */
+            size_t size() { return m_oTimers.size(); }
+            bool pending(TimerId id);
+            uint64_t nextDeadline();
+
+            /* Commands */
+            TimerId add(uint64_t delay, TimerHandler *handler, uint64_t interval = 0);
+            bool cancel(TimerId id);
+            void clear();
+
+            int expire(uint64_t now);
+
+        protected:
+
+        private:
+            TimerQueue(const TimerQueue &rhs);
+            TimerQueue & operator=(const TimerQueue &rhs);
+
+            void discardStale();
+
+        /********************
+         *      MEMBERS     *
+         ********************/
+
+        protected:
+
+        private:
+            typedef pair<uint64_t, TimerId> HeapEntry;
+
+            TimerId m_iNextId;
+            map<TimerId, Timer> m_oTimers;
+            priority_queue<HeapEntry, vector<HeapEntry>, greater<HeapEntry> > m_oHeap;
+    };
+}
+
+#endif //__TIMER_QUEUE_H_
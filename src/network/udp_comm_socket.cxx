@@ -34,6 +34,8 @@
 #include "common/util.h"
 #include "common/logger.h"
 #include "common/exception.h"
+#include "network/timer_queue.h"
+#include "network/udp_sequence.h"
 
 #include <netinet/in.h>
 #include <netdb.h>
@@ -44,6 +46,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sstream>
+#include <vector>
 
 using namespace std;
 using namespace logger;
@@ -60,6 +65,11 @@ using namespace network;
 UDPCommSocket::UDPCommSocket() : CommSocket() {
 	m_sHostname = "";
 	m_iPort = 0;
+	m_iResolveTime = 0;
+	m_bResolve = false;
+	m_bSequenced = false;
+	m_iSequence = 0;
+	m_iMulticastTTL = 1;
 }
 
 
@@ -70,6 +80,12 @@ UDPCommSocket::UDPCommSocket() : CommSocket() {
 UDPCommSocket::UDPCommSocket(const UDPCommSocket &rhs) {
 	m_sHostname = rhs.m_sHostname;
 	m_iPort = rhs.m_iPort;
+	m_iResolveTime = 0;
+	m_bResolve = false;
+	m_bSequenced = rhs.m_bSequenced;
+	m_iSequence = 0;
+	m_iMulticastTTL = rhs.m_iMulticastTTL;
+	m_sMulticastInterface = rhs.m_sMulticastInterface;
 }
 
 
@@ -96,6 +112,9 @@ CommBase * UDPCommSocket::copy() {
 UDPCommSocket & UDPCommSocket::operator=(const UDPCommSocket &rhs) {
 	m_sHostname = rhs.m_sHostname;
 	m_iPort = rhs.m_iPort;
+	m_bSequenced = rhs.m_bSequenced;
+	m_iMulticastTTL = rhs.m_iMulticastTTL;
+	m_sMulticastInterface = rhs.m_sMulticastInterface;
 
 	return *this;
 }
@@ -111,50 +130,25 @@ bool UDPCommSocket::isConfigured() {
 
 /******************************************************************************
  * Method: initalize
- * Description: Setup a UDP listener
+ * Description: Resolve the hostname and connect a UDP socket to it.
  * Exceptions:
  *   SocketMissingConfig
- *   SocketConnectFailure
+ *   SocketCreateFailure
+ *   SocketHostFailure
  ******************************************************************************/
 bool UDPCommSocket::initialize() {
-	int fflags;
 	int newsock;
-        struct sockaddr_in serv_addr;
-        struct hostent *server;
 	
 	LOG(DEBUG) << "UDP Client initialize()";
 
 	if(!isConfigured())
 		throw SocketMissingConfig("missing inet port");
 
-	LOG(DEBUG2) << "Creating INET socket";
-	newsock = socket(AF_INET, SOCK_DGRAM, 0);
-
-	if(!newsock)
-		throw SocketCreateFailure("socket create failure");
-
-        LOG(DEBUG2) << "Looking up server name";
-	server = gethostbyname(m_sHostname.c_str());
-
-	if(!server || server->h_length == 0)
-		throw SocketHostFailure(m_sHostname.c_str());
-
-	bzero((char *) &serv_addr, sizeof(serv_addr));
-	serv_addr.sin_family = AF_INET;
-	bcopy((char *)server->h_addr,
-		 (char *)&serv_addr.sin_addr.s_addr,
-		 server->h_length);
-	serv_addr.sin_port = htons(m_iPort);
-	
-	if(! blocking()) {
-		LOG(DEBUG3) << "set server socket non-blocking";
-		fcntl(newsock, F_SETFL, O_NONBLOCK);
-		int opts = fcntl(newsock, F_GETFL);
-		LOG(DEBUG3) << "fd: " << hex << newsock << " "
-		            << "sock opts: " << hex << opts << " "
-		            << "non block flag: " << hex << O_NONBLOCK;
-	}
+	newsock = connectSocket();
 	
+	if(m_pSocketFD > 0)
+		close(m_pSocketFD);
+
 	LOG(DEBUG2) << "storing new fd: " << newsock;
 	m_pSocketFD = newsock;
 	
@@ -178,38 +172,193 @@ bool UDPCommSocket::initialize() {
  *   SocketWriteFailure
  ******************************************************************************/
 uint32_t UDPCommSocket::writeData(const char *buffer, const uint32_t size) {
-    int count;
-    struct sockaddr_in serv_addr;
-    struct hostent *server;
-    socklen_t sendsize = sizeof(serv_addr);
-
     if(! connected())
         throw(SocketNotInitialized());
 
-    LOG(DEBUG2) << "Looking up server name";
-    server = gethostbyname(m_sHostname.c_str());
+    if(m_bSequenced) {
+        struct iovec iov;
+        iov.iov_base = (void *)buffer;
+        iov.iov_len = size;
 
-    if(!server || server->h_length == 0)
-        throw SocketHostFailure(m_sHostname.c_str());
-    
-    bzero((char *) &serv_addr, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    bcopy((char *)server->h_addr, (char *)&serv_addr.sin_addr.s_addr,
-          server->h_length);
-    serv_addr.sin_port = htons(m_iPort);
+        writeVector(&iov, 1);
+        return size;
+    }
 	
     LOG(DEBUG) << "WRITE DEVICE: " << buffer;
-    int res = sendto(m_pSocketFD, buffer, size, 0, (struct sockaddr*)&serv_addr, sendsize);
-    
+    int res = send(m_pSocketFD, buffer, size, 0);
+
+    // A refusal of an earlier datagram is reported here, try once more
+    if(res < 0 && errno == ECONNREFUSED)
+        res = send(m_pSocketFD, buffer, size, 0);
+
     if(res < 0) {
-	throw SocketWriteFailure(strerror(errno));
+        writeFailed(errno);
+        return size;
     }
+
     LOG(DEBUG) << "bytes written: " << res;
 
     return size;
 }
 
 
+/******************************************************************************
+ * Method: writeVector
+ * Description: Send several buffers as a single datagram with sendmsg.
+ *
+ * Parameters:
+ *   iov - the buffers to send
+ *   count - number of buffers
+ * Return:
+ *   returns the number of bytes written.
+ * Exceptions:
+ *   SocketNotInitialized
+ *   SocketWriteFailure
+ ******************************************************************************/
+uint32_t UDPCommSocket::writeVector(const struct iovec *iov, int count) {
+    char header[UDP_SEQUENCE_HEADER_SIZE];
+    vector<struct iovec> parts;
+    struct msghdr message;
+    uint32_t size = 0;
+
+    if(! connected())
+        throw(SocketNotInitialized());
+
+    for(int i = 0; i < count; i++)
+        size += iov[i].iov_len;
+
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = (struct iovec *)iov;
+    message.msg_iovlen = count;
+
+    if(m_bSequenced) {
+        encodeSequenceHeader(header, m_iSequence);
+
+        parts.resize(count + 1);
+        parts[0].iov_base = header;
+        parts[0].iov_len = UDP_SEQUENCE_HEADER_SIZE;
+        for(int i = 0; i < count; i++)
+            parts[i + 1] = iov[i];
+
+        message.msg_iov = &parts[0];
+        message.msg_iovlen = count + 1;
+    }
+
+    int res = sendmsg(m_pSocketFD, &message, 0);
+
+    if(res < 0 && errno == ECONNREFUSED)
+        res = sendmsg(m_pSocketFD, &message, 0);
+
+    if(res < 0) {
+        writeFailed(errno);
+
+        if(m_bSequenced)
+            m_iSequence++;
+        return size;
+    }
+
+    LOG(DEBUG) << "bytes written: " << res;
+
+    // Callers count their own bytes, not the header
+    if(m_bSequenced) {
+        m_iSequence++;
+        res -= UDP_SEQUENCE_HEADER_SIZE;
+    }
+
+    return res;
+}
+
+
+/******************************************************************************
+ * Method: writeMessages
+ * Description: Send each buffer as its own datagram.  sendmmsg sends the
+ * whole batch in one system call, it may stop early so keep going until
+ * everything is sent.
+ *
+ * Parameters:
+ *   iov - the buffers to send, one per datagram
+ *   count - number of buffers
+ * Return:
+ *   returns the number of bytes written.
+ * Exceptions:
+ *   SocketNotInitialized
+ *   SocketWriteFailure
+ ******************************************************************************/
+uint32_t UDPCommSocket::writeMessages(const struct iovec *iov, int count) {
+    vector<struct mmsghdr> messages(count);
+    vector<struct iovec> parts;
+    vector<char> headers;
+    uint32_t bytesWritten = 0;
+    bool refused = false;
+    int sent = 0;
+
+    if(! connected())
+        throw(SocketNotInitialized());
+
+    for(int i = 0; i < count; i++) {
+        memset(&messages[i], 0, sizeof(struct mmsghdr));
+        messages[i].msg_hdr.msg_iov = (struct iovec *)&iov[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // Each datagram gets its own header in front of its buffer
+    if(m_bSequenced) {
+        headers.resize(count * UDP_SEQUENCE_HEADER_SIZE);
+        parts.resize(count * 2);
+
+        for(int i = 0; i < count; i++) {
+            char *header = &headers[i * UDP_SEQUENCE_HEADER_SIZE];
+            encodeSequenceHeader(header, m_iSequence + i);
+
+            parts[i * 2].iov_base = header;
+            parts[i * 2].iov_len = UDP_SEQUENCE_HEADER_SIZE;
+            parts[i * 2 + 1] = iov[i];
+
+            messages[i].msg_hdr.msg_iov = &parts[i * 2];
+            messages[i].msg_hdr.msg_iovlen = 2;
+        }
+    }
+
+    while(sent < count) {
+        int res = sendmmsg(m_pSocketFD, &messages[sent], count - sent, 0);
+
+        if(res < 0 && errno == ECONNREFUSED && !refused) {
+            refused = true;
+            continue;
+        }
+
+        if(res < 0) {
+            writeFailed(errno);
+
+            // Refused, nobody is listening to the rest either
+            for(int i = sent; i < count; i++)
+                bytesWritten += iov[i].iov_len;
+
+            if(m_bSequenced)
+                m_iSequence += count - sent;
+            break;
+        }
+
+        for(int i = sent; i < sent + res; i++) {
+            bytesWritten += messages[i].msg_len;
+
+            if(m_bSequenced)
+                bytesWritten -= UDP_SEQUENCE_HEADER_SIZE;
+        }
+
+        // Keep count as we go, a later failure throws
+        if(m_bSequenced)
+            m_iSequence += res;
+
+        sent += res;
+    }
+
+    LOG(DEBUG) << "datagrams: " << count << " bytes written: " << bytesWritten;
+
+    return bytesWritten;
+}
+
+
 /******************************************************************************
  * Method: readData
  * Description: the port agent doesn't currently need to read UDP so we didn't
@@ -225,4 +374,232 @@ uint32_t UDPCommSocket::writeData(const char *buffer, const uint32_t size) {
  ******************************************************************************/
 uint32_t UDPCommSocket::readData(char *buffer, const uint32_t size) {
     throw NotImplemented();
-}
\ No newline at end of file
+}
+
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: connectSocket
+ * Description: Resolve the hostname and connect a new datagram socket to the
+ * first address that takes it.  IPv4 addresses are tried before IPv6 so a
+ * dual stack name goes where it always has.
+ *
+ * Return:
+ *   the new socket's file descriptor
+ * Exceptions:
+ *   SocketCreateFailure
+ *   SocketHostFailure
+ ******************************************************************************/
+int UDPCommSocket::connectSocket() {
+    struct addrinfo hints, *result, *addr;
+    int families[] = { AF_INET, AF_INET6 };
+    ostringstream port;
+    int newsock = -1;
+    int error;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICSERV;
+
+    port << m_iPort;
+
+    LOG(DEBUG2) << "Looking up server name";
+    error = getaddrinfo(m_sHostname.c_str(), port.str().c_str(), &hints, &result);
+    if(error) {
+        LOG(ERROR) << "resolve " << m_sHostname << ": " << gai_strerror(error);
+        throw SocketHostFailure(m_sHostname.c_str());
+    }
+
+    for(int f = 0; f < 2 && newsock < 0; f++) {
+        for(addr = result; addr && newsock < 0; addr = addr->ai_next) {
+            if(addr->ai_family != families[f])
+                continue;
+
+            LOG(DEBUG2) << "Creating socket, family: " << addr->ai_family;
+            newsock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+            if(newsock < 0)
+                continue;
+
+            if(!setMulticastOptions(newsock, addr)) {
+                close(newsock);
+                newsock = -1;
+                continue;
+            }
+
+            if(connect(newsock, addr->ai_addr, addr->ai_addrlen) < 0) {
+                LOG(DEBUG2) << "connect failed: " << strerror(errno);
+                close(newsock);
+                newsock = -1;
+            }
+        }
+    }
+
+    freeaddrinfo(result);
+
+    if(newsock < 0)
+        throw SocketCreateFailure("socket create failure");
+
+    if(! blocking()) {
+        LOG(DEBUG3) << "set server socket non-blocking";
+        fcntl(newsock, F_SETFL, O_NONBLOCK);
+        int opts = fcntl(newsock, F_GETFL);
+        LOG(DEBUG3) << "fd: " << hex << newsock << " "
+                    << "sock opts: " << hex << opts << " "
+                    << "non block flag: " << hex << O_NONBLOCK;
+    }
+
+    m_iResolveTime = TimerQueue::now();
+    m_bResolve = false;
+
+    return newsock;
+}
+
+/******************************************************************************
+ * Method: setMulticastOptions
+ * Description: If the address is a multicast group set the hops and the
+ * outgoing interface.  This has to happen before connect so the route is
+ * picked on the right interface.
+ *
+ * Parameters:
+ *   sock - the new socket
+ *   addr - the address it will be connected to
+ * Return:
+ *   false if an option couldn't be set
+ ******************************************************************************/
+bool UDPCommSocket::setMulticastOptions(int sock, struct addrinfo *addr) {
+    struct in_addr ifaddr;
+    unsigned int index = 0;
+    int hops = m_iMulticastTTL;
+
+    if(addr->ai_family == AF_INET) {
+        struct sockaddr_in *group = (struct sockaddr_in *)addr->ai_addr;
+        if(!IN_MULTICAST(ntohl(group->sin_addr.s_addr)))
+            return true;
+    }
+    else if(addr->ai_family == AF_INET6) {
+        struct sockaddr_in6 *group = (struct sockaddr_in6 *)addr->ai_addr;
+        if(!IN6_IS_ADDR_MULTICAST(&group->sin6_addr))
+            return true;
+    }
+    else {
+        return true;
+    }
+
+    if(m_sMulticastInterface.length() &&
+       !network::multicastInterface(m_sMulticastInterface, ifaddr, index)) {
+        LOG(ERROR) << "unknown multicast interface: " << m_sMulticastInterface;
+        return false;
+    }
+
+    LOG(DEBUG2) << "multicast ttl: " << hops << " interface: " << m_sMulticastInterface;
+
+    if(addr->ai_family == AF_INET) {
+        unsigned char ttl = m_iMulticastTTL;
+
+        if(setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0) {
+            LOG(ERROR) << "set multicast ttl: " << strerror(errno);
+            return false;
+        }
+
+        if(m_sMulticastInterface.length()) {
+            struct ip_mreqn request;
+
+            memset(&request, 0, sizeof(request));
+            request.imr_address = ifaddr;
+            request.imr_ifindex = index;
+
+            if(setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &request, sizeof(request)) < 0) {
+                LOG(ERROR) << "set multicast interface: " << strerror(errno);
+                return false;
+            }
+        }
+    }
+    else {
+        if(setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops, sizeof(hops)) < 0) {
+            LOG(ERROR) << "set multicast hops: " << strerror(errno);
+            return false;
+        }
+
+        // IPv6 only takes an interface index
+        if(index &&
+           setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_IF, &index, sizeof(index)) < 0) {
+            LOG(ERROR) << "set multicast interface: " << strerror(errno);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/******************************************************************************
+ * Method: checkResolve
+ * Description: Resolve the hostname again if it is due.  If that fails the
+ * old socket is kept and we try again after another interval.  This blocks
+ * on the lookup, so it belongs in a timer and never on the write path.
+ *
+ * Parameters:
+ *   now - current monotonic time in microseconds
+ ******************************************************************************/
+void UDPCommSocket::checkResolve(uint64_t now) {
+    if(!connected() || resolveDelay(now))
+        return;
+
+    LOG(DEBUG) << "resolve " << m_sHostname << " again";
+
+    try {
+        int newsock = connectSocket();
+
+        close(m_pSocketFD);
+        m_pSocketFD = newsock;
+    }
+    catch(OOIException &e) {
+        LOG(ERROR) << "keeping old address for " << m_sHostname << ": " << e.what();
+        m_iResolveTime = now;
+    }
+}
+
+/******************************************************************************
+ * Method: resolveDelay
+ * Description: How long until the hostname should be resolved again.  An
+ * unreachable destination is retried sooner, but never more often than
+ * every UDP_RESOLVE_RETRY seconds.
+ *
+ * Parameters:
+ *   now - current monotonic time in microseconds
+ * Return:
+ *   microseconds to wait, 0 if it is due now
+ ******************************************************************************/
+uint64_t UDPCommSocket::resolveDelay(uint64_t now) {
+    uint64_t interval = m_bResolve ? UDP_RESOLVE_RETRY : UDP_RESOLVE_INTERVAL;
+    uint64_t deadline = m_iResolveTime + interval * USEC_PER_SEC;
+
+    return now >= deadline ? 0 : deadline - now;
+}
+
+/******************************************************************************
+ * Method: writeFailed
+ * Description: Handle a failed send.  A refused datagram only means nobody
+ * is listening, which is fine for UDP.  An unreachable destination is
+ * resolved again sooner than usual, see resolveDelay().
+ *
+ * Parameters:
+ *   error - errno from the send
+ * Exceptions:
+ *   SocketWriteFailure
+ ******************************************************************************/
+void UDPCommSocket::writeFailed(int error) {
+    if(error == ECONNREFUSED) {
+        LOG(DEBUG) << "datagram refused, no listener on " << m_sHostname << ":" << m_iPort;
+        return;
+    }
+
+    if(error == ENETUNREACH || error == EHOSTUNREACH || error == EDESTADDRREQ ||
+       error == ENOTCONN || error == EADDRNOTAVAIL)
+        m_bResolve = true;
+
+    throw SocketWriteFailure(strerror(error));
+}
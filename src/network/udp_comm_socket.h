@@ -18,7 +18,8 @@
  * // Enable blocking connections. Default is non-blocking
  * socket.setBlocking(true);
  *
- * // Initialize the connection
+ * // Initialize the connection.  The hostname is resolved here and the socket
+ * // connected to it, writes don't look it up again.
  * socket.initialize();
  * 
  * // Read data from a client. Ignores source address information.
@@ -28,6 +29,23 @@
  * // Write data to the client.
  * int bytes_written = socket.writeData("Hello World", strlen("Hello World"));
  *
+ * Writes never resolve the hostname.  The owner asks for resolveDelay() and
+ * calls checkResolve() once it has passed, from a timer.  The name is due
+ * again every UDP_RESOLVE_INTERVAL seconds, or UDP_RESOLVE_RETRY seconds
+ * after the network reported the destination unreachable.
+ *
+ * // from a timer, resolveDelay(TimerQueue::now()) us from now
+ * socket.checkResolve(TimerQueue::now());
+ *
+ * For a multicast group set the hops and outgoing interface before
+ * initialize().  With sequencing on, every datagram starts with the header
+ * described in udp_sequence.h so receivers can count what they missed.
+ *
+ * socket.setHostname("239.1.1.1");
+ * socket.setMulticastTTL(4);
+ * socket.setMulticastInterface("eth1");
+ * socket.setSequenced(true);
+ *
  ******************************************************************************/
 
 #ifndef __UDP_COMM_SOCKET_H_
@@ -36,6 +54,15 @@
 #include "common/logger.h"
 #include "network/comm_socket.h"
 
+#include <netinet/in.h>
+#include <netdb.h>
+
+// Seconds before the hostname is resolved again
+#define UDP_RESOLVE_INTERVAL 300
+
+// Seconds between attempts while the destination is unreachable
+#define UDP_RESOLVE_RETRY 10
+
 using namespace std;
 using namespace logger;
 
@@ -65,13 +92,34 @@ namespace network {
 			uint16_t port() { return m_iPort; }
 			string hostname() { return m_sHostname; }
 
+            void setSequenced(bool sequenced) { m_bSequenced = sequenced; }
+            bool sequenced() { return m_bSequenced; }
+
+            // Sequence of the next datagram sent
+            uint64_t sequence() { return m_iSequence; }
+
+            void setMulticastTTL(uint8_t ttl) { m_iMulticastTTL = ttl; }
+            uint8_t multicastTTL() { return m_iMulticastTTL; }
+
+            // Outgoing interface for multicast, an IPv4 address or a name
+            void setMulticastInterface(const string &name) { m_sMulticastInterface = name; }
+            string multicastInterface() { return m_sMulticastInterface; }
+
             /* Commands */
 	    
 	    // Connect to the network host
             bool initialize();
+
+            // Resolve the hostname again if it is due
+            void checkResolve(uint64_t now);
+
+            // Microseconds from now until the hostname is due
+            uint64_t resolveDelay(uint64_t now);
             
 	    virtual uint32_t writeData(const char *buffer, uint32_t size);
             virtual uint32_t readData(char *buffer, uint32_t size);
+            virtual uint32_t writeVector(const struct iovec *iov, int count);
+            virtual uint32_t writeMessages(const struct iovec *iov, int count);
 
         protected:
 
@@ -79,6 +127,15 @@ namespace network {
             // Does this object have a complete configuration?
             bool isConfigured();
 
+            // Resolve the hostname and connect a new socket to it
+            int connectSocket();
+
+            // Hops and interface for a multicast destination
+            bool setMulticastOptions(int sock, struct addrinfo *addr);
+
+            // Note an unreachable destination so it is resolved again
+            void writeFailed(int error);
+
         /********************
          *      MEMBERS     *
          ********************/
@@ -86,6 +143,16 @@ namespace network {
         protected:
             
         private:
+            // When the hostname was last resolved or tried, monotonic
+            // microseconds, and was the destination unreachable since
+            uint64_t m_iResolveTime;
+            bool m_bResolve;
+
+            bool m_bSequenced;
+            uint64_t m_iSequence;
+
+            uint8_t m_iMulticastTTL;
+            string m_sMulticastInterface;
     };
 }
 
@@ -0,0 +1,421 @@
+/*******************************************************************************
+ * Class: SequenceTracker, UDPSequenceReceiver
+ * Filename: udp_sequence.cxx
+ * License: Apache 2.0
+ *
+ * Sequenced UDP datagrams and gap accounting.  See udp_sequence.h for usage.
+ ******************************************************************************/
+
+#include "udp_sequence.h"
+#include "common/logger.h"
+#include "common/exception.h"
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sstream>
+
+// Largest UDP payload
+#define SEQUENCE_RECEIVE_BUFFER 65536
+
+using namespace std;
+using namespace logger;
+using namespace network;
+
+/******************************************************************************
+ *   HEADER FUNCTIONS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: encodeSequenceHeader
+ * Description: Write the sync and sequence to the front of a datagram.
+ *
+ * Parameters:
+ *   buffer - at least UDP_SEQUENCE_HEADER_SIZE bytes
+ *   sequence - the datagram's sequence number
+ ******************************************************************************/
+void network::encodeSequenceHeader(char *buffer, uint64_t sequence) {
+    uint32_t words[3];
+
+    words[0] = htonl(UDP_SEQUENCE_SYNC);
+    words[1] = htonl((uint32_t)(sequence >> 32));
+    words[2] = htonl((uint32_t)(sequence & 0xFFFFFFFF));
+
+    memcpy(buffer, words, UDP_SEQUENCE_HEADER_SIZE);
+}
+
+/******************************************************************************
+ * Method: decodeSequenceHeader
+ * Description: Read the sequence from the front of a datagram.
+ *
+ * Parameters:
+ *   buffer - the datagram
+ *   size - bytes in the datagram
+ *   sequence - set to the datagram's sequence number
+ * Return:
+ *   false if the datagram is too short or doesn't start with the sync
+ ******************************************************************************/
+bool network::decodeSequenceHeader(const char *buffer, uint32_t size, uint64_t &sequence) {
+    uint32_t words[3];
+
+    if(size < UDP_SEQUENCE_HEADER_SIZE)
+        return false;
+
+    memcpy(words, buffer, UDP_SEQUENCE_HEADER_SIZE);
+
+    if(ntohl(words[0]) != UDP_SEQUENCE_SYNC)
+        return false;
+
+    sequence = ((uint64_t)ntohl(words[1]) << 32) | ntohl(words[2]);
+    return true;
+}
+
+/******************************************************************************
+ * Method: multicastInterface
+ * Description: Find a multicast interface from an IPv4 address or an
+ * interface name like eth1.
+ *
+ * Parameters:
+ *   name - the address or name
+ *   addr - set to the address if name is one
+ *   index - set to the interface index otherwise
+ * Return:
+ *   false if name is neither
+ ******************************************************************************/
+bool network::multicastInterface(const string &name, struct in_addr &addr, unsigned int &index) {
+    addr.s_addr = htonl(INADDR_ANY);
+    index = 0;
+
+    if(inet_pton(AF_INET, name.c_str(), &addr) == 1)
+        return true;
+
+    index = if_nametoindex(name.c_str());
+    return index > 0;
+}
+
+
+/******************************************************************************
+ *   SEQUENCE TRACKER
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ ******************************************************************************/
+SequenceTracker::SequenceTracker() {
+    reset();
+}
+
+/******************************************************************************
+ * Method: reset
+ * Description: Forget everything, the next sequence received starts over.
+ ******************************************************************************/
+void SequenceTracker::reset() {
+    m_bStarted = false;
+    m_iNext = 0;
+    m_iFirst = 0;
+    m_iWindow = 0;
+
+    m_iReceived = 0;
+    m_iLost = 0;
+    m_iLate = 0;
+    m_iEarly = 0;
+    m_iDuplicates = 0;
+    m_iRestarts = 0;
+}
+
+/******************************************************************************
+ * Method: receive
+ * Description: Account for a datagram.  A jump forward counts everything
+ * skipped as lost.  If a skipped datagram turns up while it is still in the
+ * window it is taken back off the lost count.  One from before the start
+ * was never counted lost, so it is only counted as early.
+ *
+ * Parameters:
+ *   sequence - the datagram's sequence number
+ * Return:
+ *   what the datagram was
+ ******************************************************************************/
+SequenceResult SequenceTracker::receive(uint64_t sequence) {
+    if(!m_bStarted) {
+        // Whatever was sent before we joined isn't lost
+        start(sequence);
+        return SEQUENCE_IN_ORDER;
+    }
+
+    if(sequence >= m_iNext) {
+        uint64_t gap = sequence - m_iNext;
+
+        if(gap + 1 >= SEQUENCE_WINDOW)
+            m_iWindow = 1;
+        else
+            m_iWindow = (m_iWindow << (gap + 1)) | 1;
+
+        m_iNext = sequence + 1;
+        m_iReceived++;
+        m_iLost += gap;
+
+        if(gap) {
+            LOG(DEBUG) << "sequence gap, " << gap << " datagrams lost before " << sequence;
+            return SEQUENCE_GAP;
+        }
+
+        return SEQUENCE_IN_ORDER;
+    }
+
+    uint64_t age = m_iNext - 1 - sequence;
+
+    if(age >= SEQUENCE_WINDOW) {
+        LOG(DEBUG) << "sequence " << sequence << " far behind " << m_iNext << ", sender restarted";
+        m_iRestarts++;
+        start(sequence);
+        return SEQUENCE_RESTART;
+    }
+
+    uint64_t bit = (uint64_t)1 << age;
+
+    if(m_iWindow & bit) {
+        m_iDuplicates++;
+        return SEQUENCE_DUPLICATE;
+    }
+
+    m_iWindow |= bit;
+    m_iReceived++;
+
+    if(sequence < m_iFirst) {
+        m_iEarly++;
+        return SEQUENCE_EARLY;
+    }
+
+    m_iLate++;
+    m_iLost--;
+
+    return SEQUENCE_LATE;
+}
+
+/******************************************************************************
+ * Method: start
+ * Description: Take sequence as the first one received.
+ ******************************************************************************/
+void SequenceTracker::start(uint64_t sequence) {
+    m_bStarted = true;
+    m_iFirst = sequence;
+    m_iNext = sequence + 1;
+    m_iWindow = 1;
+    m_iReceived++;
+}
+
+
+/******************************************************************************
+ *   RECEIVER
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ ******************************************************************************/
+UDPSequenceReceiver::UDPSequenceReceiver() {
+    m_iPort = 0;
+    m_iSocketFD = 0;
+    m_iInvalid = 0;
+    m_pBuffer = new char[SEQUENCE_RECEIVE_BUFFER];
+}
+
+/******************************************************************************
+ * Method: Destructor
+ ******************************************************************************/
+UDPSequenceReceiver::~UDPSequenceReceiver() {
+    close();
+    delete [] m_pBuffer;
+}
+
+/******************************************************************************
+ * Method: initialize
+ * Description: Bind the port and join the group.  With no group set we
+ * listen on every address, which is what a unicast receiver wants.
+ *
+ * Exceptions:
+ *   SocketMissingConfig
+ *   SocketHostFailure
+ *   SocketCreateFailure
+ *   SocketConnectFailure
+ ******************************************************************************/
+bool UDPSequenceReceiver::initialize() {
+    struct addrinfo hints, *result;
+    ostringstream port;
+    int error;
+    int on = 1;
+
+    if(!m_iPort)
+        throw SocketMissingConfig("missing inet port");
+
+    close();
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICSERV | AI_PASSIVE;
+
+    port << m_iPort;
+
+    error = getaddrinfo(m_sGroup.length() ? m_sGroup.c_str() : NULL,
+                        port.str().c_str(), &hints, &result);
+    if(error) {
+        LOG(ERROR) << "resolve " << m_sGroup << ": " << gai_strerror(error);
+        throw SocketHostFailure(m_sGroup.c_str());
+    }
+
+    m_iSocketFD = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if(m_iSocketFD < 0) {
+        m_iSocketFD = 0;
+        freeaddrinfo(result);
+        throw SocketCreateFailure(strerror(errno));
+    }
+
+    // Several receivers on one host can share a group
+    setsockopt(m_iSocketFD, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    if(bind(m_iSocketFD, result->ai_addr, result->ai_addrlen) < 0) {
+        string message = strerror(errno);
+        freeaddrinfo(result);
+        close();
+        throw SocketConnectFailure(message);
+    }
+
+    try {
+        joinGroup(result->ai_family, result->ai_addr);
+    }
+    catch(OOIException &e) {
+        freeaddrinfo(result);
+        close();
+        throw;
+    }
+
+    freeaddrinfo(result);
+
+    LOG(DEBUG) << "sequence receiver on " << m_sGroup << ":" << m_iPort
+               << " fd: " << m_iSocketFD;
+
+    return true;
+}
+
+/******************************************************************************
+ * Method: close
+ * Description: Close the socket, leaving the group.
+ ******************************************************************************/
+void UDPSequenceReceiver::close() {
+    if(m_iSocketFD > 0)
+        ::close(m_iSocketFD);
+
+    m_iSocketFD = 0;
+}
+
+/******************************************************************************
+ * Method: readData
+ * Description: Read one datagram, account for its sequence and copy out the
+ * payload.  Payload that doesn't fit in buffer is cut off.
+ *
+ * Parameters:
+ *   buffer - where to put the payload
+ *   size - bytes available in buffer
+ * Return:
+ *   bytes of payload, 0 for an invalid datagram or nothing to read on a
+ *   non-blocking socket
+ * Exceptions:
+ *   SocketNotInitialized
+ *   SocketReadFailure
+ ******************************************************************************/
+uint32_t UDPSequenceReceiver::readData(char *buffer, uint32_t size) {
+    uint64_t sequence;
+
+    if(!connected())
+        throw SocketNotInitialized();
+
+    int res = recv(m_iSocketFD, m_pBuffer, SEQUENCE_RECEIVE_BUFFER, 0);
+
+    if(res < 0) {
+        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return 0;
+
+        throw SocketReadFailure(strerror(errno));
+    }
+
+    if(!decodeSequenceHeader(m_pBuffer, res, sequence)) {
+        LOG(DEBUG) << "datagram without a sequence header, " << res << " bytes";
+        m_iInvalid++;
+        return 0;
+    }
+
+    SequenceResult result = m_oTracker.receive(sequence);
+    if(result == SEQUENCE_DUPLICATE)
+        return 0;
+
+    uint32_t payload = res - UDP_SEQUENCE_HEADER_SIZE;
+    if(payload > size)
+        payload = size;
+
+    memcpy(buffer, m_pBuffer + UDP_SEQUENCE_HEADER_SIZE, payload);
+
+    return payload;
+}
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: joinGroup
+ * Description: Join the bound address's group if it is a multicast address,
+ * on the configured interface if there is one.
+ *
+ * Parameters:
+ *   family - AF_INET or AF_INET6
+ *   addr - the bound address
+ * Exceptions:
+ *   SocketHostFailure
+ *   SocketConnectFailure
+ ******************************************************************************/
+void UDPSequenceReceiver::joinGroup(int family, struct sockaddr *addr) {
+    struct in_addr ifaddr;
+    unsigned int index = 0;
+
+    ifaddr.s_addr = htonl(INADDR_ANY);
+
+    if(m_sInterface.length() && !multicastInterface(m_sInterface, ifaddr, index))
+        throw SocketHostFailure(m_sInterface.c_str());
+
+    if(family == AF_INET) {
+        struct sockaddr_in *group = (struct sockaddr_in *)addr;
+        struct ip_mreqn request;
+
+        if(!IN_MULTICAST(ntohl(group->sin_addr.s_addr)))
+            return;
+
+        memset(&request, 0, sizeof(request));
+        request.imr_multiaddr = group->sin_addr;
+        request.imr_address = ifaddr;
+        request.imr_ifindex = index;
+
+        if(setsockopt(m_iSocketFD, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) < 0)
+            throw SocketConnectFailure(strerror(errno));
+    }
+    else if(family == AF_INET6) {
+        struct sockaddr_in6 *group = (struct sockaddr_in6 *)addr;
+        struct ipv6_mreq request;
+
+        if(!IN6_IS_ADDR_MULTICAST(&group->sin6_addr))
+            return;
+
+        memset(&request, 0, sizeof(request));
+        request.ipv6mr_multiaddr = group->sin6_addr;
+        request.ipv6mr_interface = index;
+
+        if(setsockopt(m_iSocketFD, IPPROTO_IPV6, IPV6_JOIN_GROUP, &request, sizeof(request)) < 0)
+            throw SocketConnectFailure(strerror(errno));
+    }
+
+    LOG(DEBUG) << "joined group " << m_sGroup;
+}
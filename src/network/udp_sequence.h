@@ -0,0 +1,169 @@
+/*******************************************************************************
+ * Class: SequenceTracker, UDPSequenceReceiver
+ * Filename: udp_sequence.h
+ * License: Apache 2.0
+ *
+ * Sequenced UDP datagrams.  A UDPCommSocket with sequencing on puts a small
+ * header in front of every datagram it sends:
+ *
+ *   sync      4 bytes  UDP_SEQUENCE_SYNC
+ *   sequence  8 bytes  0 for the first datagram, one more for each after
+ *
+ * Both are in network byte order, the packet follows.  Receivers use the
+ * sequence to count datagrams lost on the way.
+ *
+ * SequenceTracker does the gap accounting.  It remembers the last
+ * SEQUENCE_WINDOW sequences so a datagram that arrives late is taken back
+ * off the lost count, and one seen twice is counted as a duplicate.  A
+ * datagram from before the first one received, reordered around the join
+ * or a restart, was never counted lost so it is only counted as early.  A
+ * sequence further back than the window means the sender restarted.
+ *
+ * UDPSequenceReceiver is the receiving end.  It binds the port, joins the
+ * group if it is a multicast address, and strips and checks the header.
+ *
+ * Usage:
+ *
+ * UDPSequenceReceiver receiver;
+ * receiver.setGroup("239.1.1.1");
+ * receiver.setPort(5000);
+ * receiver.setInterface("eth1");      // optional, address or name
+ * receiver.initialize();
+ *
+ * char buffer[65536];
+ * uint32_t size = receiver.readData(buffer, sizeof(buffer));
+ *
+ * uint64_t lost = receiver.tracker().lost();
+ ******************************************************************************/
+
+#ifndef __UDP_SEQUENCE_H_
+#define __UDP_SEQUENCE_H_
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include <string>
+
+#define UDP_SEQUENCE_SYNC        0x50415351
+#define UDP_SEQUENCE_HEADER_SIZE 12
+
+// Sequences remembered for late and duplicate datagrams
+#define SEQUENCE_WINDOW 64
+
+using namespace std;
+
+namespace network {
+    // Write and read the header at the front of a datagram
+    void encodeSequenceHeader(char *buffer, uint64_t sequence);
+    bool decodeSequenceHeader(const char *buffer, uint32_t size, uint64_t &sequence);
+
+    // Find a multicast interface given as an IPv4 address or a name.  One of
+    // addr or index is set, the other is left zero.
+    bool multicastInterface(const string &name, struct in_addr &addr, unsigned int &index);
+
+    typedef enum SequenceResult {
+        SEQUENCE_IN_ORDER,
+        SEQUENCE_GAP,
+        SEQUENCE_LATE,
+        SEQUENCE_EARLY,
+        SEQUENCE_DUPLICATE,
+        SEQUENCE_RESTART
+    } SequenceResult;
+
+    class SequenceTracker {
+        /********************
+         *      METHODS     *
+         ********************/
+
+        public:
+            SequenceTracker();
+
+            SequenceResult receive(uint64_t sequence);
+            void reset();
+
+            /* Accessors */
+            uint64_t received() { return m_iReceived; }
+            uint64_t lost() { return m_iLost; }
+            uint64_t late() { return m_iLate; }
+            uint64_t early() { return m_iEarly; }
+            uint64_t duplicates() { return m_iDuplicates; }
+            uint64_t restarts() { return m_iRestarts; }
+
+            // The sequence expected next
+            uint64_t expected() { return m_iNext; }
+
+        private:
+            void start(uint64_t sequence);
+
+        /********************
+         *      MEMBERS     *
+         ********************/
+
+        private:
+            bool m_bStarted;
+            uint64_t m_iNext;
+
+            // First sequence since the start, anything before it was
+            // sent before we were counting
+            uint64_t m_iFirst;
+
+            // Bit n is set if sequence m_iNext - 1 - n has been seen
+            uint64_t m_iWindow;
+
+            uint64_t m_iReceived;
+            uint64_t m_iLost;
+            uint64_t m_iLate;
+            uint64_t m_iEarly;
+            uint64_t m_iDuplicates;
+            uint64_t m_iRestarts;
+    };
+
+    class UDPSequenceReceiver {
+        /********************
+         *      METHODS     *
+         ********************/
+
+        public:
+            UDPSequenceReceiver();
+            virtual ~UDPSequenceReceiver();
+
+            void setGroup(const string &group) { m_sGroup = group; }
+            void setPort(uint16_t port) { m_iPort = port; }
+            void setInterface(const string &name) { m_sInterface = name; }
+
+            bool initialize();
+            void close();
+
+            // Read one datagram, returns the payload size, 0 if it was
+            // invalid or there was nothing to read
+            uint32_t readData(char *buffer, uint32_t size);
+
+            /* Accessors */
+            int socketFD() { return m_iSocketFD; }
+            bool connected() { return m_iSocketFD > 0; }
+            SequenceTracker & tracker() { return m_oTracker; }
+
+            // Datagrams without a good header
+            uint64_t invalid() { return m_iInvalid; }
+
+        private:
+            void joinGroup(int family, struct sockaddr *addr);
+
+        /********************
+         *      MEMBERS     *
+         ********************/
+
+        private:
+            string m_sGroup;
+            string m_sInterface;
+            uint16_t m_iPort;
+
+            int m_iSocketFD;
+            SequenceTracker m_oTracker;
+            uint64_t m_iInvalid;
+
+            // Receive buffer, payload is copied out without the header
+            char *m_pBuffer;
+    };
+}
+
+#endif //__UDP_SEQUENCE_H_
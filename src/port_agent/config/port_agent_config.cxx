@@ -10,11 +10,15 @@
 #include "port_agent_config.h"
 #include "common/logger.h"
 #include "common/log_file.h"
+#include "common/log_archiver.h"
 #include "common/exception.h"
 #include "common/util.h"
+#include "network/shared_memory_ring.h"
 
 #include <ctype.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include <unistd.h>
 #include <getopt.h>
 
@@ -58,8 +62,33 @@ PortAgentConfig::PortAgentConfig(int argc, char* argv[]) {
     m_version = false;
     m_outputThrottle = 0;
     m_maxPacketSize = DEFAULT_PACKET_SIZE;
+    m_maxQuiescentTime = DEFAULT_MAX_QUIESCENT_TIME;
+    m_maxHoldTime = DEFAULT_MAX_HOLD_TIME;
     m_ppid = 0;
+
+    // Only the data port batches by default
+    m_dataPortBatch.packets = DEFAULT_DATA_BATCH_PACKETS;
+    m_dataPortBatch.bytes = DEFAULT_DATA_BATCH_BYTES;
+    m_dataPortBatch.delay = DEFAULT_DATA_BATCH_DELAY;
+    m_commandPortBatch.packets = m_commandPortBatch.bytes = m_commandPortBatch.delay = 0;
+    m_telnetSnifferBatch = m_commandPortBatch;
+    m_dataLogCommit.delay = DEFAULT_LOG_COMMIT_DELAY;
+    m_dataLogCommit.bytes = DEFAULT_LOG_COMMIT_BYTES;
+    m_dataLogCommit.sync = DEFAULT_LOG_SYNC_INTERVAL;
+    m_dataLogPreallocate = DEFAULT_LOG_PREALLOCATE;
+    m_dataLogCompress = DEFAULT_LOG_COMPRESS;
+    m_dataLogRetention.age = 0;
+    m_dataLogRetention.bytes = 0;
+    m_dataLogIndex.packets = DEFAULT_LOG_INDEX_PACKETS;
+    m_dataLogIndex.interval = DEFAULT_LOG_INDEX_INTERVAL;
+
+    m_outputBufferSize = DEFAULT_OUTPUT_BUFFER_SIZE;
+    m_slowConsumerPolicy = OUTPUT_DROP_OLDEST;
+    m_maxClients = DEFAULT_MAX_CLIENTS;
     m_telnetSnifferPort = 0;
+    m_multicastPort = 0;
+    m_multicastTTL = DEFAULT_MULTICAST_TTL;
+    m_sharedMemorySize = DEFAULT_SHARED_MEMORY_SIZE;
     
     // For backward compatibility, observatory connection defaults to standard
     m_observatoryConnectionType = OBS_TYPE_STANDARD;
@@ -79,6 +108,10 @@ PortAgentConfig::PortAgentConfig(int argc, char* argv[]) {
     m_instrumentDataRxPort = 0;
     m_instrumentCommandPort = 0;
     m_heartbeatInterval = DEFAULT_HEARTBEAT_INTERVAL;
+    m_pipelineDepth = DEFAULT_PIPELINE_DEPTH;
+    m_reconnectMinDelay = DEFAULT_RECONNECT_MIN_DELAY;
+    m_reconnectMaxDelay = DEFAULT_RECONNECT_MAX_DELAY;
+    m_reconnectJitter = DEFAULT_RECONNECT_JITTER;
     
     m_piddir = DEFAULT_PID_DIR;
     m_logdir = DEFAULT_LOG_DIR;
@@ -418,6 +451,10 @@ string PortAgentConfig::getConfig() {
         }
         
         out << "heartbeat_interval " << m_heartbeatInterval << endl;
+        out << "pipeline_depth " << m_pipelineDepth << endl;
+        out << "reconnect_min_delay " << m_reconnectMinDelay << endl;
+        out << "reconnect_max_delay " << m_reconnectMaxDelay << endl;
+        out << "reconnect_jitter " << m_reconnectJitter << endl;
         
         buffer = m_sentinleSequence.c_str(); 
         out << "sentinle '";
@@ -433,6 +470,34 @@ string PortAgentConfig::getConfig() {
         
         out << "output_throttle " << m_outputThrottle << endl
             << "max_packet_size " << m_maxPacketSize << endl
+            << "max_quiescent_time " << m_maxQuiescentTime << endl
+            << "max_hold_time " << m_maxHoldTime << endl
+            << "data_port_batch " << m_dataPortBatch.packets << ","
+                << m_dataPortBatch.bytes << "," << m_dataPortBatch.delay << endl
+            << "command_port_batch " << m_commandPortBatch.packets << ","
+                << m_commandPortBatch.bytes << "," << m_commandPortBatch.delay << endl
+            << "telnet_sniffer_batch " << m_telnetSnifferBatch.packets << ","
+                << m_telnetSnifferBatch.bytes << "," << m_telnetSnifferBatch.delay << endl
+            << "data_log_commit " << m_dataLogCommit.delay << ","
+                << m_dataLogCommit.bytes << "," << m_dataLogCommit.sync << endl
+            << "data_log_preallocate " << m_dataLogPreallocate << endl
+            << "data_log_compress " << m_dataLogCompress << endl
+            << "data_log_retention " << m_dataLogRetention.age << ","
+                << m_dataLogRetention.bytes << endl
+            << "data_log_index " << m_dataLogIndex.packets << ","
+                << m_dataLogIndex.interval << endl
+            << "output_buffer_size " << m_outputBufferSize << endl
+            << "slow_consumer_policy ";
+
+        if(m_slowConsumerPolicy == OUTPUT_DROP_OLDEST)
+            out << "drop_oldest";
+        else if(m_slowConsumerPolicy == OUTPUT_DROP_NEWEST)
+            out << "drop_newest";
+        else if(m_slowConsumerPolicy == OUTPUT_DISCONNECT)
+            out << "disconnect";
+
+        out << endl
+            << "max_clients " << m_maxClients << endl
             << "baud " << m_baud << endl
             << "stopbits " << m_stopbits << endl
             << "databits " << m_databits << endl
@@ -451,6 +516,19 @@ string PortAgentConfig::getConfig() {
             if(m_telnetSnifferSuffix.length()) 
                 out << "telnet_sniffer_suffix " << m_telnetSnifferSuffix << endl;
         }
+
+        if(m_multicastGroup.length()) {
+            out << "multicast_group " << m_multicastGroup << endl
+                << "multicast_port " << m_multicastPort << endl
+                << "multicast_ttl " << (int)m_multicastTTL << endl;
+            if(m_multicastInterface.length())
+                out << "multicast_interface " << m_multicastInterface << endl;
+        }
+
+        if(m_sharedMemoryName.length()) {
+            out << "shared_memory_name " << m_sharedMemoryName << endl
+                << "shared_memory_size " << m_sharedMemorySize << endl;
+        }
         
     return out.str();
 }
@@ -613,7 +691,8 @@ bool PortAgentConfig::setSentinleSequence(const string &command) {
 
 /******************************************************************************
  * Method: setOutputThrottle
- * Description: Set the output throttle
+ * Description: Set the output throttle, the most instrument data packets
+ * published per second.  0 turns the throttle off.
  * Param:
  *     param - string represention of the value of the throttle.  If it is not
  *     a number the value will be set to 0.
@@ -671,6 +750,115 @@ bool PortAgentConfig::setHeartbeatInterval(const string &param) {
     return true;
 }
 
+/******************************************************************************
+ * Method: setPipelineDepth
+ * Description: Set the number of packets the instrument pipeline can queue
+ * between the reader and publisher threads.  Zero disables the pipeline and
+ * instrument data is published from the main loop.
+ * Param:
+ *     param - string represention of the depth.
+ * Return:
+ *     return true if the depth was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setPipelineDepth(const string &param) {
+    const char* v = param.c_str();
+    
+    int value = atoi(v);
+    
+    if(value == 0 && v[0] != '0') {
+        LOG(ERROR) << "invalid pipeline depth parameter, " << param;
+        return false;
+    }
+    
+    if(value < 0 || value > MAX_PIPELINE_DEPTH) {
+        LOG(ERROR) << "pipeline depth out of range, " << value;
+        return false;
+    }
+    
+    LOG(INFO) << "set pipeline depth to " << value;
+    m_pipelineDepth = value;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setReconnectMinDelay
+ * Description: Set how long to wait before the first instrument reconnect
+ * attempt after a failure.  Each further failure doubles the delay up to the
+ * max delay.
+ * Param:
+ *     param - string represention of the delay in milliseconds.
+ * Return:
+ *     return true if the delay was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setReconnectMinDelay(const string &param) {
+    const char* v = param.c_str();
+
+    int value = atoi(v);
+
+    if(value <= 0) {
+        LOG(ERROR) << "invalid reconnect min delay parameter, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set reconnect min delay to " << value;
+    m_reconnectMinDelay = value;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setReconnectMaxDelay
+ * Description: Set the longest we will wait between instrument reconnect
+ * attempts.
+ * Param:
+ *     param - string represention of the delay in milliseconds.
+ * Return:
+ *     return true if the delay was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setReconnectMaxDelay(const string &param) {
+    const char* v = param.c_str();
+
+    int value = atoi(v);
+
+    if(value <= 0) {
+        LOG(ERROR) << "invalid reconnect max delay parameter, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set reconnect max delay to " << value;
+    m_reconnectMaxDelay = value;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setReconnectJitter
+ * Description: Set how much each reconnect delay is randomized so a group of
+ * port agents don't retry in lock step.
+ * Param:
+ *     param - string represention of the jitter as a percent of the delay,
+ *     0 to 100.
+ * Return:
+ *     return true if the jitter was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setReconnectJitter(const string &param) {
+    const char* v = param.c_str();
+
+    int value = atoi(v);
+
+    if(value == 0 && v[0] != '0') {
+        LOG(ERROR) << "invalid reconnect jitter parameter, " << param;
+        return false;
+    }
+
+    if(value < 0 || value > 100) {
+        LOG(ERROR) << "reconnect jitter out of range, " << value;
+        return false;
+    }
+
+    LOG(INFO) << "set reconnect jitter to " << value;
+    m_reconnectJitter = value;
+    return true;
+}
+
 /******************************************************************************
  * Method: setObervatoryDataPort
  * Description: Set the observatory data port
@@ -892,6 +1080,312 @@ bool PortAgentConfig::setMaxPacketSize(const string &param) {
     return true;
 }
 
+/******************************************************************************
+ * Method: setMaxQuiescentTime
+ * Description: Set how long the instrument can be quiet before a partially
+ * framed record is sent anyway.
+ * Param:
+ *     param - string represention of the time in milliseconds.  0 disables
+ *     the quiescent trigger.
+ * Return:
+ *     return true if the time was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setMaxQuiescentTime(const string &param) {
+    const char* v = param.c_str();
+
+    int value = atoi(v);
+
+    if((value == 0 && v[0] != '0') || value < 0) {
+        LOG(ERROR) << "invalid max quiescent time parameter, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set max quiescent time to " << value;
+    m_maxQuiescentTime = value;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setMaxHoldTime
+ * Description: Set the longest the output throttle may hold instrument data
+ * while it waits to send.
+ * Param:
+ *     param - string represention of the time in milliseconds.
+ * Return:
+ *     return true if the time was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setMaxHoldTime(const string &param) {
+    const char* v = param.c_str();
+
+    int value = atoi(v);
+
+    if(value <= 0) {
+        LOG(ERROR) << "invalid max hold time parameter, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set max hold time to " << value;
+    m_maxHoldTime = value;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setDataPortBatch
+ * Description: Set how the driver data port batches packets.
+ * Param:
+ *     param - "packets,bytes,delay" or "off"
+ * Return:
+ *     return true if the batch policy was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setDataPortBatch(const string &param) {
+    return parseBatch(param, m_dataPortBatch);
+}
+
+/******************************************************************************
+ * Method: setCommandPortBatch
+ * Description: Set how the driver command port batches packets.
+ * Param:
+ *     param - "packets,bytes,delay" or "off"
+ * Return:
+ *     return true if the batch policy was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setCommandPortBatch(const string &param) {
+    return parseBatch(param, m_commandPortBatch);
+}
+
+/******************************************************************************
+ * Method: setTelnetSnifferBatch
+ * Description: Set how the telnet sniffer batches packets.
+ * Param:
+ *     param - "packets,bytes,delay" or "off"
+ * Return:
+ *     return true if the batch policy was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setTelnetSnifferBatch(const string &param) {
+    return parseBatch(param, m_telnetSnifferBatch);
+}
+
+/******************************************************************************
+ * Method: setDataLogCommit
+ * Description: Set how the data log group commits writes.  "off" flushes
+ * every packet as it is logged.  The policy is left alone if the param is
+ * bad.
+ * Param:
+ *     param - "delay,bytes,sync" or "off"
+ * Return:
+ *     return true if the commit policy was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setDataLogCommit(const string &param) {
+    LogCommit value;
+    char trailing;
+
+    if(param == "off" || param == "0") {
+        LOG(INFO) << "set data log group commit off";
+        m_dataLogCommit.delay = m_dataLogCommit.bytes = m_dataLogCommit.sync = 0;
+        return true;
+    }
+
+    if(param.length() == 0 || param[0] == '-' ||
+       sscanf(param.c_str(), "%u,%u,%u%c", &value.delay, &value.bytes,
+              &value.sync, &trailing) != 3) {
+        LOG(ERROR) << "invalid data log commit parameter, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set data log commit to " << value.delay << " ms, "
+              << value.bytes << " bytes, sync every " << value.sync << " ms";
+    m_dataLogCommit = value;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setDataLogPreallocate
+ * Description: Set the segment the data log is preallocated in.  Preallocated
+ * logs are written through mmap, "off" or 0 goes back to a stream.
+ * Param:
+ *     param - segment size in bytes, or "off"
+ * Return:
+ *     return true if the segment size was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setDataLogPreallocate(const string &param) {
+    const char* v = param.c_str();
+
+    int value = param == "off" ? 0 : atoi(v);
+
+    if(value < 0 || value > MAX_LOG_PREALLOCATE ||
+       (value == 0 && param != "off" && param != "0")) {
+        LOG(ERROR) << "invalid data log preallocate parameter, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set data log preallocation to " << value;
+    m_dataLogPreallocate = value;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setDataLogCompress
+ * Description: Set the gzip level rolled data logs are compressed with in
+ * the background.  "off" or 0 leaves them uncompressed.
+ * Param:
+ *     param - level 1-9, or "off"
+ * Return:
+ *     return true if the level was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setDataLogCompress(const string &param) {
+    const char* v = param.c_str();
+
+    int value = param == "off" ? 0 : atoi(v);
+
+    if(value < 0 || value > LOG_ARCHIVER_MAX_LEVEL ||
+       (value == 0 && param != "off" && param != "0")) {
+        LOG(ERROR) << "invalid data log compress parameter, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set data log compression level to " << value;
+    m_dataLogCompress = value;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setDataLogRetention
+ * Description: Set when rolled data logs are removed.  "off" keeps them
+ * all.  The policy is left alone if the param is bad.
+ * Param:
+ *     param - "age,bytes" or "off", age in seconds and 0 for no limit
+ * Return:
+ *     return true if the retention policy was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setDataLogRetention(const string &param) {
+    LogRetention value;
+    char trailing;
+
+    if(param == "off") {
+        LOG(INFO) << "set data log retention off";
+        m_dataLogRetention.age = m_dataLogRetention.bytes = 0;
+        return true;
+    }
+
+    if(param.length() == 0 || param[0] == '-' || param.find(",-") != string::npos ||
+       sscanf(param.c_str(), "%u,%" SCNu64 "%c", &value.age, &value.bytes,
+              &trailing) != 2) {
+        LOG(ERROR) << "invalid data log retention parameter, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set data log retention to " << value.age << " seconds, "
+              << value.bytes << " bytes";
+    m_dataLogRetention = value;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setDataLogIndex
+ * Description: Set how often the data log time index gets an entry.  "off"
+ * stops writing the index.  The policy is left alone if the param is bad.
+ * Param:
+ *     param - "packets,seconds" or "off"
+ * Return:
+ *     return true if the index policy was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setDataLogIndex(const string &param) {
+    LogIndexPolicy value;
+    char trailing;
+
+    if(param == "off") {
+        LOG(INFO) << "set data log index off";
+        m_dataLogIndex.packets = m_dataLogIndex.interval = 0;
+        return true;
+    }
+
+    if(param.length() == 0 || param[0] == '-' || param.find(",-") != string::npos ||
+       sscanf(param.c_str(), "%u,%u%c", &value.packets, &value.interval,
+              &trailing) != 2) {
+        LOG(ERROR) << "invalid data log index parameter, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set data log index every " << value.packets << " packets, "
+              << value.interval << " seconds";
+    m_dataLogIndex = value;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setOutputBufferSize
+ * Description: Set how much data may wait for each slow observatory client.
+ * Param:
+ *     param - string represention of the size in bytes.
+ * Return:
+ *     return true if the size was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setOutputBufferSize(const string &param) {
+    const char* v = param.c_str();
+
+    int value = atoi(v);
+
+    if(value <= 0) {
+        LOG(ERROR) << "invalid output buffer size parameter, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set output buffer size to " << value;
+    m_outputBufferSize = value;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setSlowConsumerPolicy
+ * Description: Set what happens when a client's output buffer is full.
+ * Param:
+ *     param - drop_oldest, drop_newest or disconnect
+ * Return:
+ *     return true if the policy was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setSlowConsumerPolicy(const string &param) {
+    string str = param;
+    transform(str.begin(), str.end(),str.begin(), ::tolower);
+
+    if(str == "drop_oldest")
+        m_slowConsumerPolicy = OUTPUT_DROP_OLDEST;
+    else if(str == "drop_newest")
+        m_slowConsumerPolicy = OUTPUT_DROP_NEWEST;
+    else if(str == "disconnect")
+        m_slowConsumerPolicy = OUTPUT_DISCONNECT;
+    else {
+        LOG(ERROR) << "invalid slow consumer policy, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set slow consumer policy to " << str;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setMaxClients
+ * Description: Set how many clients each observatory and telnet sniffer port
+ * serves at once.  The oldest client on a port has command authority.
+ * Param:
+ *     param - string represention of the client count.
+ * Return:
+ *     return true if the count was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setMaxClients(const string &param) {
+    const char* v = param.c_str();
+
+    int value = atoi(v);
+
+    if(value <= 0) {
+        LOG(ERROR) << "invalid max clients parameter, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set max clients to " << value;
+    m_maxClients = value;
+    return true;
+}
+
 /******************************************************************************
  * Method: setLogLevel
  * Description: Change the log level
@@ -1097,6 +1591,103 @@ bool PortAgentConfig::setTelnetSnifferPort(const string &param) {
     return true;
 }
 
+/******************************************************************************
+ * Method: setMulticastPort
+ * Description: Set the port the multicast publisher sends to
+ * Param:
+ *     param - string represention of the value of the port.  If it is not
+ *     a number the value will be set to 0.
+ * Return:
+ *     return true if the port was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setMulticastPort(const string &param) {
+    const char* v = param.c_str();
+    
+    int value = atoi(v);
+    m_multicastPort = 0;
+    
+    if(value <= 0 || value > 65535) {
+        LOG(ERROR) << "Invalid port specification, setting to 0";
+        return false;
+    }
+    
+    LOG(INFO) << "set multicast port to " << value;
+    m_multicastPort = value;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setMulticastTTL
+ * Description: Set how many hops multicast datagrams may take
+ * Param:
+ *     param - string represention of the ttl, 1 - 255
+ * Return:
+ *     return true if the ttl was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setMulticastTTL(const string &param) {
+    const char* v = param.c_str();
+
+    int value = atoi(v);
+
+    if(value <= 0 || value > 255) {
+        LOG(ERROR) << "invalid multicast ttl parameter, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set multicast ttl to " << value;
+    m_multicastTTL = value;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setSharedMemoryName
+ * Description: Set the name of the shared memory ring local consumers map.
+ * POSIX shared memory names start with a single slash, it is added if
+ * missing.
+ * Param:
+ *     param - name of the segment, e.g. /port_agent_4001
+ * Return:
+ *     return true if the name was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setSharedMemoryName(const string &param) {
+    if(param.find('/', 1) != string::npos) {
+        LOG(ERROR) << "invalid shared memory name, " << param;
+        return false;
+    }
+
+    if(param.length() && param[0] != '/')
+        m_sharedMemoryName = "/" + param;
+    else
+        m_sharedMemoryName = param;
+
+    LOG(INFO) << "set shared memory name to " << m_sharedMemoryName;
+    return true;
+}
+
+/******************************************************************************
+ * Method: setSharedMemorySize
+ * Description: Set the size in bytes of the shared memory ring
+ * Param:
+ *     param - string represention of the size, at least
+ *     SHM_RING_MIN_CAPACITY.  It is rounded up to a power of two.
+ * Return:
+ *     return true if the size was set correctly, otherwise false.
+ *****************************************************************************/
+bool PortAgentConfig::setSharedMemorySize(const string &param) {
+    const char* v = param.c_str();
+
+    int value = atoi(v);
+
+    if(value < SHM_RING_MIN_CAPACITY || value > (1 << 30)) {
+        LOG(ERROR) << "invalid shared memory size parameter, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set shared memory size to " << value;
+    m_sharedMemorySize = value;
+    return true;
+}
+
 
 /******************************************************************************
  *   PRIVATE METHODS
@@ -1235,6 +1826,9 @@ bool PortAgentConfig::processCommand(const string & command) {
     else if( command == "ping" )
         addCommand(CMD_PING);
         
+    else if( command == "get_stats" )
+        addCommand(CMD_GET_STATS);
+        
     else if( command == "shutdown" )
         addCommand(CMD_SHUTDOWN);
         
@@ -1266,7 +1860,7 @@ bool PortAgentConfig::processCommand(const string & command) {
     }
     
     else if(cmd == "output_throttle") {
-        addCommand(CMD_COMM_CONFIG_UPDATE);
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
         return setOutputThrottle(param);
     }
     
@@ -1274,11 +1868,90 @@ bool PortAgentConfig::processCommand(const string & command) {
         return setHeartbeatInterval(param);
     }
     
+    else if(cmd == "pipeline_depth") {
+        addCommand(CMD_COMM_CONFIG_UPDATE);
+        return setPipelineDepth(param);
+    }
+    
+    else if(cmd == "reconnect_min_delay") {
+        return setReconnectMinDelay(param);
+    }
+
+    else if(cmd == "reconnect_max_delay") {
+        return setReconnectMaxDelay(param);
+    }
+
+    else if(cmd == "reconnect_jitter") {
+        return setReconnectJitter(param);
+    }
+
     else if(cmd == "max_packet_size") {
         addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
         return setMaxPacketSize(param);
     }
     
+    else if(cmd == "max_quiescent_time") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setMaxQuiescentTime(param);
+    }
+
+    else if(cmd == "data_port_batch") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setDataPortBatch(param);
+    }
+
+    else if(cmd == "command_port_batch") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setCommandPortBatch(param);
+    }
+
+    else if(cmd == "telnet_sniffer_batch") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setTelnetSnifferBatch(param);
+    }
+
+    else if(cmd == "data_log_commit") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setDataLogCommit(param);
+    }
+
+    else if(cmd == "data_log_preallocate") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setDataLogPreallocate(param);
+    }
+
+    else if(cmd == "data_log_compress") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setDataLogCompress(param);
+    }
+
+    else if(cmd == "data_log_retention") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setDataLogRetention(param);
+    }
+
+    else if(cmd == "data_log_index") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setDataLogIndex(param);
+    }
+
+    else if(cmd == "output_buffer_size") {
+        return setOutputBufferSize(param);
+    }
+
+    else if(cmd == "slow_consumer_policy") {
+        return setSlowConsumerPolicy(param);
+    }
+
+    else if(cmd == "max_clients") {
+        return setMaxClients(param);
+    }
+
+    else if(cmd == "max_hold_time") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setMaxHoldTime(param);
+    }
+
     else if(cmd == "data_port") {
         addCommand(CMD_COMM_CONFIG_UPDATE);
         return setObservatoryDataPort(param);
@@ -1412,6 +2085,36 @@ bool PortAgentConfig::processCommand(const string & command) {
         return setTelnetSnifferSuffix(param);
     }
     
+    else if(cmd == "multicast_group") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setMulticastGroup(param);
+    }
+    
+    else if(cmd == "multicast_port") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setMulticastPort(param);
+    }
+    
+    else if(cmd == "multicast_ttl") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setMulticastTTL(param);
+    }
+    
+    else if(cmd == "multicast_interface") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setMulticastInterface(param);
+    }
+    
+    else if(cmd == "shared_memory_name") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setSharedMemoryName(param);
+    }
+    
+    else if(cmd == "shared_memory_size") {
+        addCommand(CMD_PUBLISHER_CONFIG_UPDATE);
+        return setSharedMemorySize(param);
+    }
+    
     // Couldn't parse this command
     else {
         LOG(ERROR) << "Failed to parse command: " << cmd;
@@ -1452,6 +2155,35 @@ bool PortAgentConfig::splitCommand(const string &raw, string & cmdResult, string
     return true;
 }
 
+/******************************************************************************
+ * Method: parseBatch()
+ * Description: Parse a publisher batch policy, "packets,bytes,delay".  "off"
+ * or "0" turns batching off.  The batch is left alone if the param is bad.
+ * Return: return true if we could successfully parse.
+ ******************************************************************************/
+bool PortAgentConfig::parseBatch(const string &param, PublisherBatch &batch) {
+    PublisherBatch value;
+    char trailing;
+
+    if(param == "off" || param == "0") {
+        LOG(INFO) << "set publisher batching off";
+        batch.packets = batch.bytes = batch.delay = 0;
+        return true;
+    }
+
+    if(param.length() == 0 || param[0] == '-' ||
+       sscanf(param.c_str(), "%u,%u,%u%c", &value.packets, &value.bytes,
+              &value.delay, &trailing) != 3) {
+        LOG(ERROR) << "invalid publisher batch parameter, " << param;
+        return false;
+    }
+
+    LOG(INFO) << "set publisher batch to " << value.packets << " packets, "
+              << value.bytes << " bytes, " << value.delay << " ms";
+    batch = value;
+    return true;
+}
+
 ObservatoryDataPorts* ObservatoryDataPorts::m_pInstance = 0;
 
 ObservatoryDataPorts::ObservatoryDataPorts() {
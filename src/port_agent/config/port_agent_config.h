@@ -20,14 +20,59 @@
 #include <list>
 #include <stdint.h>
 #include "common/log_file.h"
+#include "network/output_buffer.h"
 
 using namespace std;
+using namespace network;
 using namespace logger;
 
 #define DEFAULT_PACKET_SIZE   1024
 #define DEFAULT_BREAK_DURATION 0
 #define MAX_PACKET_SIZE       4097
 #define DEFAULT_HEARTBEAT_INTERVAL 120
+#define DEFAULT_PIPELINE_DEPTH 0
+#define MAX_PIPELINE_DEPTH    65536
+
+// Instrument reconnect backoff, delays in milliseconds
+#define DEFAULT_RECONNECT_MIN_DELAY 1000
+#define DEFAULT_RECONNECT_MAX_DELAY 60000
+#define DEFAULT_RECONNECT_JITTER    25
+
+// Flush a partial instrument record after this much silence (ms), 0 is off
+#define DEFAULT_MAX_QUIESCENT_TIME  0
+
+// Longest the output throttle holds instrument data back (ms)
+#define DEFAULT_MAX_HOLD_TIME       1000
+
+// Data port publish batching, packets, bytes and delay (ms) per write
+#define DEFAULT_DATA_BATCH_PACKETS  32
+#define DEFAULT_DATA_BATCH_BYTES    16384
+#define DEFAULT_DATA_BATCH_DELAY    5
+
+// Data log group commit, delay (ms), bytes and fdatasync interval (ms)
+#define DEFAULT_LOG_COMMIT_DELAY    1000
+#define DEFAULT_LOG_COMMIT_BYTES    65536
+#define DEFAULT_LOG_SYNC_INTERVAL   0
+
+// Data log preallocation segment in bytes, 0 writes through a stream
+#define DEFAULT_LOG_PREALLOCATE     0
+#define MAX_LOG_PREALLOCATE         (1 << 30)
+
+// Rolled data log gzip level, 0 leaves them uncompressed
+#define DEFAULT_LOG_COMPRESS        0
+
+// Data log time index, an entry every this many packets or seconds
+#define DEFAULT_LOG_INDEX_PACKETS   1000
+#define DEFAULT_LOG_INDEX_INTERVAL  1
+
+// Clients each observatory and telnet sniffer port serves at once
+#define DEFAULT_MAX_CLIENTS         8
+
+// Hops for the multicast publisher, 1 stays on the local network
+#define DEFAULT_MULTICAST_TTL       1
+
+// Size of the shared memory ring for local consumers
+#define DEFAULT_SHARED_MEMORY_SIZE  (4 * 1024 * 1024)
 
 #define BASE_FILENAME "port_agent"
 
@@ -53,7 +98,8 @@ namespace port_agent {
         CMD_PING                    = 0x00000008,
         CMD_BREAK                   = 0x00000009,
         CMD_SHUTDOWN                = 0x00000010,
-        CMD_ROTATION_INTERVAL       = 0x00000011
+        CMD_ROTATION_INTERVAL       = 0x00000011,
+        CMD_GET_STATS               = 0x00000012
     } PortAgentCommand;
     typedef list<PortAgentCommand>  CommandQueue;
     
@@ -73,6 +119,41 @@ namespace port_agent {
         TYPE_RSN               = 0x00000004
     } InstrumentConnectionType;
 
+    // When a publisher writes out batched packets.  packets of 0 or 1 means
+    // no batching, bytes of 0 means no byte limit, delay is in milliseconds.
+    typedef struct PublisherBatch
+    {
+        uint32_t packets;
+        uint32_t bytes;
+        uint32_t delay;
+    } PublisherBatch;
+
+    // When the data log commits its writes.  A delay of 0 flushes every
+    // packet, bytes of 0 means no byte limit, a sync interval of 0 never
+    // calls fdatasync.  Delay and sync are in milliseconds.
+    typedef struct LogCommit
+    {
+        uint32_t delay;
+        uint32_t bytes;
+        uint32_t sync;
+    } LogCommit;
+
+    // When rolled data logs are removed, age in seconds and the total size
+    // of the logs in bytes.  0 is no limit.
+    typedef struct LogRetention
+    {
+        uint32_t age;
+        uint64_t bytes;
+    } LogRetention;
+
+    // How often the data log time index gets an entry, every this many
+    // packets or seconds of packet time.  0 is no limit, both 0 is off.
+    typedef struct LogIndexPolicy
+    {
+        uint32_t packets;
+        uint32_t interval;
+    } LogIndexPolicy;
+
     // DHE NEW: a list of data port entries; in the future the ObservatoryDataPortEntry_T
     // can be extended to be a structure including a routing key.  Also, the fact that
     // it's a list should be abstracted, so that we can change it to a map for faster
@@ -135,7 +216,24 @@ namespace port_agent {
             bool setSentinleSequence(const string &param);
             bool setOutputThrottle(const string &param);
             bool setHeartbeatInterval(const string &param);
+            bool setPipelineDepth(const string &param);
+            bool setReconnectMinDelay(const string &param);
+            bool setReconnectMaxDelay(const string &param);
+            bool setReconnectJitter(const string &param);
             bool setMaxPacketSize(const string &param);
+            bool setMaxQuiescentTime(const string &param);
+            bool setMaxHoldTime(const string &param);
+            bool setDataPortBatch(const string &param);
+            bool setCommandPortBatch(const string &param);
+            bool setTelnetSnifferBatch(const string &param);
+            bool setDataLogCommit(const string &param);
+            bool setDataLogPreallocate(const string &param);
+            bool setDataLogCompress(const string &param);
+            bool setDataLogRetention(const string &param);
+            bool setDataLogIndex(const string &param);
+            bool setOutputBufferSize(const string &param);
+            bool setSlowConsumerPolicy(const string &param);
+            bool setMaxClients(const string &param);
             bool setLogLevel(const string &param);
             bool setDevicePath(const string &param);
             bool setBaud(const string &param);
@@ -151,6 +249,12 @@ namespace port_agent {
 			bool setTelnetSnifferPort(const string &param);
             bool setTelnetSnifferPrefix(const string &param) { m_telnetSnifferPrefix = param; return true; }
             bool setTelnetSnifferSuffix(const string &param) { m_telnetSnifferSuffix = param; return true; }
+            bool setMulticastGroup(const string &param) { m_multicastGroup = param; return true; }
+            bool setMulticastPort(const string &param);
+            bool setMulticastTTL(const string &param);
+            bool setMulticastInterface(const string &param) { m_multicastInterface = param; return true; }
+            bool setSharedMemoryName(const string &param);
+            bool setSharedMemorySize(const string &param);
             
             // Common Config
             string programName() { return m_programName; }
@@ -181,7 +285,24 @@ namespace port_agent {
             const string & sentinleSequence() { return m_sentinleSequence; }
             uint32_t outputThrottle() { return m_outputThrottle; }
             uint32_t heartbeatInterval() { return m_heartbeatInterval; }
+            uint32_t pipelineDepth() { return m_pipelineDepth; }
+            uint32_t reconnectMinDelay() { return m_reconnectMinDelay; }
+            uint32_t reconnectMaxDelay() { return m_reconnectMaxDelay; }
+            uint32_t reconnectJitter() { return m_reconnectJitter; }
             uint32_t maxPacketSize() { return m_maxPacketSize; }
+            uint32_t maxQuiescentTime() { return m_maxQuiescentTime; }
+            uint32_t maxHoldTime() { return m_maxHoldTime; }
+            const PublisherBatch & dataPortBatch() { return m_dataPortBatch; }
+            const PublisherBatch & commandPortBatch() { return m_commandPortBatch; }
+            const PublisherBatch & telnetSnifferBatch() { return m_telnetSnifferBatch; }
+            const LogCommit & dataLogCommit() { return m_dataLogCommit; }
+            uint32_t dataLogPreallocate() { return m_dataLogPreallocate; }
+            int dataLogCompress() { return m_dataLogCompress; }
+            const LogRetention & dataLogRetention() { return m_dataLogRetention; }
+            const LogIndexPolicy & dataLogIndex() { return m_dataLogIndex; }
+            uint32_t outputBufferSize() { return m_outputBufferSize; }
+            OutputPolicy slowConsumerPolicy() { return m_slowConsumerPolicy; }
+            uint32_t maxClients() { return m_maxClients; }
             
             bool    devicePathChanged() { return m_bDevicePathChanged; }
             void    clearDevicePathChanged() { m_bDevicePathChanged = false; }
@@ -204,12 +325,23 @@ namespace port_agent {
             uint16_t telnetSnifferPort() { return m_telnetSnifferPort; }
             string telnetSnifferPrefix() { return m_telnetSnifferPrefix; }
             string telnetSnifferSuffix() { return m_telnetSnifferSuffix; }
+
+            // Multicast publisher config
+            const string & multicastGroup() { return m_multicastGroup; }
+            uint16_t multicastPort() { return m_multicastPort; }
+            uint8_t multicastTTL() { return m_multicastTTL; }
+            const string & multicastInterface() { return m_multicastInterface; }
+
+            // Shared memory publisher config
+            const string & sharedMemoryName() { return m_sharedMemoryName; }
+            uint32_t sharedMemorySize() { return m_sharedMemorySize; }
             
         private:
             void setParameter(char option, char *value);
             void addCommand(PortAgentCommand command);
             bool processCommand(const string & command);
             bool splitCommand(const string & raw, string & cmdResult, string & parameter);
+            bool parseBatch(const string &param, PublisherBatch &batch);
             
             void verifyCommandLineParameters();
             
@@ -245,12 +377,31 @@ namespace port_agent {
             
             uint32_t m_outputThrottle;
             uint32_t m_maxPacketSize;
+            uint32_t m_maxQuiescentTime;
+            uint32_t m_maxHoldTime;
+
+            PublisherBatch m_dataPortBatch;
+            PublisherBatch m_commandPortBatch;
+            PublisherBatch m_telnetSnifferBatch;
+            LogCommit m_dataLogCommit;
+            uint32_t m_dataLogPreallocate;
+            int m_dataLogCompress;
+            LogRetention m_dataLogRetention;
+            LogIndexPolicy m_dataLogIndex;
+
+            uint32_t m_outputBufferSize;
+            OutputPolicy m_slowConsumerPolicy;
+            uint32_t m_maxClients;
             
             ObservatoryConnectionType m_observatoryConnectionType;
             InstrumentConnectionType m_instrumentConnectionType;
             RotationType m_eRotationInterval;
 			
             uint16_t m_heartbeatInterval;
+            uint32_t m_pipelineDepth;
+            uint32_t m_reconnectMinDelay;
+            uint32_t m_reconnectMaxDelay;
+            uint32_t m_reconnectJitter;
 			
 			bool    m_bDevicePathChanged;
             bool    m_bSerialSettingsChanged;
@@ -271,6 +422,16 @@ namespace port_agent {
 			uint16_t m_telnetSnifferPort;
 			string m_telnetSnifferPrefix;
 			string m_telnetSnifferSuffix;
+
+            // Multicast publisher config
+            string m_multicastGroup;
+            uint16_t m_multicastPort;
+            uint8_t m_multicastTTL;
+            string m_multicastInterface;
+
+            // Shared memory publisher config
+            string m_sharedMemoryName;
+            uint32_t m_sharedMemorySize;
     };
 }
 
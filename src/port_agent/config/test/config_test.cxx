@@ -158,6 +158,7 @@ TEST_F(CommonTest, Commands) {
     commands << "get_config\n";
     commands << "get_state\n";
     commands << "ping\n";
+    commands << "get_stats\n";
     commands << "break\n";
     commands << "break 1000\n";
     commands << "shutdown\n";
@@ -169,6 +170,7 @@ TEST_F(CommonTest, Commands) {
     EXPECT_EQ(config.getCommand(), CMD_GET_CONFIG);
     EXPECT_EQ(config.getCommand(), CMD_GET_STATE);
     EXPECT_EQ(config.getCommand(), CMD_PING);
+    EXPECT_EQ(config.getCommand(), CMD_GET_STATS);
     EXPECT_EQ(config.getCommand(), CMD_BREAK);
     EXPECT_EQ(config.getCommand(), CMD_SHUTDOWN);
 }
@@ -338,6 +340,66 @@ TEST_F(CommonTest, SetHeartbeatInterval) {
     EXPECT_EQ(config.heartbeatInterval(), 0);
 }
 
+/* Test setting the pipeline depth parameter */
+TEST_F(CommonTest, SetPipelineDepth) {
+    char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
+    int argc = sizeof(argv) / sizeof(char*);
+    
+    PortAgentConfig config(argc, argv);
+    
+    EXPECT_EQ(config.pipelineDepth(), DEFAULT_PIPELINE_DEPTH);
+    
+    EXPECT_TRUE(config.parse("pipeline_depth 1024"));
+    EXPECT_EQ(config.pipelineDepth(), 1024);
+    EXPECT_EQ(config.getCommand(), CMD_COMM_CONFIG_UPDATE);
+    
+    EXPECT_TRUE(config.parse("pipeline_depth 0"));
+    EXPECT_EQ(config.pipelineDepth(), 0);
+    
+    // Bad values leave the depth alone
+    EXPECT_TRUE(config.parse("pipeline_depth 16"));
+    
+    EXPECT_FALSE(config.parse("pipeline_depth -1"));
+    EXPECT_EQ(config.pipelineDepth(), 16);
+    
+    EXPECT_FALSE(config.parse("pipeline_depth ab"));
+    EXPECT_EQ(config.pipelineDepth(), 16);
+    
+    EXPECT_FALSE(config.parse("pipeline_depth 1000000"));
+    EXPECT_EQ(config.pipelineDepth(), 16);
+}
+
+/* Test setting the reconnect backoff parameters */
+TEST_F(CommonTest, SetReconnectBackoff) {
+    char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
+    int argc = sizeof(argv) / sizeof(char*);
+
+    PortAgentConfig config(argc, argv);
+
+    EXPECT_EQ(config.reconnectMinDelay(), DEFAULT_RECONNECT_MIN_DELAY);
+    EXPECT_EQ(config.reconnectMaxDelay(), DEFAULT_RECONNECT_MAX_DELAY);
+    EXPECT_EQ(config.reconnectJitter(), DEFAULT_RECONNECT_JITTER);
+
+    EXPECT_TRUE(config.parse("reconnect_min_delay 250"));
+    EXPECT_EQ(config.reconnectMinDelay(), 250);
+
+    EXPECT_TRUE(config.parse("reconnect_max_delay 5000"));
+    EXPECT_EQ(config.reconnectMaxDelay(), 5000);
+
+    EXPECT_TRUE(config.parse("reconnect_jitter 0"));
+    EXPECT_EQ(config.reconnectJitter(), 0);
+
+    // Bad values are ignored
+    EXPECT_FALSE(config.parse("reconnect_min_delay 0"));
+    EXPECT_EQ(config.reconnectMinDelay(), 250);
+
+    EXPECT_FALSE(config.parse("reconnect_max_delay ab"));
+    EXPECT_EQ(config.reconnectMaxDelay(), 5000);
+
+    EXPECT_FALSE(config.parse("reconnect_jitter 101"));
+    EXPECT_EQ(config.reconnectJitter(), 0);
+}
+
 /* Test setting the max packet size parameter */
 TEST_F(CommonTest, SetMaxPacketSize) {
     char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
@@ -373,6 +435,295 @@ TEST_F(CommonTest, SetMaxPacketSize) {
     EXPECT_EQ(config.maxPacketSize(), DEFAULT_PACKET_SIZE);
 }
 
+/* Test setting the max quiescent time parameter */
+TEST_F(CommonTest, SetMaxQuiescentTime) {
+    char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
+    int argc = sizeof(argv) / sizeof(char*);
+
+    PortAgentConfig config(argc, argv);
+
+    EXPECT_EQ(config.maxQuiescentTime(), DEFAULT_MAX_QUIESCENT_TIME);
+
+    EXPECT_TRUE(config.parse("max_quiescent_time 250"));
+    EXPECT_EQ(config.maxQuiescentTime(), 250);
+
+    // Bad values are ignored
+    EXPECT_FALSE(config.parse("max_quiescent_time -1"));
+    EXPECT_EQ(config.maxQuiescentTime(), 250);
+
+    EXPECT_FALSE(config.parse("max_quiescent_time ab"));
+    EXPECT_EQ(config.maxQuiescentTime(), 250);
+
+    EXPECT_TRUE(config.parse("max_quiescent_time 0"));
+    EXPECT_EQ(config.maxQuiescentTime(), 0);
+}
+
+/* Test setting the max hold time parameter */
+TEST_F(CommonTest, SetMaxHoldTime) {
+    char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
+    int argc = sizeof(argv) / sizeof(char*);
+
+    PortAgentConfig config(argc, argv);
+
+    EXPECT_EQ(config.maxHoldTime(), DEFAULT_MAX_HOLD_TIME);
+
+    EXPECT_TRUE(config.parse("max_hold_time 50"));
+    EXPECT_EQ(config.maxHoldTime(), 50);
+
+    // Bad values are ignored
+    EXPECT_FALSE(config.parse("max_hold_time 0"));
+    EXPECT_EQ(config.maxHoldTime(), 50);
+
+    EXPECT_FALSE(config.parse("max_hold_time ab"));
+    EXPECT_EQ(config.maxHoldTime(), 50);
+}
+
+/* Test setting the publisher batch parameters */
+TEST_F(CommonTest, SetPublisherBatch) {
+    char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
+    int argc = sizeof(argv) / sizeof(char*);
+
+    PortAgentConfig config(argc, argv);
+
+    // Only the data port batches by default
+    EXPECT_EQ(config.dataPortBatch().packets, DEFAULT_DATA_BATCH_PACKETS);
+    EXPECT_EQ(config.dataPortBatch().bytes, DEFAULT_DATA_BATCH_BYTES);
+    EXPECT_EQ(config.dataPortBatch().delay, DEFAULT_DATA_BATCH_DELAY);
+    EXPECT_EQ(config.commandPortBatch().packets, 0);
+    EXPECT_EQ(config.telnetSnifferBatch().packets, 0);
+
+    EXPECT_TRUE(config.parse("command_port_batch 8,4096,2"));
+    EXPECT_EQ(config.commandPortBatch().packets, 8);
+    EXPECT_EQ(config.commandPortBatch().bytes, 4096);
+    EXPECT_EQ(config.commandPortBatch().delay, 2);
+
+    EXPECT_TRUE(config.parse("telnet_sniffer_batch 4,0,10"));
+    EXPECT_EQ(config.telnetSnifferBatch().packets, 4);
+    EXPECT_EQ(config.telnetSnifferBatch().bytes, 0);
+    EXPECT_EQ(config.telnetSnifferBatch().delay, 10);
+
+    EXPECT_TRUE(config.parse("data_port_batch off"));
+    EXPECT_EQ(config.dataPortBatch().packets, 0);
+    EXPECT_EQ(config.dataPortBatch().delay, 0);
+
+    // Bad values are ignored
+    EXPECT_FALSE(config.parse("command_port_batch 8,4096"));
+    EXPECT_FALSE(config.parse("command_port_batch 8,4096,2x"));
+    EXPECT_FALSE(config.parse("command_port_batch -1,0,0"));
+    EXPECT_EQ(config.commandPortBatch().packets, 8);
+    EXPECT_EQ(config.commandPortBatch().delay, 2);
+}
+
+/* Test setting the slow consumer parameters */
+TEST_F(CommonTest, SetSlowConsumerPolicy) {
+    char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
+    int argc = sizeof(argv) / sizeof(char*);
+
+    PortAgentConfig config(argc, argv);
+
+    EXPECT_EQ(config.outputBufferSize(), DEFAULT_OUTPUT_BUFFER_SIZE);
+    EXPECT_EQ(config.slowConsumerPolicy(), OUTPUT_DROP_OLDEST);
+
+    EXPECT_TRUE(config.parse("output_buffer_size 65536"));
+    EXPECT_EQ(config.outputBufferSize(), 65536);
+
+    EXPECT_TRUE(config.parse("slow_consumer_policy disconnect"));
+    EXPECT_EQ(config.slowConsumerPolicy(), OUTPUT_DISCONNECT);
+
+    EXPECT_TRUE(config.parse("slow_consumer_policy DROP_NEWEST"));
+    EXPECT_EQ(config.slowConsumerPolicy(), OUTPUT_DROP_NEWEST);
+
+    // Bad values are ignored
+    EXPECT_FALSE(config.parse("output_buffer_size 0"));
+    EXPECT_EQ(config.outputBufferSize(), 65536);
+
+    EXPECT_FALSE(config.parse("slow_consumer_policy block"));
+    EXPECT_EQ(config.slowConsumerPolicy(), OUTPUT_DROP_NEWEST);
+}
+
+/* Test setting how many clients a port serves */
+TEST_F(CommonTest, SetMaxClients) {
+    char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
+    int argc = sizeof(argv) / sizeof(char*);
+
+    PortAgentConfig config(argc, argv);
+
+    EXPECT_EQ(config.maxClients(), DEFAULT_MAX_CLIENTS);
+
+    EXPECT_TRUE(config.parse("max_clients 1"));
+    EXPECT_EQ(config.maxClients(), 1);
+
+    EXPECT_TRUE(config.parse("max_clients 3"));
+    EXPECT_EQ(config.maxClients(), 3);
+
+    // Bad values are ignored
+    EXPECT_FALSE(config.parse("max_clients 0"));
+    EXPECT_FALSE(config.parse("max_clients -2"));
+    EXPECT_EQ(config.maxClients(), 3);
+}
+
+/* Test setting the multicast publisher */
+TEST_F(CommonTest, SetMulticast) {
+    char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
+    int argc = sizeof(argv) / sizeof(char*);
+
+    PortAgentConfig config(argc, argv);
+
+    EXPECT_EQ(config.multicastGroup(), "");
+    EXPECT_EQ(config.multicastPort(), 0);
+    EXPECT_EQ(config.multicastTTL(), DEFAULT_MULTICAST_TTL);
+
+    EXPECT_TRUE(config.parse("multicast_group 239.1.1.1\n"
+                             "multicast_port 5000\n"
+                             "multicast_ttl 4\n"
+                             "multicast_interface eth1"));
+    EXPECT_EQ(config.multicastGroup(), "239.1.1.1");
+    EXPECT_EQ(config.multicastPort(), 5000);
+    EXPECT_EQ(config.multicastTTL(), 4);
+    EXPECT_EQ(config.multicastInterface(), "eth1");
+
+    // Bad values are ignored
+    EXPECT_FALSE(config.parse("multicast_ttl 0"));
+    EXPECT_FALSE(config.parse("multicast_ttl 256"));
+    EXPECT_EQ(config.multicastTTL(), 4);
+
+    EXPECT_FALSE(config.parse("multicast_port 70000"));
+    EXPECT_EQ(config.multicastPort(), 0);
+}
+
+/* Test setting the data log commit policy */
+TEST_F(CommonTest, SetDataLogCommit) {
+    char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
+    int argc = sizeof(argv) / sizeof(char*);
+
+    PortAgentConfig config(argc, argv);
+
+    EXPECT_EQ(config.dataLogCommit().delay, DEFAULT_LOG_COMMIT_DELAY);
+    EXPECT_EQ(config.dataLogCommit().bytes, DEFAULT_LOG_COMMIT_BYTES);
+    EXPECT_EQ(config.dataLogCommit().sync, DEFAULT_LOG_SYNC_INTERVAL);
+
+    EXPECT_TRUE(config.parse("data_log_commit 500,4096,10000"));
+    EXPECT_EQ(config.dataLogCommit().delay, 500);
+    EXPECT_EQ(config.dataLogCommit().bytes, 4096);
+    EXPECT_EQ(config.dataLogCommit().sync, 10000);
+
+    // Bad values are ignored
+    EXPECT_FALSE(config.parse("data_log_commit 500,4096"));
+    EXPECT_FALSE(config.parse("data_log_commit -1,0,0"));
+    EXPECT_EQ(config.dataLogCommit().delay, 500);
+
+    EXPECT_TRUE(config.parse("data_log_commit off"));
+    EXPECT_EQ(config.dataLogCommit().delay, 0);
+    EXPECT_EQ(config.dataLogCommit().bytes, 0);
+    EXPECT_EQ(config.dataLogCommit().sync, 0);
+}
+
+/* Test setting the data log preallocation */
+TEST_F(CommonTest, SetDataLogPreallocate) {
+    char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
+    int argc = sizeof(argv) / sizeof(char*);
+
+    PortAgentConfig config(argc, argv);
+
+    EXPECT_EQ(config.dataLogPreallocate(), DEFAULT_LOG_PREALLOCATE);
+
+    EXPECT_TRUE(config.parse("data_log_preallocate 16777216"));
+    EXPECT_EQ(config.dataLogPreallocate(), 16777216);
+
+    // Bad values are ignored
+    EXPECT_FALSE(config.parse("data_log_preallocate -1"));
+    EXPECT_FALSE(config.parse("data_log_preallocate lots"));
+    EXPECT_EQ(config.dataLogPreallocate(), 16777216);
+
+    EXPECT_TRUE(config.parse("data_log_preallocate off"));
+    EXPECT_EQ(config.dataLogPreallocate(), 0);
+}
+
+/* Test setting the data log compression and retention */
+TEST_F(CommonTest, SetDataLogArchive) {
+    char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
+    int argc = sizeof(argv) / sizeof(char*);
+
+    PortAgentConfig config(argc, argv);
+
+    EXPECT_EQ(config.dataLogCompress(), DEFAULT_LOG_COMPRESS);
+    EXPECT_EQ(config.dataLogRetention().age, 0);
+    EXPECT_EQ(config.dataLogRetention().bytes, 0);
+
+    EXPECT_TRUE(config.parse("data_log_compress 6\n"
+                             "data_log_retention 2592000,107374182400"));
+    EXPECT_EQ(config.dataLogCompress(), 6);
+    EXPECT_EQ(config.dataLogRetention().age, 2592000);
+    EXPECT_EQ(config.dataLogRetention().bytes, 107374182400ULL);
+
+    // Bad values are ignored
+    EXPECT_FALSE(config.parse("data_log_compress 10"));
+    EXPECT_FALSE(config.parse("data_log_compress fast"));
+    EXPECT_EQ(config.dataLogCompress(), 6);
+
+    EXPECT_FALSE(config.parse("data_log_retention 3600"));
+    EXPECT_FALSE(config.parse("data_log_retention 3600,-1"));
+    EXPECT_EQ(config.dataLogRetention().age, 2592000);
+
+    EXPECT_TRUE(config.parse("data_log_compress off\n"
+                             "data_log_retention off"));
+    EXPECT_EQ(config.dataLogCompress(), 0);
+    EXPECT_EQ(config.dataLogRetention().age, 0);
+    EXPECT_EQ(config.dataLogRetention().bytes, 0);
+}
+
+/* Test setting the data log time index policy */
+TEST_F(CommonTest, SetDataLogIndex) {
+    char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
+    int argc = sizeof(argv) / sizeof(char*);
+
+    PortAgentConfig config(argc, argv);
+
+    EXPECT_EQ(config.dataLogIndex().packets, DEFAULT_LOG_INDEX_PACKETS);
+    EXPECT_EQ(config.dataLogIndex().interval, DEFAULT_LOG_INDEX_INTERVAL);
+
+    EXPECT_TRUE(config.parse("data_log_index 500,10"));
+    EXPECT_EQ(config.dataLogIndex().packets, 500);
+    EXPECT_EQ(config.dataLogIndex().interval, 10);
+
+    // Bad values are ignored
+    EXPECT_FALSE(config.parse("data_log_index 500"));
+    EXPECT_FALSE(config.parse("data_log_index 500,-1"));
+    EXPECT_FALSE(config.parse("data_log_index 500,10x"));
+    EXPECT_EQ(config.dataLogIndex().packets, 500);
+    EXPECT_EQ(config.dataLogIndex().interval, 10);
+
+    EXPECT_TRUE(config.parse("data_log_index off"));
+    EXPECT_EQ(config.dataLogIndex().packets, 0);
+    EXPECT_EQ(config.dataLogIndex().interval, 0);
+}
+
+/* Test setting the shared memory publisher parameters */
+TEST_F(CommonTest, SetSharedMemory) {
+    char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
+    int argc = sizeof(argv) / sizeof(char*);
+
+    PortAgentConfig config(argc, argv);
+
+    EXPECT_EQ(config.sharedMemoryName(), "");
+    EXPECT_EQ(config.sharedMemorySize(), DEFAULT_SHARED_MEMORY_SIZE);
+
+    EXPECT_TRUE(config.parse("shared_memory_name port_agent_4001\n"
+                             "shared_memory_size 65536"));
+    EXPECT_EQ(config.sharedMemoryName(), "/port_agent_4001");
+    EXPECT_EQ(config.sharedMemorySize(), 65536);
+
+    EXPECT_TRUE(config.parse("shared_memory_name /pa"));
+    EXPECT_EQ(config.sharedMemoryName(), "/pa");
+
+    // Bad values are ignored
+    EXPECT_FALSE(config.parse("shared_memory_name /dev/shm/pa"));
+    EXPECT_EQ(config.sharedMemoryName(), "/pa");
+
+    EXPECT_FALSE(config.parse("shared_memory_size 100"));
+    EXPECT_EQ(config.sharedMemorySize(), 65536);
+}
+
 /* Test setting the observatory data port parameter */
 TEST_F(CommonTest, SetObservatoryDataPort) {
     char* argv[] = { "port_agent_config_test", "-p", TEST_PORT };
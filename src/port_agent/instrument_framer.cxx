@@ -0,0 +1,142 @@
+/*******************************************************************************
+ * Class: InstrumentFramer
+ * Filename: instrument_framer.cxx
+ * License: Apache 2.0
+ *
+ * Cuts instrument reads into records.  See instrument_framer.h for usage.
+ ******************************************************************************/
+
+#include "instrument_framer.h"
+#include "network/timer_queue.h"
+#include "common/logger.h"
+
+using namespace std;
+using namespace packet;
+using namespace logger;
+using namespace network;
+using namespace port_agent;
+
+/******************************************************************************
+ *   PUBLIC METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ *
+ * Parameters:
+ *   maxPayloadSize - largest record, longer records are cut at this size
+ *   sentinle - sequence that ends a record, may be empty
+ *   quiescentTime - flush a partial record after this many milliseconds
+ *                   without data, 0 to only flush on the sentinle
+ * Throws:
+ *   PacketParamOutOfRange - bad max payload size
+ ******************************************************************************/
+InstrumentFramer::InstrumentFramer(uint16_t maxPayloadSize, const string &sentinle,
+                                   uint32_t quiescentTime) :
+    m_oPacket(DATA_FROM_INSTRUMENT, maxPayloadSize, 0,
+              sentinle.length() ? sentinle.c_str() : NULL, sentinle.length()),
+    m_sSentinle(sentinle), m_iMaxPayloadSize(maxPayloadSize),
+    m_iQuiescentTime(quiescentTime) {
+    m_iLastAdd = 0;
+    m_iRecords = 0;
+    m_iFlushes = 0;
+}
+
+/******************************************************************************
+ * Method: required
+ * Description: Without a sentinle or a quiescent time there is nothing to
+ * frame on and reads are published as they are.
+ ******************************************************************************/
+bool InstrumentFramer::required(const string &sentinle, uint32_t quiescentTime) {
+    return sentinle.length() || quiescentTime;
+}
+
+/******************************************************************************
+ * Method: configuredFor
+ * Description: Compare the framer settings with the current configuration.
+ ******************************************************************************/
+bool InstrumentFramer::configuredFor(uint16_t maxPayloadSize, const string &sentinle,
+                                     uint32_t quiescentTime) {
+    return m_iMaxPayloadSize == maxPayloadSize &&
+           m_sSentinle == sentinle &&
+           m_iQuiescentTime == quiescentTime;
+}
+
+/******************************************************************************
+ * Method: add
+ * Description: Add a read to the current record.  A read can finish any
+ * number of records, each one is handed back as its own packet timestamped
+ * with the read that started it.
+ *
+ * Parameters:
+ *   data - bytes read from the instrument
+ *   size - number of bytes
+ *   timestamp - when they were read
+ *   records - completed records are appended, the caller owns them
+ ******************************************************************************/
+void InstrumentFramer::add(const char *data, uint32_t size, const Timestamp &timestamp,
+                           vector<SharedPacket *> &records) {
+    uint32_t offset = 0;
+
+    while(offset < size) {
+        offset += m_oPacket.add(data + offset, size - offset, timestamp);
+
+        if(m_oPacket.readyToSend()) {
+            records.push_back(take());
+            m_iRecords++;
+        }
+    }
+
+    m_iLastAdd = TimerQueue::now();
+}
+
+/******************************************************************************
+ * Method: flushDelay
+ * Description: How long until the partial record should go out even though
+ * it isn't finished.
+ *
+ * Parameters:
+ *   now - current monotonic time in microseconds
+ * Return:
+ *   microseconds to wait, 0 if the record is due now
+ ******************************************************************************/
+uint64_t InstrumentFramer::flushDelay(uint64_t now) {
+    uint64_t quiescent = m_iQuiescentTime ? m_iQuiescentTime : FRAMER_DEFAULT_FLUSH_TIME;
+    uint64_t deadline = m_iLastAdd + quiescent * USEC_PER_MSEC;
+
+    return now >= deadline ? 0 : deadline - now;
+}
+
+/******************************************************************************
+ * Method: flush
+ * Description: Give up waiting for the rest of the record.
+ * Return:
+ *   the partial record owned by the caller, or NULL if there is none.
+ ******************************************************************************/
+SharedPacket* InstrumentFramer::flush() {
+    if(!pending())
+        return NULL;
+
+    LOG(DEBUG2) << "flush partial instrument record, size: " << m_oPacket.payloadSize();
+    m_iFlushes++;
+
+    return take();
+}
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: take
+ * Description: Copy the current record into a shared packet and start a new
+ * one.
+ ******************************************************************************/
+SharedPacket* InstrumentFramer::take() {
+    SharedPacket *packet = SharedPacket::create(DATA_FROM_INSTRUMENT, m_oPacket.timestamp(),
+                                                m_oPacket.payload(), m_oPacket.payloadSize());
+
+    m_oPacket.reset();
+
+    return packet;
+}
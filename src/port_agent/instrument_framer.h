@@ -0,0 +1,105 @@
+/*******************************************************************************
+ * Class: InstrumentFramer
+ * Filename: instrument_framer.h
+ * License: Apache 2.0
+ *
+ * Assembles instrument data into records before it is published.  Reads from
+ * the instrument come in whatever pieces the OS hands us, the framer cuts
+ * them into DATA_FROM_INSTRUMENT packets on the configured sentinle sequence,
+ * when a record reaches the max packet size, or when the instrument has been
+ * quiet for the max quiescent time.
+ *
+ * The framer has no timer of its own.  After adding data the owner asks for
+ * flushDelay() and arranges to call flush() once it has passed.  With a
+ * sentinle but no quiescent time a partial record is still flushed after
+ * FRAMER_DEFAULT_FLUSH_TIME so it can't sit in the framer forever.
+ *
+ * Framing is only needed when a sentinle or quiescent time is configured,
+ * see required().
+ *
+ * Usage:
+ *
+ * InstrumentFramer framer(1024, "\r\n", 0);
+ * vector<SharedPacket *> records;
+ *
+ * framer.add(buffer, bytesRead, ts, records);
+ * // publish and release each record
+ *
+ * if(framer.pending())
+ *     // call framer.flush() in framer.flushDelay(TimerQueue::now()) us
+ ******************************************************************************/
+
+#ifndef __INSTRUMENT_FRAMER_H_
+#define __INSTRUMENT_FRAMER_H_
+
+#include "common/timestamp.h"
+#include "packet/buffered_single_char.h"
+#include "packet/shared_packet.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace packet;
+
+// Flush a partial record after this long when only a sentinle is set (ms)
+#define FRAMER_DEFAULT_FLUSH_TIME 1000
+
+namespace port_agent {
+
+    class InstrumentFramer {
+        public:
+            InstrumentFramer(uint16_t maxPayloadSize, const string &sentinle,
+                             uint32_t quiescentTime);
+
+            // Is framing configured at all?
+            static bool required(const string &sentinle, uint32_t quiescentTime);
+
+            // Was this framer built with these settings?
+            bool configuredFor(uint16_t maxPayloadSize, const string &sentinle,
+                               uint32_t quiescentTime);
+
+            // Frame a read, completed records are appended to records
+            void add(const char *data, uint32_t size, const Timestamp &timestamp,
+                     vector<SharedPacket *> &records);
+
+            // Is a partial record waiting?
+            bool pending() { return m_oPacket.payloadSize() > 0; }
+
+            // Microseconds from now until the partial record is due
+            uint64_t flushDelay(uint64_t now);
+
+            // Take the partial record, NULL if there isn't one
+            SharedPacket* flush();
+
+            // Records completed by a sentinle or the max size, and partial
+            // records sent by flush()
+            uint64_t records() { return m_iRecords; }
+            uint64_t flushes() { return m_iFlushes; }
+
+        private:
+            InstrumentFramer(const InstrumentFramer &rhs);
+            InstrumentFramer & operator=(const InstrumentFramer &rhs);
+
+            SharedPacket* take();
+
+        /////
+        // Members
+        /////
+
+        private:
+            BufferedSingleCharPacket m_oPacket;
+            string m_sSentinle;
+            uint16_t m_iMaxPayloadSize;
+            uint32_t m_iQuiescentTime;
+
+            // Monotonic time of the last add, microseconds
+            uint64_t m_iLastAdd;
+
+            uint64_t m_iRecords;
+            uint64_t m_iFlushes;
+    };
+}
+
+#endif //__INSTRUMENT_FRAMER_H_
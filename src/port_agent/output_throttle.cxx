@@ -0,0 +1,199 @@
+/*******************************************************************************
+ * Class: OutputThrottle
+ * Filename: output_throttle.cxx
+ * License: Apache 2.0
+ *
+ * Token bucket with coalescing.  See output_throttle.h for usage.
+ ******************************************************************************/
+
+#include "output_throttle.h"
+#include "packet/packet_buffer_pool.h"
+#include "network/timer_queue.h"
+#include "common/logger.h"
+
+#include <string.h>
+
+using namespace std;
+using namespace packet;
+using namespace logger;
+using namespace network;
+using namespace port_agent;
+
+/******************************************************************************
+ *   PUBLIC METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ *
+ * Parameters:
+ *   rate - instrument data packets per second
+ *   maxHoldTime - longest a packet is held back, milliseconds
+ *   maxPacketSize - largest payload to coalesce into
+ ******************************************************************************/
+OutputThrottle::OutputThrottle(uint32_t rate, uint32_t maxHoldTime, uint16_t maxPacketSize) {
+    m_iRate = rate;
+    m_iMaxHoldTime = maxHoldTime;
+    m_iMaxPacketSize = maxPacketSize;
+
+    m_iInterval = rate ? USEC_PER_SEC / rate : 0;
+    m_iNextToken = 0;
+
+    m_pHeld = NULL;
+    m_iHeldSize = 0;
+    m_iHeldSince = 0;
+
+    m_iPacketsIn = 0;
+    m_iPacketsOut = 0;
+}
+
+/******************************************************************************
+ * Method: Destructor
+ * Description: Anything still held is dropped.  Call flush() first to keep it.
+ ******************************************************************************/
+OutputThrottle::~OutputThrottle() {
+    if(m_pHeld)
+        PacketBufferPool::release(m_pHeld);
+}
+
+/******************************************************************************
+ * Method: configuredFor
+ * Description: Compare the throttle settings with the current configuration.
+ ******************************************************************************/
+bool OutputThrottle::configuredFor(uint32_t rate, uint32_t maxHoldTime, uint16_t maxPacketSize) {
+    return m_iRate == rate &&
+           m_iMaxHoldTime == maxHoldTime &&
+           m_iMaxPacketSize == maxPacketSize;
+}
+
+/******************************************************************************
+ * Method: add
+ * Description: Publish the packet now if there is a token, otherwise hold it.
+ *
+ * Parameters:
+ *   packet - instrument data packet, the throttle takes the reference
+ *   now - current monotonic time in microseconds
+ *   ready - packets to publish are appended, the caller owns them
+ ******************************************************************************/
+void OutputThrottle::add(SharedPacket *packet, uint64_t now, vector<SharedPacket *> &ready) {
+    m_iPacketsIn++;
+
+    // Something already held has to go first to keep the data in order
+    poll(now, ready);
+
+    if(!m_pHeld && takeToken(now)) {
+        m_iPacketsOut++;
+        ready.push_back(packet);
+        return;
+    }
+
+    if(m_pHeld && m_iHeldSize + packet->payloadSize() > m_iMaxPacketSize)
+        ready.push_back(release());
+
+    // Too big to coalesce, only possible just after max_packet_size shrinks
+    if(packet->payloadSize() > m_iMaxPacketSize) {
+        m_iPacketsOut++;
+        ready.push_back(packet);
+        return;
+    }
+
+    hold(packet, now);
+}
+
+/******************************************************************************
+ * Method: poll
+ * Description: Send the held packet if a token is ready or it has been held
+ * for the max hold time.  Sending on the hold time counts as using a token so
+ * the next packet waits a full interval.
+ ******************************************************************************/
+void OutputThrottle::poll(uint64_t now, vector<SharedPacket *> &ready) {
+    if(!m_pHeld)
+        return;
+
+    if(takeToken(now))
+        ready.push_back(release());
+    else if(now >= m_iHeldSince + m_iMaxHoldTime * USEC_PER_MSEC) {
+        m_iNextToken = now + m_iInterval;
+        ready.push_back(release());
+    }
+}
+
+/******************************************************************************
+ * Method: flushDelay
+ * Description: How long until poll() will send the held packet.
+ * Return:
+ *   microseconds to wait, 0 if it is due now
+ ******************************************************************************/
+uint64_t OutputThrottle::flushDelay(uint64_t now) {
+    uint64_t deadline = m_iHeldSince + m_iMaxHoldTime * USEC_PER_MSEC;
+
+    if(m_iNextToken < deadline)
+        deadline = m_iNextToken;
+
+    return now >= deadline ? 0 : deadline - now;
+}
+
+/******************************************************************************
+ * Method: flush
+ * Description: Give up the held packet without waiting for a token.
+ * Return:
+ *   the held packet owned by the caller, or NULL if there is none.
+ ******************************************************************************/
+SharedPacket* OutputThrottle::flush() {
+    if(!m_pHeld)
+        return NULL;
+
+    return release();
+}
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: takeToken
+ * Description: Use the token if it has refilled.
+ ******************************************************************************/
+bool OutputThrottle::takeToken(uint64_t now) {
+    if(now < m_iNextToken)
+        return false;
+
+    m_iNextToken = now + m_iInterval;
+    return true;
+}
+
+/******************************************************************************
+ * Method: hold
+ * Description: Append a packet's payload to the held packet, starting one if
+ * needed, and drop the packet.
+ ******************************************************************************/
+void OutputThrottle::hold(SharedPacket *packet, uint64_t now) {
+    if(!m_pHeld) {
+        m_pHeld = PacketBufferPool::global().allocate(HEADER_SIZE + m_iMaxPacketSize);
+        m_iHeldSize = 0;
+        m_oHeldTimestamp = packet->timestamp();
+        m_iHeldSince = now;
+    }
+
+    memcpy(m_pHeld + HEADER_SIZE + m_iHeldSize, packet->payload(), packet->payloadSize());
+    m_iHeldSize += packet->payloadSize();
+
+    packet->release();
+}
+
+/******************************************************************************
+ * Method: release
+ * Description: Turn the held buffer into a packet.
+ ******************************************************************************/
+SharedPacket* OutputThrottle::release() {
+    SharedPacket *packet = SharedPacket::adopt(DATA_FROM_INSTRUMENT, m_oHeldTimestamp,
+                                               m_pHeld, m_iHeldSize);
+
+    LOG(DEBUG2) << "throttle release, size: " << m_iHeldSize;
+
+    m_pHeld = NULL;
+    m_iHeldSize = 0;
+    m_iPacketsOut++;
+
+    return packet;
+}
@@ -0,0 +1,106 @@
+/*******************************************************************************
+ * Class: OutputThrottle
+ * Filename: output_throttle.h
+ * License: Apache 2.0
+ *
+ * Limits how many instrument data packets are published per second.  This is
+ * a token bucket holding a single token that refills at the configured rate.
+ * A packet that arrives with a token available goes straight out.  Otherwise
+ * it is appended to a held packet, and consecutive chunks coalesce into one
+ * packet up to the max packet size.  The held packet goes out when the next
+ * token arrives, or when it has been held for the max hold time, whichever
+ * comes first.  Slow links get fewer, fuller packets and latency stays
+ * bounded.
+ *
+ * If a chunk doesn't fit in the held packet, the held packet goes out early
+ * rather than growing.  A throttle can't make the link faster, it only trades
+ * header overhead for latency.
+ *
+ * Like the framer, the throttle has no timer of its own.  The owner calls
+ * poll() once flushDelay() has passed.
+ *
+ * Usage:
+ *
+ * OutputThrottle throttle(10, 1000, 1024);
+ * vector<SharedPacket *> ready;
+ *
+ * throttle.add(packet, TimerQueue::now(), ready);
+ * // publish and release each ready packet
+ *
+ * if(throttle.pending())
+ *     // call throttle.poll() in throttle.flushDelay(TimerQueue::now()) us
+ ******************************************************************************/
+
+#ifndef __OUTPUT_THROTTLE_H_
+#define __OUTPUT_THROTTLE_H_
+
+#include "common/timestamp.h"
+#include "packet/shared_packet.h"
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+using namespace packet;
+
+namespace port_agent {
+
+    class OutputThrottle {
+        public:
+            OutputThrottle(uint32_t rate, uint32_t maxHoldTime, uint16_t maxPacketSize);
+            ~OutputThrottle();
+
+            // Was this throttle built with these settings?
+            bool configuredFor(uint32_t rate, uint32_t maxHoldTime, uint16_t maxPacketSize);
+
+            // Take a packet, packets ready to publish are appended to ready
+            void add(SharedPacket *packet, uint64_t now, vector<SharedPacket *> &ready);
+
+            // Release the held packet if it is due
+            void poll(uint64_t now, vector<SharedPacket *> &ready);
+
+            // Is a packet being held?
+            bool pending() { return m_pHeld != NULL; }
+
+            // Microseconds from now until the held packet is due
+            uint64_t flushDelay(uint64_t now);
+
+            // Take the held packet regardless of the rate, NULL if none
+            SharedPacket* flush();
+
+            uint64_t packetsIn() { return m_iPacketsIn; }
+            uint64_t packetsOut() { return m_iPacketsOut; }
+
+        private:
+            OutputThrottle(const OutputThrottle &rhs);
+            OutputThrottle & operator=(const OutputThrottle &rhs);
+
+            bool takeToken(uint64_t now);
+            void hold(SharedPacket *packet, uint64_t now);
+            SharedPacket* release();
+
+        /////
+        // Members
+        /////
+
+        private:
+            uint32_t m_iRate;
+            uint32_t m_iMaxHoldTime;
+            uint16_t m_iMaxPacketSize;
+
+            // Microseconds between tokens and when the next one is ready
+            uint64_t m_iInterval;
+            uint64_t m_iNextToken;
+
+            // Packet being coalesced, a pool buffer with header room
+            char *m_pHeld;
+            uint32_t m_iHeldSize;
+            Timestamp m_oHeldTimestamp;
+            uint64_t m_iHeldSince;
+
+            uint64_t m_iPacketsIn;
+            uint64_t m_iPacketsOut;
+    };
+}
+
+#endif //__OUTPUT_THROTTLE_H_
@@ -22,6 +22,7 @@
  ******************************************************************************/
 
 #include "buffered_single_char.h"
+#include "packet_buffer_pool.h"
 #include "common/logger.h"
 #include "common/util.h"
 #include "common/exception.h"
@@ -35,6 +36,7 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 using namespace std;
 using namespace packet;
@@ -53,6 +55,7 @@ BufferedSingleCharPacket::BufferedSingleCharPacket() : Packet::Packet() {
 	LOG(INFO) << "Default BufferedSingleCharPacket called";
 
     m_pSentinleSequence = NULL;
+    m_pSentinleFailure = NULL;
     m_iSentinleSize = 0;
     m_iSentinleIndex = 0;
 
@@ -102,6 +105,7 @@ BufferedSingleCharPacket::BufferedSingleCharPacket( PacketType packetType,
     
     m_tPacketType = packetType;
     m_pSentinleSequence = NULL;
+    m_pSentinleFailure = NULL;
         
     setSentinle(sentinleSequence, sentinleSequenceSize);
     setQuiescentTime(maxQuiescentTime);
@@ -123,6 +127,7 @@ BufferedSingleCharPacket::BufferedSingleCharPacket( BufferedSingleCharPacket& co
         
     LOG(DEBUG) << "BufferedSingleCharPacket copy constructor";
     m_pSentinleSequence = NULL;
+    m_pSentinleFailure = NULL;
     
     setSentinle(copy.m_pSentinleSequence, copy.m_iSentinleSize);
     setQuiescentTime(copy.m_fQuiescentTime);
@@ -135,10 +140,7 @@ BufferedSingleCharPacket::BufferedSingleCharPacket( BufferedSingleCharPacket& co
  *  data.
  ******************************************************************************/
 BufferedSingleCharPacket::~BufferedSingleCharPacket() {
-    if(m_pSentinleSequence) {
-        delete [] m_pSentinleSequence;
-        m_pSentinleSequence = NULL;
-    }
+    setSentinle(NULL, 0);
 }
 
 /******************************************************************************
@@ -151,10 +153,8 @@ BufferedSingleCharPacket::~BufferedSingleCharPacket() {
  ******************************************************************************/
 BufferedSingleCharPacket & BufferedSingleCharPacket::operator=(const BufferedSingleCharPacket &rhs) {
 
-	if(m_pSentinleSequence) {
-		delete m_pSentinleSequence;
-		m_pSentinleSequence = NULL;
-	}
+    if(this == &rhs)
+        return *this;
 
     setSentinle(rhs.m_pSentinleSequence, rhs.m_iSentinleSize);
     setQuiescentTime(rhs.m_fQuiescentTime);
@@ -210,18 +210,102 @@ void BufferedSingleCharPacket::add( char input, const Timestamp &timestamp ) {
     // First just add the data to the buffer
     m_pPacket[m_iPacketSize] = input;
     m_iPacketSize++;
+    invalidateHeader();
 
     // If we are triggering on time then set the last seen timestamp
     if(m_fQuiescentTime)
         m_oLastAddTimestamp = timestamp;
 
     // Check for a sentinle character match
-    if(m_pSentinleSequence) {
-        if(m_pSentinleSequence[m_iSentinleIndex] == input)
-            m_iSentinleIndex++;
-        else
-            m_iSentinleIndex = 0;
+    if(m_pSentinleSequence)
+        matchSentinle(input);
+}
+
+/******************************************************************************
+ * Method: add
+ * Description: Add a block of data read at one time.  Data is copied until
+ *              the packet is full or a sentinle sequence completes, whatever
+ *              is left belongs in the next packet.  All of the data shares one
+ *              timestamp, so there is no clock read per character.
+ *
+ *              Between partial matches we skip straight to the next
+ *              occurrence of the first sentinle character with memchr and
+ *              copy everything in between in one go.
+ *
+ * Parameters:
+ *   input - data to add
+ *   size - number of bytes in input
+ *   timestamp - when the data was read
+ * Return:
+ *   number of bytes consumed.  Less than size when the packet became ready
+ *   to send.
+ *
+ * Throws:
+ *
+ * PacketOverflow - the packet was already full.
+ *
+ ******************************************************************************/
+uint32_t BufferedSingleCharPacket::add(const char *input, uint32_t size,
+                                       const Timestamp &timestamp) {
+    uint32_t available = m_iMaxPayloadSize + HEADER_SIZE - packetSize();
+    uint32_t consumed = 0;
+
+    if(!size)
+        return 0;
+
+    if(!available)
+        throw PacketOverflow("boom");
+
+    if(size > available)
+        size = available;
+
+    // Set the packet time if this is our first data element
+    if(packetSize() == HEADER_SIZE)
+        m_oTimestamp = timestamp;
+
+    if(m_fQuiescentTime)
+        m_oLastAddTimestamp = timestamp;
+
+    if(!m_pSentinleSequence) {
+        consumed = size;
     }
+    else {
+        while(consumed < size) {
+            // Nothing partially matched, jump to the next possible start
+            if(m_iSentinleIndex == 0) {
+                const char *next = (const char *)memchr(input + consumed,
+                                                        m_pSentinleSequence[0],
+                                                        size - consumed);
+                if(!next) {
+                    consumed = size;
+                    break;
+                }
+
+                consumed = next - input;
+            }
+
+            if(matchSentinle(input[consumed++]))
+                break;
+        }
+    }
+
+    memcpy(m_pPacket + m_iPacketSize, input, consumed);
+    m_iPacketSize += consumed;
+    invalidateHeader();
+
+    return consumed;
+}
+
+/******************************************************************************
+ * Method: reset
+ * Description: Empty the packet so it can be filled again once it has been
+ *              sent.  Trigger settings are kept.
+ ******************************************************************************/
+void BufferedSingleCharPacket::reset() {
+    m_iPacketSize = HEADER_SIZE;
+    m_iSentinleIndex = 0;
+    m_oTimestamp.setTime(0,0);
+    invalidateHeader();
 }
 
 /******************************************************************************
@@ -284,6 +368,10 @@ void BufferedSingleCharPacket::setSentinle(const char* sentinleSequence,
     // Reset all of the sentinle parameters to nothing.
     if(m_pSentinleSequence)
         delete [] m_pSentinleSequence;
+    if(m_pSentinleFailure)
+        delete [] m_pSentinleFailure;
+    m_pSentinleSequence = NULL;
+    m_pSentinleFailure = NULL;
     m_iSentinleSize = 0;
     m_iSentinleIndex = 0;
     
@@ -291,9 +379,23 @@ void BufferedSingleCharPacket::setSentinle(const char* sentinleSequence,
     if(sentinleSequence) {
         m_iSentinleSize = sentinleSequenceSize;
         m_pSentinleSequence = new char[sentinleSequenceSize];
+        m_pSentinleFailure = new uint16_t[sentinleSequenceSize];
+
+        memcpy(m_pSentinleSequence, sentinleSequence, sentinleSequenceSize);
         
-        for(int i = 0; i < m_iSentinleSize; i++)
-            m_pSentinleSequence[i] = sentinleSequence[i];
+        // KMP failure table: m_pSentinleFailure[i] is the length of the
+        // longest proper prefix of the sequence that is also a suffix of
+        // the first i + 1 characters.
+        m_pSentinleFailure[0] = 0;
+        for(int i = 1, k = 0; i < m_iSentinleSize; i++) {
+            while(k > 0 && m_pSentinleSequence[i] != m_pSentinleSequence[k])
+                k = m_pSentinleFailure[k - 1];
+
+            if(m_pSentinleSequence[i] == m_pSentinleSequence[k])
+                k++;
+
+            m_pSentinleFailure[i] = k;
+        }
     }
 }
             
@@ -327,6 +429,29 @@ void BufferedSingleCharPacket::setQuiescentTime(float maxQuiecentTime) {
  *   PRIVATE METHODS
  ******************************************************************************/
 
+/******************************************************************************
+ * Method: matchSentinle
+ * Description: Advance the sentinle match by one character.  On a mismatch we
+ *              fall back to the longest prefix that still matches instead of
+ *              starting over, so overlapping sequences like "aab" for a
+ *              sentinle of "ab" are found.
+ * Return:
+ *   true if this character completed the sentinle sequence.
+ ******************************************************************************/
+bool BufferedSingleCharPacket::matchSentinle(char input) {
+    // Already matched, keep going as if the match was a prefix
+    if(m_iSentinleIndex == m_iSentinleSize)
+        m_iSentinleIndex = m_pSentinleFailure[m_iSentinleIndex - 1];
+
+    while(m_iSentinleIndex > 0 && m_pSentinleSequence[m_iSentinleIndex] != input)
+        m_iSentinleIndex = m_pSentinleFailure[m_iSentinleIndex - 1];
+
+    if(m_pSentinleSequence[m_iSentinleIndex] == input)
+        m_iSentinleIndex++;
+
+    return m_iSentinleIndex == m_iSentinleSize;
+}
+
 /******************************************************************************
  * Method: setMaxPayloadSize
  * Description: Set the max packet size and allocate memory for the packet buffer.
@@ -353,7 +478,8 @@ void BufferedSingleCharPacket::setMaxPayloadSize(uint16_t maxPayloadSize) {
     m_iPacketSize = HEADER_SIZE;
     
     if(m_pPacket)
-        delete [] m_pPacket;
+        PacketBufferPool::release(m_pPacket);
         
-    m_pPacket = new char[m_iPacketSize + maxPayloadSize];
+    m_pPacket = PacketBufferPool::global().allocate(m_iPacketSize + maxPayloadSize);
+    invalidateHeader();
 }
@@ -43,6 +43,23 @@
  * 
  * if(packet.readyToSend())
  *    write(packet.packet(), packet().packetSize());
+ *
+ * // Or add everything read at once.  add() stops at a completed sentinle or
+ * // a full packet and returns how much it took, the rest goes in the next
+ * // packet.
+ *
+ * char buffer[1024];
+ * int bytesRead = read(infile, buffer, sizeof(buffer));
+ * int offset = 0;
+ *
+ * while(offset < bytesRead) {
+ *     offset += packet.add(buffer + offset, bytesRead - offset, now);
+ *
+ *     if(packet.readyToSend()) {
+ *         write(packet.packet(), packet.packetSize());
+ *         packet.reset();
+ *     }
+ * }
  * 
  * Exceptions:
  *
@@ -98,6 +115,12 @@ namespace packet {
 
             // Add a character to the packet buffer
             void add(char input, const Timestamp &timestamp);
+
+            // Add a block of characters, returns the number used
+            uint32_t add(const char *input, uint32_t size, const Timestamp &timestamp);
+
+            // Empty the packet after it has been sent
+            void reset();
             
             // Overloaded readyToSend method
             bool readyToSend();
@@ -121,6 +144,9 @@ namespace packet {
             // Setup the packet buffer.  This is private because I don't want
             // people to change this after the object is instantiated. 
             void setMaxPayloadSize(uint16_t maxPayloadSize);
+
+            // Advance the sentinle match, true when it completes
+            bool matchSentinle(char input);
         
         /********************
          *      MEMBERS     *
@@ -131,6 +157,7 @@ namespace packet {
         private:
             // members for sentinle triggering
             char* m_pSentinleSequence;
+            uint16_t* m_pSentinleFailure;
             uint16_t m_iSentinleSize;
             uint16_t m_iSentinleIndex;
             
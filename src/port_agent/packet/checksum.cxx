@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * Filename: checksum.cxx
+ * License: Apache 2.0
+ *
+ * Word and vector XOR reductions.  See checksum.h for usage.
+ ******************************************************************************/
+
+#include "checksum.h"
+
+#include <string.h>
+
+#ifdef PACKET_CHECKSUM_X86
+#include <immintrin.h>
+#endif
+
+using namespace packet;
+
+typedef uint8_t (*XorFunction)(const char *buffer, uint32_t size);
+
+/******************************************************************************
+ * Method: fold
+ * Description: XOR the eight bytes of a word together.
+ ******************************************************************************/
+static inline uint8_t fold(uint64_t word) {
+    word ^= word >> 32;
+    word ^= word >> 16;
+    word ^= word >> 8;
+    return (uint8_t)word;
+}
+
+/******************************************************************************
+ * Method: xorTail
+ * Description: Byte at a time XOR for whatever is left over.
+ ******************************************************************************/
+static inline uint8_t xorTail(const char *buffer, uint32_t size) {
+    uint8_t result = 0;
+
+    for(uint32_t i = 0; i < size; i++)
+        result ^= (uint8_t)buffer[i];
+
+    return result;
+}
+
+/******************************************************************************
+ * Method: selectImplementation
+ * Description: Pick the widest implementation the CPU supports.
+ ******************************************************************************/
+static XorFunction selectImplementation() {
+#ifdef PACKET_CHECKSUM_X86
+    if(cpuHasAVX2())
+        return xorBytesAVX2;
+
+    if(cpuHasSSE2())
+        return xorBytesSSE2;
+#endif
+
+    return xorBytesScalar;
+}
+
+/******************************************************************************
+ * Method: xorBytes
+ * Description: XOR of every byte in the buffer.
+ ******************************************************************************/
+uint8_t packet::xorBytes(const char *buffer, uint32_t size) {
+    static XorFunction implementation = selectImplementation();
+
+    return implementation(buffer, size);
+}
+
+/******************************************************************************
+ * Method: xorBytesScalar
+ * Description: Eight bytes at a time.  memcpy keeps unaligned loads legal and
+ * compiles to a single load.
+ ******************************************************************************/
+uint8_t packet::xorBytesScalar(const char *buffer, uint32_t size) {
+    uint64_t accumulator = 0;
+    uint64_t word;
+    uint32_t i = 0;
+
+    for(; i + 8 <= size; i += 8) {
+        memcpy(&word, buffer + i, 8);
+        accumulator ^= word;
+    }
+
+    return fold(accumulator) ^ xorTail(buffer + i, size - i);
+}
+
+#ifdef PACKET_CHECKSUM_X86
+
+/******************************************************************************
+ * Method: cpuHasSSE2
+ ******************************************************************************/
+bool packet::cpuHasSSE2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+/******************************************************************************
+ * Method: cpuHasAVX2
+ ******************************************************************************/
+bool packet::cpuHasAVX2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+/******************************************************************************
+ * Method: xorBytesSSE2
+ * Description: Sixteen bytes at a time.
+ ******************************************************************************/
+__attribute__((target("sse2")))
+uint8_t packet::xorBytesSSE2(const char *buffer, uint32_t size) {
+    __m128i accumulator = _mm_setzero_si128();
+    uint64_t lanes[2];
+    uint32_t i = 0;
+
+    for(; i + 16 <= size; i += 16)
+        accumulator = _mm_xor_si128(accumulator,
+                                    _mm_loadu_si128((const __m128i *)(buffer + i)));
+
+    _mm_storeu_si128((__m128i *)lanes, accumulator);
+
+    return fold(lanes[0] ^ lanes[1]) ^ xorBytesScalar(buffer + i, size - i);
+}
+
+/******************************************************************************
+ * Method: xorBytesAVX2
+ * Description: Thirty two bytes at a time.
+ ******************************************************************************/
+__attribute__((target("avx2")))
+uint8_t packet::xorBytesAVX2(const char *buffer, uint32_t size) {
+    __m256i accumulator = _mm256_setzero_si256();
+    uint64_t lanes[4];
+    uint32_t i = 0;
+
+    for(; i + 32 <= size; i += 32)
+        accumulator = _mm256_xor_si256(accumulator,
+                                       _mm256_loadu_si256((const __m256i *)(buffer + i)));
+
+    _mm256_storeu_si256((__m256i *)lanes, accumulator);
+
+    return fold(lanes[0] ^ lanes[1] ^ lanes[2] ^ lanes[3]) ^
+           xorBytesScalar(buffer + i, size - i);
+}
+
+#endif
@@ -0,0 +1,44 @@
+/*******************************************************************************
+ * Filename: checksum.h
+ * License: Apache 2.0
+ *
+ * XOR of every byte in a buffer, the building block of the packet checksum.
+ * The buffer is folded a word or a vector register at a time instead of a
+ * byte at a time.  On x86 the widest implementation the CPU supports (AVX2,
+ * then SSE2) is picked the first time xorBytes is called.  Everywhere else,
+ * and on CPUs without them, a 64 bit word loop is used.  Every implementation
+ * returns exactly the same value as a byte loop.
+ *
+ * Usage:
+ *
+ * uint8_t sum = xorBytes(buffer, size);
+ ******************************************************************************/
+
+#ifndef __CHECKSUM_H_
+#define __CHECKSUM_H_
+
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PACKET_CHECKSUM_X86
+#endif
+
+namespace packet {
+
+    // XOR of size bytes starting at buffer, using the fastest implementation
+    uint8_t xorBytes(const char *buffer, uint32_t size);
+
+    // The individual implementations, exposed for testing.  Only call the
+    // vector versions if the CPU supports them.
+    uint8_t xorBytesScalar(const char *buffer, uint32_t size);
+
+#ifdef PACKET_CHECKSUM_X86
+    uint8_t xorBytesSSE2(const char *buffer, uint32_t size);
+    uint8_t xorBytesAVX2(const char *buffer, uint32_t size);
+
+    bool cpuHasSSE2();
+    bool cpuHasAVX2();
+#endif
+}
+
+#endif //__CHECKSUM_H_
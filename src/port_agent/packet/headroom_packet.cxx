@@ -0,0 +1,97 @@
+/*******************************************************************************
+ * Class: HeadroomPacket
+ * Filename: headroom_packet.cxx
+ * License: Apache 2.0
+ *
+ * A packet built in place in a caller supplied buffer.  See headroom_packet.h
+ * for usage.
+ ******************************************************************************/
+
+#include "headroom_packet.h"
+#include "common/logger.h"
+#include "common/exception.h"
+
+using namespace std;
+using namespace packet;
+using namespace logger;
+
+/******************************************************************************
+ *   PUBLIC METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ * Description: Wrap a buffer that already holds the payload after
+ * HEADER_SIZE bytes of headroom and stamp the header in place.
+ *
+ * Parameters:
+ *   packetType - type of packet.  See the PacketTypeEnum
+ *   timestamp  - Timestamp when the data was initially collected.
+ *   buffer - headroom followed by the payload
+ *   payloadSize - number of bytes in the payload
+ *   ownsBuffer - if true, buffer came from PacketBufferPool and is released
+ *                with the packet
+ * Throws:
+ *   PacketParamOutOfRange
+ ******************************************************************************/
+HeadroomPacket::HeadroomPacket(PacketType packetType, Timestamp timestamp,
+                               char *buffer, uint16_t payloadSize,
+                               bool ownsBuffer) : Packet() {
+    if(packetType == 0)
+        throw PacketParamOutOfRange("invalid packet type");
+
+    if(!buffer)
+        throw PacketParamOutOfRange("NULL packet buffer");
+
+    m_oTimestamp = timestamp;
+    m_tPacketType = packetType;
+    m_iPacketSize = HEADER_SIZE + payloadSize;
+    m_pPacket = buffer;
+    m_bOwnsBuffer = ownsBuffer;
+
+    // Write the header into the headroom, this also sets the checksum
+    packet();
+}
+
+/******************************************************************************
+ * Method: Copy Constructor
+ * Description: Deep copy, the copy owns its buffer.
+ ******************************************************************************/
+HeadroomPacket::HeadroomPacket(const HeadroomPacket &rhs) : Packet(rhs) {
+    m_bOwnsBuffer = true;
+}
+
+/******************************************************************************
+ * Method: Destructor
+ * Description: Leave the buffer alone if the caller still owns it.
+ ******************************************************************************/
+HeadroomPacket::~HeadroomPacket() {
+    if(!m_bOwnsBuffer)
+        m_pPacket = NULL;
+}
+
+/******************************************************************************
+ * Method: assignment operator
+ * Description: Deep copy rhs.  Drop our reference to a caller owned buffer
+ * first so the base class doesn't free it.
+ ******************************************************************************/
+Packet & HeadroomPacket::operator=(const Packet &rhs) {
+    if(this == &rhs)
+        return *this;
+
+    if(!m_bOwnsBuffer)
+        m_pPacket = NULL;
+
+    Packet::operator=(rhs);
+    m_bOwnsBuffer = true;
+
+    return *this;
+}
+
+/******************************************************************************
+ * Method: assignment operator
+ ******************************************************************************/
+HeadroomPacket & HeadroomPacket::operator=(const HeadroomPacket &rhs) {
+    operator=((const Packet &)rhs);
+    return *this;
+}
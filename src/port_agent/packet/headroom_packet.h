@@ -0,0 +1,83 @@
+/*******************************************************************************
+ * Class: HeadroomPacket
+ * Filename: headroom_packet.h
+ * License: Apache 2.0
+ *
+ * A packet built in a buffer the caller already has.  The caller reserves
+ * HEADER_SIZE bytes at the front of the buffer and reads the payload in right
+ * after them.  The header is stamped into the reserved bytes, so building the
+ * packet doesn't allocate or copy the payload.
+ *
+ * By default the caller still owns the buffer and it must outlive the packet.
+ * Pass ownsBuffer = true to hand over a buffer from PacketBufferPool, it is
+ * then released with the packet.  Copies of a headroom packet are ordinary
+ * deep copies and always own their buffer.
+ *
+ * Usage:
+ *
+ * char buffer[HEADER_SIZE + MAX_READ];
+ * int bytesRead = read(fd, buffer + HEADER_SIZE, MAX_READ);
+ *
+ * HeadroomPacket packet(DATA_FROM_INSTRUMENT, timestamp, buffer, bytesRead);
+ * write(out, packet.packet(), packet.packetSize());
+ *
+ * Exceptions:
+ *
+ * PacketParameterOutOfRange - raised when
+ *     - packet type is UNKNOWN
+ *     - buffer is NULL
+ *
+ ******************************************************************************/
+
+#ifndef __HEADROOM_PACKET_H_
+#define __HEADROOM_PACKET_H_
+
+#include "common/timestamp.h"
+#include "packet.h"
+
+#include <stdint.h>
+
+using namespace std;
+
+namespace packet {
+    class HeadroomPacket : public Packet {
+        /********************
+         *      METHODS     *
+         ********************/
+
+        public:
+            // Constructor.  buffer must have HEADER_SIZE bytes of headroom
+            // followed by payloadSize bytes of payload.
+            HeadroomPacket(PacketType packetType, Timestamp timestamp,
+                           char *buffer, uint16_t payloadSize,
+                           bool ownsBuffer = false);
+
+            // Copy Constructor.
+            HeadroomPacket(const HeadroomPacket &rhs);
+
+            // Destructor
+            virtual ~HeadroomPacket();
+
+            // overloaded assignment
+            virtual Packet & operator=(const Packet &rhs);
+            HeadroomPacket & operator=(const HeadroomPacket &rhs);
+
+            // Will the buffer be freed with the packet?
+            bool ownsBuffer() { return m_bOwnsBuffer; }
+
+        protected:
+
+        private:
+
+        /********************
+         *      MEMBERS     *
+         ********************/
+
+        protected:
+
+        private:
+            bool m_bOwnsBuffer;
+    };
+}
+
+#endif //__HEADROOM_PACKET_H_
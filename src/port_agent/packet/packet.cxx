@@ -31,6 +31,8 @@
  ******************************************************************************/
 
 #include "packet.h"
+#include "packet_buffer_pool.h"
+#include "checksum.h"
 #include "common/util.h"
 #include "common/logger.h"
 #include "common/exception.h"
@@ -65,6 +67,7 @@ Packet::Packet() {
     m_iPacketSize = 0;
     m_iChecksum = 0;
     m_pPacket = NULL;
+    m_bHeaderValid = false;
 }
 
 /******************************************************************************
@@ -98,20 +101,20 @@ Packet::Packet(PacketType packetType, Timestamp timestamp,
     m_oTimestamp = timestamp;
     m_tPacketType = packetType;
     m_iPacketSize = HEADER_SIZE + payloadSize;
-    m_pPacket = new char[m_iPacketSize];
+    m_pPacket = PacketBufferPool::global().allocate(m_iPacketSize);
     
     LOG(DEBUG1) << "Setting packet header info";
     
     if(payload) {
         LOG(DEBUG1) << "Deep copy packet payload, size: " << m_iPacketSize;
         // Deep copy the data
-        for(int i = HEADER_SIZE; i < m_iPacketSize; i++)
-            m_pPacket[i] = payload[i-HEADER_SIZE];
+        memcpy(m_pPacket + HEADER_SIZE, payload, payloadSize);
     }
     
     LOG(DEBUG1) << "Deep copy complete";
     
-    m_iChecksum = calculateChecksum();
+    m_bHeaderValid = false;
+    packet();
 }
 
 /******************************************************************************
@@ -136,7 +139,7 @@ Packet::Packet(const Packet& rhs) {
 Packet::~Packet() {
 	LOG(DEBUG) << "Packet DTOR";
     if( m_pPacket ) {
-        delete [] m_pPacket;
+        PacketBufferPool::release(m_pPacket);
         m_pPacket = NULL;
     }
 	LOG(DEBUG) << "Packet DTOR exit";
@@ -152,8 +155,11 @@ Packet::~Packet() {
  ******************************************************************************/
 Packet & Packet::operator=(const Packet &rhs) {
 
+	if(this == &rhs)
+		return *this;
+
 	if(m_pPacket) {
-		delete m_pPacket;
+		PacketBufferPool::release(m_pPacket);
 		m_pPacket = NULL;
 	}
 
@@ -176,13 +182,15 @@ void Packet::copy(const Packet &copy) {
     m_iPacketSize = copy.m_iPacketSize;
     m_iChecksum = copy.m_iChecksum;
 
-    // Deep copy the payload
+    // Deep copy the whole buffer, header included, so a stamped header
+    // doesn't need to be redone.
     if(copy.m_pPacket) {
-        m_pPacket = new char[packetSize()];
-        for(int i = HEADER_SIZE; i < packetSize(); i++)
-            m_pPacket[i] = copy.m_pPacket[i];
+        m_pPacket = PacketBufferPool::global().allocate(packetSize());
+        memcpy(m_pPacket, copy.m_pPacket, packetSize());
+        m_bHeaderValid = copy.m_bHeaderValid;
     } else {
     	m_pPacket = NULL;
+    	m_bHeaderValid = false;
     }
 }
 
@@ -284,7 +292,9 @@ string Packet::pretty() {
 
 /******************************************************************************
  * Method: packet
- * Description: Reconstruct the packet header in the buffer.
+ * Description: Reconstruct the packet header in the buffer.  This is only
+ * done when the packet has changed since the last call, so publishing a
+ * packet to many publishers calculates the checksum once.
  *
  * Make sure we have converted everything to big-endian!
  *
@@ -299,19 +309,17 @@ char* Packet::packet() {
     uint16_t size = htons(m_iPacketSize);
     uint16_t checksum = 0;
 
-    if(m_pPacket) {
+    if(m_pPacket && !m_bHeaderValid) {
         memcpy(m_pPacket, &sync, 3);
         m_pPacket[3] = m_tPacketType;
         memcpy(m_pPacket + 4, &size, 2);
         memcpy(m_pPacket + 8, &ts, 8);
 
-        // For the base class recalculating the checksum may be a waste of time,
-        // but for most mutable packets it's a requirements.  Since we likely
-        // won't use the base packet in production taking the cycle hit seems worth
-        // missing a recalculation in derived classes.
         m_iChecksum = calculateChecksum();
         checksum = htons(m_iChecksum);
         memcpy(m_pPacket + 6, &checksum, 2);
+
+        m_bHeaderValid = true;
     }
     
     return m_pPacket;
@@ -324,7 +332,10 @@ char* Packet::packet() {
 
 /******************************************************************************
  * Method: calculateChecksum
- * Description: calculate the checksum of the current packet buffer.
+ * Description: calculate the checksum of the current packet buffer.  The
+ * checksum is the XOR of every byte except the checksum field itself.  XOR
+ * the whole buffer and then XOR the checksum field back out, that way the
+ * fast path has no branches.
  *    TODO: Identify a good checksum algorithm to use.
  *
  * Return:
@@ -337,13 +348,12 @@ uint16_t Packet::calculateChecksum() {
     if(m_pPacket) {
         LOG(DEBUG2) << "Calculating check sum";
     
-        for(int i = 0; i < packetSize(); i++) {
-        	// Make sure we ignore the part of the buffer where we store the
-        	// checksum value.
-        	if(i < 6 || i > 7) {
-                    checksum = checksum ^ byteToUnsignedInt(m_pPacket[i]);
-                }
-        }
+        checksum = xorBytes(m_pPacket, packetSize());
+
+        // Make sure we ignore the part of the buffer where we store the
+        // checksum value.
+        for(int i = 6; i < 8 && i < packetSize(); i++)
+            checksum ^= byteToUnsignedInt(m_pPacket[i]);
     }
         
     LOG(DEBUG2) << "Checksum: " << checksum;
@@ -31,6 +31,10 @@
  *
  * if(packet.readyToSend())
  *    write(packet.packet(), packet().packetSize());
+ *
+ * The header and checksum are written into the buffer the first time packet()
+ * is called and reused after that.  Derived classes that change the buffer
+ * must call invalidateHeader().
  *    
  ******************************************************************************/
 
@@ -98,6 +102,9 @@ namespace packet {
             // overloaded for buffered packets.
             virtual bool readyToSend() { return true; }
 
+            // Is this a reference counted SharedPacket?
+            virtual bool shared() { return false; }
+
             // Convert a PacketType to a string representation
             string typeToString(PacketType type);
         protected:
@@ -105,6 +112,10 @@ namespace packet {
             // Calculate a checksum of the packet buffer.
             virtual uint16_t calculateChecksum();
 
+            // The buffer changed, restamp the header and checksum next time
+            // packet() is called.
+            void invalidateHeader() { m_bHeaderValid = false; }
+
             // deep copy a packet object
             virtual void copy(const Packet &copy);
 
@@ -128,6 +139,9 @@ namespace packet {
             Timestamp m_oTimestamp;
             char *m_pPacket;
 
+            // Header and checksum in m_pPacket are up to date
+            bool m_bHeaderValid;
+
     };
 }
 
@@ -0,0 +1,255 @@
+/*******************************************************************************
+ * Class: PacketBufferPool
+ * Filename: packet_buffer_pool.cxx
+ * License: Apache 2.0
+ *
+ * Size classed packet buffer pool.  See packet_buffer_pool.h for usage.
+ ******************************************************************************/
+
+#include "packet_buffer_pool.h"
+#include "common/logger.h"
+
+#include <sstream>
+
+using namespace std;
+using namespace packet;
+using namespace logger;
+
+// Marks a buffer as ours so a stray pointer passed to release() is caught
+#define PACKET_POOL_MAGIC 0x50425546
+
+typedef struct BufferPrefix
+{
+    PacketBufferPool *pool;
+    uint32_t sizeClass;
+    uint32_t magic;
+} BufferPrefix;
+
+/******************************************************************************
+ *   PUBLIC METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ ******************************************************************************/
+PacketBufferPool::PacketBufferPool() {
+    for(int i = 0; i < PACKET_POOL_CLASSES; i++) {
+        m_iCreated[i] = 0;
+        m_iInUse[i] = 0;
+        m_iHighWater[i] = 0;
+    }
+
+    m_iHeapAllocations = 0;
+    m_iOversize = 0;
+}
+
+/******************************************************************************
+ * Method: Destructor
+ * Description: Free the idle buffers.  Buffers still held by packets must
+ * not be released after the pool is gone.
+ ******************************************************************************/
+PacketBufferPool::~PacketBufferPool() {
+    for(int i = 0; i < PACKET_POOL_CLASSES; i++) {
+        for(size_t j = 0; j < m_oFree[i].size(); j++)
+            delete [] m_oFree[i][j];
+
+        m_oFree[i].clear();
+    }
+}
+
+/******************************************************************************
+ * Method: global
+ * Description: The pool all packets allocate from.  It is never destroyed so
+ * packets that outlive main() can still release their buffers.
+ ******************************************************************************/
+PacketBufferPool & PacketBufferPool::global() {
+    static PacketBufferPool *pool = new PacketBufferPool();
+    return *pool;
+}
+
+/******************************************************************************
+ * Method: classSize
+ * Description: Usable bytes in each buffer of a size class.
+ ******************************************************************************/
+uint32_t PacketBufferPool::classSize(uint32_t sizeClass) {
+    return 1 << (PACKET_POOL_MIN_SHIFT + sizeClass);
+}
+
+/******************************************************************************
+ * Method: classFor
+ * Description: Smallest size class that holds size bytes.
+ * Return:
+ *   size class, or PACKET_POOL_CLASSES if size is bigger than every class.
+ ******************************************************************************/
+uint32_t PacketBufferPool::classFor(uint32_t size) {
+    uint32_t sizeClass = 0;
+
+    while(sizeClass < PACKET_POOL_CLASSES && classSize(sizeClass) < size)
+        sizeClass++;
+
+    return sizeClass;
+}
+
+/******************************************************************************
+ * Method: allocate
+ * Description: Get a buffer of at least size bytes.  Only goes to the heap if
+ * the free list for the size class is empty.
+ *
+ * Parameters:
+ *   size - bytes needed
+ * Return:
+ *   pointer to the buffer, give it back with release().
+ ******************************************************************************/
+char* PacketBufferPool::allocate(uint32_t size) {
+    uint32_t sizeClass = classFor(size);
+    BufferPrefix *prefix;
+    char *raw;
+
+    {
+        MutexLock lock(m_oLock);
+
+        if(sizeClass == PACKET_POOL_CLASSES) {
+            m_iOversize++;
+            m_iHeapAllocations++;
+            raw = new char[PACKET_POOL_PREFIX + size];
+        }
+        else {
+            if(m_oFree[sizeClass].empty()) {
+                m_iCreated[sizeClass]++;
+                m_iHeapAllocations++;
+                raw = new char[PACKET_POOL_PREFIX + classSize(sizeClass)];
+
+                // Room to hand back every buffer without growing the list
+                m_oFree[sizeClass].reserve(m_iCreated[sizeClass]);
+            }
+            else {
+                raw = m_oFree[sizeClass].back();
+                m_oFree[sizeClass].pop_back();
+            }
+
+            m_iInUse[sizeClass]++;
+            if(m_iInUse[sizeClass] > m_iHighWater[sizeClass])
+                m_iHighWater[sizeClass] = m_iInUse[sizeClass];
+        }
+    }
+
+    prefix = (BufferPrefix *)raw;
+    prefix->pool = this;
+    prefix->sizeClass = sizeClass;
+    prefix->magic = PACKET_POOL_MAGIC;
+
+    return raw + PACKET_POOL_PREFIX;
+}
+
+/******************************************************************************
+ * Method: release
+ * Description: Give a buffer back to the pool it came from.  NULL is ignored.
+ ******************************************************************************/
+void PacketBufferPool::release(char *buffer) {
+    BufferPrefix *prefix;
+    char *raw;
+
+    if(!buffer)
+        return;
+
+    raw = buffer - PACKET_POOL_PREFIX;
+    prefix = (BufferPrefix *)raw;
+
+    if(prefix->magic != PACKET_POOL_MAGIC || !prefix->pool) {
+        LOG(ERROR) << "release of a buffer that isn't from a packet pool";
+        return;
+    }
+
+    prefix->magic = 0;
+    prefix->pool->put(raw, prefix->sizeClass);
+}
+
+/******************************************************************************
+ * Method: reserve
+ * Description: Pre-allocate buffers so at least count buffers of the size
+ * class for size exist, in use or free.
+ ******************************************************************************/
+void PacketBufferPool::reserve(uint32_t size, uint32_t count) {
+    uint32_t sizeClass = classFor(size);
+    MutexLock lock(m_oLock);
+
+    if(sizeClass == PACKET_POOL_CLASSES)
+        return;
+
+    m_oFree[sizeClass].reserve(count);
+
+    while(m_iCreated[sizeClass] < count) {
+        m_oFree[sizeClass].push_back(new char[PACKET_POOL_PREFIX + classSize(sizeClass)]);
+        m_iCreated[sizeClass]++;
+        m_iHeapAllocations++;
+    }
+}
+
+/******************************************************************************
+ * Method: stats
+ * Description: Snapshot of the pool counters.
+ ******************************************************************************/
+PoolStats PacketBufferPool::stats() {
+    MutexLock lock(m_oLock);
+    PoolStats result;
+
+    for(int i = 0; i < PACKET_POOL_CLASSES; i++) {
+        result.classes[i].size = classSize(i);
+        result.classes[i].created = m_iCreated[i];
+        result.classes[i].free = m_oFree[i].size();
+        result.classes[i].inUse = m_iInUse[i];
+        result.classes[i].highWater = m_iHighWater[i];
+    }
+
+    result.heapAllocations = m_iHeapAllocations;
+    result.oversize = m_iOversize;
+
+    return result;
+}
+
+/******************************************************************************
+ * Method: statsAsString
+ * Description: Counters formatted for a status packet.  Only size classes
+ * that have been used are listed.
+ ******************************************************************************/
+string PacketBufferPool::statsAsString() {
+    PoolStats current = stats();
+    ostringstream out;
+
+    for(int i = 0; i < PACKET_POOL_CLASSES; i++) {
+        PoolClassStats &sizeClass = current.classes[i];
+
+        if(!sizeClass.created)
+            continue;
+
+        out << "packet_pool_" << sizeClass.size << "_created " << sizeClass.created << endl
+            << "packet_pool_" << sizeClass.size << "_in_use " << sizeClass.inUse << endl
+            << "packet_pool_" << sizeClass.size << "_high_water " << sizeClass.highWater << endl;
+    }
+
+    out << "packet_pool_heap_allocations " << current.heapAllocations << endl
+        << "packet_pool_oversize " << current.oversize << endl;
+
+    return out.str();
+}
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: put
+ * Description: Return a raw buffer to its free list.  Oversize buffers go
+ * back to the heap.
+ ******************************************************************************/
+void PacketBufferPool::put(char *raw, uint32_t sizeClass) {
+    if(sizeClass >= PACKET_POOL_CLASSES) {
+        delete [] raw;
+        return;
+    }
+
+    MutexLock lock(m_oLock);
+
+    m_iInUse[sizeClass]--;
+    m_oFree[sizeClass].push_back(raw);
+}
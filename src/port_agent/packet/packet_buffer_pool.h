@@ -0,0 +1,122 @@
+/*******************************************************************************
+ * Class: PacketBufferPool
+ * Filename: packet_buffer_pool.h
+ * License: Apache 2.0
+ *
+ * Recycles packet buffers so the packet hot path doesn't go to the heap.
+ * Buffers come in power of two size classes from 64 bytes to 64 KiB.  A
+ * request is rounded up to the smallest class that fits and served from that
+ * class's free list.  The heap is only used when the free list is empty, so
+ * once a running agent has seen its peak load its footprint stops growing.
+ * Released buffers are kept for reuse, never freed.
+ *
+ * Every buffer carries a small prefix recording its pool and size class, so
+ * release() only needs the buffer pointer.  Requests bigger than the largest
+ * class are allocated from the heap and freed on release.
+ *
+ * All packets draw from the pool returned by global().  The pool is shared by
+ * the main loop and the pipeline threads so every call takes a lock.
+ *
+ * Usage:
+ *
+ * // Make sure 32 buffers of at least 4 KiB exist before we need them
+ * PacketBufferPool::global().reserve(4096, 32);
+ *
+ * char *buffer = PacketBufferPool::global().allocate(size);
+ * ...
+ * PacketBufferPool::release(buffer);
+ ******************************************************************************/
+
+#ifndef __PACKET_BUFFER_POOL_H_
+#define __PACKET_BUFFER_POOL_H_
+
+#include "common/mutex.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Smallest class is 1 << PACKET_POOL_MIN_SHIFT bytes, each class doubles
+#define PACKET_POOL_MIN_SHIFT   6
+#define PACKET_POOL_CLASSES     11
+
+// Bytes in front of each buffer holding the pool and size class.  Keeps the
+// buffer itself 16 byte aligned.
+#define PACKET_POOL_PREFIX      16
+
+using namespace std;
+
+namespace packet {
+
+    typedef struct PoolClassStats
+    {
+        uint32_t size;
+        uint32_t created;
+        uint32_t free;
+        uint32_t inUse;
+        uint32_t highWater;
+    } PoolClassStats;
+
+    typedef struct PoolStats
+    {
+        PoolClassStats classes[PACKET_POOL_CLASSES];
+        uint64_t heapAllocations;
+        uint64_t oversize;
+    } PoolStats;
+
+    class PacketBufferPool {
+        /********************
+         *      METHODS     *
+         ********************/
+
+        public:
+            ///////////////////////
+            // Public Methods
+            PacketBufferPool();
+            virtual ~PacketBufferPool();
+
+            // The pool packets allocate from
+            static PacketBufferPool & global();
+
+            // Size of the buffers in a class, and the class for a size
+            static uint32_t classSize(uint32_t sizeClass);
+            static uint32_t classFor(uint32_t size);
+
+            /* Commands */
+            char* allocate(uint32_t size);
+            static void release(char *buffer);
+
+            void reserve(uint32_t size, uint32_t count);
+
+            /* Accessors */
+            PoolStats stats();
+            string statsAsString();
+
+        protected:
+
+        private:
+            PacketBufferPool(const PacketBufferPool &rhs);
+            PacketBufferPool & operator=(const PacketBufferPool &rhs);
+
+            void put(char *raw, uint32_t sizeClass);
+
+        /********************
+         *      MEMBERS     *
+         ********************/
+
+        protected:
+
+        private:
+            Mutex m_oLock;
+
+            vector<char *> m_oFree[PACKET_POOL_CLASSES];
+            uint32_t m_iCreated[PACKET_POOL_CLASSES];
+            uint32_t m_iInUse[PACKET_POOL_CLASSES];
+            uint32_t m_iHighWater[PACKET_POOL_CLASSES];
+
+            uint64_t m_iHeapAllocations;
+            uint64_t m_iOversize;
+    };
+}
+
+#endif //__PACKET_BUFFER_POOL_H_
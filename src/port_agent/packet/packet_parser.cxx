@@ -0,0 +1,358 @@
+/*******************************************************************************
+ * Class: PacketParser
+ * Filename: packet_parser.cxx
+ * License: Apache 2.0
+ *
+ * Streaming deframer with a vector sync scan.  See packet_parser.h for usage.
+ ******************************************************************************/
+
+#include "packet_parser.h"
+#include "checksum.h"
+#include "common/logger.h"
+#include "common/exception.h"
+
+#include <arpa/inet.h>
+#include <string.h>
+
+#ifdef PACKET_CHECKSUM_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace packet;
+using namespace logger;
+
+typedef uint32_t (*FindSyncFunction)(const char *buffer, uint32_t size);
+
+static const uint8_t SYNC_0 = (SYNC >> 16) & 0xFF;
+static const uint8_t SYNC_1 = (SYNC >> 8) & 0xFF;
+static const uint8_t SYNC_2 = SYNC & 0xFF;
+
+/******************************************************************************
+ * Method: selectImplementation
+ * Description: Pick the vector scan if the CPU supports it.
+ ******************************************************************************/
+static FindSyncFunction selectImplementation() {
+#ifdef PACKET_CHECKSUM_X86
+    if(cpuHasSSE2())
+        return findSyncSSE2;
+#endif
+
+    return findSyncScalar;
+}
+
+/******************************************************************************
+ * Method: syncPrefix
+ * Description: How many bytes at the end of the buffer could be the start of
+ * a SYNC sequence that continues in the next chunk.
+ ******************************************************************************/
+static uint32_t syncPrefix(const char *buffer, uint32_t size) {
+    if(size >= 2 && (uint8_t)buffer[size - 2] == SYNC_0 &&
+                    (uint8_t)buffer[size - 1] == SYNC_1)
+        return 2;
+
+    if(size >= 1 && (uint8_t)buffer[size - 1] == SYNC_0)
+        return 1;
+
+    return 0;
+}
+
+/******************************************************************************
+ * Method: readUint32
+ * Description: Big-endian 32 bit value from an unaligned buffer.
+ ******************************************************************************/
+static inline uint32_t readUint32(const char *buffer) {
+    uint32_t value;
+    memcpy(&value, buffer, 4);
+    return ntohl(value);
+}
+
+/******************************************************************************
+ * Method: findSync
+ * Description: Find the first SYNC sequence in the buffer.
+ * Return:
+ *   offset of the sequence, or size if there isn't a complete one
+ ******************************************************************************/
+uint32_t packet::findSync(const char *buffer, uint32_t size) {
+    static FindSyncFunction implementation = selectImplementation();
+
+    return implementation(buffer, size);
+}
+
+/******************************************************************************
+ * Method: findSyncScalar
+ * Description: memchr for the first sync byte, then check the other two.
+ * memchr is already vectorized in most C libraries and the first byte is rare
+ * in most data.
+ ******************************************************************************/
+uint32_t packet::findSyncScalar(const char *buffer, uint32_t size) {
+    const char *end = buffer + size;
+    const char *next = buffer;
+
+    while(end - next >= 3) {
+        next = (const char *)memchr(next, SYNC_0, end - next - 2);
+        if(!next)
+            break;
+
+        if((uint8_t)next[1] == SYNC_1 && (uint8_t)next[2] == SYNC_2)
+            return next - buffer;
+
+        next++;
+    }
+
+    return size;
+}
+
+#ifdef PACKET_CHECKSUM_X86
+
+/******************************************************************************
+ * Method: findSyncSSE2
+ * Description: Sixteen candidate offsets at a time.  Compare three
+ * overlapping loads against the three sync bytes and AND the results, so a
+ * lone first byte in binary data doesn't drop out of the vector loop.
+ ******************************************************************************/
+__attribute__((target("sse2")))
+uint32_t packet::findSyncSSE2(const char *buffer, uint32_t size) {
+    const __m128i sync0 = _mm_set1_epi8((char)SYNC_0);
+    const __m128i sync1 = _mm_set1_epi8((char)SYNC_1);
+    const __m128i sync2 = _mm_set1_epi8((char)SYNC_2);
+    uint32_t i = 0;
+
+    for(; i + 18 <= size; i += 16) {
+        __m128i match = _mm_and_si128(
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buffer + i)), sync0),
+            _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buffer + i + 1)), sync1),
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buffer + i + 2)), sync2)));
+
+        int mask = _mm_movemask_epi8(match);
+        if(mask)
+            return i + __builtin_ctz(mask);
+    }
+
+    return i + findSyncScalar(buffer + i, size - i);
+}
+
+#endif
+
+/******************************************************************************
+ *   PUBLIC METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ *
+ * Parameters:
+ *   maxPacketSize - largest packet, header included, to accept.  A candidate
+ *                   claiming to be bigger is rejected without waiting for it.
+ ******************************************************************************/
+PacketParser::PacketParser(uint16_t maxPacketSize) {
+    m_iMaxPacketSize = maxPacketSize < HEADER_SIZE ? HEADER_SIZE : maxPacketSize;
+
+    m_pChunk = NULL;
+    m_iChunkSize = 0;
+    m_iChunkOffset = 0;
+
+    // A partial packet plus up to one packet's worth of the next chunk
+    m_pCarry = new char[2 * m_iMaxPacketSize];
+    m_iCarrySize = 0;
+    m_iCarryOffset = 0;
+    m_iCarryBoundary = 0;
+
+    m_iPackets = 0;
+    m_iHeaderErrors = 0;
+    m_iChecksumErrors = 0;
+    m_iBytesDiscarded = 0;
+}
+
+/******************************************************************************
+ * Method: Destructor
+ ******************************************************************************/
+PacketParser::~PacketParser() {
+    delete [] m_pCarry;
+}
+
+/******************************************************************************
+ * Method: add
+ * Description: Take the next chunk of the stream.  The chunk isn't copied,
+ * except for the start of it when a partial packet is held over.  That copy
+ * is at most one max size packet, enough to finish any packet that started
+ * in an earlier chunk.
+ *
+ * Parameters:
+ *   buffer - stream data, must stay valid until next() returns false
+ *   size - bytes in the buffer
+ ******************************************************************************/
+void PacketParser::add(const char *buffer, uint32_t size) {
+    if(m_iChunkOffset < m_iChunkSize)
+        throw PacketParamOutOfRange("add before the last chunk was parsed");
+
+    m_pChunk = buffer;
+    m_iChunkSize = size;
+    m_iChunkOffset = 0;
+
+    if(m_iCarrySize) {
+        uint32_t copy = size < m_iMaxPacketSize ? size : m_iMaxPacketSize;
+
+        m_iCarryBoundary = m_iCarrySize;
+        memcpy(m_pCarry + m_iCarrySize, buffer, copy);
+        m_iCarrySize += copy;
+    }
+}
+
+/******************************************************************************
+ * Method: next
+ * Description: Find the next complete packet.  Work through the held over
+ * data first, then go back to parsing the chunk in place.
+ *
+ * Parameters:
+ *   view - set to the packet when one is found
+ * Return:
+ *   true if a packet was found, false if more data is needed
+ ******************************************************************************/
+bool PacketParser::next(PacketView &view) {
+    while(true) {
+        if(m_iCarrySize) {
+            ParseResult result = parse(m_pCarry, m_iCarrySize, m_iCarryOffset,
+                                       m_iCarryBoundary, view);
+
+            if(result == PARSE_PACKET)
+                return true;
+
+            if(result == PARSE_LIMIT) {
+                // Past the held over bytes, carry on in the chunk itself
+                m_iChunkOffset = m_iCarryOffset - m_iCarryBoundary;
+                m_iCarrySize = m_iCarryOffset = m_iCarryBoundary = 0;
+                continue;
+            }
+
+            // Still incomplete, so the whole chunk was copied in
+            m_iChunkOffset = m_iChunkSize;
+            keep(m_pCarry + m_iCarryOffset, m_iCarrySize - m_iCarryOffset);
+            return false;
+        }
+
+        if(m_iChunkOffset >= m_iChunkSize)
+            return false;
+
+        ParseResult result = parse(m_pChunk, m_iChunkSize, m_iChunkOffset,
+                                   m_iChunkSize, view);
+
+        if(result == PARSE_PACKET)
+            return true;
+
+        if(result == PARSE_INCOMPLETE)
+            keep(m_pChunk + m_iChunkOffset, m_iChunkSize - m_iChunkOffset);
+
+        m_iChunkOffset = m_iChunkSize;
+        return false;
+    }
+}
+
+/******************************************************************************
+ * Method: reset
+ * Description: Forget the current chunk and any held over data.  The
+ * counters are kept.
+ ******************************************************************************/
+void PacketParser::reset() {
+    m_pChunk = NULL;
+    m_iChunkSize = m_iChunkOffset = 0;
+    m_iCarrySize = m_iCarryOffset = m_iCarryBoundary = 0;
+}
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: parse
+ * Description: Scan for the next valid packet starting at offset.  A bad
+ * candidate is skipped one byte at a time so a SYNC sequence inside it is
+ * still found.
+ *
+ * Parameters:
+ *   buffer - data to parse
+ *   size - bytes in the buffer
+ *   offset - where to start, left at the first byte not yet consumed
+ *   limit - stop once a candidate starts at or after this offset
+ *   view - set to the packet when one is found
+ * Return:
+ *   PARSE_PACKET when view is set, PARSE_INCOMPLETE when the data from
+ *   offset on might be the start of a packet, PARSE_LIMIT when offset reached
+ *   the limit.
+ ******************************************************************************/
+PacketParser::ParseResult PacketParser::parse(const char *buffer, uint32_t size,
+                                              uint32_t &offset, uint32_t limit,
+                                              PacketView &view) {
+    while(offset < limit) {
+        uint32_t start = offset + findSync(buffer + offset, size - offset);
+
+        if(start == size) {
+            start = size - syncPrefix(buffer + offset, size - offset);
+            m_iBytesDiscarded += start - offset;
+            offset = start;
+            return offset < limit ? PARSE_INCOMPLETE : PARSE_LIMIT;
+        }
+
+        m_iBytesDiscarded += start - offset;
+        offset = start;
+
+        if(start >= limit)
+            return PARSE_LIMIT;
+
+        if(size - start < (uint32_t)HEADER_SIZE)
+            return PARSE_INCOMPLETE;
+
+        const char *packet = buffer + start;
+        uint8_t type = packet[3];
+        uint16_t packetSize = ((uint8_t)packet[4] << 8) | (uint8_t)packet[5];
+
+        if(type == UNKNOWN || type > PORT_AGENT_HEARTBEAT ||
+           packetSize < HEADER_SIZE || packetSize > m_iMaxPacketSize ||
+           packet[6] != 0) {
+            LOG(DEBUG2) << "bad packet header at " << start;
+            m_iHeaderErrors++;
+            m_iBytesDiscarded++;
+            offset++;
+            continue;
+        }
+
+        if(size - start < packetSize)
+            return PARSE_INCOMPLETE;
+
+        // The checksum skips its own field, byte 6 is known to be zero
+        uint8_t checksum = (uint8_t)packet[7];
+        if((xorBytes(packet, packetSize) ^ checksum) != checksum) {
+            LOG(DEBUG2) << "bad packet checksum at " << start;
+            m_iChecksumErrors++;
+            m_iBytesDiscarded++;
+            offset++;
+            continue;
+        }
+
+        view.type = (PacketType)type;
+        view.timestamp = Timestamp(readUint32(packet + 8), readUint32(packet + 12));
+        view.checksum = checksum;
+        view.packetSize = packetSize;
+        view.packet = packet;
+
+        m_iPackets++;
+        offset += packetSize;
+        return PARSE_PACKET;
+    }
+
+    return PARSE_LIMIT;
+}
+
+/******************************************************************************
+ * Method: keep
+ * Description: Hold on to the unparsed end of the data until the next chunk.
+ * This is always less than a max size packet.
+ ******************************************************************************/
+void PacketParser::keep(const char *buffer, uint32_t size) {
+    memmove(m_pCarry, buffer, size);
+
+    m_iCarrySize = size;
+    m_iCarryOffset = 0;
+    m_iCarryBoundary = size;
+}
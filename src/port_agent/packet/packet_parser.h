@@ -0,0 +1,136 @@
+/*******************************************************************************
+ * Class: PacketParser
+ * Filename: packet_parser.h
+ * License: Apache 2.0
+ *
+ * Streaming deframer for the port agent wire format, the inverse of
+ * Packet::packet().  Bytes are handed over in whatever chunks they arrive in
+ * and complete packets come back as views.  A view points straight into the
+ * chunk when the whole packet is inside it.  Only a packet that straddles
+ * two chunks is copied, into a buffer the parser keeps for that.
+ *
+ * The stream is scanned for the SYNC sequence with SSE2 on x86 and memchr
+ * everywhere else.  A candidate is only accepted when the header is sane
+ * (known type, size between HEADER_SIZE and the max packet size, high
+ * checksum byte zero) and the checksum matches.  Otherwise the parser steps
+ * one byte past the candidate and scans again, so it resynchronizes on the
+ * next good packet after garbage or corruption.
+ *
+ * A view is only good until the next call to next(), add() or reset().  The
+ * chunk passed to add() must stay valid until next() returns false, and
+ * next() must return false before the next add().
+ *
+ * Usage:
+ *
+ * PacketParser parser;
+ * PacketView view;
+ *
+ * parser.add(buffer, bytesRead);
+ * while(parser.next(view))
+ *     handle(view.type, view.timestamp, view.payload(), view.payloadSize());
+ ******************************************************************************/
+
+#ifndef __PACKET_PARSER_H_
+#define __PACKET_PARSER_H_
+
+#include "common/timestamp.h"
+#include "packet.h"
+#include "checksum.h"
+
+#include <stdint.h>
+
+using namespace std;
+
+namespace packet {
+
+    /* A parsed packet, pointing into the parser's input */
+    struct PacketView {
+        PacketType type;
+        Timestamp timestamp;
+        uint16_t checksum;
+        uint16_t packetSize;
+        const char *packet;
+
+        const char* payload() const { return packet + HEADER_SIZE; }
+        uint16_t payloadSize() const { return packetSize - HEADER_SIZE; }
+    };
+
+    // Offset of the first SYNC sequence in the buffer, size if there isn't one
+    uint32_t findSync(const char *buffer, uint32_t size);
+
+    // The individual implementations, exposed for testing.  Only call the
+    // vector version if the CPU supports it.
+    uint32_t findSyncScalar(const char *buffer, uint32_t size);
+
+#ifdef PACKET_CHECKSUM_X86
+    uint32_t findSyncSSE2(const char *buffer, uint32_t size);
+#endif
+
+    class PacketParser {
+        /********************
+         *      METHODS     *
+         ********************/
+
+        public:
+            PacketParser(uint16_t maxPacketSize = 0xFFFF);
+            ~PacketParser();
+
+            // Hand over the next chunk of the stream
+            void add(const char *buffer, uint32_t size);
+
+            // Get the next complete packet, false when more data is needed
+            bool next(PacketView &view);
+
+            // Drop any partial packet and the current chunk
+            void reset();
+
+            // Bytes of a partial packet held over from earlier chunks
+            uint32_t buffered() { return m_iCarrySize; }
+
+            uint64_t packets() { return m_iPackets; }
+            uint64_t headerErrors() { return m_iHeaderErrors; }
+            uint64_t checksumErrors() { return m_iChecksumErrors; }
+            uint64_t bytesDiscarded() { return m_iBytesDiscarded; }
+
+        private:
+            PacketParser(const PacketParser &rhs);
+            PacketParser & operator=(const PacketParser &rhs);
+
+            enum ParseResult {
+                PARSE_PACKET,
+                PARSE_INCOMPLETE,
+                PARSE_LIMIT
+            };
+
+            ParseResult parse(const char *buffer, uint32_t size, uint32_t &offset,
+                              uint32_t limit, PacketView &view);
+            void keep(const char *buffer, uint32_t size);
+
+        /********************
+         *      MEMBERS     *
+         ********************/
+
+        private:
+            uint16_t m_iMaxPacketSize;
+
+            // Caller's chunk and how far into it we have parsed
+            const char *m_pChunk;
+            uint32_t m_iChunkSize;
+            uint32_t m_iChunkOffset;
+
+            // Partial packet from earlier chunks followed by the start of the
+            // current chunk.  Bytes from m_iCarryBoundary on are copies of
+            // the chunk, once parsing reaches them it moves back to the chunk.
+            char *m_pCarry;
+            uint32_t m_iCarrySize;
+            uint32_t m_iCarryOffset;
+            uint32_t m_iCarryBoundary;
+
+            uint64_t m_iPackets;
+            uint64_t m_iHeaderErrors;
+            uint64_t m_iChecksumErrors;
+            uint64_t m_iBytesDiscarded;
+    };
+}
+
+#endif //__PACKET_PARSER_H_
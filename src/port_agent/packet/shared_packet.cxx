@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * Class: SharedPacket
+ * Filename: shared_packet.cxx
+ * License: Apache 2.0
+ *
+ * Immutable reference counted packets.  See shared_packet.h for usage.
+ ******************************************************************************/
+
+#include "shared_packet.h"
+#include "packet_buffer_pool.h"
+#include "common/logger.h"
+#include "common/exception.h"
+
+#include <string.h>
+
+using namespace std;
+using namespace packet;
+using namespace logger;
+
+/******************************************************************************
+ *   PUBLIC METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: create
+ * Description: Build a shared packet from a payload.  The payload is copied
+ * into a pool buffer.
+ *
+ * Return:
+ *   a packet with one reference, owned by the caller.
+ * Throws:
+ *   PacketParamOutOfRange
+ ******************************************************************************/
+SharedPacket* SharedPacket::create(PacketType packetType, Timestamp timestamp,
+                                   const char *payload, uint16_t payloadSize) {
+    char *buffer = PacketBufferPool::global().allocate(HEADER_SIZE + payloadSize);
+
+    if(payload && payloadSize)
+        memcpy(buffer + HEADER_SIZE, payload, payloadSize);
+
+    return adopt(packetType, timestamp, buffer, payloadSize);
+}
+
+/******************************************************************************
+ * Method: adopt
+ * Description: Build a shared packet around a pool buffer that already holds
+ * the payload after HEADER_SIZE bytes of headroom.  The packet owns the
+ * buffer from here on, even if this throws.
+ *
+ * Return:
+ *   a packet with one reference, owned by the caller.
+ * Throws:
+ *   PacketParamOutOfRange
+ ******************************************************************************/
+SharedPacket* SharedPacket::adopt(PacketType packetType, Timestamp timestamp,
+                                  char *buffer, uint16_t payloadSize) {
+    if(packetType == 0) {
+        PacketBufferPool::release(buffer);
+        throw PacketParamOutOfRange("invalid packet type");
+    }
+
+    return new SharedPacket(packetType, timestamp, buffer, payloadSize);
+}
+
+/******************************************************************************
+ * Method: share
+ * Description: Get a reference to a packet that can be kept after the call
+ * that handed it to us returns.
+ *
+ * Return:
+ *   the same packet with another reference if it is already shared,
+ *   otherwise a shared copy.  Either way the caller must release it.
+ ******************************************************************************/
+SharedPacket* SharedPacket::share(Packet *packet) {
+    char *buffer;
+
+    if(!packet)
+        return NULL;
+
+    if(packet->shared())
+        return ((SharedPacket *)packet)->retain();
+
+    buffer = PacketBufferPool::global().allocate(packet->packetSize());
+    memcpy(buffer, packet->packet(), packet->packetSize());
+
+    return adopt(packet->packetType(), packet->timestamp(), buffer,
+                 packet->payloadSize());
+}
+
+/******************************************************************************
+ * Method: retain
+ * Description: Take another reference.
+ ******************************************************************************/
+SharedPacket* SharedPacket::retain() {
+    __atomic_add_fetch(&m_iReferences, 1, __ATOMIC_RELAXED);
+    return this;
+}
+
+/******************************************************************************
+ * Method: release
+ * Description: Drop a reference, the last one deletes the packet.  Don't
+ * touch the packet after releasing it.
+ ******************************************************************************/
+void SharedPacket::release() {
+    if(__atomic_sub_fetch(&m_iReferences, 1, __ATOMIC_ACQ_REL) == 0)
+        delete this;
+}
+
+/******************************************************************************
+ * Method: references
+ * Description: Current reference count, for testing and logging.
+ ******************************************************************************/
+uint32_t SharedPacket::references() {
+    return __atomic_load_n(&m_iReferences, __ATOMIC_RELAXED);
+}
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ * Description: Stamp the header once, the packet never changes after this.
+ ******************************************************************************/
+SharedPacket::SharedPacket(PacketType packetType, Timestamp timestamp,
+                           char *buffer, uint16_t payloadSize) :
+    HeadroomPacket(packetType, timestamp, buffer, payloadSize, true) {
+    m_iReferences = 1;
+}
+
+/******************************************************************************
+ * Method: Destructor
+ * Description: The buffer goes back to the pool with the base class.
+ ******************************************************************************/
+SharedPacket::~SharedPacket() {
+}
+
+/******************************************************************************
+ * Method: assignment operator
+ * Description: Shared packets are immutable.  Not reachable through
+ * SharedPacket, this catches assignment through a Packet reference.
+ ******************************************************************************/
+Packet & SharedPacket::operator=(const Packet &rhs) {
+    LOG(ERROR) << "attempt to assign to an immutable shared packet";
+    return *this;
+}
@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * Class: SharedPacket
+ * Filename: shared_packet.h
+ * License: Apache 2.0
+ *
+ * An immutable, reference counted packet.  The header and checksum are
+ * stamped once when the packet is built and never change after that, so any
+ * number of publishers, queues or replay buffers can hold the same packet
+ * without copying it.  The packet is deleted when the last reference is
+ * released.
+ *
+ * The buffer always comes from PacketBufferPool.  Shared packets can only
+ * live on the heap, use the factory methods to build them.  The reference
+ * count is atomic so a packet may be released from any thread.
+ *
+ * Publishers are handed a plain Packet pointer that is only good for the
+ * duration of the call.  To keep it, take a reference with share().  If the
+ * packet is already shared that is just a reference count bump, otherwise the
+ * packet is copied once.
+ *
+ * Usage:
+ *
+ * // Read straight into a pool buffer and take it over
+ * char *buffer = PacketBufferPool::global().allocate(HEADER_SIZE + size);
+ * int bytesRead = read(fd, buffer + HEADER_SIZE, size);
+ * SharedPacket *packet = SharedPacket::adopt(DATA_FROM_INSTRUMENT, ts,
+ *                                            buffer, bytesRead);
+ *
+ * // In a publisher that delivers later
+ * SharedPacket *kept = SharedPacket::share(packet);
+ * ...
+ * kept->release();
+ *
+ * // Drop the creator's reference
+ * packet->release();
+ ******************************************************************************/
+
+#ifndef __SHARED_PACKET_H_
+#define __SHARED_PACKET_H_
+
+#include "common/timestamp.h"
+#include "headroom_packet.h"
+
+#include <stdint.h>
+
+using namespace std;
+
+namespace packet {
+    class SharedPacket : public HeadroomPacket {
+        /********************
+         *      METHODS     *
+         ********************/
+
+        public:
+            // Build a packet, copying the payload
+            static SharedPacket* create(PacketType packetType, Timestamp timestamp,
+                                        const char *payload, uint16_t payloadSize);
+
+            // Take over a pool buffer with HEADER_SIZE bytes of headroom
+            static SharedPacket* adopt(PacketType packetType, Timestamp timestamp,
+                                       char *buffer, uint16_t payloadSize);
+
+            // A reference to packet, copying it only if it isn't shared
+            static SharedPacket* share(Packet *packet);
+
+            // Reference counting
+            SharedPacket* retain();
+            void release();
+            uint32_t references();
+
+            virtual bool shared() { return true; }
+
+        protected:
+
+        private:
+            SharedPacket(PacketType packetType, Timestamp timestamp,
+                         char *buffer, uint16_t payloadSize);
+            virtual ~SharedPacket();
+
+            // Immutable, no copies or assignment
+            SharedPacket(const SharedPacket &rhs);
+            virtual Packet & operator=(const Packet &rhs);
+            SharedPacket & operator=(const SharedPacket &rhs);
+
+        /********************
+         *      MEMBERS     *
+         ********************/
+
+        protected:
+
+        private:
+            uint32_t m_iReferences;
+    };
+}
+
+#endif //__SHARED_PACKET_H_
@@ -6,6 +6,7 @@
 
 #include <sstream>
 #include <string>
+#include <vector>
 #include <string.h>
 #include <unistd.h>
 
@@ -239,6 +240,81 @@ TEST_F(BufferedPacketTest, SentinleTrigger) {
     LOG(DEBUG) << "Final packet: " << myPacket.pretty();
 }
 
+/* Sentinle sequences that overlap themselves */
+TEST_F(BufferedPacketTest, SentinleOverlap) {
+    BufferedSingleCharPacket myPacket(DATA_FROM_INSTRUMENT, 20, 0, "aab", 3);
+    Timestamp ts;
+
+    // "aaab" contains "aab", a reset on the third 'a' would miss it
+    myPacket.add('a', ts);
+    myPacket.add('a', ts);
+    myPacket.add('a', ts);
+    EXPECT_FALSE(myPacket.readyToSend());
+    myPacket.add('b', ts);
+    EXPECT_TRUE(myPacket.readyToSend());
+
+    // Same thing through the bulk add
+    myPacket.reset();
+    EXPECT_EQ(myPacket.packetSize(), HEADER_SIZE);
+    EXPECT_FALSE(myPacket.readyToSend());
+    EXPECT_EQ(myPacket.add("xaaabyz", 7, ts), 5);
+    EXPECT_TRUE(myPacket.readyToSend());
+    EXPECT_EQ(memcmp(myPacket.payload(), "xaaab", 5), 0);
+}
+
+/* Bulk add splits a buffer into packets at each sentinle */
+TEST_F(BufferedPacketTest, BulkAdd) {
+    BufferedSingleCharPacket myPacket(DATA_FROM_INSTRUMENT, 100, 0, "\r\n", 2);
+    const char *input = "first\r\nsecond\r\nthi";
+    uint32_t size = strlen(input);
+    uint32_t offset = 0;
+    Timestamp ts(1, 0);
+    vector<string> packets;
+
+    while(offset < size) {
+        offset += myPacket.add(input + offset, size - offset, ts);
+
+        if(myPacket.readyToSend()) {
+            packets.push_back(string(myPacket.payload(), myPacket.payloadSize()));
+            EXPECT_EQ(myPacket.timestamp().seconds(), 1);
+            myPacket.reset();
+        }
+    }
+
+    ASSERT_EQ(packets.size(), 2);
+    EXPECT_EQ(packets[0], "first\r\n");
+    EXPECT_EQ(packets[1], "second\r\n");
+    EXPECT_EQ(string(myPacket.payload(), myPacket.payloadSize()), "thi");
+    EXPECT_FALSE(myPacket.readyToSend());
+
+    // A sentinle split between reads still matches
+    EXPECT_EQ(myPacket.add("rd\r", 3, ts), 3);
+    EXPECT_FALSE(myPacket.readyToSend());
+    EXPECT_EQ(myPacket.add("\nmore", 5, ts), 1);
+    EXPECT_TRUE(myPacket.readyToSend());
+    EXPECT_EQ(string(myPacket.payload(), myPacket.payloadSize()), "third\r\n");
+
+    // Header is restamped for the new contents
+    char *buffer = myPacket.packet();
+    EXPECT_EQ(buffer[5], HEADER_SIZE + 7);
+}
+
+/* Bulk add stops at the max packet size */
+TEST_F(BufferedPacketTest, BulkAddMaxSize) {
+    BufferedSingleCharPacket myPacket(DATA_FROM_INSTRUMENT, 4);
+    Timestamp ts;
+
+    EXPECT_EQ(myPacket.add("abcdef", 6, ts), 4);
+    EXPECT_TRUE(myPacket.readyToSend());
+    EXPECT_EQ(myPacket.add("ef", 0, ts), 0);
+    EXPECT_THROW(myPacket.add("ef", 2, ts), PacketOverflow);
+
+    myPacket.reset();
+    EXPECT_EQ(myPacket.add("ef", 2, ts), 2);
+    EXPECT_FALSE(myPacket.readyToSend());
+    EXPECT_EQ(memcmp(myPacket.payload(), "ef", 2), 0);
+}
+
 /* Test Quiescent Time Trigger. */
 TEST_F(BufferedPacketTest, QuiescentTimeTrigger) {
     LOG(INFO) << "Testing Quiescent Time Trigger";
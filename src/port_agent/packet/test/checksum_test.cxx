@@ -0,0 +1,102 @@
+#include "common/exception.h"
+#include "common/logger.h"
+#include "port_agent/packet/packet.h"
+#include "port_agent/packet/buffered_single_char.h"
+#include "port_agent/packet/checksum.h"
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+using namespace packet;
+using namespace logger;
+
+#define TEST_BUFFER_SIZE 1024
+
+class ChecksumTest : public testing::Test {
+
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile("/tmp/gtest.log");
+            Logger::SetLogLevel("MESG");
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "      Port Agent Checksum Test Start Up";
+            LOG(INFO) << "************************************************";
+
+            srand(1234);
+            for(int i = 0; i < TEST_BUFFER_SIZE; i++)
+                m_aBuffer[i] = rand() & 0xFF;
+        }
+
+        // The original byte at a time reduction
+        uint8_t reference(const char *buffer, uint32_t size) {
+            uint8_t result = 0;
+
+            for(uint32_t i = 0; i < size; i++)
+                result ^= (uint8_t)buffer[i];
+
+            return result;
+        }
+
+        char m_aBuffer[TEST_BUFFER_SIZE];
+};
+
+/* Every implementation matches the byte loop for all sizes and alignments */
+TEST_F(ChecksumTest, Implementations) {
+    for(uint32_t offset = 0; offset < 32; offset++) {
+        for(uint32_t size = 0; size + offset <= TEST_BUFFER_SIZE; size += (size < 80 ? 1 : 37)) {
+            const char *buffer = m_aBuffer + offset;
+            uint8_t expected = reference(buffer, size);
+
+            ASSERT_EQ(xorBytesScalar(buffer, size), expected) << "size: " << size;
+            ASSERT_EQ(xorBytes(buffer, size), expected) << "size: " << size;
+
+#ifdef PACKET_CHECKSUM_X86
+            if(cpuHasSSE2())
+                ASSERT_EQ(xorBytesSSE2(buffer, size), expected) << "size: " << size;
+
+            if(cpuHasAVX2())
+                ASSERT_EQ(xorBytesAVX2(buffer, size), expected) << "size: " << size;
+#endif
+        }
+    }
+}
+
+/* The packet checksum skips the checksum field */
+TEST_F(ChecksumTest, PacketChecksum) {
+    Timestamp ts(1, 0x80000000);
+    Packet packet(DATA_FROM_DRIVER, ts, m_aBuffer, 500);
+    char *buffer = packet.packet();
+    uint8_t expected = reference(buffer, 6) ^ reference(buffer + 8, packet.packetSize() - 8);
+
+    EXPECT_EQ(packet.checksum(), expected);
+    EXPECT_EQ((uint8_t)buffer[7], expected);
+    EXPECT_EQ(buffer[6], 0);
+
+    // Same as the known value from the basic packet test
+    Packet small(DATA_FROM_DRIVER, ts, "ad", 2);
+    EXPECT_EQ(small.checksum(), 0xd0);
+}
+
+/* Mutable packets restamp the header after they change */
+TEST_F(ChecksumTest, Invalidate) {
+    BufferedSingleCharPacket packet(DATA_FROM_INSTRUMENT, 64);
+    Timestamp ts(1, 0);
+    uint16_t first;
+
+    packet.add('a', ts);
+    packet.packet();
+    first = packet.checksum();
+
+    // Nothing changed, nothing to redo
+    EXPECT_EQ(packet.packet()[7], (char)first);
+
+    packet.add('b', ts);
+    char *buffer = packet.packet();
+
+    EXPECT_NE(packet.checksum(), first);
+    EXPECT_EQ(packet.checksum(), reference(buffer, 6) ^ reference(buffer + 8, packet.packetSize() - 8));
+    EXPECT_EQ(buffer[5], HEADER_SIZE + 2);
+}
@@ -0,0 +1,97 @@
+#include "common/exception.h"
+#include "common/logger.h"
+#include "port_agent/packet/packet.h"
+#include "port_agent/packet/headroom_packet.h"
+#include "port_agent/packet/packet_buffer_pool.h"
+#include "gtest/gtest.h"
+
+#include <string.h>
+
+using namespace std;
+using namespace packet;
+using namespace logger;
+
+class HeadroomPacketTest : public testing::Test {
+
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile("/tmp/gtest.log");
+            Logger::SetLogLevel("MESG");
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "      Port Agent Headroom Packet Test Start Up";
+            LOG(INFO) << "************************************************";
+        }
+};
+
+/* The packet is built in the caller's buffer and matches a copied packet */
+TEST_F(HeadroomPacketTest, InPlace) {
+    Timestamp ts(1, 0x80000000);
+    char buffer[HEADER_SIZE + 4];
+
+    memcpy(buffer + HEADER_SIZE, "abcd", 4);
+
+    HeadroomPacket packet(DATA_FROM_INSTRUMENT, ts, buffer, 4);
+    Packet reference(DATA_FROM_INSTRUMENT, ts, "abcd", 4);
+
+    EXPECT_FALSE(packet.ownsBuffer());
+    EXPECT_EQ(packet.packet(), buffer);
+    EXPECT_EQ(packet.payload(), buffer + HEADER_SIZE);
+    EXPECT_EQ(packet.packetSize(), HEADER_SIZE + 4);
+    EXPECT_EQ(packet.payloadSize(), 4);
+
+    // Header is already in the headroom
+    EXPECT_EQ(buffer[0], (char)0xA3);
+    EXPECT_EQ(buffer[1], (char)0x9D);
+    EXPECT_EQ(buffer[2], (char)0x7A);
+    EXPECT_EQ(buffer[3], DATA_FROM_INSTRUMENT);
+
+    EXPECT_EQ(memcmp(packet.packet(), reference.packet(), reference.packetSize()), 0);
+    EXPECT_EQ(packet.checksum(), reference.checksum());
+}
+
+/* Copies are deep and the caller's buffer is left alone */
+TEST_F(HeadroomPacketTest, Copy) {
+    Timestamp ts(1, 0);
+    char buffer[HEADER_SIZE + 3];
+
+    memcpy(buffer + HEADER_SIZE, "xyz", 3);
+    HeadroomPacket packet(DATA_FROM_INSTRUMENT, ts, buffer, 3);
+
+    HeadroomPacket copy(packet);
+    EXPECT_TRUE(copy.ownsBuffer());
+    EXPECT_NE(copy.packet(), buffer);
+    EXPECT_EQ(memcmp(copy.packet(), buffer, copy.packetSize()), 0);
+
+    // Assignment over a caller owned buffer must not free it
+    Packet other(PORT_AGENT_STATUS, ts, "status", 6);
+    packet = other;
+    EXPECT_TRUE(packet.ownsBuffer());
+    EXPECT_EQ(packet.packetType(), PORT_AGENT_STATUS);
+    EXPECT_EQ(memcmp(buffer + HEADER_SIZE, "xyz", 3), 0);
+}
+
+/* A pool buffer can be handed over */
+TEST_F(HeadroomPacketTest, OwnsBuffer) {
+    Timestamp ts;
+    char *buffer = PacketBufferPool::global().allocate(HEADER_SIZE + 2);
+
+    memcpy(buffer + HEADER_SIZE, "ok", 2);
+
+    HeadroomPacket *packet = new HeadroomPacket(DATA_FROM_INSTRUMENT, ts, buffer, 2, true);
+    EXPECT_TRUE(packet->ownsBuffer());
+    EXPECT_EQ(packet->packet(), buffer);
+    delete packet;
+}
+
+/* Bad parameters */
+TEST_F(HeadroomPacketTest, Exceptions) {
+    Timestamp ts;
+    char buffer[HEADER_SIZE];
+
+    EXPECT_THROW(HeadroomPacket(UNKNOWN, ts, buffer, 0), PacketParamOutOfRange);
+    EXPECT_THROW(HeadroomPacket(DATA_FROM_INSTRUMENT, ts, NULL, 0), PacketParamOutOfRange);
+
+    HeadroomPacket empty(PORT_AGENT_HEARTBEAT, ts, buffer, 0);
+    EXPECT_EQ(empty.packetSize(), HEADER_SIZE);
+}
@@ -0,0 +1,127 @@
+#include "common/exception.h"
+#include "common/logger.h"
+#include "port_agent/packet/packet.h"
+#include "port_agent/packet/packet_buffer_pool.h"
+#include "gtest/gtest.h"
+
+#include <string.h>
+
+using namespace std;
+using namespace packet;
+using namespace logger;
+
+class PacketBufferPoolTest : public testing::Test {
+
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile("/tmp/gtest.log");
+            Logger::SetLogLevel("MESG");
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "      Port Agent Packet Buffer Pool Test Start Up";
+            LOG(INFO) << "************************************************";
+        }
+};
+
+/* Sizes round up to a power of two class */
+TEST_F(PacketBufferPoolTest, SizeClasses) {
+    EXPECT_EQ(PacketBufferPool::classSize(0), 64);
+    EXPECT_EQ(PacketBufferPool::classFor(0), 0);
+    EXPECT_EQ(PacketBufferPool::classFor(64), 0);
+    EXPECT_EQ(PacketBufferPool::classFor(65), 1);
+    EXPECT_EQ(PacketBufferPool::classSize(PacketBufferPool::classFor(HEADER_SIZE + 4097)), 8192);
+    EXPECT_EQ(PacketBufferPool::classFor(65536), PACKET_POOL_CLASSES - 1);
+    EXPECT_EQ(PacketBufferPool::classFor(65537), PACKET_POOL_CLASSES);
+}
+
+/* Released buffers are reused and the high water mark is kept */
+TEST_F(PacketBufferPoolTest, Reuse) {
+    PacketBufferPool pool;
+    uint32_t sizeClass = PacketBufferPool::classFor(100);
+    PoolStats stats;
+
+    char *first = pool.allocate(100);
+    char *second = pool.allocate(120);
+    ASSERT_TRUE(first != NULL);
+    ASSERT_TRUE(second != NULL);
+    memset(first, 'a', 128);
+    memset(second, 'b', 128);
+
+    stats = pool.stats();
+    EXPECT_EQ(stats.classes[sizeClass].inUse, 2);
+    EXPECT_EQ(stats.classes[sizeClass].highWater, 2);
+    EXPECT_EQ(stats.heapAllocations, 2);
+
+    PacketBufferPool::release(second);
+    PacketBufferPool::release(first);
+
+    // Most recently released comes back first
+    EXPECT_EQ(pool.allocate(90), first);
+
+    stats = pool.stats();
+    EXPECT_EQ(stats.classes[sizeClass].created, 2);
+    EXPECT_EQ(stats.classes[sizeClass].inUse, 1);
+    EXPECT_EQ(stats.classes[sizeClass].free, 1);
+    EXPECT_EQ(stats.classes[sizeClass].highWater, 2);
+    EXPECT_EQ(stats.heapAllocations, 2);
+
+    PacketBufferPool::release(first);
+    PacketBufferPool::release(NULL);
+}
+
+/* Reserved buffers are allocated up front */
+TEST_F(PacketBufferPoolTest, Reserve) {
+    PacketBufferPool pool;
+    char *buffers[8];
+
+    pool.reserve(4096, 8);
+    EXPECT_EQ(pool.stats().heapAllocations, 8);
+
+    for(int i = 0; i < 8; i++)
+        buffers[i] = pool.allocate(4000);
+
+    EXPECT_EQ(pool.stats().heapAllocations, 8);
+
+    for(int i = 0; i < 8; i++)
+        PacketBufferPool::release(buffers[i]);
+
+    // Already have enough
+    pool.reserve(4096, 4);
+    EXPECT_EQ(pool.stats().heapAllocations, 8);
+    EXPECT_EQ(pool.stats().classes[PacketBufferPool::classFor(4096)].free, 8);
+}
+
+/* Buffers too big for any class come from the heap */
+TEST_F(PacketBufferPoolTest, Oversize) {
+    PacketBufferPool pool;
+
+    char *buffer = pool.allocate(100000);
+    memset(buffer, 0, 100000);
+    EXPECT_EQ(pool.stats().oversize, 1);
+
+    PacketBufferPool::release(buffer);
+    EXPECT_EQ(pool.stats().heapAllocations, 1);
+}
+
+/* Packets draw from the global pool and give their buffers back */
+TEST_F(PacketBufferPoolTest, Packets) {
+    Timestamp ts;
+    uint32_t sizeClass = PacketBufferPool::classFor(HEADER_SIZE + 5);
+    uint32_t inUse = PacketBufferPool::global().stats().classes[sizeClass].inUse;
+
+    {
+        Packet packet(PORT_AGENT_STATUS, ts, "hello", 5);
+        Packet copy(packet);
+
+        EXPECT_EQ(PacketBufferPool::global().stats().classes[sizeClass].inUse, inUse + 2);
+    }
+
+    EXPECT_EQ(PacketBufferPool::global().stats().classes[sizeClass].inUse, inUse);
+
+    // A steady stream of packets doesn't grow the pool
+    uint64_t heap = PacketBufferPool::global().stats().heapAllocations;
+    for(int i = 0; i < 100; i++)
+        Packet packet(PORT_AGENT_STATUS, ts, "hello", 5);
+
+    EXPECT_EQ(PacketBufferPool::global().stats().heapAllocations, heap);
+}
@@ -0,0 +1,224 @@
+#include "common/exception.h"
+#include "common/logger.h"
+#include "port_agent/packet/packet.h"
+#include "port_agent/packet/packet_parser.h"
+#include "gtest/gtest.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace packet;
+using namespace logger;
+
+class PacketParserTest : public testing::Test {
+
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile("/tmp/gtest.log");
+            Logger::SetLogLevel("MESG");
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "      Port Agent Packet Parser Test Start Up";
+            LOG(INFO) << "************************************************";
+        }
+
+        // Append a packet to the stream
+        void append(string &stream, PacketType type, Timestamp ts, const char *payload) {
+            Packet packet(type, ts, (char *)payload, strlen(payload));
+            stream.append(packet.packet(), packet.packetSize());
+        }
+
+        // Three packets back to back
+        string threePackets() {
+            string stream;
+            append(stream, DATA_FROM_INSTRUMENT, Timestamp(1, 2), "first");
+            append(stream, PORT_AGENT_HEARTBEAT, Timestamp(3, 4), "");
+            append(stream, DATA_FROM_DRIVER, Timestamp(5, 6), "third packet");
+            return stream;
+        }
+
+        // Parse the chunk and collect the payloads
+        void drain(PacketParser &parser, vector<string> &payloads) {
+            PacketView view;
+
+            while(parser.next(view))
+                payloads.push_back(string(view.payload(), view.payloadSize()));
+        }
+};
+
+/* Packets come back exactly as they were built, pointing into the chunk */
+TEST_F(PacketParserTest, RoundTrip) {
+    Timestamp ts(0x01020304, 0x80000000);
+    Packet packet(DATA_FROM_INSTRUMENT, ts, "payload", 7);
+    const char *buffer = packet.packet();
+
+    PacketParser parser;
+    PacketView view;
+
+    parser.add(buffer, packet.packetSize());
+    ASSERT_TRUE(parser.next(view));
+
+    EXPECT_EQ(view.packet, buffer);
+    EXPECT_EQ(view.type, DATA_FROM_INSTRUMENT);
+    EXPECT_EQ(view.packetSize, packet.packetSize());
+    EXPECT_EQ(view.checksum, packet.checksum());
+    EXPECT_EQ(view.timestamp.seconds(), 0x01020304);
+    EXPECT_EQ(view.timestamp.fraction(), 0x80000000);
+    EXPECT_EQ(string(view.payload(), view.payloadSize()), "payload");
+
+    EXPECT_FALSE(parser.next(view));
+    EXPECT_EQ(parser.packets(), 1);
+    EXPECT_EQ(parser.buffered(), 0);
+    EXPECT_EQ(parser.bytesDiscarded(), 0);
+}
+
+/* Every way of splitting the stream in two gives the same packets */
+TEST_F(PacketParserTest, ChunkSplits) {
+    string stream = threePackets();
+
+    for(uint32_t split = 0; split <= stream.length(); split++) {
+        PacketParser parser;
+        vector<string> payloads;
+
+        parser.add(stream.data(), split);
+        drain(parser, payloads);
+        parser.add(stream.data() + split, stream.length() - split);
+        drain(parser, payloads);
+
+        ASSERT_EQ(payloads.size(), 3) << "split: " << split;
+        EXPECT_EQ(payloads[0], "first");
+        EXPECT_EQ(payloads[1], "");
+        EXPECT_EQ(payloads[2], "third packet");
+        EXPECT_EQ(parser.buffered(), 0);
+        EXPECT_EQ(parser.bytesDiscarded(), 0);
+    }
+}
+
+/* A byte at a time works too */
+TEST_F(PacketParserTest, ByteAtATime) {
+    string stream = threePackets();
+    PacketParser parser;
+    vector<string> payloads;
+
+    for(uint32_t i = 0; i < stream.length(); i++) {
+        parser.add(stream.data() + i, 1);
+        drain(parser, payloads);
+    }
+
+    ASSERT_EQ(payloads.size(), 3);
+    EXPECT_EQ(payloads[2], "third packet");
+    EXPECT_EQ(parser.packets(), 3);
+}
+
+/* Garbage and damaged packets are skipped and the good ones still found */
+TEST_F(PacketParserTest, Resync) {
+    string stream = "garbage\xA3\x9D";
+    append(stream, DATA_FROM_INSTRUMENT, Timestamp(1, 2), "one");
+
+    // Flip a payload bit
+    string bad;
+    append(bad, DATA_FROM_INSTRUMENT, Timestamp(1, 2), "corrupt");
+    bad[HEADER_SIZE] ^= 0x01;
+    stream += bad;
+
+    // A sync sequence with a nonsense header
+    stream += string("\xA3\x9D\x7A\x09\x00\x10", 6);
+
+    append(stream, DATA_FROM_DRIVER, Timestamp(1, 2), "two");
+
+    PacketParser parser;
+    vector<string> payloads;
+
+    parser.add(stream.data(), stream.length());
+    drain(parser, payloads);
+
+    ASSERT_EQ(payloads.size(), 2);
+    EXPECT_EQ(payloads[0], "one");
+    EXPECT_EQ(payloads[1], "two");
+    EXPECT_EQ(parser.checksumErrors(), 1);
+    EXPECT_EQ(parser.headerErrors(), 1);
+    EXPECT_EQ(parser.bytesDiscarded(), 9 + bad.length() + 6);
+
+    // The same stream split at every offset finds the same packets
+    for(uint32_t split = 0; split <= stream.length(); split++) {
+        PacketParser split_parser;
+        payloads.clear();
+
+        split_parser.add(stream.data(), split);
+        drain(split_parser, payloads);
+        split_parser.add(stream.data() + split, stream.length() - split);
+        drain(split_parser, payloads);
+
+        ASSERT_EQ(payloads.size(), 2) << "split: " << split;
+        EXPECT_EQ(split_parser.bytesDiscarded(), parser.bytesDiscarded());
+    }
+}
+
+/* A packet bigger than the max is rejected without waiting for it */
+TEST_F(PacketParserTest, MaxPacketSize) {
+    string big;
+    append(big, DATA_FROM_INSTRUMENT, Timestamp(1, 2), "much too long for the parser");
+
+    string stream = big;
+    append(stream, DATA_FROM_INSTRUMENT, Timestamp(1, 2), "ok");
+
+    PacketParser parser(HEADER_SIZE + 8);
+    vector<string> payloads;
+
+    // Only the header of the big packet, nothing is held for it
+    parser.add(stream.data(), HEADER_SIZE);
+    drain(parser, payloads);
+    EXPECT_EQ(parser.buffered(), 0);
+    EXPECT_EQ(parser.headerErrors(), 1);
+
+    parser.add(stream.data() + HEADER_SIZE, stream.length() - HEADER_SIZE);
+    drain(parser, payloads);
+
+    ASSERT_EQ(payloads.size(), 1);
+    EXPECT_EQ(payloads[0], "ok");
+}
+
+/* The chunk has to be parsed before the next one is added */
+TEST_F(PacketParserTest, AddBeforeParsed) {
+    string stream = threePackets();
+    PacketParser parser;
+    PacketView view;
+
+    parser.add(stream.data(), stream.length());
+    ASSERT_TRUE(parser.next(view));
+    EXPECT_THROW(parser.add(stream.data(), stream.length()), PacketParamOutOfRange);
+
+    parser.reset();
+    parser.add(stream.data(), stream.length());
+    EXPECT_TRUE(parser.next(view));
+}
+
+/* Every sync scan finds the same offset as a byte loop */
+TEST_F(PacketParserTest, FindSync) {
+    char buffer[100];
+
+    for(uint32_t i = 0; i < sizeof(buffer); i++)
+        buffer[i] = (i % 3) ? 0x9D : 0xA3;
+
+    EXPECT_EQ(findSync(buffer, sizeof(buffer)), sizeof(buffer));
+
+    for(uint32_t position = 0; position + 3 <= sizeof(buffer); position++) {
+        for(uint32_t i = 0; i < sizeof(buffer); i++)
+            buffer[i] = (i % 3) ? 0x9D : 0xA3;
+
+        memcpy(buffer + position, "\xA3\x9D\x7A", 3);
+
+        for(uint32_t size = 0; size <= sizeof(buffer); size++) {
+            uint32_t expected = position + 3 <= size ? position : size;
+
+            EXPECT_EQ(findSyncScalar(buffer, size), expected);
+            EXPECT_EQ(findSync(buffer, size), expected);
+#ifdef PACKET_CHECKSUM_X86
+            if(cpuHasSSE2())
+                EXPECT_EQ(findSyncSSE2(buffer, size), expected);
+#endif
+        }
+    }
+}
@@ -0,0 +1,128 @@
+#include "common/exception.h"
+#include "common/logger.h"
+#include "port_agent/packet/packet.h"
+#include "port_agent/packet/shared_packet.h"
+#include "port_agent/packet/packet_buffer_pool.h"
+#include "gtest/gtest.h"
+
+#include <pthread.h>
+#include <string.h>
+
+using namespace std;
+using namespace packet;
+using namespace logger;
+
+class SharedPacketTest : public testing::Test {
+
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile("/tmp/gtest.log");
+            Logger::SetLogLevel("MESG");
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "      Port Agent Shared Packet Test Start Up";
+            LOG(INFO) << "************************************************";
+        }
+};
+
+/* Built packets match plain packets and start with one reference */
+TEST_F(SharedPacketTest, Create) {
+    Timestamp ts(1, 0x80000000);
+    SharedPacket *packet = SharedPacket::create(DATA_FROM_DRIVER, ts, "ad", 2);
+    Packet reference(DATA_FROM_DRIVER, ts, "ad", 2);
+
+    EXPECT_TRUE(packet->shared());
+    EXPECT_FALSE(reference.shared());
+    EXPECT_EQ(packet->references(), 1);
+    EXPECT_EQ(packet->packetSize(), reference.packetSize());
+    EXPECT_EQ(packet->checksum(), reference.checksum());
+    EXPECT_EQ(memcmp(packet->packet(), reference.packet(), reference.packetSize()), 0);
+
+    packet->release();
+
+    // An empty payload is fine
+    packet = SharedPacket::create(PORT_AGENT_HEARTBEAT, ts, NULL, 0);
+    EXPECT_EQ(packet->packetSize(), HEADER_SIZE);
+    packet->release();
+
+    EXPECT_THROW(SharedPacket::create(UNKNOWN, ts, "ad", 2), PacketParamOutOfRange);
+}
+
+/* Sharing a shared packet is a reference, sharing a plain packet a copy */
+TEST_F(SharedPacketTest, Share) {
+    Timestamp ts;
+    char *buffer = PacketBufferPool::global().allocate(HEADER_SIZE + 4);
+    memcpy(buffer + HEADER_SIZE, "data", 4);
+
+    SharedPacket *packet = SharedPacket::adopt(DATA_FROM_INSTRUMENT, ts, buffer, 4);
+    EXPECT_EQ(packet->packet(), buffer);
+
+    SharedPacket *second = SharedPacket::share(packet);
+    EXPECT_EQ(second, packet);
+    EXPECT_EQ(packet->references(), 2);
+
+    packet->release();
+    EXPECT_EQ(second->references(), 1);
+    EXPECT_EQ(memcmp(second->payload(), "data", 4), 0);
+    second->release();
+
+    Packet plain(PORT_AGENT_STATUS, ts, "status", 6);
+    SharedPacket *copy = SharedPacket::share(&plain);
+    EXPECT_NE(copy->packet(), plain.packet());
+    EXPECT_EQ(copy->packetType(), PORT_AGENT_STATUS);
+    EXPECT_EQ(memcmp(copy->packet(), plain.packet(), plain.packetSize()), 0);
+    copy->release();
+
+    EXPECT_TRUE(SharedPacket::share(NULL) == NULL);
+}
+
+/* The buffer goes back to the pool with the last reference */
+TEST_F(SharedPacketTest, ReleaseToPool) {
+    Timestamp ts;
+    uint32_t sizeClass = PacketBufferPool::classFor(HEADER_SIZE + 1000);
+    uint32_t inUse = PacketBufferPool::global().stats().classes[sizeClass].inUse;
+    char payload[1000];
+
+    memset(payload, 'x', sizeof(payload));
+    SharedPacket *packet = SharedPacket::create(DATA_FROM_INSTRUMENT, ts, payload, sizeof(payload));
+    packet->retain();
+
+    EXPECT_EQ(PacketBufferPool::global().stats().classes[sizeClass].inUse, inUse + 1);
+
+    packet->release();
+    EXPECT_EQ(PacketBufferPool::global().stats().classes[sizeClass].inUse, inUse + 1);
+
+    packet->release();
+    EXPECT_EQ(PacketBufferPool::global().stats().classes[sizeClass].inUse, inUse);
+}
+
+static void* releaseMany(void *arg) {
+    SharedPacket *packet = (SharedPacket *)arg;
+
+    for(int i = 0; i < 10000; i++)
+        packet->release();
+
+    return NULL;
+}
+
+/* References can be dropped from several threads at once */
+TEST_F(SharedPacketTest, Threads) {
+    Timestamp ts;
+    uint32_t sizeClass = PacketBufferPool::classFor(HEADER_SIZE + 4);
+    uint32_t inUse = PacketBufferPool::global().stats().classes[sizeClass].inUse;
+    SharedPacket *packet = SharedPacket::create(DATA_FROM_INSTRUMENT, ts, "data", 4);
+    pthread_t threads[4];
+
+    for(int i = 0; i < 40000; i++)
+        packet->retain();
+
+    for(int i = 0; i < 4; i++)
+        pthread_create(&threads[i], NULL, releaseMany, packet);
+
+    for(int i = 0; i < 4; i++)
+        pthread_join(threads[i], NULL);
+
+    EXPECT_EQ(packet->references(), 1);
+    packet->release();
+    EXPECT_EQ(PacketBufferPool::global().stats().classes[sizeClass].inUse, inUse);
+}
@@ -0,0 +1,709 @@
+/*******************************************************************************
+ * Class: PacketPipeline
+ * Filename: packet_pipeline.cxx
+ * License: Apache 2.0
+ *
+ * Reader and publisher threads for instrument data.  See packet_pipeline.h
+ * for usage.
+ ******************************************************************************/
+#include "packet_pipeline.h"
+#include "config/port_agent_config.h"
+#include "common/logger.h"
+#include "common/exception.h"
+#include "common/timestamp.h"
+#include "network/timer_queue.h"
+
+#include <sstream>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+using namespace std;
+using namespace logger;
+using namespace network;
+using namespace packet;
+using namespace publisher;
+using namespace port_agent;
+
+/******************************************************************************
+ *   PUBLIC METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ * Description: Allocate the ring and the wake up descriptors.  The threads
+ * are not started until start() is called.
+ *
+ * Parameters:
+ *   publishers - publisher list the packets are written to
+ *   publisherLock - held while writing to the publisher list
+ *   depth - number of packets the ring can hold, rounded up to a power of 2
+ *   readSize - maximum number of bytes read into a single packet
+ ******************************************************************************/
+PacketPipeline::PacketPipeline(PublisherList &publishers, Mutex &publisherLock,
+                               uint32_t depth, uint32_t readSize) :
+    m_oPublishers(publishers), m_oPublisherLock(publisherLock), m_oRing(depth),
+    m_iDepth(depth) {
+
+    m_iSourceFD = -1;
+    m_iSourceGeneration = 0;
+    m_bSourceLost = false;
+    m_iReadSize = 0;
+    setReadSize(readSize);
+
+    m_pFramer = NULL;
+    m_pThrottle = NULL;
+    m_iThrottleDeadline = 0;
+
+    m_bRunning = false;
+    m_bStopping = false;
+
+    m_iEnqueued = 0;
+    m_iPublished = 0;
+    m_iDropped = 0;
+    m_iHighWater = 0;
+
+    m_iSourceWakeFD = eventfd(0, EFD_NONBLOCK);
+    m_iPublishWakeFD = eventfd(0, EFD_NONBLOCK);
+    m_iNotifyFD = eventfd(0, EFD_NONBLOCK);
+
+    if(m_iSourceWakeFD < 0 || m_iPublishWakeFD < 0 || m_iNotifyFD < 0)
+        throw PipelineFailure(strerror(errno));
+}
+
+/******************************************************************************
+ * Method: Destructor
+ * Description: Stop the threads and free any packets still queued.
+ ******************************************************************************/
+PacketPipeline::~PacketPipeline() {
+    SharedPacket *packet;
+
+    stop();
+
+    while(m_oRing.pop(packet))
+        packet->release();
+
+    for(uint32_t i = 0; i < m_oFramed.size(); i++)
+        m_oFramed[i]->release();
+
+    if(m_pFramer)
+        delete m_pFramer;
+
+    if(m_pThrottle)
+        delete m_pThrottle;
+
+    if(m_iSourceWakeFD >= 0)
+        close(m_iSourceWakeFD);
+
+    if(m_iPublishWakeFD >= 0)
+        close(m_iPublishWakeFD);
+
+    if(m_iNotifyFD >= 0)
+        close(m_iNotifyFD);
+}
+
+/******************************************************************************
+ * Method: start
+ * Description: Start the reader and publisher threads.
+ * Return:
+ *   true if both threads are running
+ ******************************************************************************/
+bool PacketPipeline::start() {
+    if(m_bRunning)
+        return true;
+
+    __atomic_store_n(&m_bStopping, false, __ATOMIC_RELEASE);
+
+    if(pthread_create(&m_oPublisherThread, NULL, publisherMain, this)) {
+        LOG(ERROR) << "failed to start pipeline publisher thread";
+        return false;
+    }
+
+    if(pthread_create(&m_oReaderThread, NULL, readerMain, this)) {
+        LOG(ERROR) << "failed to start pipeline reader thread";
+        __atomic_store_n(&m_bStopping, true, __ATOMIC_RELEASE);
+        signal(m_iPublishWakeFD);
+        pthread_join(m_oPublisherThread, NULL);
+        return false;
+    }
+
+    LOG(INFO) << "packet pipeline started, depth: " << capacity();
+    m_bRunning = true;
+    return true;
+}
+
+/******************************************************************************
+ * Method: stop
+ * Description: Stop and join both threads.  The reader queues the record in
+ * progress and the publisher publishes whatever the reader queued, and
+ * whatever the throttle is holding, before they exit.
+ ******************************************************************************/
+void PacketPipeline::stop() {
+    if(!m_bRunning)
+        return;
+
+    __atomic_store_n(&m_bStopping, true, __ATOMIC_RELEASE);
+
+    signal(m_iSourceWakeFD);
+    pthread_join(m_oReaderThread, NULL);
+
+    signal(m_iPublishWakeFD);
+    pthread_join(m_oPublisherThread, NULL);
+
+    m_bRunning = false;
+    LOG(INFO) << "packet pipeline stopped";
+}
+
+/******************************************************************************
+ * Method: setSource
+ * Description: Set the descriptor the reader thread reads from.  When this
+ * returns the reader is no longer using the old descriptor, so it is safe for
+ * the caller to close it.  Whatever we have of the old source's last record
+ * is sent as it is.
+ *
+ * Parameters:
+ *   fd - instrument descriptor, or -1 to stop reading
+ ******************************************************************************/
+void PacketPipeline::setSource(int fd) {
+    MutexLock lock(m_oSourceLock);
+
+    if(fd == m_iSourceFD && !m_bSourceLost)
+        return;
+
+    LOG(DEBUG) << "pipeline source fd: " << fd;
+
+    if(m_pFramer && m_pFramer->pending())
+        m_oFramed.push_back(m_pFramer->flush());
+
+    m_iSourceFD = fd;
+    m_iSourceGeneration++;
+    m_bSourceLost = false;
+
+    signal(m_iSourceWakeFD);
+}
+
+/******************************************************************************
+ * Method: sourceLost
+ * Description: Has the reader seen the instrument close or fail?
+ ******************************************************************************/
+bool PacketPipeline::sourceLost() {
+    MutexLock lock(m_oSourceLock);
+    return m_bSourceLost;
+}
+
+/******************************************************************************
+ * Method: setReadSize
+ * Description: Set the maximum number of bytes in a packet.
+ ******************************************************************************/
+void PacketPipeline::setReadSize(uint32_t readSize) {
+    MutexLock lock(m_oSourceLock);
+
+    if(readSize == 0 || readSize > MAX_PACKET_SIZE)
+        readSize = MAX_PACKET_SIZE;
+
+    m_iReadSize = readSize;
+}
+
+/******************************************************************************
+ * Method: setFraming
+ * Description: Build, rebuild or drop the reader's framer to match the
+ * configuration.  A record in progress is sent before the framer is
+ * replaced.
+ *
+ * Parameters:
+ *   maxPacketSize - largest record payload
+ *   sentinle - record terminator, empty for none
+ *   quiescentTime - send a partial record after this much quiet (ms)
+ ******************************************************************************/
+void PacketPipeline::setFraming(uint16_t maxPacketSize, const string &sentinle,
+                                uint32_t quiescentTime) {
+    bool required = InstrumentFramer::required(sentinle, quiescentTime);
+    MutexLock lock(m_oSourceLock);
+
+    if(m_pFramer) {
+        if(required && m_pFramer->configuredFor(maxPacketSize, sentinle, quiescentTime))
+            return;
+
+        LOG(INFO) << "Stop pipeline framer";
+        if(m_pFramer->pending())
+            m_oFramed.push_back(m_pFramer->flush());
+
+        delete m_pFramer;
+        m_pFramer = NULL;
+        signal(m_iSourceWakeFD);
+    }
+
+    if(!required)
+        return;
+
+    LOG(INFO) << "Initialize pipeline framer, sentinle size: " << sentinle.length()
+              << " max quiescent time: " << quiescentTime;
+    m_pFramer = new InstrumentFramer(maxPacketSize, sentinle, quiescentTime);
+}
+
+/******************************************************************************
+ * Method: setThrottle
+ * Description: Build, rebuild or drop the publisher's output throttle to
+ * match the configuration.  Held data is published before the throttle is
+ * replaced.  Called with the publisher lock held.
+ *
+ * Parameters:
+ *   rate - packets per second, 0 for no throttle
+ *   maxHoldTime - longest data is held back (ms)
+ *   maxPacketSize - largest packet held data is coalesced into
+ ******************************************************************************/
+void PacketPipeline::setThrottle(uint32_t rate, uint32_t maxHoldTime, uint16_t maxPacketSize) {
+    SharedPacket *packet;
+
+    if(m_pThrottle) {
+        if(rate && m_pThrottle->configuredFor(rate, maxHoldTime, maxPacketSize))
+            return;
+
+        LOG(INFO) << "Stop pipeline output throttle";
+        packet = m_pThrottle->flush();
+        if(packet)
+            publish(packet);
+
+        delete m_pThrottle;
+        m_pThrottle = NULL;
+        __atomic_store_n(&m_iThrottleDeadline, 0, __ATOMIC_RELAXED);
+    }
+
+    if(!rate)
+        return;
+
+    LOG(INFO) << "Initialize pipeline output throttle, packets per second: " << rate
+              << " max hold time: " << maxHoldTime;
+    m_pThrottle = new OutputThrottle(rate, maxHoldTime, maxPacketSize);
+}
+
+/******************************************************************************
+ * Method: clearNotify
+ * Description: Reset the main loop notification descriptor.
+ ******************************************************************************/
+void PacketPipeline::clearNotify() {
+    clear(m_iNotifyFD);
+}
+
+/******************************************************************************
+ * Method: stats
+ * Description: Snapshot of the pipeline counters.
+ ******************************************************************************/
+PipelineStats PacketPipeline::stats() {
+    PipelineStats result;
+
+    result.capacity = m_oRing.capacity();
+    result.occupancy = m_oRing.size();
+    result.highWater = __atomic_load_n(&m_iHighWater, __ATOMIC_RELAXED);
+    result.enqueued = __atomic_load_n(&m_iEnqueued, __ATOMIC_RELAXED);
+    result.published = __atomic_load_n(&m_iPublished, __ATOMIC_RELAXED);
+    result.dropped = __atomic_load_n(&m_iDropped, __ATOMIC_RELAXED);
+
+    return result;
+}
+
+/******************************************************************************
+ * Method: statsAsString
+ * Description: Counters formatted for a status packet.  Called with the
+ * publisher lock held.
+ ******************************************************************************/
+string PacketPipeline::statsAsString() {
+    PipelineStats current = stats();
+    ostringstream out;
+
+    out << "pipeline_depth " << current.capacity << endl
+        << "pipeline_occupancy " << current.occupancy << endl
+        << "pipeline_high_water " << current.highWater << endl
+        << "pipeline_enqueued " << current.enqueued << endl
+        << "pipeline_published " << current.published << endl
+        << "pipeline_dropped " << current.dropped << endl;
+
+    if(m_pThrottle)
+        out << "throttle_packets_in " << m_pThrottle->packetsIn() << endl
+            << "throttle_packets_out " << m_pThrottle->packetsOut() << endl;
+
+    MutexLock lock(m_oSourceLock);
+    if(m_pFramer)
+        out << "framer_records " << m_pFramer->records() << endl
+            << "framer_flushes " << m_pFramer->flushes() << endl;
+
+    return out.str();
+}
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: readerMain
+ * Description: pthread entry point for the reader thread.
+ ******************************************************************************/
+void * PacketPipeline::readerMain(void *arg) {
+    ((PacketPipeline *)arg)->readLoop();
+    return NULL;
+}
+
+/******************************************************************************
+ * Method: publisherMain
+ * Description: pthread entry point for the publisher thread.
+ ******************************************************************************/
+void * PacketPipeline::publisherMain(void *arg) {
+    ((PacketPipeline *)arg)->publishLoop();
+    return NULL;
+}
+
+/******************************************************************************
+ * Method: readLoop
+ * Description: Wait for the instrument to have data and read it.  We also
+ * watch the source wake descriptor so a new source, or a request to stop,
+ * is picked up straight away.  The wait is cut short when a partial record
+ * is due.
+ ******************************************************************************/
+void PacketPipeline::readLoop() {
+    struct pollfd fds[2];
+    uint32_t generation;
+    int fd;
+    int timeout;
+    nfds_t count;
+
+    while(!__atomic_load_n(&m_bStopping, __ATOMIC_ACQUIRE)) {
+        {
+            MutexLock lock(m_oSourceLock);
+            fd = m_bSourceLost ? -1 : m_iSourceFD;
+            generation = m_iSourceGeneration;
+            timeout = framerTimeout();
+        }
+
+        fds[0].fd = m_iSourceWakeFD;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        count = 1;
+
+        if(fd >= 0) {
+            fds[1].fd = fd;
+            fds[1].events = POLLIN;
+            fds[1].revents = 0;
+            count = 2;
+        }
+
+        if(::poll(fds, count, timeout) < 0) {
+            if(errno != EINTR)
+                LOG(ERROR) << "pipeline reader poll error: " << strerror(errno);
+            continue;
+        }
+
+        if(fds[0].revents)
+            clear(m_iSourceWakeFD);
+
+        if(count == 2 && fds[1].revents)
+            readSource(fd, generation);
+
+        flushFramer(false);
+    }
+
+    flushFramer(true);
+}
+
+/******************************************************************************
+ * Method: readSource
+ * Description: Read from the instrument and queue a packet, or with framing
+ * the records the read finished.  The source lock is held during the read so
+ * the main loop can't close the descriptor under us.  If the source has
+ * changed since we polled, the read is skipped.
+ *
+ * Return:
+ *   true if the read got data
+ ******************************************************************************/
+bool PacketPipeline::readSource(int fd, uint32_t generation) {
+    vector<SharedPacket *> records;
+    char *buffer;
+    ssize_t bytesRead;
+    bool framed = false;
+    Timestamp ts;
+
+    {
+        MutexLock lock(m_oSourceLock);
+
+        if(fd != m_iSourceFD || generation != m_iSourceGeneration || m_bSourceLost)
+            return false;
+
+        // The packet takes the buffer, so read after the header space and
+        // the payload is never copied.
+        buffer = PacketBufferPool::global().allocate(HEADER_SIZE + m_iReadSize);
+        bytesRead = read(fd, buffer + HEADER_SIZE, m_iReadSize);
+
+        if(bytesRead == 0 ||
+           (bytesRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            LOG(INFO) << "pipeline source closed: " << (bytesRead ? strerror(errno) : "zero bytes recv");
+            m_bSourceLost = true;
+            signal(m_iNotifyFD);
+            PacketBufferPool::release(buffer);
+
+            // Whatever we have of the last record is all we are going to get
+            if(m_pFramer && m_pFramer->pending())
+                m_oFramed.push_back(m_pFramer->flush());
+            return false;
+        }
+
+        if(bytesRead > 0 && m_pFramer) {
+            m_pFramer->add(buffer + HEADER_SIZE, bytesRead, ts, records);
+            PacketBufferPool::release(buffer);
+            framed = true;
+        }
+    }
+
+    if(bytesRead < 0) {
+        PacketBufferPool::release(buffer);
+        return false;
+    }
+
+    if(framed) {
+        enqueue(records);
+        return true;
+    }
+
+    enqueue(SharedPacket::adopt(DATA_FROM_INSTRUMENT, ts, buffer, bytesRead));
+    return true;
+}
+
+/******************************************************************************
+ * Method: flushFramer
+ * Description: Queue the records the main loop took out of the framer, and
+ * the partial record if it is due.
+ *
+ * Parameters:
+ *   force - queue the partial record even if it isn't due
+ ******************************************************************************/
+void PacketPipeline::flushFramer(bool force) {
+    vector<SharedPacket *> records;
+
+    {
+        MutexLock lock(m_oSourceLock);
+
+        records.swap(m_oFramed);
+
+        if(m_pFramer && m_pFramer->pending() &&
+           (force || m_pFramer->flushDelay(TimerQueue::now()) == 0))
+            records.push_back(m_pFramer->flush());
+    }
+
+    enqueue(records);
+}
+
+/******************************************************************************
+ * Method: framerTimeout
+ * Description: How long the reader can wait before the partial record is
+ * due, called with the source lock held.
+ *
+ * Return:
+ *   milliseconds, at most PIPELINE_WAIT_TIMEOUT
+ ******************************************************************************/
+int PacketPipeline::framerTimeout() {
+    uint64_t delay;
+
+    if(!m_pFramer || !m_pFramer->pending())
+        return PIPELINE_WAIT_TIMEOUT;
+
+    // Round up so we don't wake just before it is due
+    delay = (m_pFramer->flushDelay(TimerQueue::now()) + USEC_PER_MSEC - 1) / USEC_PER_MSEC;
+
+    return delay < PIPELINE_WAIT_TIMEOUT ? delay : PIPELINE_WAIT_TIMEOUT;
+}
+
+/******************************************************************************
+ * Method: enqueue
+ * Description: Hand a packet to the publisher thread.  If the ring is full the
+ * packet is dropped; the reader never waits for the publishers.
+ ******************************************************************************/
+void PacketPipeline::enqueue(SharedPacket *packet) {
+    uint32_t occupancy;
+
+    if(!m_oRing.push(packet)) {
+        packet->release();
+        __atomic_add_fetch(&m_iDropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    __atomic_add_fetch(&m_iEnqueued, 1, __ATOMIC_RELAXED);
+
+    occupancy = m_oRing.size();
+    if(occupancy > __atomic_load_n(&m_iHighWater, __ATOMIC_RELAXED))
+        __atomic_store_n(&m_iHighWater, occupancy, __ATOMIC_RELAXED);
+
+    signal(m_iPublishWakeFD);
+}
+
+/******************************************************************************
+ * Method: enqueue
+ * Description: Hand a list of packets to the publisher thread, in order.
+ ******************************************************************************/
+void PacketPipeline::enqueue(vector<SharedPacket *> &packets) {
+    for(uint32_t i = 0; i < packets.size(); i++)
+        enqueue(packets[i]);
+
+    packets.clear();
+}
+
+/******************************************************************************
+ * Method: publishLoop
+ * Description: Wait for packets and publish them.  The wait is cut short
+ * when held data is due.  On the way out, drain whatever is left so nothing
+ * read from the instrument is lost on a clean shutdown.
+ ******************************************************************************/
+void PacketPipeline::publishLoop() {
+    struct pollfd fds[1];
+
+    while(!__atomic_load_n(&m_bStopping, __ATOMIC_ACQUIRE)) {
+        fds[0].fd = m_iPublishWakeFD;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+
+        if(::poll(fds, 1, throttleTimeout()) < 0) {
+            if(errno != EINTR)
+                LOG(ERROR) << "pipeline publisher poll error: " << strerror(errno);
+            continue;
+        }
+
+        if(fds[0].revents)
+            clear(m_iPublishWakeFD);
+
+        drain(false);
+    }
+
+    drain(true);
+}
+
+/******************************************************************************
+ * Method: throttleTimeout
+ * Description: How long the publisher can wait before held data is due.  The
+ * deadline is read without the lock, a stale one only wakes us early.
+ *
+ * Return:
+ *   milliseconds, at most PIPELINE_WAIT_TIMEOUT
+ ******************************************************************************/
+int PacketPipeline::throttleTimeout() {
+    uint64_t deadline = __atomic_load_n(&m_iThrottleDeadline, __ATOMIC_RELAXED);
+    uint64_t now = TimerQueue::now();
+    uint64_t delay;
+
+    if(!deadline)
+        return PIPELINE_WAIT_TIMEOUT;
+
+    if(deadline <= now)
+        return 0;
+
+    // Round up so we don't wake just before it is due
+    delay = (deadline - now + USEC_PER_MSEC - 1) / USEC_PER_MSEC;
+
+    return delay < PIPELINE_WAIT_TIMEOUT ? delay : PIPELINE_WAIT_TIMEOUT;
+}
+
+/******************************************************************************
+ * Method: drain
+ * Description: Publish every packet in the ring.  The publisher lock is taken
+ * once for the whole batch, and batching publishers write once at the end.
+ * With a throttle the packets go through it and only what it releases is
+ * published, the rest waits for the next token.  The main loop is woken if a
+ * client fell behind or a publish failed, it watches slow clients and
+ * replaces dropped ones.
+ *
+ * Parameters:
+ *   final - the pipeline is stopping, publish held data now
+ ******************************************************************************/
+void PacketPipeline::drain(bool final) {
+    vector<SharedPacket *> ready;
+    SharedPacket *packet;
+    bool outputPending;
+    bool failed = false;
+    uint64_t deadline = __atomic_load_n(&m_iThrottleDeadline, __ATOMIC_RELAXED);
+    uint64_t now = TimerQueue::now();
+
+    if(m_oRing.empty() && !final && (!deadline || now < deadline))
+        return;
+
+    MutexLock lock(m_oPublisherLock);
+
+    outputPending = m_oPublishers.outputPending();
+
+    while(m_oRing.pop(packet)) {
+        __atomic_add_fetch(&m_iPublished, 1, __ATOMIC_RELAXED);
+
+        if(m_pThrottle)
+            m_pThrottle->add(packet, now, ready);
+        else if(!publish(packet))
+            failed = true;
+    }
+
+    if(m_pThrottle) {
+        m_pThrottle->poll(now, ready);
+
+        if(final && (packet = m_pThrottle->flush()))
+            ready.push_back(packet);
+
+        deadline = m_pThrottle->pending() ? now + m_pThrottle->flushDelay(now) : 0;
+        __atomic_store_n(&m_iThrottleDeadline, deadline, __ATOMIC_RELAXED);
+    }
+
+    for(uint32_t i = 0; i < ready.size(); i++) {
+        if(!publish(ready[i]))
+            failed = true;
+    }
+
+    try {
+        m_oPublishers.flush();
+    }
+    catch(OOIException &e) {
+        LOG(ERROR) << "pipeline flush failed: " << e.what();
+        failed = true;
+    }
+
+    if(failed || (!outputPending && m_oPublishers.outputPending()))
+        signal(m_iNotifyFD);
+}
+
+/******************************************************************************
+ * Method: publish
+ * Description: Publish a packet and release it, called with the publisher
+ * lock held.
+ *
+ * Return:
+ *   false if a publisher failed
+ ******************************************************************************/
+bool PacketPipeline::publish(SharedPacket *packet) {
+    bool result = true;
+
+    try {
+        m_oPublishers.publish(packet);
+    }
+    catch(OOIException &e) {
+        LOG(ERROR) << "pipeline publish failed: " << e.what();
+        result = false;
+    }
+
+    packet->release();
+    return result;
+}
+
+/******************************************************************************
+ * Method: signal
+ * Description: Wake whoever is waiting on an eventfd.
+ ******************************************************************************/
+void PacketPipeline::signal(int fd) {
+    uint64_t value = 1;
+
+    if(write(fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        LOG(ERROR) << "pipeline signal failed: " << strerror(errno);
+}
+
+/******************************************************************************
+ * Method: clear
+ * Description: Reset an eventfd after we have been woken.
+ ******************************************************************************/
+void PacketPipeline::clear(int fd) {
+    uint64_t value;
+
+    if(read(fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        LOG(ERROR) << "pipeline clear failed: " << strerror(errno);
+}
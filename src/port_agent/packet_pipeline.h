@@ -0,0 +1,185 @@
+/*******************************************************************************
+ * Class: PacketPipeline
+ * Filename: packet_pipeline.h
+ * License: Apache 2.0
+ *
+ * Moves instrument data off the main loop.  A reader thread waits on the
+ * instrument descriptor, timestamps what it reads into packets and pushes
+ * them into a bounded SPSC ring.  A publisher thread drains the ring and
+ * writes the packets to the publisher list.  The reader never waits on an
+ * output; when the ring is full the new packet is dropped and counted.
+ *
+ * The main loop still owns the instrument connection.  It hands the pipeline
+ * the descriptor to read with setSource() and must call setSource(-1) before
+ * the connection is closed.  The reader never closes the descriptor itself,
+ * if the instrument drops it flags the source as lost and wakes the main
+ * loop through notifyFD().
+ *
+ * With a sentinle or quiescent time set through setFraming() the reader
+ * runs its own InstrumentFramer and queues records instead of raw reads.  A
+ * partial record goes out when it is due, when the source changes and when
+ * the pipeline stops.
+ *
+ * With a rate set through setThrottle() the publisher runs what it takes off
+ * the ring through its own OutputThrottle, and publishes held data when it
+ * is due.  Held data is published when the pipeline stops.
+ *
+ * Publishing happens with the caller supplied publisher lock held so the
+ * main loop can keep the publisher list and its connections to itself by
+ * holding the same lock.  The throttle belongs to the publisher thread and
+ * is guarded by the same lock.
+ *
+ * Usage:
+ *
+ * PacketPipeline pipeline(publishers, publisherLock, 1024, 1024);
+ * pipeline.start();
+ *
+ * pipeline.setFraming(1024, "\r\n", 0);
+ * pipeline.setSource(instrumentFD);
+ *
+ * // main loop, when notifyFD() is readable
+ * pipeline.clearNotify();
+ * if(pipeline.sourceLost()) {
+ *     pipeline.setSource(-1);
+ *     connection->disconnect();
+ * }
+ *
+ * pipeline.stop();
+ ******************************************************************************/
+
+#ifndef __PACKET_PIPELINE_H_
+#define __PACKET_PIPELINE_H_
+
+#include "common/mutex.h"
+#include "common/spsc_ring.h"
+#include "packet/packet.h"
+#include "packet/shared_packet.h"
+#include "packet/packet_buffer_pool.h"
+#include "publisher/publisher_list.h"
+#include "instrument_framer.h"
+#include "output_throttle.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace packet;
+using namespace publisher;
+
+// How long the threads wait before checking if they have been stopped (ms)
+#define PIPELINE_WAIT_TIMEOUT 1000
+
+namespace port_agent {
+
+    typedef struct PipelineStats
+    {
+        uint32_t capacity;
+        uint32_t occupancy;
+        uint32_t highWater;
+        uint64_t enqueued;
+        uint64_t published;
+        uint64_t dropped;
+    } PipelineStats;
+
+    class PacketPipeline {
+        public:
+            PacketPipeline(PublisherList &publishers, Mutex &publisherLock,
+                           uint32_t depth, uint32_t readSize);
+            ~PacketPipeline();
+
+            bool start();
+            void stop();
+            bool running() { return m_bRunning; }
+
+            // Called from the main loop
+            void setSource(int fd);
+            int source() { return m_iSourceFD; }
+            bool sourceLost();
+            void setReadSize(uint32_t readSize);
+            void setFraming(uint16_t maxPacketSize, const string &sentinle,
+                            uint32_t quiescentTime);
+
+            // Called with the publisher lock held
+            void setThrottle(uint32_t rate, uint32_t maxHoldTime, uint16_t maxPacketSize);
+
+            int notifyFD() { return m_iNotifyFD; }
+            void clearNotify();
+
+            uint32_t depth() { return m_iDepth; }
+            uint32_t capacity() { return m_oRing.capacity(); }
+            PipelineStats stats();
+            string statsAsString();
+
+        private:
+            PacketPipeline(const PacketPipeline &rhs);
+            PacketPipeline & operator=(const PacketPipeline &rhs);
+
+            static void * readerMain(void *arg);
+            static void * publisherMain(void *arg);
+
+            void readLoop();
+            void publishLoop();
+
+            bool readSource(int fd, uint32_t generation);
+            void flushFramer(bool force);
+            int framerTimeout();
+            void enqueue(SharedPacket *packet);
+            void enqueue(vector<SharedPacket *> &packets);
+            void drain(bool final);
+            int throttleTimeout();
+            bool publish(SharedPacket *packet);
+
+            void signal(int fd);
+            void clear(int fd);
+
+        /////
+        // Members
+        /////
+
+        private:
+            PublisherList &m_oPublishers;
+            Mutex &m_oPublisherLock;
+
+            SPSCRing<SharedPacket *> m_oRing;
+            uint32_t m_iDepth;
+
+            // Instrument source, changed by the main loop with the source
+            // lock held.  The reader holds the lock while it reads.
+            Mutex m_oSourceLock;
+            int m_iSourceFD;
+            uint32_t m_iSourceGeneration;
+            bool m_bSourceLost;
+            uint32_t m_iReadSize;
+
+            // Framing, also guarded by the source lock.  Records the main
+            // loop takes out of the framer wait in m_oFramed for the reader
+            // to queue, only the reader pushes to the ring.
+            InstrumentFramer *m_pFramer;
+            vector<SharedPacket *> m_oFramed;
+
+            // Throttle and when its held packet is due, 0 if nothing is
+            // held.  Guarded by the publisher lock.
+            OutputThrottle *m_pThrottle;
+            uint64_t m_iThrottleDeadline;
+
+            // eventfds used to wake the reader, publisher and main loop
+            int m_iSourceWakeFD;
+            int m_iPublishWakeFD;
+            int m_iNotifyFD;
+
+            pthread_t m_oReaderThread;
+            pthread_t m_oPublisherThread;
+            bool m_bRunning;
+            bool m_bStopping;
+
+            // Counters, written by one thread and read by any
+            uint64_t m_iEnqueued;
+            uint64_t m_iPublished;
+            uint64_t m_iDropped;
+            uint32_t m_iHighWater;
+    };
+}
+
+#endif //__PACKET_PIPELINE_H_
@@ -16,6 +16,8 @@
 #include "connection/instrument_serial_connection.h"
 #include "packet/packet.h"
 #include "packet/buffered_single_char.h"
+#include "packet/packet_buffer_pool.h"
+#include "packet/shared_packet.h"
 
 #include "publisher/log_publisher.h"
 #include "publisher/driver_command_publisher.h"
@@ -24,10 +26,12 @@
 #include "publisher/instrument_data_publisher.h"
 #include "publisher/telnet_sniffer_publisher.h"
 #include "publisher/udp_publisher.h"
+#include "publisher/shared_memory_publisher.h"
 #include "publisher/tcp_publisher.h"
 
 #include <iostream>
 #include <sstream>
+#include <set>
 #include <string.h>
 #include <netinet/in.h>
 #include <netdb.h>
@@ -51,12 +55,36 @@ using namespace port_agent;
 /******************************************************************************
  * Method: Default Constructor
  ******************************************************************************/
-PortAgent::PortAgent() {
+PortAgent::PortAgent() :
+    m_oReconnectBackoff(DEFAULT_RECONNECT_MIN_DELAY, DEFAULT_RECONNECT_MAX_DELAY,
+                        DEFAULT_RECONNECT_JITTER) {
     m_pObservatoryConnection = NULL;
     m_pInstrumentConnection = NULL;
+    m_pTelnetSnifferConnection = NULL;
+    m_pMulticastConnection = NULL;
+    m_pSharedMemoryConnection = NULL;
+    m_pPacketPipeline = NULL;
+    m_pInstrumentFramer = NULL;
+    m_pOutputThrottle = NULL;
+    m_pLogArchiver = NULL;
     
     m_pConfig = NULL;
     m_oState = STATE_UNKNOWN;
+    
+    m_bEventSourcesChanged = true;
+    m_bShutdownRequested = false;
+    
+    m_iHeartbeatTimer = 0;
+    m_iHeartbeatInterval = 0;
+    m_iReconnectTimer = 0;
+    m_iConnectTimer = 0;
+    m_iFramerTimer = 0;
+    m_iThrottleTimer = 0;
+    m_iPublisherFlushTimer = 0;
+    m_iPublisherFlushDeadline = 0;
+    m_iResolveTimer = 0;
+    m_iResolveDeadline = 0;
+    m_iConnectedSince = 0;
 }
 
 /******************************************************************************
@@ -64,7 +92,9 @@ PortAgent::PortAgent() {
  * Description: Construct a configuration object from command line parameters
  *              passed in from the command line using (argv).
  ******************************************************************************/
-PortAgent::PortAgent(int argc, char *argv[]) {
+PortAgent::PortAgent(int argc, char *argv[]) :
+    m_oReconnectBackoff(DEFAULT_RECONNECT_MIN_DELAY, DEFAULT_RECONNECT_MAX_DELAY,
+                        DEFAULT_RECONNECT_JITTER) {
     // Setup the log file if we are running as a daemon
     LOG(DEBUG) << "Initialize port agent with args";
     
@@ -74,6 +104,27 @@ PortAgent::PortAgent(int argc, char *argv[]) {
     m_pInstrumentConnection = NULL;
     m_pObservatoryConnection = NULL;
     m_pTelnetSnifferConnection = NULL;
+    m_pMulticastConnection = NULL;
+    m_pSharedMemoryConnection = NULL;
+    m_pPacketPipeline = NULL;
+    m_pInstrumentFramer = NULL;
+    m_pOutputThrottle = NULL;
+    m_pLogArchiver = NULL;
+    
+    m_bEventSourcesChanged = true;
+    m_bShutdownRequested = false;
+    
+    m_iHeartbeatTimer = 0;
+    m_iHeartbeatInterval = 0;
+    m_iReconnectTimer = 0;
+    m_iConnectTimer = 0;
+    m_iFramerTimer = 0;
+    m_iThrottleTimer = 0;
+    m_iPublisherFlushTimer = 0;
+    m_iPublisherFlushDeadline = 0;
+    m_iResolveTimer = 0;
+    m_iResolveDeadline = 0;
+    m_iConnectedSince = 0;
 }
 
 /******************************************************************************
@@ -81,6 +132,19 @@ PortAgent::PortAgent(int argc, char *argv[]) {
  * Description: Clear dynamic memory
  ******************************************************************************/
 PortAgent::~PortAgent() {
+    // Stop the pipeline threads before the connections they use go away
+    if(m_pPacketPipeline)
+        delete m_pPacketPipeline;
+    
+    if(m_pInstrumentFramer)
+        delete m_pInstrumentFramer;
+
+    if(m_pOutputThrottle)
+        delete m_pOutputThrottle;
+
+    if(m_pLogArchiver)
+        delete m_pLogArchiver;
+
     if(m_pObservatoryConnection)
         delete m_pObservatoryConnection;
         
@@ -89,7 +153,13 @@ PortAgent::~PortAgent() {
         
     if(m_pTelnetSnifferConnection)
         delete m_pTelnetSnifferConnection;
-        
+
+    if(m_pMulticastConnection)
+        delete m_pMulticastConnection;
+
+    if(m_pSharedMemoryConnection)
+        delete m_pSharedMemoryConnection;
+
     if(m_pConfig)
         delete m_pConfig;
         
@@ -105,6 +175,36 @@ const string PortAgent::daemon_command() {
     throw NotImplemented();
 }
 
+/******************************************************************************
+ * Method: shutdown
+ * Description: Overloaded virtual method from the Daemon Process class.
+ * Publishers may be holding packets in a batch or an uncommitted data log
+ * write, get those out before the process exits, and close the data log so
+ * a preallocated one is truncated.  Called without the publisher lock held.
+ ******************************************************************************/
+void PortAgent::shutdown() {
+    // Joins the publisher thread, nothing else is published after this
+    if(m_pPacketPipeline) {
+        delete m_pPacketPipeline;
+        m_pPacketPipeline = NULL;
+    }
+
+    try {
+        MutexLock lock(m_oPublisherLock);
+        m_oPublishers.flush();
+        m_oPublishers.closeFiles();
+    }
+    catch(OOIException &e) {
+        LOG(ERROR) << "Failed to flush publishers: " << e.what();
+    }
+
+    // Drops a half compressed file rather than leave it behind
+    if(m_pLogArchiver)
+        m_pLogArchiver->stop();
+
+    DaemonProcess::shutdown();
+}
+
 /******************************************************************************
  * Method: no_daemon
  * Description: Tell the parent class if we should daemonize or not.
@@ -322,6 +422,11 @@ void PortAgent::initializeObservatoryCommandConnection() {
  * this method will need to support more types.
  ******************************************************************************/
 void PortAgent::initializeInstrumentConnection() {
+    // The connection may be closed or rebuilt, make sure the pipeline reader
+    // has let go of it first.
+    if(m_pPacketPipeline)
+        m_pPacketPipeline->setSource(-1);
+    
     if (m_pConfig->instrumentConnectionType() == TYPE_TCP) {
         initializeTCPInstrumentConnection();
     }
@@ -371,28 +476,12 @@ void PortAgent::initializeTCPInstrumentConnection() {
         connection->setDataPort(m_pConfig->instrumentDataPort());
     }
 
-    if (!connection->connected()) {
+    if (!connection->connected() && !instrumentConnecting()) {
         LOG(DEBUG) << "Instrument not connected, attempting to reconnect";
         LOG(DEBUG2) << "host: " << connection->dataHost() << " port: " << connection->dataPort();
 
-        setState(STATE_DISCONNECTED);
-
-        try {
-            connection->initialize();
-        }
-        catch(SocketConnectFailure &e) {
-            connection->disconnect();
-            string msg = e.what();
-            LOG(ERROR) << msg;
-        };
-
-        // Let everything connect
-        sleep(SELECT_SLEEP_TIME);
+        startInstrumentConnect();
     }
-
-
-    if(connection->connected())
-        setState(STATE_CONNECTED);
 }
 
 /******************************************************************************
@@ -433,29 +522,13 @@ void PortAgent::initialize_BOTPT_InstrumentConnection() {
         connection->setDataRxPort(m_pConfig->instrumentDataRxPort());
     }
     
-    if (!connection->connected()) {
+    if (!connection->dataConnected() && !instrumentConnecting()) {
         LOG(DEBUG) << "Instrument not connected, attempting to reconnect";
         LOG(DEBUG2) << "host: " << connection->dataHost() << " port: " << connection->dataTxPort();
         LOG(DEBUG2) << "host: " << connection->dataHost() << " port: " << connection->dataRxPort();
         
-        setState(STATE_DISCONNECTED);
-        
-        try {
-            connection->initialize();
-        }
-        catch(SocketConnectFailure &e) {
-            connection->disconnect();
-            string msg = e.what();
-            LOG(ERROR) << msg;
-        };
-        
-        // Let everything connect
-        sleep(SELECT_SLEEP_TIME);
+        startInstrumentConnect();
     }
-    
-    
-    if(connection->connected())
-        setState(STATE_CONNECTED);
 }
 
 /******************************************************************************
@@ -484,9 +557,16 @@ void PortAgent::initializeSerialInstrumentConnection() {
 
     if (m_pConfig->devicePathChanged() || !connection->connected()) {
         LOG(INFO) << "Detected device path change or not opened.  closing and reopening.";
-        m_pInstrumentConnection->initialize();
         m_pConfig->clearDevicePathChanged();
 
+        try {
+            m_pInstrumentConnection->initialize();
+        }
+        catch(DeviceOpenFailure &e) {
+            instrumentConnectFailed(e.what());
+            return;
+        }
+
         // If the devicePath has changed, we need to initialize the serial settings
         // regardless of whether they have changed.
         if (initializeSerialSettings()) {
@@ -502,10 +582,11 @@ void PortAgent::initializeSerialInstrumentConnection() {
     }
 
     if (connection->connected()) {
-        setState(STATE_CONNECTED);
+        if(getCurrentState() != STATE_CONNECTED)
+            instrumentConnected();
     }
     else {
-        setState(STATE_DISCONNECTED);
+        instrumentConnectFailed("device not open");
     }
 }
 
@@ -528,6 +609,215 @@ bool PortAgent::initializeSerialSettings() {
 
 }
 
+/******************************************************************************
+ * Method: initializePacketPipeline
+ * Description: Start, resize or stop the instrument data pipeline to match
+ * the pipeline_depth configuration.  The pipeline threads are joined when it
+ * is stopped, so this must not be called with the publisher lock held.
+ ******************************************************************************/
+void PortAgent::initializePacketPipeline() {
+    uint32_t depth = m_pConfig ? m_pConfig->pipelineDepth() : 0;
+    
+    // Enough buffers for a full ring plus the packets being read and
+    // published, so the pipeline doesn't go to the heap under load.
+    if(depth)
+        PacketBufferPool::global().reserve(HEADER_SIZE + m_pConfig->maxPacketSize(), depth + 2);
+
+    if(m_pPacketPipeline) {
+        if(m_pPacketPipeline->depth() == depth) {
+            m_pPacketPipeline->setReadSize(m_pConfig->maxPacketSize());
+            return;
+        }
+        
+        LOG(INFO) << "Stop packet pipeline";
+        delete m_pPacketPipeline;
+        m_pPacketPipeline = NULL;
+        eventSourcesChanged();
+    }
+    
+    if(!depth)
+        return;
+    
+    LOG(INFO) << "Initialize packet pipeline, depth: " << depth;
+    m_pPacketPipeline = new PacketPipeline(m_oPublishers, m_oPublisherLock,
+                                           depth, m_pConfig->maxPacketSize());
+    
+    if(!m_pPacketPipeline->start()) {
+        delete m_pPacketPipeline;
+        m_pPacketPipeline = NULL;
+        throw PipelineFailure("failed to start threads");
+    }
+    
+    eventSourcesChanged();
+}
+
+/******************************************************************************
+ * Method: initializeInstrumentFramer
+ * Description: Build, rebuild or drop the instrument framer to match the
+ * sentinle, max_quiescent_time and max_packet_size configuration.  A record
+ * in progress is sent before the framer is replaced.  With the pipeline
+ * running the reader thread frames the data, so the settings go to it.
+ ******************************************************************************/
+void PortAgent::initializeInstrumentFramer() {
+    string sentinle = m_pConfig ? m_pConfig->sentinleSequence() : "";
+    uint32_t quiescentTime = m_pConfig ? m_pConfig->maxQuiescentTime() : 0;
+    uint32_t maxPacketSize = m_pConfig ? m_pConfig->maxPacketSize() : 0;
+    bool required = InstrumentFramer::required(sentinle, quiescentTime);
+
+    if(m_pPacketPipeline) {
+        if(m_pInstrumentFramer) {
+            LOG(INFO) << "Stop instrument framer";
+            flushInstrumentFramer();
+            delete m_pInstrumentFramer;
+            m_pInstrumentFramer = NULL;
+        }
+
+        m_pPacketPipeline->setFraming(maxPacketSize, sentinle, quiescentTime);
+        return;
+    }
+
+    if(m_pInstrumentFramer) {
+        if(required && m_pInstrumentFramer->configuredFor(maxPacketSize, sentinle, quiescentTime))
+            return;
+
+        LOG(INFO) << "Stop instrument framer";
+        flushInstrumentFramer();
+        delete m_pInstrumentFramer;
+        m_pInstrumentFramer = NULL;
+    }
+
+    if(!required)
+        return;
+
+    LOG(INFO) << "Initialize instrument framer, sentinle size: " << sentinle.length()
+              << " max quiescent time: " << quiescentTime;
+    m_pInstrumentFramer = new InstrumentFramer(maxPacketSize, sentinle, quiescentTime);
+}
+
+/******************************************************************************
+ * Method: initializeOutputThrottle
+ * Description: Build, rebuild or drop the output throttle to match the
+ * output_throttle, max_hold_time and max_packet_size configuration.  Held
+ * data is sent before the throttle is replaced.  With the pipeline running
+ * its publisher thread throttles the data, so the settings go to it.
+ ******************************************************************************/
+void PortAgent::initializeOutputThrottle() {
+    uint32_t rate = m_pConfig ? m_pConfig->outputThrottle() : 0;
+    uint32_t maxHoldTime = m_pConfig ? m_pConfig->maxHoldTime() : 0;
+    uint32_t maxPacketSize = m_pConfig ? m_pConfig->maxPacketSize() : 0;
+
+    if(m_pPacketPipeline) {
+        if(m_pOutputThrottle) {
+            LOG(INFO) << "Stop output throttle";
+            flushOutputThrottle();
+            delete m_pOutputThrottle;
+            m_pOutputThrottle = NULL;
+        }
+
+        m_pPacketPipeline->setThrottle(rate, maxHoldTime, maxPacketSize);
+        return;
+    }
+
+    if(m_pOutputThrottle) {
+        if(rate && m_pOutputThrottle->configuredFor(rate, maxHoldTime, maxPacketSize))
+            return;
+
+        LOG(INFO) << "Stop output throttle";
+        flushOutputThrottle();
+        delete m_pOutputThrottle;
+        m_pOutputThrottle = NULL;
+    }
+
+    if(!rate)
+        return;
+
+    LOG(INFO) << "Initialize output throttle, packets per second: " << rate
+              << " max hold time: " << maxHoldTime;
+    m_pOutputThrottle = new OutputThrottle(rate, maxHoldTime, maxPacketSize);
+}
+
+/******************************************************************************
+ * Method: initializePublisherBatching
+ * Description: Apply the configured batch policy to the driver data, driver
+ * command and telnet sniffer publishers, and the commit policy,
+ * preallocation and time index policy to the data log.  Publishers come
+ * and go with their clients so this runs every loop, it does nothing if the
+ * policy is already set.
+ ******************************************************************************/
+void PortAgent::initializePublisherBatching() {
+    if(!m_pConfig)
+        return;
+
+    const PublisherBatch &data = m_pConfig->dataPortBatch();
+    const PublisherBatch &command = m_pConfig->commandPortBatch();
+    const PublisherBatch &sniffer = m_pConfig->telnetSnifferBatch();
+    const LogCommit &commit = m_pConfig->dataLogCommit();
+    const LogIndexPolicy &index = m_pConfig->dataLogIndex();
+
+    try {
+        m_oPublishers.setBatchPolicy(PUBLISHER_DRIVER_DATA,
+                                     data.packets, data.bytes, data.delay);
+        m_oPublishers.setBatchPolicy(PUBLISHER_DRIVER_COMMAND,
+                                     command.packets, command.bytes, command.delay);
+        m_oPublishers.setBatchPolicy(PUBLISHER_TELNET_SNIFFER,
+                                     sniffer.packets, sniffer.bytes, sniffer.delay);
+        m_oPublishers.setCommitPolicy(commit.delay, commit.bytes, commit.sync);
+        m_oPublishers.setPreallocation(m_pConfig->dataLogPreallocate());
+        m_oPublishers.setIndexPolicy(index.packets, index.interval);
+    }
+    catch(OOIException &e) {
+        LOG(ERROR) << "Failed to set publisher policy: " << e.what();
+    }
+}
+
+/******************************************************************************
+ * Method: initializeLogArchiver
+ * Description: Start, update or stop the data log archiver to match the
+ * data_log_compress and data_log_retention configuration, and make it the
+ * data log's listener.  Runs every loop with the publisher lock held, so
+ * the listener isn't swapped under a publishing pipeline thread.
+ ******************************************************************************/
+void PortAgent::initializeLogArchiver() {
+    int level = m_pConfig ? m_pConfig->dataLogCompress() : 0;
+    LogRetention retention = {0, 0};
+
+    if(m_pConfig)
+        retention = m_pConfig->dataLogRetention();
+
+    if((!level && !retention.age && !retention.bytes) ||
+       !m_pConfig->datafile().length()) {
+        if(m_pLogArchiver) {
+            LOG(INFO) << "Stop log archiver";
+            m_oPublishers.setLogListener(NULL);
+            delete m_pLogArchiver;
+            m_pLogArchiver = NULL;
+        }
+        return;
+    }
+
+    try {
+        if(!m_pLogArchiver) {
+            LOG(INFO) << "Initialize log archiver, compression level: " << level
+                      << " max age: " << retention.age << " max bytes: " << retention.bytes;
+            m_pLogArchiver = new LogArchiver();
+
+            if(!m_pLogArchiver->start()) {
+                delete m_pLogArchiver;
+                m_pLogArchiver = NULL;
+                return;
+            }
+        }
+
+        m_pLogArchiver->setBase(m_pConfig->datafile(), "data");
+        m_pLogArchiver->setCompression(level);
+        m_pLogArchiver->setRetention(retention.age, retention.bytes);
+        m_oPublishers.setLogListener(m_pLogArchiver);
+    }
+    catch(OOIException &e) {
+        LOG(ERROR) << "Failed to initialize log archiver: " << e.what();
+    }
+}
+
 /******************************************************************************
  * Method: initializePulishers
  * Description: setup all publishers
@@ -541,6 +831,7 @@ void PortAgent::initializePublishers() {
     initializePublisherInstrumentCommand();    
     initializePublisherTCP();    
     initializePublisherUDP();    
+    initializePublisherSharedMemory();
     initializePublisherTelnetSniffer();    
 }
 
@@ -783,10 +1074,112 @@ void PortAgent::initializePublisherTCP() {
 
 /******************************************************************************
  * Method: initializePublisherUDP
- * Description: setup the udp publisher
+ * Description: setup the udp publisher.  Packets are sent to the multicast
+ * group, each datagram carrying a sequence number so receivers can count
+ * what they lost.  An open socket with the same configuration is kept,
+ * otherwise its publisher is removed before the socket is deleted.
  ******************************************************************************/
 void PortAgent::initializePublisherUDP() {
     LOG(INFO) << "Initialize UDP Publisher";
+    
+    const string &group = m_pConfig->multicastGroup();
+    int port = m_pConfig->multicastPort();
+    bool configured = group.length() && port > 0;
+    
+    if(configured && m_pMulticastConnection && m_pMulticastConnection->connected() &&
+       m_pMulticastConnection->hostname() == group &&
+       m_pMulticastConnection->port() == port &&
+       m_pMulticastConnection->multicastTTL() == m_pConfig->multicastTTL() &&
+       m_pMulticastConnection->multicastInterface() == m_pConfig->multicastInterface()) {
+        LOG(DEBUG) << "multicast publisher unchanged";
+        return;
+    }
+    
+    if(m_pMulticastConnection) {
+        m_oPublishers.removeByType(PUBLISHER_UDP);
+        delete m_pMulticastConnection;
+        m_pMulticastConnection = NULL;
+    }
+    
+    if(!configured) {
+        LOG(INFO) << "multicast group not configured.  Not starting.";
+        return;
+    }
+    
+    LOG(DEBUG) << "Establish UDP socket for multicast group " << group;
+    UDPCommSocket *connection = new UDPCommSocket();
+    connection->setHostname(group);
+    connection->setPort(port);
+    connection->setMulticastTTL(m_pConfig->multicastTTL());
+    connection->setMulticastInterface(m_pConfig->multicastInterface());
+    connection->setSequenced(true);
+    
+    try {
+        connection->initialize();
+    }
+    catch(OOIException &e) {
+        delete connection;
+        LOG(ERROR) << "Failed to establish multicast publisher: " << e.what();
+        return;
+    };
+    
+    m_pMulticastConnection = connection;
+    
+    UDPPublisher publisher(m_pMulticastConnection);
+    m_oPublishers.add(&publisher);
+}
+
+/******************************************************************************
+ * Method: initializePublisherSharedMemory
+ * Description: setup the shared memory publisher.  Every packet is written
+ * to a ring in /dev/shm that drivers on this host read without a socket.
+ * A ring with the same configuration is kept, so its readers aren't reset,
+ * otherwise its publisher is removed before the ring is deleted.
+ ******************************************************************************/
+void PortAgent::initializePublisherSharedMemory() {
+    LOG(INFO) << "Initialize Shared Memory Publisher";
+    
+    const string &name = m_pConfig->sharedMemoryName();
+    uint64_t capacity = SharedMemoryRing::roundCapacity(m_pConfig->sharedMemorySize());
+    
+    if(name.length() && m_pSharedMemoryConnection &&
+       m_pSharedMemoryConnection->connected() &&
+       m_pSharedMemoryConnection->name() == name &&
+       m_pSharedMemoryConnection->capacity() == capacity) {
+        LOG(DEBUG) << "shared memory publisher unchanged";
+        return;
+    }
+    
+    if(m_pSharedMemoryConnection) {
+        m_oPublishers.removeByType(PUBLISHER_SHARED_MEMORY);
+        delete m_pSharedMemoryConnection;
+        m_pSharedMemoryConnection = NULL;
+    }
+    
+    if(!name.length()) {
+        LOG(INFO) << "shared memory name not configured.  Not starting.";
+        return;
+    }
+    
+    LOG(DEBUG) << "Establish shared memory ring " << name;
+    
+    SharedMemoryRing *connection = new SharedMemoryRing();
+    connection->setName(name);
+    connection->setCapacity(capacity);
+    
+    try {
+        connection->initialize();
+    }
+    catch(OOIException &e) {
+        delete connection;
+        LOG(ERROR) << "Failed to establish shared memory publisher: " << e.what();
+        return;
+    };
+    
+    m_pSharedMemoryConnection = connection;
+    
+    SharedMemoryPublisher publisher(m_pSharedMemoryConnection);
+    m_oPublishers.add(&publisher);
 }
 
 
@@ -855,6 +1248,10 @@ void PortAgent::processPortAgentCommands() {
                 LOG(DEBUG) << "get state command";
                 publishStatus(getCurrentStateAsString());
                 break;
+            case CMD_GET_STATS:
+                LOG(DEBUG) << "get stats command";
+                publishStatus(getStats());
+                break;
             case CMD_PING:
                 msg << "pong. version: " << PORT_AGENT_VERSION;
                 LOG(DEBUG) << "ping command. logger version: " << PORT_AGENT_VERSION;
@@ -870,7 +1267,8 @@ void PortAgent::processPortAgentCommands() {
                 break;
             case CMD_SHUTDOWN:
                 LOG(DEBUG) << "shutdown command";
-                shutdown();
+                // Shut down once the publisher lock is released
+                m_bShutdownRequested = true;
                 break;
         };
     }
@@ -885,6 +1283,10 @@ void PortAgent::processPortAgentCommands() {
  *   listener - TCP listener object for managing the tcp connection.
  ******************************************************************************/
 void PortAgent::handleTCPConnect(TCPCommListener &listener) {
+    // The new client needs watching, and a full listener closes its server
+    // socket
+    eventSourcesChanged();
+    
     listener.acceptClient();
     LOG(DEBUG) << "new client FD: " << listener.clientFD();
     
@@ -895,15 +1297,12 @@ void PortAgent::handleTCPConnect(TCPCommListener &listener) {
 
 /******************************************************************************
  * Method: handleStateUnconfigured
- * Description: handler for the unconfigured state
+ * Description: handler for the unconfigured state.  Observatory commands and
+ * data are serviced by the event loop.
  ******************************************************************************/
-void PortAgent::handleStateUnconfigured(const fd_set &readFDs) {
+void PortAgent::handleStateUnconfigured() {
     LOG(DEBUG) << "start state unconfigured handler";
     
-    handleObservatoryCommandAccept(readFDs);
-    handleObservatoryCommandRead(readFDs);
-    handleObservatoryDataRead(readFDs);
-    
     if(m_pConfig->isConfigured())
         setState(STATE_CONFIGURED);
 }
@@ -914,47 +1313,47 @@ void PortAgent::handleStateUnconfigured(const fd_set &readFDs) {
  * state is either go into connected (if we can connect to the instrument) or
  * disconnected.
  ******************************************************************************/
-void PortAgent::handleStateConfigured(const fd_set &readFDs) {
+void PortAgent::handleStateConfigured() {
     LOG(DEBUG) << "start state configured handler";
     
     initializeObservatoryCommandConnection();
     initializeObservatoryDataConnection();
     initializeInstrumentConnection();
     initializePublishers();
+    
+    eventSourcesChanged();
 }
 
 /******************************************************************************
  * Method: handleStateConnected
- * Description: handler for the connected state
+ * Description: handler for the connected state.  Accepts and reads are
+ * dispatched from the event loop, all we need to do here is notice if the
+ * instrument has dropped.
  ******************************************************************************/
-void PortAgent::handleStateConnected(const fd_set &readFDs) {
+void PortAgent::handleStateConnected() {
     LOG(DEBUG) << "start state connected handler";
     
-    // Accept any new connections.
-    handleObservatoryCommandAccept(readFDs);
-    handleObservatoryDataAccept(readFDs);
-    
-    // Read data
-    handleObservatoryCommandRead(readFDs);
-    handleObservatoryDataRead(readFDs);
-    handleInstrumentDataRead(readFDs);
+    if(!m_pInstrumentConnection || !m_pInstrumentConnection->dataConnected())
+        instrumentLost();
 }
 
 /******************************************************************************
  * Method: handleStateDisconnected
- * Description: handler for the disconnected state
+ * Description: handler for the disconnected state.  Try to reconnect to the
+ * instrument.
  ******************************************************************************/
-void PortAgent::handleStateDisconnected(const fd_set &readFDs) {
+void PortAgent::handleStateDisconnected() {
     LOG(DEBUG) << "start state disconnected handler";
     
-    // Accept any new connections.
-    handleObservatoryCommandAccept(readFDs);
-    handleObservatoryDataAccept(readFDs);
-    
-    // Read data
-    handleObservatoryCommandRead(readFDs);
-    handleObservatoryDataRead(readFDs);
-    handleInstrumentDataRead(readFDs);
+    if(!m_pInstrumentConnection || !m_pInstrumentConnection->dataConnected()) {
+        // Waiting for a connect to finish or for the next attempt
+        if(instrumentConnecting() || reconnectPending())
+            return;
+        
+        LOG(DEBUG2) << "instrument not connected, attempting to re-init the socket";
+        initializeInstrumentConnection();
+        eventSourcesChanged();
+    }
 }
 
 /******************************************************************************
@@ -983,70 +1382,89 @@ void PortAgent::handleStateStartup() {
     setState(STATE_UNCONFIGURED);
 }
 
-/******************************************************************************
- * Method: handleCommon
- * Description: common tasks to be handled regardless of state.
- ******************************************************************************/
-void PortAgent::handleCommon(const fd_set &readFDs) {
-    handleTelnetSnifferAccept(readFDs);
-    handleTelnetSnifferRead(readFDs);
-}
-
 /******************************************************************************
  * Method: poll
  * Description: main program loop.  Looping structure is in base class
+ *
+ * Each pass runs the state handler, brings the event loop registrations up to
+ * date if a connection was opened or closed, then waits for the registered
+ * descriptors.  Ready descriptors are dispatched to handleEvent.
  ******************************************************************************/
 void PortAgent::poll() {
-    fd_set readFDs;
-    struct timeval tv;
+    PortAgentState startState = getCurrentState();
+    int timeout = ppid() ? SELECT_SLEEP_TIME * 1000 : -1;
     int readyCount;
-    int maxFD = buildFDSet(readFDs);
-    
-    tv.tv_sec = SELECT_SLEEP_TIME;
-    tv.tv_usec = 0;
-    
-    // Main select to see if any incoming pipes have data.
-    LOG(DEBUG) << "Start select process";
-    readyCount = select(maxFD+1, &readFDs, NULL, NULL, &tv);
-    if(readyCount < 0) {
-        if (errno != EINTR) 
-            LOG(ERROR) << "Socket select error: " << strerror(errno);
-        else
-            LOG(DEBUG) << "Socket select error: " << strerror(errno) << " IGNORED";
-        
-        return;
-    }
-
-    LOG(DEBUG) << "On select: ready to read on " << readyCount << " connections";
     
     LOG(DEBUG) << "Port Agent Version: " << PORT_AGENT_VERSION;
     LOG(DEBUG) << "CURRENT STATE: " << getCurrentStateAsString();
     
     try {
-        // We don't use else if here so that the work in one state handler
-        // can change the state can call a subsiquent handler without having
-        // to iterate.
-        if(getCurrentState() == STATE_UNCONFIGURED)
-            handleStateUnconfigured(readFDs);
+        // Outside of the publisher lock, stopping the pipeline joins the
+        // publisher thread.
+        initializePacketPipeline();
         
-        if(getCurrentState() == STATE_CONFIGURED)
-            handleStateConfigured(readFDs);
-        
-        if(getCurrentState() == STATE_CONNECTED)
-            handleStateConnected(readFDs);
-        
-        if(getCurrentState() == STATE_DISCONNECTED)
-            handleStateDisconnected(readFDs);
-        
-        if(getCurrentState() == STATE_STARTUP)
-            handleStateStartup();
-        
-        if(getCurrentState() == STATE_UNKNOWN)
-            handleStateUnknown();
+        {
+            MutexLock lock(m_oPublisherLock);
             
-        handleCommon(readFDs);
+            // We don't use else if here so that the work in one state handler
+            // can change the state can call a subsiquent handler without having
+            // to iterate.
+            if(getCurrentState() == STATE_UNCONFIGURED)
+                handleStateUnconfigured();
             
-        publishHeartbeat();
+            if(getCurrentState() == STATE_CONFIGURED)
+                handleStateConfigured();
+            
+            if(getCurrentState() == STATE_CONNECTED)
+                handleStateConnected();
+            
+            if(getCurrentState() == STATE_DISCONNECTED)
+                handleStateDisconnected();
+            
+            if(getCurrentState() == STATE_STARTUP)
+                handleStateStartup();
+            
+            if(getCurrentState() == STATE_UNKNOWN)
+                handleStateUnknown();
+            
+            updateOutputBuffers();
+
+            if(m_bEventSourcesChanged)
+                updateEventSources();
+            
+            updateHeartbeatTimer();
+            initializeInstrumentFramer();
+            initializeOutputThrottle();
+            initializePublisherBatching();
+            initializeLogArchiver();
+            updatePublisherFlushTimer();
+            updateResolveTimer();
+        }
+        
+        // Main event wait to see if any incoming pipes have data.
+        LOG(DEBUG) << "Start event loop dispatch";
+        // Timers bound the wait, so with nothing to do we sleep until
+        // something arrives.  Only watching for the parent to exit needs a
+        // periodic wake up.  If the state changed the new state's handler
+        // hasn't run yet, so don't wait at all.
+        if(getCurrentState() != startState)
+            timeout = 0;
+
+        readyCount = m_oEventLoop.dispatch(timeout);
+
+        if(m_bShutdownRequested)
+            shutdown();
+
+        if(readyCount < 0) {
+            if (errno != EINTR) 
+                LOG(ERROR) << "Event loop wait error: " << strerror(errno);
+            else
+                LOG(DEBUG) << "Event loop wait error: " << strerror(errno) << " IGNORED";
+            
+            return;
+        }
+        
+        LOG(DEBUG) << "On dispatch: " << readyCount << " connections ready";
     }
     catch(UnknownState &e) {
         //re-throw the exception
@@ -1055,112 +1473,608 @@ void PortAgent::poll() {
     catch(OOIException &e) {
         string msg = e.what();
         LOG(ERROR) << msg;
+        
+        // A failed read or accept may have closed a connection.
+        eventSourcesChanged();
         // TODO: publish fault packet
     }
 }
 
 /******************************************************************************
- * Method: buildFDSet
- * Description: Build a fd_set of file descriptors of all of our read lines and
- * return the max file descriptor for use in a select statement.
+ * Method: handleEvent
+ * Description: Event loop callback.  Look up what the descriptor belongs to
+ * and call the matching handler.  Handlers may publish or open and close
+ * connections the publishers use, so they run with the publisher lock held.
  *
- * We need to read from several descriptors:
- *  * Observatory Command Connection (Listener)
- *  * Observatory Connection Connection (Client)
- *  * Observatory Data Connection (Listener)
- *  * Observatory Data Connection (Client)
- *  * Instrument Data Connection (Client)
- *  * Telnet Sniffer Connection (Listener)
- * 
- * Return:
- *  the maximum file descriptor value.
- *  readFDs populated with all current FDs available for reading
+ * Parameters:
+ *   fd - file descriptor that is ready
+ *   events - epoll event mask
  ******************************************************************************/
-int PortAgent::buildFDSet(fd_set &readFDs) {
-    int maxFD = 0;
-    
-    FD_ZERO(&readFDs);
+void PortAgent::handleEvent(int fd, uint32_t events) {
+    MutexLock lock(m_oPublisherLock);
+    EventSourceMap::iterator i = m_oEventSources.find(fd);
     
-    addObservatoryCommandListenerFD(maxFD, readFDs);
-    addObservatoryCommandClientFD(maxFD, readFDs);
-    addObservatoryDataListenerFD(maxFD, readFDs);
-    addObservatoryDataClientFD(maxFD, readFDs);
-    addInstrumentDataClientFD(maxFD, readFDs);
-    addTelnetSnifferListenerFD(maxFD, readFDs);
-    addTelnetSnifferClientFD(maxFD, readFDs);
+    if(i == m_oEventSources.end()) {
+        LOG(ERROR) << "event on unknown fd: " << fd;
+        m_oEventLoop.removeHandler(fd);
+        return;
+    }
     
-    return maxFD;
+    LOG(DEBUG2) << "event on fd: " << fd << " type: " << i->second.type;
+    
+    // Only a connecting instrument is watched for writability for any reason
+    // other than waiting output
+    if((events & EVENT_WRITE) && i->second.type != EVENT_INSTRUMENT_CONNECT) {
+        if(i->second.connection && !i->second.connection->flushOutput())
+            eventSourcesChanged();
+
+        // Writable is all we were told, there is nothing to read
+        if(!(events & ~EVENT_WRITE))
+            return;
+    }
+
+    switch(i->second.type) {
+        case EVENT_OBSERVATORY_COMMAND_LISTENER:
+            handleObservatoryCommandAccept();
+            break;
+        case EVENT_OBSERVATORY_COMMAND_CLIENT:
+            handleObservatoryCommandRead(fd);
+            break;
+        case EVENT_OBSERVATORY_DATA_LISTENER:
+            handleObservatoryDataAccept((TCPCommListener*)i->second.connection);
+            break;
+        case EVENT_OBSERVATORY_DATA_CLIENT:
+            handleObservatoryDataRead((TCPCommListener*)i->second.connection, fd);
+            break;
+        case EVENT_INSTRUMENT_DATA_CLIENT:
+            handleInstrumentDataRead(i->second.connection);
+            break;
+        case EVENT_TELNET_SNIFFER_LISTENER:
+            handleTelnetSnifferAccept();
+            break;
+        case EVENT_TELNET_SNIFFER_CLIENT:
+            handleTelnetSnifferRead(fd);
+            break;
+        case EVENT_PACKET_PIPELINE:
+            handlePacketPipelineNotify();
+            break;
+        case EVENT_INSTRUMENT_CONNECT:
+            handleInstrumentConnect();
+            break;
+    };
 }
 
 /******************************************************************************
- * Method: addTelnetSnifferListenerFD
- * Description: Add the telnet sniffer fd to the fd_set.  Also update
- * the max file descriptor.
+ * Method: handleTimer
+ * Description: Event loop timer callback.  The heartbeat timer publishes a
+ * heartbeat.  The reconnect timer has no work of its own, it wakes the loop
+ * so the state handlers try the instrument again.  The connect timer gives
+ * up on an instrument connect that is taking too long.
  *
- * If the connection isn't initialized then do nothing.
+ * Parameters:
+ *   id - timer that expired
  ******************************************************************************/
-void PortAgent::addTelnetSnifferListenerFD(int &maxFD, fd_set &readFDs) {
-    
-    if(m_pTelnetSnifferConnection) {
-        int fd = 0;
-    
-        if(m_pTelnetSnifferConnection->listening())
-            fd = getTelnetSnifferListenerFD();
+void PortAgent::handleTimer(TimerId id) {
+    MutexLock lock(m_oPublisherLock);
     
-        if(m_pTelnetSnifferConnection->listening() && fd) {
-            LOG(DEBUG2) << "add telnet sniffer listener FD";
-            maxFD = fd > maxFD ? fd : maxFD;
-            FD_SET(fd, &readFDs);
-        }
-        else {
-            LOG(DEBUG) << "telnet sniffer not initialized";
-        }
-    }
+    if(id == m_iHeartbeatTimer)
+        publishHeartbeat();
+    else if(id == m_iReconnectTimer)
+        LOG(DEBUG2) << "reconnect timer expired";
+    else if(id == m_iConnectTimer)
+        instrumentConnectFailed("connect timed out");
+    else if(id == m_iFramerTimer)
+        handleInstrumentFramerTimer();
+    else if(id == m_iThrottleTimer)
+        handleOutputThrottleTimer();
+    else if(id == m_iPublisherFlushTimer)
+        handlePublisherFlushTimer();
+    else if(id == m_iResolveTimer)
+        handleResolveTimer();
 }
 
 /******************************************************************************
- * Method: addTelnetSnifferClientFD
- * Description: Add the sniffer client fd to the fd_set.  Also update
- * the max file descriptor.
- *
- * If the connection isn't initialized then do nothing.
+ * Method: handleInstrumentFramerTimer
+ * Description: A partial instrument record may be due.  More data could have
+ * arrived since the timer was set, if so wait for the rest of the quiescent
+ * time instead of resetting the timer on every read.
  ******************************************************************************/
-void PortAgent::addTelnetSnifferClientFD(int &maxFD, fd_set &readFDs) {
-    if(m_pTelnetSnifferConnection) {
-        int fd = m_pTelnetSnifferConnection->clientFD();
-        
-        if(fd) {
-            LOG(DEBUG) << "add telnet sniffer client FD";
-            maxFD = fd > maxFD ? fd : maxFD;
-            FD_SET(fd, &readFDs);
-        }
-        else {
-            LOG(DEBUG) << "telnet sniffer client not initialized";
-        }    
+void PortAgent::handleInstrumentFramerTimer() {
+    uint64_t delay;
+
+    m_iFramerTimer = 0;
+
+    if(!m_pInstrumentFramer || !m_pInstrumentFramer->pending())
+        return;
+
+    delay = m_pInstrumentFramer->flushDelay(TimerQueue::now());
+    if(delay) {
+        m_iFramerTimer = m_oEventLoop.addTimer(delay, this);
+        return;
     }
+
+    flushInstrumentFramer();
 }
 
 /******************************************************************************
- * Method: addObservatoryCommandListenerFD
- * Description: Add the observatory connection fd to the fd_set.  Also update
- * the max file descriptor.
- *
- * If the connection isn't initialized then do nothing.
+ * Method: handleOutputThrottleTimer
+ * Description: Held instrument data may be due, either a token is ready or
+ * it has been held for the max hold time.
  ******************************************************************************/
-void PortAgent::addObservatoryCommandListenerFD(int &maxFD, fd_set &readFDs) {
-    CommBase *pConnection;
-    
-    if(m_pObservatoryConnection) {
-        pConnection = m_pObservatoryConnection->commandConnectionObject();
-        int fd = 0;
-    
-        if(m_pObservatoryConnection->commandInitialized())
+void PortAgent::handleOutputThrottleTimer() {
+    vector<SharedPacket *> ready;
+
+    m_iThrottleTimer = 0;
+
+    if(!m_pOutputThrottle)
+        return;
+
+    m_pOutputThrottle->poll(TimerQueue::now(), ready);
+    updateOutputThrottleTimer();
+
+    publishSharedPackets(ready);
+}
+
+/******************************************************************************
+ * Method: updateOutputThrottleTimer
+ * Description: Wake up when held data is due, if we aren't already going to.
+ ******************************************************************************/
+void PortAgent::updateOutputThrottleTimer() {
+    if(!m_pOutputThrottle || !m_pOutputThrottle->pending() ||
+       m_oEventLoop.timerPending(m_iThrottleTimer))
+        return;
+
+    m_iThrottleTimer = m_oEventLoop.addTimer(
+        m_pOutputThrottle->flushDelay(TimerQueue::now()), this);
+}
+
+/******************************************************************************
+ * Method: handlePublisherFlushTimer
+ * Description: Write out publisher batches that have waited long enough.
+ ******************************************************************************/
+void PortAgent::handlePublisherFlushTimer() {
+    m_iPublisherFlushTimer = 0;
+
+    try {
+        m_oPublishers.flushDue(TimerQueue::now());
+    }
+    catch(OOIException &e) {
+        LOG(ERROR) << "Failed to flush publishers: " << e.what();
+    }
+
+    updatePublisherFlushTimer();
+}
+
+/******************************************************************************
+ * Method: updatePublisherFlushTimer
+ * Description: Wake up when a publisher batch or data log commit is due, if
+ * we aren't already going to by then.  The data log can wait much longer
+ * than a batch, so a sooner deadline replaces the timer.
+ ******************************************************************************/
+void PortAgent::updatePublisherFlushTimer() {
+    if(!m_oPublishers.pending())
+        return;
+
+    uint64_t now = TimerQueue::now();
+    uint64_t delay = m_oPublishers.flushDelay(now);
+
+    if(m_oEventLoop.timerPending(m_iPublisherFlushTimer)) {
+        if(m_iPublisherFlushDeadline <= now + delay)
+            return;
+
+        m_oEventLoop.cancelTimer(m_iPublisherFlushTimer);
+    }
+
+    m_iPublisherFlushDeadline = now + delay;
+    m_iPublisherFlushTimer = m_oEventLoop.addTimer(delay, this);
+}
+
+/******************************************************************************
+ * Method: handleResolveTimer
+ * Description: Look up the multicast destination again if it is due.  The
+ * lookup can block, doing it here keeps it off the publish path.
+ ******************************************************************************/
+void PortAgent::handleResolveTimer() {
+    m_iResolveTimer = 0;
+
+    if(m_pMulticastConnection)
+        m_pMulticastConnection->checkResolve(TimerQueue::now());
+
+    updateResolveTimer();
+}
+
+/******************************************************************************
+ * Method: updateResolveTimer
+ * Description: Wake up when the multicast destination is due to be looked up
+ * again.  A failed write makes it due sooner, so a sooner deadline replaces
+ * the timer.
+ ******************************************************************************/
+void PortAgent::updateResolveTimer() {
+    if(!m_pMulticastConnection || !m_pMulticastConnection->connected())
+        return;
+
+    uint64_t now = TimerQueue::now();
+    uint64_t delay = m_pMulticastConnection->resolveDelay(now);
+
+    if(m_oEventLoop.timerPending(m_iResolveTimer)) {
+        if(m_iResolveDeadline <= now + delay)
+            return;
+
+        m_oEventLoop.cancelTimer(m_iResolveTimer);
+    }
+
+    m_iResolveDeadline = now + delay;
+    m_iResolveTimer = m_oEventLoop.addTimer(delay, this);
+}
+
+/******************************************************************************
+ * Method: updateHeartbeatTimer
+ * Description: Keep the repeating heartbeat timer in step with the configured
+ * heartbeat interval.  An interval of 0 disables heartbeats.
+ ******************************************************************************/
+void PortAgent::updateHeartbeatTimer() {
+    uint32_t interval = m_pConfig ? m_pConfig->heartbeatInterval() : 0;
+    
+    if(interval == m_iHeartbeatInterval && (!interval || m_oEventLoop.timerPending(m_iHeartbeatTimer)))
+        return;
+    
+    LOG(DEBUG) << "heartbeat interval changed: " << interval;
+    
+    m_oEventLoop.cancelTimer(m_iHeartbeatTimer);
+    m_iHeartbeatTimer = 0;
+    m_iHeartbeatInterval = interval;
+    
+    if(interval)
+        m_iHeartbeatTimer = m_oEventLoop.addTimer(interval * USEC_PER_SEC, this, interval * USEC_PER_SEC);
+}
+
+/******************************************************************************
+ * Method: reconnectPending
+ * Description: Are we still waiting before the next connection attempt?
+ ******************************************************************************/
+bool PortAgent::reconnectPending() {
+    return m_oEventLoop.timerPending(m_iReconnectTimer);
+}
+
+/******************************************************************************
+ * Method: startInstrumentConnect
+ * Description: Start a non-blocking connect on each instrument socket that
+ * isn't connected.  The event loop tells us when the sockets become writable
+ * and handleInstrumentConnect() finishes the job.
+ *
+ * State Transitions:
+ *  Connected - if every socket connected straight away
+ *  Disconnected - while the connect is in progress or after it failed
+ ******************************************************************************/
+void PortAgent::startInstrumentConnect() {
+    vector<TCPCommSocket *> sockets;
+    vector<TCPCommSocket *>::iterator i;
+    ostringstream msg;
+
+    getInstrumentSockets(sockets);
+
+    m_oEventLoop.cancelTimer(m_iReconnectTimer);
+    m_iReconnectTimer = 0;
+
+    setState(STATE_DISCONNECTED);
+    eventSourcesChanged();
+
+    msg << "INSTRUMENT_CONNECTING " << m_pConfig->instrumentAddr();
+    publishStatus(msg.str());
+
+    try {
+        for(i = sockets.begin(); i != sockets.end(); i++) {
+            if(!(*i)->connected() && !(*i)->connecting())
+                (*i)->startConnect();
+        }
+    }
+    catch(OOIException &e) {
+        instrumentConnectFailed(e.what());
+        return;
+    }
+    
+    if(m_pInstrumentConnection->dataConnected()) {
+        instrumentConnected();
+        return;
+    }
+
+    m_oEventLoop.cancelTimer(m_iConnectTimer);
+    m_iConnectTimer = m_oEventLoop.addTimer(INSTRUMENT_CONNECT_TIMEOUT * USEC_PER_SEC, this);
+}
+
+/******************************************************************************
+ * Method: instrumentConnecting
+ * Description: Is a non-blocking connect to the instrument in progress?
+ ******************************************************************************/
+bool PortAgent::instrumentConnecting() {
+    vector<TCPCommSocket *> sockets;
+    vector<TCPCommSocket *>::iterator i;
+
+    getInstrumentSockets(sockets);
+
+    for(i = sockets.begin(); i != sockets.end(); i++) {
+        if((*i)->connecting())
+            return true;
+    }
+
+    return false;
+}
+
+/******************************************************************************
+ * Method: instrumentConnected
+ * Description: The instrument connection is up.
+ *
+ * State Transitions:
+ *  Connected
+ ******************************************************************************/
+void PortAgent::instrumentConnected() {
+    m_oEventLoop.cancelTimer(m_iConnectTimer);
+    m_iConnectTimer = 0;
+
+    m_iConnectedSince = TimerQueue::now();
+
+    setState(STATE_CONNECTED);
+    eventSourcesChanged();
+
+    publishStatus("INSTRUMENT_CONNECTED");
+}
+
+/******************************************************************************
+ * Method: instrumentConnectFailed
+ * Description: A connection attempt failed.  Close whatever is left of the
+ * connection and wait for the next backoff delay before trying again.
+ *
+ * Parameters:
+ *   reason - why the attempt failed, included in the status packet
+ *
+ * State Transitions:
+ *  Disconnected
+ ******************************************************************************/
+void PortAgent::instrumentConnectFailed(const string &reason) {
+    vector<TCPCommSocket *> sockets;
+    vector<TCPCommSocket *>::iterator i;
+    uint32_t delay;
+    ostringstream msg;
+
+    if(m_pPacketPipeline)
+        m_pPacketPipeline->setSource(-1);
+
+    getInstrumentSockets(sockets);
+    for(i = sockets.begin(); i != sockets.end(); i++)
+        (*i)->disconnect();
+
+    m_oEventLoop.cancelTimer(m_iConnectTimer);
+    m_iConnectTimer = 0;
+
+    m_oReconnectBackoff.setLimits(m_pConfig->reconnectMinDelay(),
+                                  m_pConfig->reconnectMaxDelay(),
+                                  m_pConfig->reconnectJitter());
+    delay = m_oReconnectBackoff.nextDelay();
+
+    m_oEventLoop.cancelTimer(m_iReconnectTimer);
+    m_iReconnectTimer = m_oEventLoop.addTimer(delay * USEC_PER_MSEC, this);
+
+    setState(STATE_DISCONNECTED);
+    eventSourcesChanged();
+
+    msg << "INSTRUMENT_CONNECT_FAILED " << reason << " attempt: "
+        << m_oReconnectBackoff.attempts() << " retry in " << delay << " ms";
+    publishStatus(msg.str());
+}
+
+/******************************************************************************
+ * Method: instrumentLost
+ * Description: The instrument dropped an established connection.  If it had
+ * been up for a while reconnect straight away, otherwise the instrument is
+ * flapping so count it as a failed attempt and back off.
+ *
+ * State Transitions:
+ *  Disconnected
+ ******************************************************************************/
+void PortAgent::instrumentLost() {
+    uint64_t uptime = TimerQueue::now() - m_iConnectedSince;
+
+    LOG(DEBUG2) << "instrument connection lost after " << uptime << " us";
+
+    if(uptime >= m_pConfig->reconnectMaxDelay() * USEC_PER_MSEC) {
+        m_oReconnectBackoff.reset();
+
+        setState(STATE_DISCONNECTED);
+        publishStatus("INSTRUMENT_DISCONNECTED");
+
+        initializeInstrumentConnection();
+        eventSourcesChanged();
+    }
+    else {
+        instrumentConnectFailed("connection lost");
+    }
+}
+
+/******************************************************************************
+ * Method: handleInstrumentConnect
+ * Description: An instrument socket with a connect in progress is writable.
+ * Check the result and move on once every socket is connected.
+ ******************************************************************************/
+void PortAgent::handleInstrumentConnect() {
+    vector<TCPCommSocket *> sockets;
+    vector<TCPCommSocket *>::iterator i;
+
+    getInstrumentSockets(sockets);
+
+    try {
+        for(i = sockets.begin(); i != sockets.end(); i++) {
+            if((*i)->connecting())
+                (*i)->finishConnect();
+        }
+    }
+    catch(OOIException &e) {
+        instrumentConnectFailed(e.what());
+        return;
+    }
+
+    if(m_pInstrumentConnection->dataConnected())
+        instrumentConnected();
+}
+
+/******************************************************************************
+ * Method: updateEventSources
+ * Description: Bring the event loop registrations in line with the current
+ * connections.  This is only needed when a connection has been opened or
+ * closed, or the state has changed, so the cost isn't paid on every pass.
+ *
+ * We need to read from several descriptors:
+ *  * Observatory Command Connection (Listener)
+ *  * Observatory Connection Connection (Client)
+ *  * Observatory Data Connection (Listener)
+ *  * Observatory Data Connection (Client)
+ *  * Instrument Data Connection (Client)
+ *  * Telnet Sniffer Connection (Listener)
+ *
+ * The observatory data listener and instrument are only serviced once we are
+ * configured.  In pipeline mode the instrument is handed to the pipeline
+ * reader instead and we watch for its notifications.
+ ******************************************************************************/
+void PortAgent::updateEventSources() {
+    EventSourceMap sources;
+    EventSourceMap::iterator i;
+    
+    LOG(DEBUG) << "update event loop registrations";
+    
+    addObservatoryCommandListenerFD(sources);
+    addObservatoryCommandClientFD(sources);
+    addObservatoryDataClientFD(sources);
+    addTelnetSnifferListenerFD(sources);
+    addTelnetSnifferClientFD(sources);
+    
+    addPacketPipelineFD(sources);
+    
+    if(getCurrentState() == STATE_CONNECTED || getCurrentState() == STATE_DISCONNECTED) {
+        addObservatoryDataListenerFD(sources);
+        addInstrumentDataClientFD(sources);
+        addInstrumentConnectFDs(sources);
+    }
+    else if(m_pPacketPipeline) {
+        m_pPacketPipeline->setSource(-1);
+    }
+    
+    // Drop descriptors we no longer service
+    for(i = m_oEventSources.begin(); i != m_oEventSources.end(); i++) {
+        if(sources.find(i->first) == sources.end())
+            m_oEventLoop.removeHandler(i->first);
+    }
+    
+    // A closed descriptor number may have been reused by a new connection
+    // so re-register everything, the loop handles existing registrations.
+    for(i = sources.begin(); i != sources.end(); i++)
+        m_oEventLoop.addHandler(i->first, this, i->second.events);
+    
+    m_oEventSources = sources;
+    m_bEventSourcesChanged = false;
+}
+
+/******************************************************************************
+ * Method: addEventSource
+ * Description: Add a descriptor to the event source map.
+ ******************************************************************************/
+void PortAgent::addEventSource(EventSourceMap &sources, int fd, EventSourceType type,
+                               CommBase *connection) {
+    EventSource source;
+    
+    source.type = type;
+    source.connection = connection;
+    source.events = EVENT_READ;
+
+    // Output waiting on a slow client goes out when it is writable.  A
+    // listener has a buffer for each of its clients.
+    if(connection && connection->type() == COMM_TCP_LISTENER) {
+        if(((TCPCommListener *)connection)->outputPending(fd))
+            source.events |= EVENT_WRITE;
+    }
+    else if(connection && connection->outputPending())
+        source.events |= EVENT_WRITE;
+
+    sources[fd] = source;
+}
+
+/******************************************************************************
+ * Method: addListenerClientFDs
+ * Description: Add every client of a TCP listener to the event sources.
+ ******************************************************************************/
+void PortAgent::addListenerClientFDs(EventSourceMap &sources, TCPCommListener *listener,
+                                     EventSourceType type) {
+    vector<int> fds;
+
+    listener->clientFDs(fds);
+
+    for(vector<int>::iterator i = fds.begin(); i != fds.end(); i++) {
+        LOG(DEBUG2) << "add client FD: " << *i << " type: " << type;
+        addEventSource(sources, *i, type, listener);
+    }
+}
+
+/******************************************************************************
+ * Method: addTelnetSnifferListenerFD
+ * Description: Add the telnet sniffer fd to the event sources.
+ *
+ * If the connection isn't initialized then do nothing.
+ ******************************************************************************/
+void PortAgent::addTelnetSnifferListenerFD(EventSourceMap &sources) {
+    
+    if(m_pTelnetSnifferConnection) {
+        int fd = 0;
+    
+        if(m_pTelnetSnifferConnection->listening())
+            fd = getTelnetSnifferListenerFD();
+    
+        if(m_pTelnetSnifferConnection->listening() && fd) {
+            LOG(DEBUG2) << "add telnet sniffer listener FD";
+            addEventSource(sources, fd, EVENT_TELNET_SNIFFER_LISTENER, m_pTelnetSnifferConnection);
+        }
+        else {
+            LOG(DEBUG) << "telnet sniffer not initialized";
+        }
+    }
+}
+
+/******************************************************************************
+ * Method: addTelnetSnifferClientFD
+ * Description: Add the sniffer client fd to the event sources.
+ *
+ * If the connection isn't initialized then do nothing.
+ ******************************************************************************/
+void PortAgent::addTelnetSnifferClientFD(EventSourceMap &sources) {
+    if(m_pTelnetSnifferConnection) {
+        int fd = m_pTelnetSnifferConnection->clientFD();
+        
+        if(fd) {
+            LOG(DEBUG) << "add telnet sniffer client FDs";
+            addListenerClientFDs(sources, m_pTelnetSnifferConnection, EVENT_TELNET_SNIFFER_CLIENT);
+        }
+        else {
+            LOG(DEBUG) << "telnet sniffer client not initialized";
+        }    
+    }
+}
+
+/******************************************************************************
+ * Method: addObservatoryCommandListenerFD
+ * Description: Add the observatory connection fd to the event sources.
+ *
+ * If the connection isn't initialized then do nothing.
+ ******************************************************************************/
+void PortAgent::addObservatoryCommandListenerFD(EventSourceMap &sources) {
+    CommBase *pConnection;
+    
+    if(m_pObservatoryConnection) {
+        pConnection = m_pObservatoryConnection->commandConnectionObject();
+        int fd = 0;
+    
+        if(m_pObservatoryConnection->commandInitialized())
             fd = getObservatoryCommandListenerFD();
     
         if(m_pObservatoryConnection->commandInitialized() && fd) {
             LOG(DEBUG2) << "add observatory command listener FD";
-            maxFD = fd > maxFD ? fd : maxFD;
-            FD_SET(fd, &readFDs);
+            addEventSource(sources, fd, EVENT_OBSERVATORY_COMMAND_LISTENER, pConnection);
         }
         else {
             LOG(DEBUG2) << "Observatory command listener not initialized";
@@ -1170,12 +2084,11 @@ void PortAgent::addObservatoryCommandListenerFD(int &maxFD, fd_set &readFDs) {
 
 /******************************************************************************
  * Method: addObservatoryCommandClientFD
- * Description: Add the observatory connection fd to the fd_set.  Also update
- * the max file descriptor.
+ * Description: Add the observatory connection fd to the event sources.
  *
  * If the connection isn't initialized then do nothing.
  ******************************************************************************/
-void PortAgent::addObservatoryCommandClientFD(int &maxFD, fd_set &readFDs) {
+void PortAgent::addObservatoryCommandClientFD(EventSourceMap &sources) {
     CommBase *pConnection;
     
     if(m_pObservatoryConnection) {
@@ -1186,9 +2099,9 @@ void PortAgent::addObservatoryCommandClientFD(int &maxFD, fd_set &readFDs) {
             fd = getObservatoryCommandClientFD();
         
         if(m_pObservatoryConnection->commandConnected() && fd) {
-            LOG(DEBUG2) << "add observatory command client FD";
-            maxFD = fd > maxFD ? fd : maxFD;
-            FD_SET(fd, &readFDs);
+            LOG(DEBUG2) << "add observatory command client FDs";
+            addListenerClientFDs(sources, (TCPCommListener *)pConnection,
+                                 EVENT_OBSERVATORY_COMMAND_CLIENT);
         }
         else {
             LOG(DEBUG2) << "Observatory data client not initialized";
@@ -1199,20 +2112,20 @@ void PortAgent::addObservatoryCommandClientFD(int &maxFD, fd_set &readFDs) {
 /******************************************************************************
  * Method: addObservatoryDataListenerFD
  * Description: Depending upon the type of observatory connection, invoke the
- * appropriate method to add the FD(s) to the select fd set.
+ * appropriate method to add the FD(s) to the event sources.
  *
  ******************************************************************************/
-void PortAgent::addObservatoryDataListenerFD(int &maxFD, fd_set &readFDs) {
+void PortAgent::addObservatoryDataListenerFD(EventSourceMap &sources) {
     PortAgentConnectionType connectionType;
 
     if (m_pObservatoryConnection) {
         connectionType = m_pObservatoryConnection->connectionType();
 
         if (PACONN_OBSERVATORY_STANDARD == connectionType) {
-            addObservatoryStandardDataListenerFD(maxFD, readFDs);
+            addObservatoryStandardDataListenerFD(sources);
         }
         else if (PACONN_OBSERVATORY_MULTI == connectionType) {
-            addObservatoryMultiDataListenerFDs(maxFD, readFDs);
+            addObservatoryMultiDataListenerFDs(sources);
         }
         else {
             LOG(ERROR) << "PortAgent::addObservatoryDataListenerFD: unknown observatory type: " << connectionType;
@@ -1222,12 +2135,11 @@ void PortAgent::addObservatoryDataListenerFD(int &maxFD, fd_set &readFDs) {
 
 /******************************************************************************
  * Method: addObservatoryStandardDataListenerFD
- * Description: Add the observatory data fd to the fd_set.  Also update
- * the max file descriptor.
+ * Description: Add the observatory data fd to the event sources.
  *
  * If the connection isn't initialized then do nothing.
  ******************************************************************************/
-void PortAgent::addObservatoryStandardDataListenerFD(int &maxFD, fd_set &readFDs) {
+void PortAgent::addObservatoryStandardDataListenerFD(EventSourceMap &sources) {
     CommBase *pConnection;
     
     if (m_pObservatoryConnection) {
@@ -1239,8 +2151,7 @@ void PortAgent::addObservatoryStandardDataListenerFD(int &maxFD, fd_set &readFDs
     
         if(m_pObservatoryConnection->dataInitialized() && fd) {
             LOG(DEBUG2) << "add observatory data listener FD";
-            maxFD = fd > maxFD ? fd : maxFD;
-            FD_SET(fd, &readFDs);
+            addEventSource(sources, fd, EVENT_OBSERVATORY_DATA_LISTENER, pConnection);
         }
         else {
             LOG(DEBUG2) << "Observatory data listener not initialized";
@@ -1250,12 +2161,12 @@ void PortAgent::addObservatoryStandardDataListenerFD(int &maxFD, fd_set &readFDs
 
 /******************************************************************************
  * Method: addObservatoryMultiDataListenerFDs
- * Description: Iterate through the listeners, adding their fds to the fd_set.
- * Also update the max file descriptor.
+ * Description: Iterate through the listeners, adding their fds to the event
+ * sources.
  *
  * If the connection isn't initialized then do nothing.
  ******************************************************************************/
-void PortAgent::addObservatoryMultiDataListenerFDs(int &maxFD, fd_set &readFDs) {
+void PortAgent::addObservatoryMultiDataListenerFDs(EventSourceMap &sources) {
     TCPCommListener* pListener = 0;
 
     if (m_pObservatoryConnection) {
@@ -1265,8 +2176,7 @@ void PortAgent::addObservatoryMultiDataListenerFDs(int &maxFD, fd_set &readFDs)
                 int fd = pListener->serverFD();
                 if (fd) {
                     LOG(DEBUG2) << "adding observatory multi data listener FD: " << fd;
-                    maxFD = fd > maxFD ? fd : maxFD;
-                    FD_SET(fd, &readFDs);
+                    addEventSource(sources, fd, EVENT_OBSERVATORY_DATA_LISTENER, pListener);
                 }
             }
             pListener = ObservatoryDataSockets::instance()->getNextSocket();
@@ -1277,21 +2187,21 @@ void PortAgent::addObservatoryMultiDataListenerFDs(int &maxFD, fd_set &readFDs)
 /******************************************************************************
  * Method: addObservatoryDataClientFD
  * Description: Depending upon the observatory connection type, add the data
- * FD(s) to the select fd_set.
+ * FD(s) to the event sources.
  *
  * If the connection isn't initialized then do nothing.
  ******************************************************************************/
-void PortAgent::addObservatoryDataClientFD(int &maxFD, fd_set &readFDs) {
+void PortAgent::addObservatoryDataClientFD(EventSourceMap &sources) {
     PortAgentConnectionType connectionType;
 
     if (m_pObservatoryConnection) {
         connectionType = m_pObservatoryConnection->connectionType();
 
         if (PACONN_OBSERVATORY_STANDARD == connectionType) {
-            addObservatoryStandardDataClientFD(maxFD, readFDs);
+            addObservatoryStandardDataClientFD(sources);
         }
         else if (PACONN_OBSERVATORY_MULTI == connectionType) {
-            addObservatoryMultiDataClientFDs(maxFD, readFDs);
+            addObservatoryMultiDataClientFDs(sources);
         }
         else {
             LOG(ERROR) << "PortAgent::addObservatoryDataClientFD: unknown observatory type: " << connectionType;
@@ -1301,12 +2211,11 @@ void PortAgent::addObservatoryDataClientFD(int &maxFD, fd_set &readFDs) {
 
 /******************************************************************************
  * Method: addObservatoryStandardDataClientFD
- * Description: Add the observatory data fd to the fd_set.  Also update
- * the max file descriptor.
+ * Description: Add the observatory data fd to the event sources.
  *
  * If the connection isn't initialized then do nothing.
  ******************************************************************************/
-void PortAgent::addObservatoryStandardDataClientFD(int &maxFD, fd_set &readFDs) {
+void PortAgent::addObservatoryStandardDataClientFD(EventSourceMap &sources) {
     CommBase *pConnection;
 
     if(m_pObservatoryConnection) {
@@ -1316,9 +2225,9 @@ void PortAgent::addObservatoryStandardDataClientFD(int &maxFD, fd_set &readFDs)
         fd = getObservatoryDataClientFD();
 
         if(fd) {
-            LOG(DEBUG2) << "add observatory data client FD";
-            maxFD = fd > maxFD ? fd : maxFD;
-            FD_SET(fd, &readFDs);
+            LOG(DEBUG2) << "add observatory data client FDs";
+            addListenerClientFDs(sources, (TCPCommListener *)pConnection,
+                                 EVENT_OBSERVATORY_DATA_CLIENT);
         }
         else {
             LOG(DEBUG2) << "Observatory data client not initialized";
@@ -1328,12 +2237,12 @@ void PortAgent::addObservatoryStandardDataClientFD(int &maxFD, fd_set &readFDs)
 
 /******************************************************************************
  * Method: addObservatoryMultiDataClientFD
- * Description: Iterate through the connections, adding their fds to the fd_set.
- * Also update the max file descriptor.
+ * Description: Iterate through the connections, adding their fds to the event
+ * sources.
  *
  * If the connection isn't initialized then do nothing.
  ******************************************************************************/
-void PortAgent::addObservatoryMultiDataClientFDs(int &maxFD, fd_set &readFDs) {
+void PortAgent::addObservatoryMultiDataClientFDs(EventSourceMap &sources) {
     TCPCommListener* pListener = 0;
     
     if (m_pObservatoryConnection) {
@@ -1342,9 +2251,8 @@ void PortAgent::addObservatoryMultiDataClientFDs(int &maxFD, fd_set &readFDs) {
             if (pListener->connected()) {
                 int fd = pListener->clientFD();
                 if (fd) {
-                    LOG(DEBUG2) << "adding observatory multi data client FD: " << fd;
-                    maxFD = fd > maxFD ? fd : maxFD;
-                    FD_SET(fd, &readFDs);
+                    LOG(DEBUG2) << "adding observatory multi data client FDs, authority: " << fd;
+                    addListenerClientFDs(sources, pListener, EVENT_OBSERVATORY_DATA_CLIENT);
                 }
             }
             pListener = ObservatoryDataSockets::instance()->getNextSocket();
@@ -1354,35 +2262,65 @@ void PortAgent::addObservatoryMultiDataClientFDs(int &maxFD, fd_set &readFDs) {
 
 /******************************************************************************
  * Method: addInstrumentDataClientFD
- * Description: Add the instrument client fd to the fd_set.  Also update
- * the max file descriptor.
+ * Description: Add the instrument client fd to the event sources.
  *
  * If the connection isn't initialized then do nothing.
  ******************************************************************************/
-void PortAgent::addInstrumentDataClientFD(int &maxFD, fd_set &readFDs) {
+void PortAgent::addInstrumentDataClientFD(EventSourceMap &sources) {
     CommBase *pConnection;
-    
+    int fd = 0;
 
     if(m_pInstrumentConnection) {
-        if (m_pInstrumentConnection->connectionType() == PACONN_INSTRUMENT_BOTPT) {
-            pConnection = ((InstrumentBOTPTConnection*) m_pInstrumentConnection)->dataTxConnectionObject();
-        }
-        else {
-            pConnection = m_pInstrumentConnection->dataConnectionObject();
-        }
-        int fd = 0;
+        pConnection = getInstrumentDataRxConnection();
         
         fd = getInstrumentDataRxClientFD();
         
-        if (fd) {
+        if (fd && m_pPacketPipeline) {
+            LOG(DEBUG2) << "hand instrument data client FD to the pipeline";
+        }
+        else if (fd) {
             LOG(DEBUG2) << "add instrument data client FD";
-            maxFD = fd > maxFD ? fd : maxFD;
-            FD_SET(fd, &readFDs);
+            addEventSource(sources, fd, EVENT_INSTRUMENT_DATA_CLIENT, pConnection);
         }
         else {
             LOG(DEBUG2) << "Observatory data client not initialized";
         }    
     }
+    
+    if(m_pPacketPipeline)
+        m_pPacketPipeline->setSource(fd ? fd : -1);
+}
+
+/******************************************************************************
+ * Method: addPacketPipelineFD
+ * Description: Watch the pipeline notification descriptor so we hear about
+ * the instrument dropping while the pipeline is reading it.
+ ******************************************************************************/
+void PortAgent::addPacketPipelineFD(EventSourceMap &sources) {
+    if(m_pPacketPipeline) {
+        LOG(DEBUG2) << "add packet pipeline FD";
+        addEventSource(sources, m_pPacketPipeline->notifyFD(), EVENT_PACKET_PIPELINE, NULL);
+    }
+}
+
+/******************************************************************************
+ * Method: addInstrumentConnectFDs
+ * Description: Watch instrument sockets with a connect in progress.  They
+ * become writable when the connect completes or fails.
+ ******************************************************************************/
+void PortAgent::addInstrumentConnectFDs(EventSourceMap &sources) {
+    vector<TCPCommSocket *> sockets;
+    vector<TCPCommSocket *>::iterator i;
+
+    getInstrumentSockets(sockets);
+
+    for(i = sockets.begin(); i != sockets.end(); i++) {
+        if((*i)->connecting()) {
+            LOG(DEBUG2) << "add instrument connect FD";
+            addEventSource(sources, (*i)->getSocketFD(), EVENT_INSTRUMENT_CONNECT, *i);
+            sources[(*i)->getSocketFD()].events = EVENT_WRITE;
+        }
+    }
 }
 
 /******************************************************************************
@@ -1483,21 +2421,44 @@ int PortAgent::getInstrumentDataTxClientFD() {
     return 0;
 }
 
+/******************************************************************************
+ * Method: getInstrumentDataRxConnection
+ * Description: Get the connection object we read instrument data from.
+ ******************************************************************************/
+CommBase * PortAgent::getInstrumentDataRxConnection() {
+    if (m_pInstrumentConnection->connectionType() == PACONN_INSTRUMENT_BOTPT)
+        return ((InstrumentBOTPTConnection*) m_pInstrumentConnection)->dataRxConnectionObject();
+    
+    return m_pInstrumentConnection->dataConnectionObject();
+}
+
+/******************************************************************************
+ * Method: getInstrumentSockets
+ * Description: The TCP sockets used by the instrument connection, if it is a
+ * TCP or BOTPT connection.  Serial connections have none.
+ ******************************************************************************/
+void PortAgent::getInstrumentSockets(vector<TCPCommSocket *> &sockets) {
+    if(!m_pInstrumentConnection)
+        return;
+
+    if(m_pInstrumentConnection->connectionType() == PACONN_INSTRUMENT_TCP) {
+        sockets.push_back((TCPCommSocket *)m_pInstrumentConnection->dataConnectionObject());
+    }
+    else if(m_pInstrumentConnection->connectionType() == PACONN_INSTRUMENT_BOTPT) {
+        InstrumentBOTPTConnection *connection = (InstrumentBOTPTConnection *)m_pInstrumentConnection;
+        sockets.push_back((TCPCommSocket *)connection->dataTxConnectionObject());
+        sockets.push_back((TCPCommSocket *)connection->dataRxConnectionObject());
+    }
+}
+
 /******************************************************************************
  * Method: getInstrumentDataRxClientFD
  * Description: Get the Rx file descriptor
  ******************************************************************************/
 int PortAgent::getInstrumentDataRxClientFD() {
-    CommBase *pConnection;;
+    CommBase *pConnection = getInstrumentDataRxConnection();
     TCPCommSocket *socket;
 
-    if (m_pInstrumentConnection->connectionType() == PACONN_INSTRUMENT_BOTPT) {
-        pConnection = ((InstrumentBOTPTConnection*) m_pInstrumentConnection)->dataRxConnectionObject();
-    }
-    else {
-        pConnection = m_pInstrumentConnection->dataConnectionObject();
-    }
-
     if (m_pInstrumentConnection->dataConnected()) {
         socket = (TCPCommSocket*)pConnection;
         if(socket && socket->connected())
@@ -1512,21 +2473,15 @@ int PortAgent::getInstrumentDataRxClientFD() {
 
 /******************************************************************************
  * Method: publishHeartbeat
- * Description: Generate a heartbeat packet if the heartbeat timeout has been
- *              exceeded.
+ * Description: Generate a heartbeat packet and send it to the publishers.
+ * Called from the heartbeat timer.
  ******************************************************************************/
 void PortAgent::publishHeartbeat() {
     Timestamp ts;
-    time_t now = time(NULL);
     
-    // if we have specificed a heartbeat interval and we need to send a heartbeat
-    if(m_pConfig->heartbeatInterval() && now - m_lLastHeartbeat > m_pConfig->heartbeatInterval() ) {
-        
-        Packet packet(PORT_AGENT_HEARTBEAT, ts, "", 0);
-        LOG(DEBUG) << "Port Agent Heartbeat";
-        publishPacket(&packet);
-        m_lLastHeartbeat = now;
-    }
+    SharedPacket *packet = SharedPacket::create(PORT_AGENT_HEARTBEAT, ts, NULL, 0);
+    LOG(DEBUG) << "Port Agent Heartbeat";
+    publishSharedPacket(packet);
 }
 
 /******************************************************************************
@@ -1535,10 +2490,10 @@ void PortAgent::publishHeartbeat() {
  ******************************************************************************/
 void PortAgent::publishFault(const string &msg) {
     Timestamp ts;
-    Packet packet(PORT_AGENT_FAULT, ts, (char *)(msg.c_str()), msg.length());
+    SharedPacket *packet = SharedPacket::create(PORT_AGENT_FAULT, ts, msg.c_str(), msg.length());
 
     LOG(ERROR) << "Port Agent Fault: " << msg;
-    publishPacket(&packet);
+    publishSharedPacket(packet);
 }
 
 /******************************************************************************
@@ -1547,10 +2502,10 @@ void PortAgent::publishFault(const string &msg) {
  ******************************************************************************/
 void PortAgent::publishStatus(const string &msg) {
     Timestamp ts;
-    Packet packet(PORT_AGENT_STATUS, ts, (char *)(msg.c_str()), msg.length());
+    SharedPacket *packet = SharedPacket::create(PORT_AGENT_STATUS, ts, msg.c_str(), msg.length());
 
     LOG(ERROR) << "Port Agent Status: " << msg;
-    publishPacket(&packet);
+    publishSharedPacket(packet);
 }
 
 /******************************************************************************
@@ -1569,53 +2524,148 @@ void PortAgent::publishPacket(Packet *packet) {
  ******************************************************************************/
 void PortAgent::publishPacket(char *payload, uint16_t size, PacketType type) {
     Timestamp ts;
-    Packet packet(type, ts, payload, size);
-    publishPacket(&packet); 
+    publishSharedPacket(SharedPacket::create(type, ts, payload, size));
+}
+
+/******************************************************************************
+ * Method: publishSharedPacket
+ * Description: Publish a shared packet and drop our reference to it.
+ * Publishers that need the packet later hold their own reference.
+ ******************************************************************************/
+void PortAgent::publishSharedPacket(SharedPacket *packet) {
+    try {
+        publishPacket(packet);
+    }
+    catch(OOIException &e) {
+        packet->release();
+        throw;
+    }
+
+    packet->release();
+}
+
+/******************************************************************************
+ * Method: publishSharedPackets
+ * Description: Publish a list of shared packets.  We own the packets, every
+ * one is released even if publishing fails.
+ ******************************************************************************/
+void PortAgent::publishSharedPackets(vector<SharedPacket *> &packets) {
+    vector<SharedPacket *>::iterator i = packets.begin();
+
+    try {
+        for(; i != packets.end(); i++)
+            publishSharedPacket(*i);
+    }
+    catch(OOIException &e) {
+        // publishSharedPacket released the one that failed
+        for(i++; i != packets.end(); i++)
+            (*i)->release();
+        throw;
+    }
+}
+
+/******************************************************************************
+ * Method: publishInstrumentPackets
+ * Description: Publish instrument data, through the output throttle if it is
+ * on.  The throttle may hold the data back and send it later.
+ ******************************************************************************/
+void PortAgent::publishInstrumentPackets(vector<SharedPacket *> &packets) {
+    vector<SharedPacket *> ready;
+    vector<SharedPacket *>::iterator i;
+    uint64_t now;
+
+    if(!m_pOutputThrottle) {
+        publishSharedPackets(packets);
+        return;
+    }
+
+    now = TimerQueue::now();
+    for(i = packets.begin(); i != packets.end(); i++)
+        m_pOutputThrottle->add(*i, now, ready);
+
+    updateOutputThrottleTimer();
+    publishSharedPackets(ready);
+}
+
+/******************************************************************************
+ * Method: publishInstrumentPacket
+ * Description: Publish one instrument data packet.
+ ******************************************************************************/
+void PortAgent::publishInstrumentPacket(SharedPacket *packet) {
+    if(!m_pOutputThrottle) {
+        publishSharedPacket(packet);
+        return;
+    }
+
+    vector<SharedPacket *> packets(1, packet);
+    publishInstrumentPackets(packets);
+}
+
+/******************************************************************************
+ * Method: flushInstrumentFramer
+ * Description: Publish the record in progress, if there is one.
+ ******************************************************************************/
+void PortAgent::flushInstrumentFramer() {
+    SharedPacket *packet;
+
+    m_oEventLoop.cancelTimer(m_iFramerTimer);
+    m_iFramerTimer = 0;
+
+    if(!m_pInstrumentFramer)
+        return;
+
+    packet = m_pInstrumentFramer->flush();
+    if(packet)
+        publishInstrumentPacket(packet);
+}
+
+/******************************************************************************
+ * Method: flushOutputThrottle
+ * Description: Publish whatever the output throttle is holding now.
+ ******************************************************************************/
+void PortAgent::flushOutputThrottle() {
+    SharedPacket *packet;
+
+    m_oEventLoop.cancelTimer(m_iThrottleTimer);
+    m_iThrottleTimer = 0;
+
+    if(!m_pOutputThrottle)
+        return;
+
+    packet = m_pOutputThrottle->flush();
+    if(packet)
+        publishSharedPacket(packet);
 }
 
 /******************************************************************************
  * Method: handleTelnetSnifferAccept
  * Description: Accept connection to the telnet sniffer connection.
  ******************************************************************************/
-void PortAgent::handleTelnetSnifferAccept(const fd_set &readFDs) {
-    int serverFD = getTelnetSnifferListenerFD();
-    
-    LOG(DEBUG) << "handleTelnetSnifferAccept - do we need to accept a new connection?";
-    LOG(DEBUG2) << "Telnet Sniffer Listener FD: " << serverFD;
-        
-    // Accept a new client
-    if(serverFD && FD_ISSET(serverFD, &readFDs)) {
-        LOG(DEBUG) << "Telnet sniffer listener has data";
-        handleTCPConnect(*m_pTelnetSnifferConnection);
-        LOG(DEBUG) << "telnet sniffer client fd: " << m_pTelnetSnifferConnection->clientFD();
-    }
+void PortAgent::handleTelnetSnifferAccept() {
+    LOG(DEBUG) << "Telnet sniffer listener has data";
+    handleTCPConnect(*m_pTelnetSnifferConnection);
+    LOG(DEBUG) << "telnet sniffer client fd: " << m_pTelnetSnifferConnection->clientFD();
 }
 
 /******************************************************************************
  * Method: handleTelnetSnifferRead
- * Description: Read from the telnet sniffer.  All data is ignored, but we need
- * the read to detect disconnects.
+ * Description: Read from a telnet sniffer client.  All data is ignored, but
+ * we need the read to detect disconnects.
  ******************************************************************************/
-void PortAgent::handleTelnetSnifferRead(const fd_set &readFDs) {
-    int clientFD = 0;
+void PortAgent::handleTelnetSnifferRead(int fd) {
     int bytesRead = 0;
     char buffer[1024];
     
-    if(m_pTelnetSnifferConnection)
-        clientFD = m_pTelnetSnifferConnection->clientFD();
+    LOG(DEBUG) << "Read data from Telnet Sniffer Client FD: " << fd;
+    bytesRead = m_pTelnetSnifferConnection->readClient(fd, buffer, 1023);
+    buffer[bytesRead] = '\0';
     
-    LOG(DEBUG) << "handleTelnetSnifferAccept - do we need to read from the telnet sniffer";
-    LOG(DEBUG) << "Telnet Sniffer Client FD: " << clientFD;
-        
-    if(clientFD && FD_ISSET(clientFD, &readFDs)) {
-        LOG(DEBUG) << "Read data from Telnet Sniffer Client FD: " << clientFD;
-        bytesRead = m_pTelnetSnifferConnection->readData(buffer, 1023);
-        buffer[bytesRead] = '\0';
-        
-        if(bytesRead) {
-            LOG(DEBUG2) << "Bytes read: " << bytesRead;
-            LOG(DEBUG) << "Bytes read from sniffer port are ignored: " << buffer;
-        }
+    if(bytesRead) {
+        LOG(DEBUG2) << "Bytes read: " << bytesRead;
+        LOG(DEBUG) << "Bytes read from sniffer port are ignored: " << buffer;
+    }
+    else {
+        eventSourcesChanged();
     }
 }
 
@@ -1623,221 +2673,268 @@ void PortAgent::handleTelnetSnifferRead(const fd_set &readFDs) {
  * Method: handleObservatoryCommandConnect
  * Description: Accept connection to the TCP command connection.
  ******************************************************************************/
-void PortAgent::handleObservatoryCommandAccept(const fd_set &readFDs) {
+void PortAgent::handleObservatoryCommandAccept() {
     CommBase *pConnection = m_pObservatoryConnection->commandConnectionObject();
-    int serverFD = getObservatoryCommandListenerFD();
     
-    LOG(DEBUG) << "handleObservatoryCommandAccept - do we need to accept a new connection?";
-    LOG(DEBUG) << "Observatory Command Listener FD: " << serverFD;
-        
-    // Accept a new observatory command client
-    if(serverFD && FD_ISSET(serverFD, &readFDs)) {
-        LOG(DEBUG) << "Observatory command listener has data";
-        handleTCPConnect(*((TCPCommListener*)pConnection));
-    }
+    LOG(DEBUG) << "Observatory command listener has data";
+    handleTCPConnect(*((TCPCommListener*)pConnection));
 }
 
 /******************************************************************************
  * Method: handleObservatoryCommandRead
- * Description: Read from the observatory command port
+ * Description: Read from an observatory command client.  Only the client
+ * with command authority is obeyed, the others are read to detect
+ * disconnects.
  ******************************************************************************/
-void PortAgent::handleObservatoryCommandRead(const fd_set &readFDs) {
-    CommBase *pConnection = m_pObservatoryConnection->commandConnectionObject();
-    int clientFD = getObservatoryCommandClientFD();
+void PortAgent::handleObservatoryCommandRead(int fd) {
+    TCPCommListener *pConnection = (TCPCommListener*)m_pObservatoryConnection->commandConnectionObject();
+    bool authority = pConnection->isAuthority(fd);
     int bytesRead = 0;
     char buffer[1024];
     
-    LOG(DEBUG) << "handleObservatoryCommandRead - do we need to read from the observatory command";
-    LOG(DEBUG) << "Observatory Command Client FD: " << clientFD;
-        
-    if(clientFD && FD_ISSET(clientFD, &readFDs)) {
-        LOG(DEBUG) << "Read data from Observatory Command Client FD: " << clientFD;
-        bytesRead = ((TCPCommListener*)pConnection)->readData(buffer, 1023);
-        buffer[bytesRead] = '\0';
-        
-        if(bytesRead) {
-            LOG(DEBUG2) << "Bytes read: " << bytesRead;
-            handlePortAgentCommand(buffer);
-            publishPacket(buffer, bytesRead, PORT_AGENT_COMMAND);
-        }
+    LOG(DEBUG) << "Read data from Observatory Command Client FD: " << fd;
+    bytesRead = pConnection->readClient(fd, buffer, 1023);
+    buffer[bytesRead] = '\0';
+    
+    if(bytesRead && !authority) {
+        LOG(DEBUG) << "Ignored command from client FD: " << fd
+                   << " without command authority: " << buffer;
+    }
+    else if(bytesRead) {
+        LOG(DEBUG2) << "Bytes read: " << bytesRead;
+        handlePortAgentCommand(buffer);
+        publishPacket(buffer, bytesRead, PORT_AGENT_COMMAND);
+    }
+    else {
+        eventSourcesChanged();
     }
 }
 
 /******************************************************************************
  * Method: handleObservatoryDataAccept
- * Description: Depending upon the observatory connection type, read from the
- * FD(s).
+ * Description: Accept connection to a TCP data connection.  For multi data
+ * connections this is the listener whose descriptor is ready.
  ******************************************************************************/
-void PortAgent::handleObservatoryDataAccept(const fd_set &readFDs) {
-    if (m_pObservatoryConnection->connectionType() == PACONN_OBSERVATORY_STANDARD) {
-        handleObservatoryStandardDataAccept(readFDs);
+void PortAgent::handleObservatoryDataAccept(TCPCommListener *listener) {
+    LOG(DEBUG) << "Observatory data listener has new connection request";
+    handleTCPConnect(*listener);
+}
+
+/******************************************************************************
+ * Method: handleObservatoryDataRead
+ * Description: Read from an observatory data client.  Only data from the
+ * client with command authority goes to the instrument, the others are read
+ * to detect disconnects.
+ ******************************************************************************/
+void PortAgent::handleObservatoryDataRead(TCPCommListener *listener, int fd) {
+    bool authority = listener->isAuthority(fd);
+    int bytesRead = 0;
+    char buffer[1024];
+    
+    LOG(DEBUG2) << "Read data from Observatory Data Client FD: " << fd;
+    bytesRead = listener->readClient(fd, buffer, 1023);
+    buffer[bytesRead] = '\0';
+
+    if(bytesRead && !authority) {
+        LOG(DEBUG) << "Ignored " << bytesRead << " bytes from data client FD: " << fd
+                   << " without command authority";
     }
-    else if (m_pObservatoryConnection->connectionType() == PACONN_OBSERVATORY_MULTI) {
-        handleObservatoryMultiDataAccept(readFDs);
+    else if(bytesRead) {
+        LOG(DEBUG2) << "Bytes read: " << bytesRead;
+        publishPacket(buffer, bytesRead, DATA_FROM_DRIVER);
     }
     else {
-        LOG(ERROR) << "handleObservatoryDataAccept: Observatory connection type unknown!";
+        eventSourcesChanged();
     }
-
 }
 
 /******************************************************************************
- * Method: handleObservatoryDataAccept
- * Description: Accept connection to the TCP data connection.
+ * Method: handleInstrumentDataRead
+ * Description: Read from the instrument data port.  Without framing each
+ * read is published as it is.  With framing the read goes to the framer,
+ * finished records are published and the flush timer is started for what is
+ * left over.
  ******************************************************************************/
-void PortAgent::handleObservatoryStandardDataAccept(const fd_set &readFDs) {
-    CommBase *pConnection = m_pObservatoryConnection->dataConnectionObject();
-    int serverFD = getObservatoryDataListenerFD();
+void PortAgent::handleInstrumentDataRead(CommBase *connection) {
+    int bytesRead = 0;
+    char *buffer;
+    unsigned int read_size;
+    
+    // Read after the header space so the packet can be built in place
+    read_size = m_pConfig->maxPacketSize();
+    buffer = PacketBufferPool::global().allocate(HEADER_SIZE + read_size);
 
-    LOG(DEBUG) << "handleObservatoryDataAccept - do we need to accept a new connection?";
-    LOG(DEBUG2) << "Observatory Data Listener FD: " << serverFD;
+    LOG(DEBUG) << "Read data from Instrument Data Client, max packet size: " << read_size;
+    try {
+        bytesRead = connection->readData(buffer + HEADER_SIZE, read_size);
+    }
+    catch(OOIException &e) {
+        PacketBufferPool::release(buffer);
+        throw;
+    }
+    
+    if(bytesRead && m_pInstrumentFramer) {
+        LOG(DEBUG2) << "Bytes read: " << bytesRead;
+        Timestamp ts;
+        vector<SharedPacket *> records;
 
-    // Accept a new observatory command client
-    if(serverFD && FD_ISSET(serverFD, &readFDs)) {
-        LOG(DEBUG) << "Observatory data listener has data";
-        handleTCPConnect(*((TCPCommListener*)pConnection));
+        m_pInstrumentFramer->add(buffer + HEADER_SIZE, bytesRead, ts, records);
+        PacketBufferPool::release(buffer);
+
+        if(m_pInstrumentFramer->pending() && !m_oEventLoop.timerPending(m_iFramerTimer))
+            m_iFramerTimer = m_oEventLoop.addTimer(
+                m_pInstrumentFramer->flushDelay(TimerQueue::now()), this);
+
+        publishInstrumentPackets(records);
+        return;
     }
-}
 
-/******************************************************************************
- * Method: handleObservatoryDataAccept
- * Description: Iterate through the observatory data connections accepting
- * those that are ready.
- ******************************************************************************/
-void PortAgent::handleObservatoryMultiDataAccept(const fd_set &readFDs) {
-    CommBase *pConnection = 0;
-    int serverFD = 0;
-    
-    LOG(DEBUG) << "handleObservatoryMultiDataAccept - checking for new connections";
+    if(bytesRead) {
+        LOG(DEBUG2) << "Bytes read: " << bytesRead;
+        Timestamp ts;
+        publishInstrumentPacket(SharedPacket::adopt(DATA_FROM_INSTRUMENT, ts, buffer, bytesRead));
+        return;
+    }
 
-    // Iterate through the listeners adding the clientFDs
-    pConnection = ObservatoryDataSockets::instance()->getFirstSocket();
-    while (pConnection) {
-        // Accept a new observatory command client
-        serverFD = ((TCPCommListener*)pConnection)->serverFD();
-        if(serverFD && FD_ISSET(serverFD, &readFDs)) {
-            LOG(DEBUG) << "Observatory data listener has new connection request";
-            handleTCPConnect(*((TCPCommListener*)pConnection));
-        }
+    PacketBufferPool::release(buffer);
 
-        pConnection = ObservatoryDataSockets::instance()->getNextSocket();
+    if(! connection->connected()) {
+        // Whatever we have of the last record is all we are going to get
+        flushInstrumentFramer();
+        flushOutputThrottle();
+        eventSourcesChanged();
     }
 }
 
 /******************************************************************************
- * Method: handleObservatoryDataRead
- * Description: Depending upon the observatory connection type, read from the
- * FD(s)
+ * Method: handlePacketPipelineNotify
+ * Description: The pipeline reader has something to tell us.  If the
+ * instrument dropped, take the descriptor back and close it here so the
+ * state handlers reconnect just as they do when we read the instrument
+ * ourselves.
  ******************************************************************************/
-void PortAgent::handleObservatoryDataRead(const fd_set &readFDs) {
-    if (m_pObservatoryConnection->connectionType() == PACONN_OBSERVATORY_STANDARD) {
-        handleObservatoryStandardDataRead(readFDs);
-    }
-    else if (m_pObservatoryConnection->connectionType() == PACONN_OBSERVATORY_MULTI) {
-        handleObservatoryMultiDataRead(readFDs);
-    }
-    else {
-        LOG(ERROR) << "handleObservatoryDataRead: Observatory connection type unknown!";
+void PortAgent::handlePacketPipelineNotify() {
+    CommSocket *pConnection;
+    
+    m_pPacketPipeline->clearNotify();
+    
+    if(!m_pPacketPipeline->sourceLost())
+        return;
+    
+    LOG(INFO) << "pipeline lost the instrument connection";
+    m_pPacketPipeline->setSource(-1);
+    
+    if(m_pInstrumentConnection) {
+        pConnection = (CommSocket*)getInstrumentDataRxConnection();
+        if(pConnection)
+            pConnection->disconnect();
     }
-
+    
+    eventSourcesChanged();
 }
 
 /******************************************************************************
- * Method: handleObservatoryStandardDataRead
- * Description: Read from the observatory data port
+ * Method: updateOutputBuffers
+ * Description: Apply the output buffer and client count configuration to the
+ * observatory and telnet sniffer listeners and keep the event loop
+ * registrations in step with them.  A client with output waiting is watched
+ * for writability, and one dropped for being too slow needs its listener
+ * watched again.
  ******************************************************************************/
-void PortAgent::handleObservatoryStandardDataRead(const fd_set &readFDs) {
-    CommBase *pConnection = m_pObservatoryConnection->dataConnectionObject();
-    int clientFD = getObservatoryDataClientFD();
-    int bytesRead = 0;
-    char buffer[1024];
-    
-    LOG(DEBUG) << "handleObservatoryDataRead - checking for observatory standard data";
-    LOG(DEBUG2) << "Observatory Data Client FD: " << clientFD;
+void PortAgent::updateOutputBuffers() {
+    EventSourceMap::iterator i;
+    uint32_t limit = m_pConfig ? m_pConfig->outputBufferSize() : DEFAULT_OUTPUT_BUFFER_SIZE;
+    OutputPolicy policy = m_pConfig ? m_pConfig->slowConsumerPolicy() : OUTPUT_DROP_OLDEST;
+    uint32_t maxClients = m_pConfig ? m_pConfig->maxClients() : DEFAULT_MAX_CLIENTS;
 
-    if(clientFD && FD_ISSET(clientFD, &readFDs)) {
-        LOG(DEBUG2) << "Read data from Observatory Data Client FD: " << clientFD;
-        bytesRead = ((TCPCommListener*)pConnection)->readData(buffer, 1023);
-        buffer[bytesRead] = '\0';
+    for(i = m_oEventSources.begin(); i != m_oEventSources.end(); i++) {
+        if(!i->second.connection || i->second.connection->type() != COMM_TCP_LISTENER)
+            continue;
 
-        if(bytesRead) {
-            LOG(DEBUG2) << "Bytes read: " << bytesRead;
-            publishPacket(buffer, bytesRead, DATA_FROM_DRIVER);
+        TCPCommListener *listener = (TCPCommListener *)i->second.connection;
+        bool client = i->second.type == EVENT_OBSERVATORY_COMMAND_CLIENT ||
+                      i->second.type == EVENT_OBSERVATORY_DATA_CLIENT ||
+                      i->second.type == EVENT_TELNET_SNIFFER_CLIENT;
+
+        listener->setOutputBuffer(limit, policy);
+
+        // A listener that was full may start listening again
+        if(listener->maxClients() != maxClients) {
+            listener->setMaxClients(maxClients);
+            eventSourcesChanged();
         }
+
+        if(client && (!listener->hasClient(i->first) ||
+           listener->outputPending(i->first) != bool(i->second.events & EVENT_WRITE)))
+            eventSourcesChanged();
+
+        if(!client && listener->serverFD() != i->first)
+            eventSourcesChanged();
     }
 }
 
 /******************************************************************************
- * Method: handleObservatoryMultiDataRead
- * Description: Iterate through the observatory data connections reading
- * those that are ready.
+ * Method: outputStats
+ * Description: Output buffer counters summed over the observatory and telnet
+ * sniffer connections.
  ******************************************************************************/
-void PortAgent::handleObservatoryMultiDataRead(const fd_set &readFDs) {
-    CommBase *pConnection = 0;
-    int bytesRead = 0;
-    char buffer[1024];
+string PortAgent::outputStats() {
+    set<TCPCommListener *> listeners;
+    set<TCPCommListener *>::iterator l;
+    EventSourceMap::iterator i;
+    uint64_t clients = 0, queued = 0, droppedOldest = 0, droppedNewest = 0, disconnects = 0;
+    ostringstream out;
 
-    LOG(DEBUG) << "handleObservatoryDataRead - checking for observatory multi data";
+    for(i = m_oEventSources.begin(); i != m_oEventSources.end(); i++) {
+        if(i->second.connection && i->second.connection->type() == COMM_TCP_LISTENER)
+            listeners.insert((TCPCommListener *)i->second.connection);
+    }
 
-    // Iterate through the listeners checking the clientFDs
-    pConnection = ObservatoryDataSockets::instance()->getFirstSocket();
-    while (pConnection) {
-        int clientFD = ((TCPCommListener*) pConnection)->clientFD();
-        LOG(DEBUG2) << "Observatory Data Client FD: " << clientFD;
+    for(l = listeners.begin(); l != listeners.end(); l++) {
+        clients += (*l)->clientCount();
+        queued += (*l)->outputQueued();
+        droppedOldest += (*l)->outputDroppedOldest();
+        droppedNewest += (*l)->outputDroppedNewest();
+        disconnects += (*l)->slowDisconnects();
+    }
 
-        if (clientFD && FD_ISSET(clientFD, &readFDs)) {
-            LOG(DEBUG2) << "Read data from Observatory Data Client FD: " << clientFD;
-            bytesRead = ((TCPCommListener*)pConnection)->readData(buffer, 1023);
-            buffer[bytesRead] = '\0';
+    out << "output_clients " << clients << endl
+        << "output_queued_bytes " << queued << endl
+        << "output_dropped_oldest " << droppedOldest << endl
+        << "output_dropped_newest " << droppedNewest << endl
+        << "output_slow_disconnects " << disconnects << endl;
 
-            if(bytesRead) {
-                LOG(DEBUG2) << "Bytes read: " << bytesRead;
-                publishPacket(buffer, bytesRead, DATA_FROM_DRIVER);
-            }
-        }
-        pConnection = ObservatoryDataSockets::instance()->getNextSocket();
-    }
+    return out.str();
 }
 
 /******************************************************************************
- * Method: handleInstrumentDataRead
- * Description: Read from the instrument data port
+ * Method: getStats
+ * Description: Runtime counters reported by the get_stats command.
  ******************************************************************************/
-void PortAgent::handleInstrumentDataRead(const fd_set &readFDs) {
-    CommBase *pConnection;
+string PortAgent::getStats() {
+    string stats = outputStats() + PacketBufferPool::global().statsAsString();
+    ostringstream framer;
+    ostringstream throttle;
 
-    if (m_pInstrumentConnection->connectionType() == PACONN_INSTRUMENT_BOTPT) {
-        pConnection = ((InstrumentBOTPTConnection*) m_pInstrumentConnection)->dataRxConnectionObject();
-    }
-    else {
-        pConnection = m_pInstrumentConnection->dataConnectionObject();
+    if(m_pInstrumentFramer) {
+        framer << "framer_records " << m_pInstrumentFramer->records() << endl
+               << "framer_flushes " << m_pInstrumentFramer->flushes() << endl;
+        stats = framer.str() + stats;
     }
 
-    int clientFD = getInstrumentDataRxClientFD();
-    int bytesRead = 0;
-    char buffer[MAX_PACKET_SIZE];
-    unsigned int read_size;
-    LOG(DEBUG) << "handleInstrumentDataRead - do we need to read from the instrument data";
-    
-    if(! pConnection->connected()) {
-        LOG(DEBUG2) << "instrument not connected, attempting to re-init the socket";
-        initializeInstrumentConnection();
-        clientFD = getInstrumentDataRxClientFD();
+    if(m_pOutputThrottle) {
+        throttle << "throttle_packets_in " << m_pOutputThrottle->packetsIn() << endl
+                 << "throttle_packets_out " << m_pOutputThrottle->packetsOut() << endl;
+        stats = throttle.str() + stats;
     }
+
+    if(m_pLogArchiver)
+        stats = m_pLogArchiver->statsAsString() + stats;
+
+    if(m_pPacketPipeline)
+        return m_pPacketPipeline->statsAsString() + stats;
     
-    LOG(DEBUG2) << "Instrument Data Client FD: " << clientFD;
-        
-    if(clientFD && FD_ISSET(clientFD, &readFDs)) {
-        read_size = m_pConfig->maxPacketSize();
-        LOG(DEBUG) << "Read data from Instrument Data Client FD: " << clientFD << " max packet size: " << read_size;
-        bytesRead = pConnection->readData(buffer, read_size);
-        
-        if(bytesRead) {
-            LOG(DEBUG2) << "Bytes read: " << bytesRead;
-            publishPacket(buffer, bytesRead, DATA_FROM_INSTRUMENT);
-            //buffer[bytesRead] = '\0';
-        }
-    }
+    return "pipeline_depth 0\n" + stats;
 }
 
 /******************************************************************************
@@ -1869,6 +2966,9 @@ void PortAgent::setState(const PortAgentState &state) {
         const string previousState = getCurrentStateAsString();
     
         m_oState = state;
+        
+        // The set of descriptors we service depends on the state
+        eventSourcesChanged();
 
         LOG(DEBUG) << "***********************************************";
         LOG(DEBUG) << "State transition from " << previousState << " TO " << getCurrentStateAsString();
@@ -4,13 +4,24 @@
 #include "common/daemon_process.h"
 #include "network/tcp_comm_listener.h"
 #include "network/tcp_comm_socket.h"
+#include "network/udp_comm_socket.h"
+#include "network/shared_memory_ring.h"
+#include "network/event_loop.h"
 #include "connection/connection.h"
 #include "config/port_agent_config.h"
 #include "packet/packet.h"
+#include "packet/shared_packet.h"
 #include "publisher/publisher_list.h"
+#include "packet_pipeline.h"
+#include "instrument_framer.h"
+#include "output_throttle.h"
+#include "reconnect_backoff.h"
+#include "common/mutex.h"
+#include "common/log_archiver.h"
 
-#include <sys/select.h>
 #include <time.h>
+#include <map>
+#include <vector>
 
 using namespace std;
 using namespace packet;
@@ -19,6 +30,9 @@ using namespace publisher;
 
 #define SELECT_SLEEP_TIME 1
 
+// Give up on an instrument connect that hasn't completed (seconds)
+#define INSTRUMENT_CONNECT_TIMEOUT 10
+
 namespace port_agent {
     
     //////////////////////////////
@@ -33,7 +47,31 @@ namespace port_agent {
         STATE_DISCONNECTED     = 0x00000005,
     } PortAgentState;
     
-    class PortAgent : public DaemonProcess {
+    //////////////////////////////
+    // File descriptors watched by the event loop
+    typedef enum EventSourceType
+    {
+        EVENT_OBSERVATORY_COMMAND_LISTENER = 0x00000001,
+        EVENT_OBSERVATORY_COMMAND_CLIENT   = 0x00000002,
+        EVENT_OBSERVATORY_DATA_LISTENER    = 0x00000003,
+        EVENT_OBSERVATORY_DATA_CLIENT      = 0x00000004,
+        EVENT_INSTRUMENT_DATA_CLIENT       = 0x00000005,
+        EVENT_TELNET_SNIFFER_LISTENER      = 0x00000006,
+        EVENT_TELNET_SNIFFER_CLIENT        = 0x00000007,
+        EVENT_PACKET_PIPELINE              = 0x00000008,
+        EVENT_INSTRUMENT_CONNECT           = 0x00000009,
+    } EventSourceType;
+    
+    typedef struct EventSource
+    {
+        EventSourceType type;
+        CommBase *connection;
+        uint32_t events;
+    } EventSource;
+    
+    typedef map<int, EventSource> EventSourceMap;
+    
+    class PortAgent : public DaemonProcess, public EventHandler, public TimerHandler {
         public:
             PortAgent();
             PortAgent(int argc, char *argv[]);
@@ -48,6 +86,12 @@ namespace port_agent {
             
             bool start();
             void poll();
+            
+            // virtual method from event handler
+            void handleEvent(int fd, uint32_t events);
+            
+            // virtual method from timer handler
+            void handleTimer(TimerId id);
             string usage() { return PortAgentConfig::Usage(); }
             
         protected:
@@ -56,24 +100,30 @@ namespace port_agent {
             bool no_daemon();
             uint32_t ppid();
             float sleep_time() { return 0; }
+            void shutdown();
             
         private:
             void setState(const PortAgentState &state);
             
-            int buildFDSet(fd_set &readFDs);
+            void updateEventSources();
+            void eventSourcesChanged() { m_bEventSourcesChanged = true; }
             void processPortAgentCommands();
     
-            void addObservatoryCommandListenerFD(int &maxFD, fd_set &readFDs);
-            void addObservatoryCommandClientFD(int &maxFD, fd_set &readFDs);
-            void addObservatoryDataListenerFD(int &maxFD, fd_set &readFDs);
-            void addObservatoryStandardDataListenerFD(int &maxFD, fd_set &readFDs);
-            void addObservatoryMultiDataListenerFDs(int &maxFD, fd_set &readFDs);
-            void addObservatoryDataClientFD(int &maxFD, fd_set &readFDs);
-            void addObservatoryStandardDataClientFD(int &maxFD, fd_set &readFDs);
-            void addObservatoryMultiDataClientFDs(int &maxFD, fd_set &readFDs);
-            void addInstrumentDataClientFD(int &maxFD, fd_set &readFDs);
-            void addTelnetSnifferListenerFD(int &maxFD, fd_set &readFDs);
-            void addTelnetSnifferClientFD(int &maxFD, fd_set &readFDs);
+            void addEventSource(EventSourceMap &sources, int fd, EventSourceType type, CommBase *connection);
+            void addListenerClientFDs(EventSourceMap &sources, TCPCommListener *listener, EventSourceType type);
+            void addObservatoryCommandListenerFD(EventSourceMap &sources);
+            void addObservatoryCommandClientFD(EventSourceMap &sources);
+            void addObservatoryDataListenerFD(EventSourceMap &sources);
+            void addObservatoryStandardDataListenerFD(EventSourceMap &sources);
+            void addObservatoryMultiDataListenerFDs(EventSourceMap &sources);
+            void addObservatoryDataClientFD(EventSourceMap &sources);
+            void addObservatoryStandardDataClientFD(EventSourceMap &sources);
+            void addObservatoryMultiDataClientFDs(EventSourceMap &sources);
+            void addInstrumentDataClientFD(EventSourceMap &sources);
+            void addTelnetSnifferListenerFD(EventSourceMap &sources);
+            void addTelnetSnifferClientFD(EventSourceMap &sources);
+            void addPacketPipelineFD(EventSourceMap &sources);
+            void addInstrumentConnectFDs(EventSourceMap &sources);
             
             int getObservatoryCommandListenerFD();
             int getObservatoryCommandClientFD();
@@ -82,6 +132,8 @@ namespace port_agent {
             int getInstrumentDataRxClientFD();
             int getInstrumentDataTxClientFD();
             int getTelnetSnifferListenerFD();
+            CommBase * getInstrumentDataRxConnection();
+            void getInstrumentSockets(vector<TCPCommSocket *> &sockets);
             
             void initializeObservatoryDataConnection();
             void initializeObservatoryStandardDataConnection();
@@ -92,7 +144,24 @@ namespace port_agent {
             void initialize_BOTPT_InstrumentConnection();
             void initializeSerialInstrumentConnection();
             bool initializeSerialSettings();
+            void initializePacketPipeline();
+            void initializeInstrumentFramer();
+            void initializeOutputThrottle();
+            void initializeLogArchiver();
+            void updateHeartbeatTimer();
+            void updateOutputThrottleTimer();
+            void updatePublisherFlushTimer();
+            void updateResolveTimer();
+            void updateOutputBuffers();
+            bool reconnectPending();
             
+            // Instrument reconnect state machine
+            void startInstrumentConnect();
+            bool instrumentConnecting();
+            void instrumentConnected();
+            void instrumentConnectFailed(const string &reason);
+            void instrumentLost();
+
             // Publisher initializers
             void initializePublishers();
             void initializePublisherFile();
@@ -105,39 +174,50 @@ namespace port_agent {
             void initializePublisherTelnetSniffer();    
             void initializePublisherTCP();    
             void initializePublisherUDP();    
+            void initializePublisherSharedMemory();
+            void initializePublisherBatching();
             
             // State handlers
             void handleStateStartup();
-            void handleStateUnconfigured(const fd_set &readFDs);
-            void handleStateConfigured(const fd_set &readFDs);
-            void handleStateConnected(const fd_set &readFDs);
-            void handleStateDisconnected(const fd_set &readFDs);
-            void handleCommon(const fd_set &readFDs);
+            void handleStateUnconfigured();
+            void handleStateConfigured();
+            void handleStateConnected();
+            void handleStateDisconnected();
             void handleStateUnknown();
             
             // Other handlers
             void handlePortAgentCommand(const char *commands);
             void handleTCPConnect(TCPCommListener &listener);
             
-            void handleTelnetSnifferAccept(const fd_set &readFDs);
-            void handleTelnetSnifferRead(const fd_set &readFDs);
-            void handleObservatoryCommandAccept(const fd_set &readFDs);
-            void handleObservatoryCommandRead(const fd_set &readFDs);
-            void handleObservatoryDataAccept(const fd_set &readFDs);
-            void handleObservatoryStandardDataAccept(const fd_set &readFDs);
-            void handleObservatoryMultiDataAccept(const fd_set &readFDs);
-            void handleObservatoryDataRead(const fd_set &readFDs);
-            void handleObservatoryStandardDataRead(const fd_set &readFDs);
-            void handleObservatoryMultiDataRead(const fd_set &readFDs);
-            void handleInstrumentDataRead(const fd_set &readFDs);
+            void handleTelnetSnifferAccept();
+            void handleTelnetSnifferRead(int fd);
+            void handleObservatoryCommandAccept();
+            void handleObservatoryCommandRead(int fd);
+            void handleObservatoryDataAccept(TCPCommListener *listener);
+            void handleObservatoryDataRead(TCPCommListener *listener, int fd);
+            void handleInstrumentDataRead(CommBase *connection);
+            void handlePacketPipelineNotify();
+            void handleInstrumentConnect();
+            void handleInstrumentFramerTimer();
+            void handleOutputThrottleTimer();
+            void handlePublisherFlushTimer();
+            void handleResolveTimer();
             
             void publishHeartbeat();
             void publishFault(const string &msg);
             void publishStatus(const string &msg);
             void publishPacket(Packet *packet);
             void publishPacket(char *payload, uint16_t size, PacketType type);
+            void publishSharedPacket(SharedPacket *packet);
+            void publishSharedPackets(vector<SharedPacket *> &packets);
+            void publishInstrumentPacket(SharedPacket *packet);
+            void publishInstrumentPackets(vector<SharedPacket *> &packets);
+            void flushInstrumentFramer();
+            void flushOutputThrottle();
 
             void displayVersion();
+            string getStats();
+            string outputStats();
             void setRotationInterval();
             
         /////
@@ -151,7 +231,45 @@ namespace port_agent {
             PortAgentState  m_oState;
             
             PublisherList m_oPublishers;
-            time_t m_lLastHeartbeat;
+            
+            // Held by the main loop while it works with the publishers or
+            // the connections they write to, and by the pipeline publisher
+            // thread while it publishes.
+            Mutex m_oPublisherLock;
+            
+            // Optional reader/publisher threads for instrument data
+            PacketPipeline *m_pPacketPipeline;
+            
+            // Cuts instrument reads into records, NULL when framing is off
+            InstrumentFramer *m_pInstrumentFramer;
+
+            // Limits the instrument data packet rate, NULL when off
+            OutputThrottle *m_pOutputThrottle;
+
+            // Compresses and expires rolled data logs, NULL when off
+            LogArchiver *m_pLogArchiver;
+
+            // Event loop and the descriptors currently registered with it
+            EventLoop m_oEventLoop;
+            EventSourceMap m_oEventSources;
+            bool m_bEventSourcesChanged;
+            bool m_bShutdownRequested;
+            
+            // Event loop timers, 0 when not scheduled
+            TimerId m_iHeartbeatTimer;
+            uint32_t m_iHeartbeatInterval;
+            TimerId m_iReconnectTimer;
+            TimerId m_iConnectTimer;
+            TimerId m_iFramerTimer;
+            TimerId m_iThrottleTimer;
+            TimerId m_iPublisherFlushTimer;
+            uint64_t m_iPublisherFlushDeadline;
+            TimerId m_iResolveTimer;
+            uint64_t m_iResolveDeadline;
+
+            // Delay between failed instrument connection attempts
+            ReconnectBackoff m_oReconnectBackoff;
+            uint64_t m_iConnectedSince;
             
             // Port agent connections
             Connection *m_pObservatoryConnection;
@@ -159,6 +277,8 @@ namespace port_agent {
             
             // Publisher Connections
             TCPCommListener *m_pTelnetSnifferConnection;
+            UDPCommSocket *m_pMulticastConnection;
+            SharedMemoryRing *m_pSharedMemoryConnection;
             
     };
 }
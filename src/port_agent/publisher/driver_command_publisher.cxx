@@ -49,7 +49,29 @@ DriverCommandPublisher::DriverCommandPublisher() : DriverPublisher() { }
  ******************************************************************************/
 bool DriverCommandPublisher::write(const char *buffer, uint32_t size) {
     if(m_pCommSocket && m_pCommSocket->connected()) 
-        DriverPublisher::write(buffer, size);
-    else
-        LOG(DEBUG) << "Command port not connected, not writing packets";
+        return DriverPublisher::write(buffer, size);
+
+    LOG(DEBUG) << "Command port not connected, not writing packets";
+    return true;
+}
+
+/******************************************************************************
+ * Method: flush
+ * Description: Like write, batched packets are dropped if nobody is connected
+ * to the command port.
+ *
+ * Exceptions:
+ *    FileDescriptorNULL
+ *    PacketPublishFailure
+ ******************************************************************************/
+bool DriverCommandPublisher::flush() {
+    if(m_pCommSocket && m_pCommSocket->connected())
+        return DriverPublisher::flush();
+
+    if(!batch().empty()) {
+        LOG(DEBUG) << "Command port not connected, dropping batched packets";
+        batch().clear();
+    }
+
+    return true;
 }
\ No newline at end of file
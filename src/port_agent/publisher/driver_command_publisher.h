@@ -28,8 +28,12 @@ namespace publisher {
            DriverCommandPublisher(CommBase *socket) : DriverPublisher(socket) {}
 
            bool write(const char *buffer, uint32_t size);
+           bool flush();
 
 	   const PublisherType publisherType() { return PUBLISHER_DRIVER_COMMAND; }
+
+	   // Everything but port agent commands
+	   PacketTypeMask subscriptions() { return ALL_PACKET_TYPES & ~PACKET_TYPE_BIT(PORT_AGENT_COMMAND); }
 	   
         protected:
             virtual bool handleInstrumentData(Packet *packet)     { return logPacket(packet); }
@@ -28,6 +28,11 @@ namespace publisher {
 	   
 	    const PublisherType publisherType() { return PUBLISHER_DRIVER_DATA; }
 
+	    PacketTypeMask subscriptions() {
+	        return PACKET_TYPE_BIT(DATA_FROM_INSTRUMENT) | PACKET_TYPE_BIT(PORT_AGENT_STATUS) |
+	               PACKET_TYPE_BIT(PORT_AGENT_FAULT) | PACKET_TYPE_BIT(PORT_AGENT_HEARTBEAT);
+	    }
+
         protected:
             virtual bool handleInstrumentData(Packet *packet)     { return logPacket(packet); }
             virtual bool handleDriverData(Packet *packet)         { return true; }
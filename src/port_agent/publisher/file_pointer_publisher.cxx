@@ -16,6 +16,8 @@
 #include "common/logger.h"
 #include "common/exception.h"
 #include "port_agent/packet/packet.h"
+#include "port_agent/packet/shared_packet.h"
+#include "network/timer_queue.h"
 
 #include <sstream>
 #include <string>
@@ -52,6 +54,10 @@ FilePointerPublisher::FilePointerPublisher(const FilePointerPublisher &rhs) : Pu
 	
     m_pFilePointer = rhs.m_pFilePointer;
     m_pCommSocket = rhs.m_pCommSocket;
+
+    // The copy gets the policy but not the queued packets
+    setBatchPolicy(rhs.m_oBatch.maxPackets(), rhs.m_oBatch.maxBytes(),
+                   rhs.m_oBatch.maxDelay());
 }
 
 /******************************************************************************
@@ -77,6 +83,8 @@ FilePointerPublisher & FilePointerPublisher::operator=(const FilePointerPublishe
     LOG(DEBUG2) << "FilePointerPublisher assignment operator";
 	m_pFilePointer = rhs.m_pFilePointer;
     setCommObject(rhs.m_pCommSocket);
+    setBatchPolicy(rhs.m_oBatch.maxPackets(), rhs.m_oBatch.maxBytes(),
+                   rhs.m_oBatch.maxDelay());
 	clearError();
 	return *this;
 }
@@ -173,6 +181,29 @@ void FilePointerPublisher::setFilePointer(FILE* file) {
     m_pFilePointer = file;
 }
 
+/******************************************************************************
+ * Method: setBatchPolicy
+ * Description: Set when batched packets are written.  Turning batching off
+ * writes anything already queued.
+ * Parameter:
+ *    maxPackets - packets per write, 0 or 1 turns batching off
+ *    maxBytes - bytes per write, 0 for no limit
+ *    maxDelay - longest a packet waits, milliseconds
+ ******************************************************************************/
+void FilePointerPublisher::setBatchPolicy(uint32_t maxPackets, uint32_t maxBytes,
+                                          uint32_t maxDelay) {
+    if(m_oBatch.policyIs(maxPackets, maxBytes, maxDelay))
+        return;
+
+    LOG(DEBUG) << "publisher type " << publisherType() << " batch policy, packets: "
+               << maxPackets << " bytes: " << maxBytes << " delay: " << maxDelay;
+
+    m_oBatch.setPolicy(maxPackets, maxBytes, maxDelay);
+
+    if(!m_oBatch.enabled() && !m_oBatch.empty())
+        flush();
+}
+
 /******************************************************************************
  * Method: logPacket
  * Description: Write a packet of data to the internal file pointer.  Raise an
@@ -190,14 +221,79 @@ bool FilePointerPublisher::logPacket(Packet *packet) {
     }
 
 	// Must be binary
-	return write(packet->packet(), packet->packetSize());
+	return writePacketData(packet, packet->packet(), packet->packetSize());
+}
+
+/******************************************************************************
+ * Method: writePacketData
+ * Description: Write bytes that live inside a packet.  With batching on the
+ * packet is kept and the bytes are queued, otherwise they are written now.
+ *
+ * Parameter:
+ *    packet - the packet holding the bytes
+ *    buffer - the bytes to write, inside packet->packet()
+ *    size - how many bytes?
+ ******************************************************************************/
+bool FilePointerPublisher::writePacketData(Packet *packet, const char *buffer, uint32_t size) {
+	if(!m_oBatch.enabled())
+		return write(buffer, size);
+
+	uint32_t offset = buffer - packet->packet();
+
+	if(m_oBatch.add(SharedPacket::share(packet), offset, size, TimerQueue::now()))
+		return flush();
+
+	return true;
+}
+
+/******************************************************************************
+ * Method: flush
+ * Description: Write every queued packet in one call to the comm object.
+ * Each packet is its own message, so UDP sends one datagram per packet.  The
+ * batch is emptied even if the write fails.
+ *
+ * Exceptions:
+ *    FileDescriptorNULL
+ *    PacketPublishFailure
+ ******************************************************************************/
+bool FilePointerPublisher::flush() {
+	uint32_t total = 0;
+
+	if(m_oBatch.empty())
+		return true;
+
+	LOG(DEBUG) << "Flush batch, packets: " << m_oBatch.count()
+	           << " bytes: " << m_oBatch.bytes();
+
+	try {
+		checkOutput();
+
+		if(m_pCommSocket)
+			total = m_pCommSocket->writeMessages(m_oBatch.iov(), m_oBatch.count());
+		else
+			for(int i = 0; i < m_oBatch.count(); i++)
+				total += fwrite(m_oBatch.iov()[i].iov_base, 1, m_oBatch.iov()[i].iov_len,
+				                m_pFilePointer);
+	}
+	catch(...) {
+		m_oBatch.clear();
+		throw;
+	}
+
+	uint32_t size = m_oBatch.bytes();
+	m_oBatch.clear();
+
+	if(total != size) {
+		LOG(DEBUG) << "Batch publish failed.  Intended bytes: " << size << " actual write: " << total;
+ 		throw PacketPublishFailure(strerror(errno));
+	}
+
+	return true;
 }
 
 /******************************************************************************
  * Method: write
- * Description: Write a buffer the the internal FILE*.  It attempts to write
- * the buffer three times.  Exceptions are thrown if the FILE* is not set or
- * we fail to write the entire packet.
+ * Description: Write a buffer the the internal FILE* or comm object.
  *
  * Parameter:
  *    char* - the buffer that we are writing.
@@ -208,42 +304,57 @@ bool FilePointerPublisher::logPacket(Packet *packet) {
  *    PacketPublishFailure
  ******************************************************************************/
 bool FilePointerPublisher::write(const char *buffer, uint32_t size) {
-	int count;
-	int total = 0;
+	struct iovec iov;
+
+	iov.iov_base = (void *)buffer;
+	iov.iov_len = size;
+
+	return writeVector(&iov, 1);
+}
+
+/******************************************************************************
+ * Method: writeVector
+ * Description: Write several buffers as one.  A comm object sends them with
+ * a single writev or sendmsg, so a header, payload and decorations don't go
+ * out as separate small segments.  The comm object keeps writing until
+ * everything is out or it fails.  Exceptions are thrown if there is nothing
+ * to write to or we fail to write everything.
+ *
+ * Parameter:
+ *    iov - the buffers that we are writing.
+ *    count - how many buffers?
+ *
+ * Exceptions:
+ *    FileDescriptorNULL
+ *    PacketPublishFailure
+ ******************************************************************************/
+bool FilePointerPublisher::writeVector(const struct iovec *iov, int count) {
+	uint32_t size = 0;
+	uint32_t total = 0;
+
+	for(int i = 0; i < count; i++)
+		size += iov[i].iov_len;
 
 	if(size == 0) {
 		LOG(INFO) << "Empty buffer for write, bailing";
 	    return false;
 	}
 	
-	LOG(DEBUG) << "Write data byte count: " << size;
+	LOG(DEBUG) << "Write data byte count: " << size << " buffers: " << count;
 
-	if(m_pFilePointer == NULL && m_pCommSocket == NULL)
-		throw FileDescriptorNULL();
-	
-    if (m_pCommSocket && ! m_pCommSocket->connected()) {
-		LOG(DEBUG) << "Not connected.";
-	    m_pCommSocket->connectClient();
-    }
+	// Anything batched was published first
+	flush();
+
+	checkOutput();
 
-	// Try to write data three times.  Throw an error if we fail.
-	for( int i = 0; i < 3 && total < size; i++) {
-		LOG(DEBUG2) << "Packet write attempt #" << i+1;
-		
-		if(m_pCommSocket) {
-			LOG(DEBUG2) << "write with comm socket.";
-		    total += m_pCommSocket->writeData(buffer + total, size - total);
-		}
-		else if(m_pFilePointer) {
-			LOG(DEBUG2) << "write with file pointer";
-		    total += fwrite(buffer + total, 1, size - total, m_pFilePointer);
-		}
-		else {
-			LOG(ERROR) << "socket not intialized! Boom!";
-			throw PacketPublishFailure("socket not initialized");
-		}
-		
-		LOG(DEBUG2) << "write attempt complete";
+	if(m_pCommSocket) {
+		LOG(DEBUG2) << "write with comm socket.";
+		total = m_pCommSocket->writeVector(iov, count);
+	}
+	else {
+		LOG(DEBUG2) << "write with file pointer";
+		for(int i = 0; i < count; i++)
+			total += fwrite(iov[i].iov_base, 1, iov[i].iov_len, m_pFilePointer);
 	}
 
 	if(total != size) {
@@ -254,6 +365,24 @@ bool FilePointerPublisher::write(const char *buffer, uint32_t size) {
 	return true;
 }
 
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
 
+/******************************************************************************
+ * Method: checkOutput
+ * Description: Make sure there is something to write to, and try to connect
+ * the comm object if it isn't connected.
+ *
+ * Exceptions:
+ *    FileDescriptorNULL
+ ******************************************************************************/
+void FilePointerPublisher::checkOutput() {
+	if(m_pFilePointer == NULL && m_pCommSocket == NULL)
+		throw FileDescriptorNULL();
 
-
+    if (m_pCommSocket && ! m_pCommSocket->connected()) {
+		LOG(DEBUG) << "Not connected.";
+	    m_pCommSocket->connectClient();
+    }
+}
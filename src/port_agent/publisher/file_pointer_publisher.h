@@ -16,9 +16,12 @@
 #define __FILE_POINTER_PUBLISHER_H_
 
 #include "publisher.h"
+#include "publish_batch.h"
 #include "network/comm_base.h"
 #include "common/log_file.h"
 
+#include <sys/uio.h>
+
 using namespace std;
 using namespace logger;
 using namespace network;
@@ -45,6 +48,15 @@ namespace publisher {
 	   
            // Explicitly set the output file
            void setFilePointer(FILE *fd);
+
+           // Write packets in batches, see PublishBatch
+           void setBatchPolicy(uint32_t maxPackets, uint32_t maxBytes, uint32_t maxDelay);
+           PublishBatch & batch() { return m_oBatch; }
+
+           virtual bool pending() { return !m_oBatch.empty(); }
+           virtual uint64_t flushDelay(uint64_t now) { return m_oBatch.flushDelay(now); }
+           virtual bool flush();
+           virtual bool outputPending() { return m_pCommSocket && m_pCommSocket->outputPending(); }
 		   
 		   CommBase *commSocket() { return m_pCommSocket; }
 
@@ -59,10 +71,13 @@ namespace publisher {
             virtual bool handleHeartbeat(Packet *packet)         { return logPacket(packet); }
 
             bool logPacket(Packet *packet);
+            bool writePacketData(Packet *packet, const char *buffer, uint32_t size);
             virtual bool write(const char *buffer, uint32_t size);
+            virtual bool writeVector(const struct iovec *iov, int count);
 
         private:
 			bool compareCommSocket(CommBase *rhs);
+			void checkOutput();
         
 
         /********************
@@ -74,6 +89,9 @@ namespace publisher {
             
         private:
             FILE* m_pFilePointer;
+
+            // Packets waiting to be written together
+            PublishBatch m_oBatch;
 	    
     };
 }
@@ -24,8 +24,14 @@ using namespace publisher;
  *    filename - path to the output file
  ******************************************************************************/
 void FilePublisher::setFilename(string filename) {
-    m_oLogger = LogFile(filename.c_str());
-	m_oLogger.setRotation(m_tRotationInterval);
+    LogFile logger(filename.c_str());
+	logger.setRotation(m_tRotationInterval);
+    logger.setCommitPolicy(m_oLogger.maxDelay(), m_oLogger.maxBytes(),
+                           m_oLogger.syncInterval());
+    logger.setPreallocation(m_oLogger.preallocation());
+    logger.setListener(m_oLogger.listener());
+
+    m_oLogger = logger;
 }
 
 /******************************************************************************
@@ -39,7 +45,50 @@ void FilePublisher::setFilename(string filename) {
  *    fileext  - the extension to add on to the filename
  ******************************************************************************/
 void FilePublisher::setFilebase(string filebase, string fileext) {
-    m_oLogger = LogFile(filebase.c_str(), fileext.c_str(), m_tRotationInterval);
+    LogFile logger(filebase.c_str(), fileext.c_str(), m_tRotationInterval);
+    logger.setCommitPolicy(m_oLogger.maxDelay(), m_oLogger.maxBytes(),
+                           m_oLogger.syncInterval());
+    logger.setPreallocation(m_oLogger.preallocation());
+    logger.setListener(m_oLogger.listener());
+
+    m_oLogger = logger;
+}
+
+/******************************************************************************
+ * Method: setCommitPolicy
+ * Description: Group commit writes to the log file instead of flushing each
+ * packet.  Held writes are committed from flush().
+ *
+ * Parameter:
+ *    maxDelay - longest a write is held, milliseconds.  0 flushes each write.
+ *    maxBytes - commit once this many bytes are held, 0 for no limit
+ *    syncInterval - fdatasync at most this often, milliseconds.  0 is never.
+ ******************************************************************************/
+void FilePublisher::setCommitPolicy(uint32_t maxDelay, uint32_t maxBytes, uint32_t syncInterval) {
+    m_oLogger.setCommitPolicy(maxDelay, maxBytes, syncInterval);
+}
+
+/******************************************************************************
+ * Method: setPreallocation
+ * Description: Preallocate the log file and write it through mmap, see
+ * LogFile.
+ *
+ * Parameter:
+ *    segmentSize - bytes to allocate at a time, 0 writes through a stream
+ ******************************************************************************/
+void FilePublisher::setPreallocation(uint32_t segmentSize) {
+    m_oLogger.setPreallocation(segmentSize);
+}
+
+/******************************************************************************
+ * Method: setListener
+ * Description: Tell listener about each log file opened, see LogFile.
+ *
+ * Parameter:
+ *    listener - not owned, NULL for no one
+ ******************************************************************************/
+void FilePublisher::setListener(LogFileListener *listener) {
+    m_oLogger.setListener(listener);
 }
 
 /******************************************************************************
@@ -68,6 +68,19 @@ namespace publisher {
             // Explicitly close the log file
             void close() { m_oLogger.close(); }
 
+            // Group commit writes to the log file, see LogFile
+            void setCommitPolicy(uint32_t maxDelay, uint32_t maxBytes, uint32_t syncInterval);
+
+            // Preallocate the log file and write through mmap, see LogFile
+            void setPreallocation(uint32_t segmentSize);
+
+            // Tell a listener about each log file opened, see LogFile
+            void setListener(LogFileListener *listener);
+
+            virtual bool pending() { return m_oLogger.pending(); }
+            virtual uint64_t flushDelay(uint64_t now) { return m_oLogger.commitDelay(now); }
+            virtual bool flush() { m_oLogger.commit(); return true; }
+
 	    const PublisherType publisherType() { return PUBLISHER_FILE; }
 
         protected:
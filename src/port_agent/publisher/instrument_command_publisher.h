@@ -30,6 +30,11 @@ namespace publisher {
 
 	    const PublisherType publisherType() { return PUBLISHER_INSTRUMENT_COMMAND; }
 
+	    // Heartbeats are written by FilePointerPublisher::handleHeartbeat
+	    PacketTypeMask subscriptions() {
+	        return PACKET_TYPE_BIT(INSTRUMENT_COMMAND) | PACKET_TYPE_BIT(PORT_AGENT_HEARTBEAT);
+	    }
+
         protected:
             virtual bool handleInstrumentCommand(Packet *packet);
 
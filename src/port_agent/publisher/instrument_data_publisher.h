@@ -30,6 +30,8 @@ namespace publisher {
 
 	    const PublisherType publisherType() { return PUBLISHER_INSTRUMENT_DATA; }
 
+	    PacketTypeMask subscriptions() { return PACKET_TYPE_BIT(DATA_FROM_DRIVER); }
+
         protected:
             virtual bool handleDriverData(Packet *packet);
             virtual bool handleHeartbeat(Packet *packet)        { return true; }
@@ -60,6 +60,9 @@ using namespace publisher;
  *   Note: Exceptions are caught in the publisher and won't hault execution.
  ******************************************************************************/
 bool LogPublisher::logPacket(Packet *packet) {
+	if(m_oIndex.enabled())
+		indexPacket(packet);
+
 	if(m_bAsciiOut) {
         LOG(DEBUG3) << "write packet (ascii) to " << logger().getFilename();
 		logger() << packet->asAscii();
@@ -70,3 +73,22 @@ bool LogPublisher::logPacket(Packet *packet) {
 
 	return true;
 }
+
+/******************************************************************************
+ *   PRIVATE METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: indexPacket
+ * Description: Give the index the packet's timestamp and where it is about
+ * to be written.  Failing to index doesn't stop the packet being logged.
+ ******************************************************************************/
+void LogPublisher::indexPacket(Packet *packet) {
+    try {
+        uint64_t offset = logger().position();
+        m_oIndex.record(logger().openFile(), offset, packet->timestamp());
+    }
+    catch(LoggerOpenFailure &e) {
+        LOG(ERROR) << "failed to write log index: " << e.what();
+    }
+}
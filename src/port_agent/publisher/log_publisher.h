@@ -20,6 +20,10 @@
  * # Enables ascii logging
  * log.setAsciiMode(true);
  *
+ * # Write a time index beside each file, an entry every 1000 packets or
+ * # second, see LogIndexWriter
+ * log.setIndexPolicy(1000, 1);
+ *
  * Handlers:
  *
  * All handlers are overloaded to write their binary representation to a file.
@@ -31,6 +35,7 @@
 
 #include "file_publisher.h"
 #include "common/log_file.h"
+#include "common/log_index.h"
 
 using namespace std;
 using namespace logger;
@@ -46,6 +51,16 @@ namespace publisher {
             // Public Methods
             LogPublisher() {}
 
+            // Time index beside the log files, see LogIndexWriter
+            void setIndexPolicy(uint32_t packets, uint32_t interval) {
+                m_oIndex.setPolicy(packets, interval);
+            }
+            uint32_t indexPackets() { return m_oIndex.packets(); }
+            uint32_t indexInterval() { return m_oIndex.interval(); }
+
+            // Heartbeats aren't logged
+            PacketTypeMask subscriptions() { return ALL_PACKET_TYPES & ~PACKET_TYPE_BIT(PORT_AGENT_HEARTBEAT); }
+
         protected:
             virtual bool handleInstrumentData(Packet *packet)      { return logPacket(packet); }
             virtual bool handleDriverData(Packet *packet)          { return logPacket(packet); }
@@ -59,6 +74,7 @@ namespace publisher {
         private:
 
             bool logPacket(Packet *packet);
+            void indexPacket(Packet *packet);
         
         /********************
          *      MEMBERS     *
@@ -67,6 +83,7 @@ namespace publisher {
         protected:
             
         private:
+            LogIndexWriter m_oIndex;
     };
 }
 
@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * Class: PublishBatch
+ * Filename: publish_batch.cxx
+ * License: Apache 2.0
+ *
+ * Packets queued for a single vectored write.  See publish_batch.h for usage.
+ ******************************************************************************/
+
+#include "publish_batch.h"
+#include "network/timer_queue.h"
+#include "common/logger.h"
+
+using namespace std;
+using namespace packet;
+using namespace logger;
+using namespace network;
+using namespace publisher;
+
+/******************************************************************************
+ *   PUBLIC METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ * Description: Batching starts off.
+ ******************************************************************************/
+PublishBatch::PublishBatch() {
+    m_iMaxPackets = 0;
+    m_iMaxBytes = 0;
+    m_iMaxDelay = 0;
+
+    m_iBytes = 0;
+    m_iFirstAdd = 0;
+}
+
+/******************************************************************************
+ * Method: Destructor
+ * Description: Anything still queued is dropped.
+ ******************************************************************************/
+PublishBatch::~PublishBatch() {
+    clear();
+}
+
+/******************************************************************************
+ * Method: setPolicy
+ * Description: Set when the batch is written.  Packets already queued stay
+ * queued.
+ *
+ * Parameters:
+ *   maxPackets - packets per write, 0 or 1 turns batching off
+ *   maxBytes - bytes per write, 0 for no limit
+ *   maxDelay - longest the first packet waits, milliseconds
+ ******************************************************************************/
+void PublishBatch::setPolicy(uint32_t maxPackets, uint32_t maxBytes, uint32_t maxDelay) {
+    m_iMaxPackets = maxPackets > MAX_BATCH_PACKETS ? MAX_BATCH_PACKETS : maxPackets;
+    m_iMaxBytes = maxBytes;
+    m_iMaxDelay = maxDelay;
+}
+
+/******************************************************************************
+ * Method: policyIs
+ * Description: Compare the policy with the current configuration.
+ ******************************************************************************/
+bool PublishBatch::policyIs(uint32_t maxPackets, uint32_t maxBytes, uint32_t maxDelay) {
+    if(maxPackets > MAX_BATCH_PACKETS)
+        maxPackets = MAX_BATCH_PACKETS;
+
+    return m_iMaxPackets == maxPackets &&
+           m_iMaxBytes == maxBytes &&
+           m_iMaxDelay == maxDelay;
+}
+
+/******************************************************************************
+ * Method: add
+ * Description: Queue part of a packet.
+ *
+ * Parameters:
+ *   packet - the packet holding the bytes, the batch takes the reference
+ *   offset - where the bytes start in packet->packet()
+ *   size - how many bytes to write
+ *   now - current monotonic time in microseconds
+ * Return:
+ *   true if the batch is full and should be written now
+ ******************************************************************************/
+bool PublishBatch::add(SharedPacket *packet, uint32_t offset, uint32_t size, uint64_t now) {
+    struct iovec iov;
+
+    if(empty())
+        m_iFirstAdd = now;
+
+    iov.iov_base = packet->packet() + offset;
+    iov.iov_len = size;
+
+    m_oPackets.push_back(packet);
+    m_oIov.push_back(iov);
+    m_iBytes += size;
+
+    return m_oPackets.size() >= m_iMaxPackets ||
+           (m_iMaxBytes && m_iBytes >= m_iMaxBytes);
+}
+
+/******************************************************************************
+ * Method: flushDelay
+ * Description: How long until the queued packets are due.
+ * Return:
+ *   microseconds to wait, 0 if they are due now
+ ******************************************************************************/
+uint64_t PublishBatch::flushDelay(uint64_t now) {
+    uint64_t deadline = m_iFirstAdd + m_iMaxDelay * USEC_PER_MSEC;
+
+    return now >= deadline ? 0 : deadline - now;
+}
+
+/******************************************************************************
+ * Method: clear
+ * Description: Release every queued packet.
+ ******************************************************************************/
+void PublishBatch::clear() {
+    for(vector<SharedPacket *>::iterator i = m_oPackets.begin(); i != m_oPackets.end(); i++)
+        (*i)->release();
+
+    m_oPackets.clear();
+    m_oIov.clear();
+    m_iBytes = 0;
+}
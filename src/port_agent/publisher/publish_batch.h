@@ -0,0 +1,99 @@
+/*******************************************************************************
+ * Class: PublishBatch
+ * Filename: publish_batch.h
+ * License: Apache 2.0
+ *
+ * Packets waiting to go out together on one publisher.  Each entry keeps a
+ * reference to its packet and points at the bytes to write, so nothing is
+ * copied.  The whole batch is handed to the comm object as an iovec array
+ * and goes out in a single writev, or a single sendmmsg on UDP.
+ *
+ * The batch reports full once it reaches the max packet count or max bytes.
+ * A partial batch is due once the first packet in it has waited the max
+ * delay.  Like the framer and throttle the batch has no timer, the owner
+ * checks flushDelay().
+ *
+ * A max packet count of 0 or 1 turns batching off.  A max bytes of 0 means
+ * no byte limit.
+ *
+ * Usage:
+ *
+ * PublishBatch batch;
+ * batch.setPolicy(32, 16384, 5);
+ *
+ * if(batch.add(SharedPacket::share(packet), 0, packet->packetSize(), now))
+ *     // write batch.iov(), batch.count() then batch.clear()
+ ******************************************************************************/
+
+#ifndef __PUBLISH_BATCH_H_
+#define __PUBLISH_BATCH_H_
+
+#include "port_agent/packet/shared_packet.h"
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <vector>
+
+using namespace std;
+using namespace packet;
+
+// Most buffers a single writev or sendmmsg takes
+#define MAX_BATCH_PACKETS 1024
+
+namespace publisher {
+    class PublishBatch {
+        /********************
+         *      METHODS     *
+         ********************/
+
+        public:
+            PublishBatch();
+            ~PublishBatch();
+
+            void setPolicy(uint32_t maxPackets, uint32_t maxBytes, uint32_t maxDelay);
+            bool policyIs(uint32_t maxPackets, uint32_t maxBytes, uint32_t maxDelay);
+            uint32_t maxPackets() const { return m_iMaxPackets; }
+            uint32_t maxBytes() const { return m_iMaxBytes; }
+            uint32_t maxDelay() const { return m_iMaxDelay; }
+
+            // Is batching turned on?
+            bool enabled() { return m_iMaxPackets > 1; }
+
+            // Queue size bytes at offset in the packet, the batch takes the
+            // reference.  Returns true when the batch should be written.
+            bool add(SharedPacket *packet, uint32_t offset, uint32_t size, uint64_t now);
+
+            bool empty() { return m_oPackets.empty(); }
+            int count() { return m_oIov.size(); }
+            uint32_t bytes() { return m_iBytes; }
+            const struct iovec* iov() { return empty() ? NULL : &m_oIov[0]; }
+
+            // Microseconds from now until a partial batch is due
+            uint64_t flushDelay(uint64_t now);
+
+            // Drop everything, call once the batch is written
+            void clear();
+
+        private:
+            PublishBatch(const PublishBatch &rhs);
+            PublishBatch & operator=(const PublishBatch &rhs);
+
+        /********************
+         *      MEMBERS     *
+         ********************/
+
+        private:
+            uint32_t m_iMaxPackets;
+            uint32_t m_iMaxBytes;
+            uint32_t m_iMaxDelay;
+
+            vector<SharedPacket *> m_oPackets;
+            vector<struct iovec> m_oIov;
+            uint32_t m_iBytes;
+
+            // Monotonic time the first packet was added, microseconds
+            uint64_t m_iFirstAdd;
+    };
+}
+
+#endif //__PUBLISH_BATCH_H_
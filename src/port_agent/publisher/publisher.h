@@ -17,6 +17,13 @@
  *   bool handleStatus(Packet *packet)
  *   bool handleFault(Packet *packet)
  *   bool handleInstrumentCommand(Packet *packet)
+ *   bool handleHeartbeat(Packet *packet)
+ *
+ * Subscriptions:
+ *
+ * subscriptions() returns a PacketTypeMask of the packet types a publisher
+ * writes.  PublisherList only routes those types to it, so a handler for a
+ * type left out is never called from the list.  The default is every type.
  *
  * Usage:
  *
@@ -28,6 +35,14 @@
  *   if(!publisher.publish(packet))
  *       handleFailure(publish.error());
  *
+ * A publisher may batch packets and write them later.  Call flush() once
+ * flushDelay() has passed while pending() is true.
+ *
+ * The packet passed to publish() and the handlers is only good for the
+ * duration of the call.  A publisher that delivers later must keep its own
+ * reference with SharedPacket::share(packet) and release it when done.  The
+ * port agent publishes shared packets so that doesn't copy anything.
+ *
  * Exceptions:
  *
  *   Exceptions are only thrown from constructors.
@@ -42,6 +57,7 @@
 #include "common/timestamp.h"
 #include "common/logger.h"
 #include "port_agent/packet/packet.h"
+#include "port_agent/packet/shared_packet.h"
 
 #include <list>
 #include <string>
@@ -63,8 +79,26 @@ namespace publisher {
         PUBLISHER_FILE,
         PUBLISHER_UDP,
         PUBLISHER_TCP,
-        PUBLISHER_TELNET_SNIFFER
+        PUBLISHER_TELNET_SNIFFER,
+        PUBLISHER_SHARED_MEMORY
     } PulisherType;
+
+    // One bit per PacketType
+    typedef uint32_t PacketTypeMask;
+
+    #define PACKET_TYPE_BIT(type) ((PacketTypeMask)1 << (type))
+
+    // Packet types are numbered from UNKNOWN up to PORT_AGENT_HEARTBEAT
+    const int PACKET_TYPE_COUNT = PORT_AGENT_HEARTBEAT + 1;
+
+    const PacketTypeMask ALL_PACKET_TYPES =
+        PACKET_TYPE_BIT(DATA_FROM_INSTRUMENT) |
+        PACKET_TYPE_BIT(DATA_FROM_DRIVER) |
+        PACKET_TYPE_BIT(PORT_AGENT_COMMAND) |
+        PACKET_TYPE_BIT(PORT_AGENT_STATUS) |
+        PACKET_TYPE_BIT(PORT_AGENT_FAULT) |
+        PACKET_TYPE_BIT(INSTRUMENT_COMMAND) |
+        PACKET_TYPE_BIT(PORT_AGENT_HEARTBEAT);
     
     class Publisher {
         /********************
@@ -89,10 +123,23 @@ namespace publisher {
             virtual bool publish(Packet *packet);
             virtual bool compare(Publisher *rhs) = 0;
 
+            // Publishers that batch their output hold packets back.  By
+            // default everything is written as it is published.
+            virtual bool pending() { return false; }
+            virtual uint64_t flushDelay(uint64_t now) { return 0; }
+            virtual bool flush() { return true; }
+
+            // Is written data still waiting for a slow client?
+            virtual bool outputPending() { return false; }
+
             /* Accessors */
 	    
 	    virtual const PublisherType publisherType() = 0;
 
+            // Packet types this publisher writes, the rest are no-ops
+            virtual PacketTypeMask subscriptions() { return ALL_PACKET_TYPES; }
+            bool subscribed(PacketType type) { return subscriptions() & PACKET_TYPE_BIT(type); }
+
             // Get the error from the last publish call
             OOIException * error();
 
@@ -36,6 +36,7 @@
 #include "port_agent/publisher/tcp_publisher.h"
 #include "port_agent/publisher/udp_publisher.h"
 #include "port_agent/publisher/telnet_sniffer_publisher.h"
+#include "port_agent/publisher/shared_memory_publisher.h"
 
 #include <sstream>
 #include <string>
@@ -70,17 +71,25 @@ PublisherList::~PublisherList() {
 
 /******************************************************************************
  * Method: publish
- * Description: publish a packet to all publishers
+ * Description: publish a packet to the publishers subscribed to its type
  *
  * Parameters:
  *   packet - a Packet object or one of it's derivatives
  *
  ******************************************************************************/
 bool PublisherList::publish(Packet *packet) {
-    PublisherObjectList::iterator i = m_oPublishers.begin();
+    PacketType type = packet->packetType();
+    PublisherRoute::iterator i;
     string error;
+
+    if(type <= packet::UNKNOWN || type >= PACKET_TYPE_COUNT) {
+        LOG(ERROR) << "Not publishing packet of unknown type: " << type;
+        return true;
+    }
+
+    PublisherRoute &route = m_oRoutes[type];
 	
-    for(i = m_oPublishers.begin(); i != m_oPublishers.end(); i++)
+    for(i = route.begin(); i != route.end(); i++)
         try {
 			LOG(DEBUG2) << "publish with publisher type: " << (*i)->publisherType();
     		(*i)->publish(packet);
@@ -97,6 +106,209 @@ bool PublisherList::publish(Packet *packet) {
     return true;
 }
 
+/******************************************************************************
+ * Method: flush
+ * Description: Write all batched packets on every publisher.
+ *
+ * Exceptions:
+ *   PacketPublishFailure
+ ******************************************************************************/
+void PublisherList::flush() {
+    flushDue(0);
+}
+
+/******************************************************************************
+ * Method: flushDue
+ * Description: Write batched packets on the publishers where they have waited
+ * long enough.  An error on one publisher doesn't stop the others.
+ *
+ * Parameters:
+ *   now - current monotonic time in microseconds, 0 to flush everything
+ *
+ * Exceptions:
+ *   PacketPublishFailure
+ ******************************************************************************/
+void PublisherList::flushDue(uint64_t now) {
+    PublisherObjectList::iterator i = m_oPublishers.begin();
+    string error;
+
+    for(i = m_oPublishers.begin(); i != m_oPublishers.end(); i++) {
+        if(!(*i)->pending() || (now && (*i)->flushDelay(now)))
+            continue;
+
+        try {
+			LOG(DEBUG2) << "flush publisher type: " << (*i)->publisherType();
+    		(*i)->flush();
+		}
+		catch(OOIException &e) {
+			ostringstream err;
+			err << "<Publish Type> error: " << e.what() << endl;
+			error += err.str();
+		};
+    }
+
+	if(error.length())
+	    throw PacketPublishFailure(error.c_str());
+}
+
+/******************************************************************************
+ * Method: setBatchPolicy
+ * Description: Set the batch policy on every publisher of a type.  Only file
+ * pointer publishers batch, the log publisher writes through its own buffer.
+ *
+ * Parameters:
+ *   type - publisher type
+ *   maxPackets - packets per write, 0 or 1 turns batching off
+ *   maxBytes - bytes per write, 0 for no limit
+ *   maxDelay - longest a packet waits, milliseconds
+ ******************************************************************************/
+void PublisherList::setBatchPolicy(PublisherType type, uint32_t maxPackets,
+                                   uint32_t maxBytes, uint32_t maxDelay) {
+    PublisherObjectList::iterator i = m_oPublishers.begin();
+
+    if(type == PUBLISHER_FILE)
+        return;
+
+    for(i = m_oPublishers.begin(); i != m_oPublishers.end(); i++)
+	    if((*i)->publisherType() == type)
+		    ((FilePointerPublisher *)(*i))->setBatchPolicy(maxPackets, maxBytes, maxDelay);
+}
+
+/******************************************************************************
+ * Method: setCommitPolicy
+ * Description: Set how every file publisher group commits its log writes.
+ *
+ * Parameters:
+ *   maxDelay - longest a write is held, milliseconds.  0 flushes each write.
+ *   maxBytes - commit once this many bytes are held, 0 for no limit
+ *   syncInterval - fdatasync at most this often, milliseconds.  0 is never.
+ ******************************************************************************/
+void PublisherList::setCommitPolicy(uint32_t maxDelay, uint32_t maxBytes,
+                                    uint32_t syncInterval) {
+    PublisherObjectList::iterator i = m_oPublishers.begin();
+
+    for(i = m_oPublishers.begin(); i != m_oPublishers.end(); i++)
+	    if((*i)->publisherType() == PUBLISHER_FILE)
+		    ((FilePublisher *)(*i))->setCommitPolicy(maxDelay, maxBytes, syncInterval);
+}
+
+/******************************************************************************
+ * Method: setPreallocation
+ * Description: Set the preallocation segment of every file publisher.
+ *
+ * Parameters:
+ *   segmentSize - bytes to allocate at a time, 0 writes through a stream
+ ******************************************************************************/
+void PublisherList::setPreallocation(uint32_t segmentSize) {
+    PublisherObjectList::iterator i = m_oPublishers.begin();
+
+    for(i = m_oPublishers.begin(); i != m_oPublishers.end(); i++)
+	    if((*i)->publisherType() == PUBLISHER_FILE)
+		    ((FilePublisher *)(*i))->setPreallocation(segmentSize);
+}
+
+/******************************************************************************
+ * Method: setIndexPolicy
+ * Description: Set how often every data log publisher indexes its packets.
+ *
+ * Parameters:
+ *   packets - an entry at least every this many packets, 0 for no limit
+ *   interval - an entry at least every this many seconds, 0 for no limit
+ ******************************************************************************/
+void PublisherList::setIndexPolicy(uint32_t packets, uint32_t interval) {
+    PublisherObjectList::iterator i = m_oPublishers.begin();
+
+    for(i = m_oPublishers.begin(); i != m_oPublishers.end(); i++)
+	    if((*i)->publisherType() == PUBLISHER_FILE)
+		    ((LogPublisher *)(*i))->setIndexPolicy(packets, interval);
+}
+
+/******************************************************************************
+ * Method: setLogListener
+ * Description: Set the listener told about every file publisher's log files.
+ *
+ * Parameters:
+ *   listener - not owned, NULL for no one
+ ******************************************************************************/
+void PublisherList::setLogListener(LogFileListener *listener) {
+    PublisherObjectList::iterator i = m_oPublishers.begin();
+
+    for(i = m_oPublishers.begin(); i != m_oPublishers.end(); i++)
+	    if((*i)->publisherType() == PUBLISHER_FILE)
+		    ((FilePublisher *)(*i))->setListener(listener);
+}
+
+/******************************************************************************
+ * Method: closeFiles
+ * Description: Close every file publisher's log.  Held writes are committed
+ * and preallocated files truncated to their data, the next write opens the
+ * file again.
+ ******************************************************************************/
+void PublisherList::closeFiles() {
+    PublisherObjectList::iterator i = m_oPublishers.begin();
+
+    for(i = m_oPublishers.begin(); i != m_oPublishers.end(); i++)
+	    if((*i)->publisherType() == PUBLISHER_FILE)
+		    ((FilePublisher *)(*i))->close();
+}
+
+/******************************************************************************
+ * Method: pending
+ * Description: Are there batched packets or uncommitted log writes on any
+ * publisher?
+ ******************************************************************************/
+bool PublisherList::pending() {
+    PublisherObjectList::iterator i = m_oPublishers.begin();
+
+    for(i = m_oPublishers.begin(); i != m_oPublishers.end(); i++)
+	    if((*i)->pending())
+		    return true;
+
+    return false;
+}
+
+/******************************************************************************
+ * Method: outputPending
+ * Description: Is written data waiting for a slow client on any publisher?
+ ******************************************************************************/
+bool PublisherList::outputPending() {
+    PublisherObjectList::iterator i = m_oPublishers.begin();
+
+    for(i = m_oPublishers.begin(); i != m_oPublishers.end(); i++)
+	    if((*i)->outputPending())
+		    return true;
+
+    return false;
+}
+
+/******************************************************************************
+ * Method: flushDelay
+ * Description: How long until the first publisher's batch is due.
+ *
+ * Parameters:
+ *   now - current monotonic time in microseconds
+ *
+ * Return:
+ *   microseconds to wait, 0 if something is due now or nothing is pending
+ ******************************************************************************/
+uint64_t PublisherList::flushDelay(uint64_t now) {
+    PublisherObjectList::iterator i = m_oPublishers.begin();
+    uint64_t delay = 0;
+    bool found = false;
+
+    for(i = m_oPublishers.begin(); i != m_oPublishers.end(); i++) {
+	    if(!(*i)->pending())
+		    continue;
+
+		uint64_t next = (*i)->flushDelay(now);
+		if(!found || next < delay)
+		    delay = next;
+		found = true;
+    }
+
+    return delay;
+}
+
 /******************************************************************************
  * Method: searchByType
  * Description: search for the first occurance of a publisher with passed type
@@ -118,6 +330,17 @@ Publisher* PublisherList::searchByType(PublisherType type) {
     return NULL;
 }
 
+/******************************************************************************
+ * Method: subscribers
+ * Description: How many publishers a packet of this type goes to.
+ ******************************************************************************/
+uint32_t PublisherList::subscribers(PacketType type) {
+    if(type <= packet::UNKNOWN || type >= PACKET_TYPE_COUNT)
+        return 0;
+
+    return m_oRoutes[type].size();
+}
+
 /******************************************************************************
  * Method: add
  * Description: Add a publisher to the list.
@@ -145,6 +368,30 @@ void PublisherList::add(Publisher *publisher) {
     }
 }
 
+/******************************************************************************
+ * Method: removeByType
+ * Description: Remove and delete every publisher of a type.  Used before the
+ * connection they write to is deleted, so nothing is left pointing at it.
+ *
+ * Parameters:
+ *   type - publisher type
+ ******************************************************************************/
+void PublisherList::removeByType(PublisherType type) {
+    PublisherObjectList::iterator i = m_oPublishers.begin();
+
+    while(i != m_oPublishers.end()) {
+        if((*i)->publisherType() == type) {
+            LOG(DEBUG2) << "Removing publisher type " << type;
+            delete *i;
+            i = m_oPublishers.erase(i);
+        }
+        else
+            i++;
+    }
+
+    buildRoutes();
+}
+
 /******************************************************************************
  * Method: addUnique
  * Description: Add a unique publisher to the list.
@@ -157,6 +404,7 @@ void PublisherList::addUnique(Publisher *publisher) {
     	if(publisher->publisherType() == (*i)->publisherType()) {
 			LOG(DEBUG2) << "Found duplicate type, removing old publisher";
 	        m_oPublishers.remove(*i);
+	        buildRoutes();
 	        // break out here to avoid crashing; list iterator gets mixed up
 	        // if we continue looping here.
 	        break;
@@ -204,6 +452,9 @@ void PublisherList::addPublisher(Publisher *publisher) {
     else if(publisher->publisherType() == PUBLISHER_TELNET_SNIFFER)
         newPublisher = new TelnetSnifferPublisher(*(TelnetSnifferPublisher*)publisher);
 	
+    else if(publisher->publisherType() == PUBLISHER_SHARED_MEMORY)
+        newPublisher = new SharedMemoryPublisher(*(SharedMemoryPublisher*)publisher);
+	
     else
         throw UnknownPublisherType();
     
@@ -214,6 +465,28 @@ void PublisherList::addPublisher(Publisher *publisher) {
 	} else {
         m_oPublishers.push_back(newPublisher);
 	}
+
+    buildRoutes();
+}
+
+/******************************************************************************
+ * Method: buildRoutes
+ * Description: Rebuild the publishers for each packet type from their
+ * subscriptions.  Done when the list changes so publish() only visits the
+ * publishers that write the packet.
+ ******************************************************************************/
+void PublisherList::buildRoutes() {
+    PublisherObjectList::iterator i;
+
+    for(int type = 0; type < PACKET_TYPE_COUNT; type++) {
+        m_oRoutes[type].clear();
+
+        for(i = m_oPublishers.begin(); i != m_oPublishers.end(); i++)
+            if((*i)->subscribed((PacketType)type))
+                m_oRoutes[type].push_back(*i);
+
+        LOG(DEBUG2) << "packet type: " << type << " publishers: " << m_oRoutes[type].size();
+    }
 }
 
 
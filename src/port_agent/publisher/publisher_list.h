@@ -20,6 +20,9 @@
  * list.add(&publisher);
  *
  * list.publish(packet);
+ *
+ * A packet only goes to the publishers subscribed to its type.  The list
+ * keeps a route for each packet type, rebuilt whenever a publisher is added.
  *    
  ******************************************************************************/
 
@@ -27,19 +30,23 @@
 #define __PUBLISHER_LIST_H_
 
 #include "common/exception.h"
+#include "common/log_file.h"
 #include "common/timestamp.h"
 #include "port_agent/publisher/publisher.h"
 
 #include <list>
 #include <string>
+#include <vector>
 
 
 using namespace std;
+using namespace logger;
 using namespace packet;
 
 
 namespace publisher {
     typedef list<Publisher *> PublisherObjectList;
+    typedef vector<Publisher *> PublisherRoute;
     
     class PublisherList {
         /********************
@@ -56,15 +63,48 @@ namespace publisher {
             
             /*  Commands */
             bool publish(Packet *packet);
+
+            // Write batched packets, all of them or only those that are due
+            void flush();
+            void flushDue(uint64_t now);
+
+            // Batch policy for every publisher of a type
+            void setBatchPolicy(PublisherType type, uint32_t maxPackets,
+                                uint32_t maxBytes, uint32_t maxDelay);
+
+            // Commit policy for the data log publishers
+            void setCommitPolicy(uint32_t maxDelay, uint32_t maxBytes, uint32_t syncInterval);
+
+            // Preallocation segment for the data log publishers, 0 for none
+            void setPreallocation(uint32_t segmentSize);
+
+            // Time index policy for the data log publishers
+            void setIndexPolicy(uint32_t packets, uint32_t interval);
+
+            // Listener for the files the data log publishers open
+            void setLogListener(LogFileListener *listener);
+
+            // Close the data log files, truncating preallocated ones
+            void closeFiles();
             
 	    void add(Publisher *publisher);
 
+            // Remove and delete every publisher of this type
+            void removeByType(PublisherType type);
+
             /* Accessors */
 			uint32_t size() const { return m_oPublishers.size(); }
 			Publisher * front() { return m_oPublishers.front(); }
 			Publisher * back() { return m_oPublishers.back(); }
 			Publisher * searchByType(PublisherType type);
 
+			// Publishers a packet of this type goes to
+			uint32_t subscribers(PacketType type);
+
+			bool pending();
+			bool outputPending();
+			uint64_t flushDelay(uint64_t now);
+
         protected:
 
 
@@ -72,6 +112,7 @@ namespace publisher {
 	    
 	    void addUnique(Publisher *publisher);
 	    void addPublisher(Publisher *publisher);
+	    void buildRoutes();
         
         /********************
          *      MEMBERS     *
@@ -82,6 +123,9 @@ namespace publisher {
         private:
             PublisherObjectList m_oPublishers;
 
+            // Subscribed publishers for each packet type, in list order
+            PublisherRoute m_oRoutes[PACKET_TYPE_COUNT];
+
     };
 }
 
@@ -0,0 +1,22 @@
+/*******************************************************************************
+ * Class: SharedMemoryPublisher
+ * Filename: shared_memory_publisher.cxx
+ * License: Apache 2.0
+ *
+ * Publish every packet to a SharedMemoryRing for drivers running on the same
+ * host.
+ ******************************************************************************/
+#include "shared_memory_publisher.h"
+
+using namespace publisher;
+    
+/******************************************************************************
+ *   PUBLIC METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ * Description: Default constructor
+ ******************************************************************************/
+SharedMemoryPublisher::SharedMemoryPublisher() {
+}
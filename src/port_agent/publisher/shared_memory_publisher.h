@@ -0,0 +1,47 @@
+/*******************************************************************************
+ * Class: SharedMemoryPublisher
+ * Filename: shared_memory_publisher.h
+ * License: Apache 2.0
+ *
+ * Publish every packet to a SharedMemoryRing for drivers running on the same
+ * host.  Each packet is one record in the ring, so readers get whole packets
+ * without a socket in between.
+ ******************************************************************************/
+
+#ifndef __SHARED_MEMORY_PUBLISHER_H_
+#define __SHARED_MEMORY_PUBLISHER_H_
+
+#include "file_pointer_publisher.h"
+
+using namespace std;
+using namespace logger;
+
+namespace publisher {
+    class SharedMemoryPublisher : public FilePointerPublisher {
+        /********************
+         *      METHODS     *
+         ********************/
+        
+        public:
+
+            SharedMemoryPublisher();
+            SharedMemoryPublisher(CommBase *ring) : FilePointerPublisher(ring) {}
+
+            const PublisherType publisherType() { return PUBLISHER_SHARED_MEMORY; }
+
+        protected:
+
+        private:
+        
+        /********************
+         *      MEMBERS     *
+         ********************/
+        
+        protected:
+            
+        private:
+
+    };
+}
+
+#endif //__SHARED_MEMORY_PUBLISHER_H_
@@ -48,28 +48,37 @@ TelnetSnifferPublisher::TelnetSnifferPublisher() : TCPPublisher() {
  ******************************************************************************/
 bool TelnetSnifferPublisher::publishDataFromInstrument(Packet *packet) {
     LOG(DEBUG2) << "Publish packet to sniffer: " << packet->payload();
-    return write(packet->payload(), packet->payloadSize());
+    return writePacketData(packet, packet->payload(), packet->payloadSize());
 }
 
 /******************************************************************************
- * Method: publishDataFrominstrument
- * Description: Write a packet of data to the internal file pointer.  Raise an
- * error if we don't have a file pointer.
+ * Method: publishDataFromObservatory
+ * Description: Write driver data wrapped in the prefix and suffix.  All three
+ * go out in one write so the sniffer sees them together.  Nothing is written
+ * unless a prefix or suffix is set.
  *
  * Parameter:
  *    Packet* - Pointer to a packet of data we need to write to the FILE*
  ******************************************************************************/
 bool TelnetSnifferPublisher::publishDataFromObservatory(Packet *packet) {
-    bool result = true;
-    if(m_prefix.length() || m_suffix.length()) {
-        if(m_prefix.length()) {
-            write(m_prefix.c_str(), m_prefix.length());
-        }
-        result = write(packet->payload(), packet->payloadSize());
-        if(m_suffix.length()) {
-            write(m_suffix.c_str(), m_suffix.length());
-        }
+    struct iovec iov[3];
+    int count = 0;
+
+    if(!m_prefix.length() && !m_suffix.length())
+        return true;
+
+    if(m_prefix.length()) {
+        iov[count].iov_base = (void *)m_prefix.c_str();
+        iov[count++].iov_len = m_prefix.length();
     }
-    
-    return result;
+
+    iov[count].iov_base = packet->payload();
+    iov[count++].iov_len = packet->payloadSize();
+
+    if(m_suffix.length()) {
+        iov[count].iov_base = (void *)m_suffix.c_str();
+        iov[count++].iov_len = m_suffix.length();
+    }
+
+    return writeVector(iov, count);
 }
\ No newline at end of file
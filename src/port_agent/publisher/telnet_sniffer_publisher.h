@@ -28,6 +28,12 @@ namespace publisher {
            TelnetSnifferPublisher(CommBase *socket) : TCPPublisher(socket) {}
 
 	       const PublisherType publisherType() { return PUBLISHER_TELNET_SNIFFER; }
+
+	       // Heartbeats are written by FilePointerPublisher::handleHeartbeat
+	       PacketTypeMask subscriptions() {
+	           return PACKET_TYPE_BIT(DATA_FROM_INSTRUMENT) | PACKET_TYPE_BIT(DATA_FROM_DRIVER) |
+	                  PACKET_TYPE_BIT(PORT_AGENT_HEARTBEAT);
+	       }
 		   
 		   bool publishDataFromInstrument(Packet *packet); 
 		   bool publishDataFromObservatory(Packet *packet);
@@ -36,8 +42,8 @@ namespace publisher {
 		   void setSuffix(const string &param) { m_suffix = param; }
 	   
         protected:
-            virtual bool handleInstrumentData(Packet *packet)     { publishDataFromInstrument(packet); }
-            virtual bool handleDriverData(Packet *packet)         { publishDataFromObservatory(packet); }
+            virtual bool handleInstrumentData(Packet *packet)     { return publishDataFromInstrument(packet); }
+            virtual bool handleDriverData(Packet *packet)         { return publishDataFromObservatory(packet); }
             virtual bool handleInstrumentCommand(Packet *packet)  { return true; }
             virtual bool handleCommand(Packet *packet)            { return true; }
             virtual bool handleStatus(Packet *packet)             { return true; }
@@ -123,6 +123,35 @@ TEST_F(LogPublisherTest, DoubleBinaryOut) {
     EXPECT_TRUE(rawCompare(expected, result, count));
 }
 
+/* Test the time index written beside the data file */
+TEST_F(LogPublisherTest, TimeIndex) {
+    LogPublisher publisher;
+    remove_file(DATAFILE LOG_INDEX_EXTENTION);
+
+    publisher.setFilename(DATAFILE);
+    publisher.setIndexPolicy(2, 0);
+    EXPECT_EQ(publisher.indexPackets(), 2);
+    EXPECT_EQ(publisher.indexInterval(), 0);
+
+    for(int i = 0; i < 5; i++) {
+        Timestamp ts(100 + i, 0);
+        Packet packet(DATA_FROM_DRIVER, ts, "data", 4);
+        EXPECT_TRUE(publisher.publish(&packet));
+    }
+    publisher.setIndexPolicy(0, 0);
+    publisher.close();
+
+    LogIndexReader reader(DATAFILE);
+    ASSERT_TRUE(reader.load());
+    ASSERT_EQ(reader.size(), 3);
+    EXPECT_EQ(reader.entry(0).offset, 0);
+    EXPECT_EQ(reader.entry(1).offset, 40);
+    EXPECT_EQ(reader.entry(2).offset, 80);
+    EXPECT_EQ(reader.seek(Timestamp(103, 0)), 40);
+
+    remove_file(DATAFILE LOG_INDEX_EXTENTION);
+}
+
 // NOTE: We are only testing one packet type because they all call the same
 // interface.
 
@@ -0,0 +1,175 @@
+#include "common/logger.h"
+#include "common/exception.h"
+#include "port_agent/packet/shared_packet.h"
+#include "port_agent/publisher/publish_batch.h"
+#include "port_agent/publisher/driver_data_publisher.h"
+#include "network/timer_queue.h"
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string>
+#include <string.h>
+
+//
+// List all tests
+//
+// publish_batch_test --gtest_list_tests
+
+
+//
+// Running individual tests
+//
+// publish_batch_test --gtest_filter=PublishBatchTest.FullOnCount
+
+using namespace std;
+using namespace logger;
+using namespace packet;
+using namespace publisher;
+using namespace network;
+
+class PublishBatchTest : public testing::Test {
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile("/tmp/gtest.log");
+            Logger::SetLogLevel("MESG");
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "         Publish Batch Test Start Up";
+            LOG(INFO) << "************************************************";
+        }
+
+        SharedPacket * newPacket(const char *payload) {
+            return SharedPacket::create(DATA_FROM_INSTRUMENT, Timestamp(1, 2),
+                                        payload, strlen(payload));
+        }
+
+        string readBack(FILE *file) {
+            char buffer[1024];
+            size_t size;
+
+            fflush(file);
+            rewind(file);
+            size = fread(buffer, 1, sizeof(buffer), file);
+            fseek(file, 0, SEEK_END);
+            return string(buffer, size);
+        }
+};
+
+/* The batch is full once it holds max packets */
+TEST_F(PublishBatchTest, FullOnCount) {
+    PublishBatch batch;
+    SharedPacket *packet = newPacket("abc");
+
+    batch.setPolicy(3, 0, 5);
+    EXPECT_TRUE(batch.enabled());
+
+    EXPECT_FALSE(batch.add(packet->retain(), HEADER_SIZE, 3, 0));
+    EXPECT_FALSE(batch.add(packet->retain(), HEADER_SIZE, 3, 0));
+    EXPECT_TRUE(batch.add(packet->retain(), HEADER_SIZE, 3, 0));
+
+    EXPECT_EQ(batch.count(), 3);
+    EXPECT_EQ(batch.bytes(), 9);
+    EXPECT_EQ(string((char *)batch.iov()[2].iov_base, batch.iov()[2].iov_len), "abc");
+
+    // Clearing gives the references back
+    EXPECT_EQ(packet->references(), 4);
+    batch.clear();
+    EXPECT_TRUE(batch.empty());
+    EXPECT_EQ(packet->references(), 1);
+
+    packet->release();
+}
+
+/* The batch is full once it holds max bytes */
+TEST_F(PublishBatchTest, FullOnBytes) {
+    PublishBatch batch;
+    SharedPacket *packet = newPacket("abcdefgh");
+
+    batch.setPolicy(100, 10, 5);
+
+    EXPECT_FALSE(batch.add(packet->retain(), HEADER_SIZE, 8, 0));
+    EXPECT_TRUE(batch.add(packet->retain(), HEADER_SIZE, 8, 0));
+
+    batch.clear();
+    packet->release();
+}
+
+/* A partial batch is due max delay after the first packet */
+TEST_F(PublishBatchTest, FlushDelay) {
+    PublishBatch batch;
+    SharedPacket *packet = newPacket("abc");
+
+    batch.setPolicy(10, 0, 5);
+
+    batch.add(packet->retain(), HEADER_SIZE, 3, 1000);
+    batch.add(packet->retain(), HEADER_SIZE, 3, 4000);
+
+    EXPECT_EQ(batch.flushDelay(1000), 5 * USEC_PER_MSEC);
+    EXPECT_EQ(batch.flushDelay(4000), 2 * USEC_PER_MSEC);
+    EXPECT_EQ(batch.flushDelay(6000), 0);
+    EXPECT_EQ(batch.flushDelay(9000), 0);
+
+    batch.clear();
+    packet->release();
+}
+
+/* Policies over the limit are capped and 0 or 1 packets is off */
+TEST_F(PublishBatchTest, Policy) {
+    PublishBatch batch;
+
+    EXPECT_FALSE(batch.enabled());
+
+    batch.setPolicy(MAX_BATCH_PACKETS + 1, 0, 0);
+    EXPECT_EQ(batch.maxPackets(), MAX_BATCH_PACKETS);
+    EXPECT_TRUE(batch.policyIs(MAX_BATCH_PACKETS + 10, 0, 0));
+
+    batch.setPolicy(1, 0, 0);
+    EXPECT_FALSE(batch.enabled());
+}
+
+/* A batching publisher writes nothing until the batch is full or flushed */
+TEST_F(PublishBatchTest, PublisherBatching) {
+    DriverDataPublisher publisher;
+    FILE *file = tmpfile();
+    SharedPacket *packet = newPacket("abc");
+
+    ASSERT_TRUE(file);
+    publisher.setFilePointer(file);
+    publisher.setAsciiMode(true);
+    publisher.setBatchPolicy(2, 0, 5);
+
+    // ascii packets are formatted, so they go out right away
+    EXPECT_TRUE(publisher.publish(packet));
+    EXPECT_FALSE(publisher.pending());
+    size_t asciiSize = readBack(file).length();
+    EXPECT_GT(asciiSize, 0);
+
+    publisher.setAsciiMode(false);
+    EXPECT_TRUE(publisher.publish(packet));
+    EXPECT_TRUE(publisher.pending());
+    EXPECT_EQ(readBack(file).length(), asciiSize);
+
+    // The batch holds a reference
+    EXPECT_EQ(packet->references(), 2);
+
+    EXPECT_TRUE(publisher.publish(packet));
+    EXPECT_FALSE(publisher.pending());
+    EXPECT_EQ(packet->references(), 1);
+    EXPECT_EQ(readBack(file).length(), asciiSize + 2 * packet->packetSize());
+
+    // A partial batch goes out on flush
+    EXPECT_TRUE(publisher.publish(packet));
+    EXPECT_TRUE(publisher.pending());
+    EXPECT_TRUE(publisher.flush());
+    EXPECT_FALSE(publisher.pending());
+    EXPECT_EQ(readBack(file).length(), asciiSize + 3 * packet->packetSize());
+
+    // Turning batching off writes what is queued
+    EXPECT_TRUE(publisher.publish(packet));
+    publisher.setBatchPolicy(0, 0, 0);
+    EXPECT_FALSE(publisher.pending());
+    EXPECT_EQ(readBack(file).length(), asciiSize + 4 * packet->packetSize());
+
+    packet->release();
+    fclose(file);
+}
@@ -6,6 +6,7 @@
 #include "port_agent/publisher/publisher_list.h"
 #include "port_agent/publisher/driver_command_publisher.h"
 #include "port_agent/publisher/instrument_command_publisher.h"
+#include "port_agent/publisher/instrument_data_publisher.h"
 #include "port_agent/publisher/tcp_publisher.h"
 #include "port_agent/publisher/udp_publisher.h"
 #include "port_agent/publisher/log_publisher.h"
@@ -247,4 +248,49 @@ TEST_F(PublisherListTest, SearchAndSetRotation) {
 	EXPECT_TRUE(found);
 	
 	((FilePublisher*)found)->setRotationInterval(HOURLY);
-}
\ No newline at end of file
+}
+
+TEST_F(PublisherListTest, Routing) {
+	PublisherList list;
+	LogPublisher publisher;
+
+	TCPCommSocket socketA;
+	socketA.setHostname("localhost");
+	socketA.setPort(OBSERVATORY_COMMAND_PORT);
+	TCPPublisher publisherA(&socketA);
+
+	TCPCommSocket socketB;
+	socketB.setHostname("localhost");
+	socketB.setPort(INSTRUMENT_DATA_PORT);
+	InstrumentDataPublisher publisherB(&socketB);
+
+	EXPECT_TRUE(publisherA.subscribed(PORT_AGENT_HEARTBEAT));
+	EXPECT_FALSE(publisher.subscribed(PORT_AGENT_HEARTBEAT));
+	EXPECT_TRUE(publisherB.subscribed(DATA_FROM_DRIVER));
+	EXPECT_FALSE(publisherB.subscribed(DATA_FROM_INSTRUMENT));
+	EXPECT_FALSE(publisherA.subscribed(packet::UNKNOWN));
+
+	EXPECT_EQ(list.subscribers(DATA_FROM_DRIVER), 0);
+
+	list.add(&publisher);
+	list.add(&publisherA);
+	list.add(&publisherB);
+	EXPECT_EQ(list.size(), 3);
+
+	EXPECT_EQ(list.subscribers(DATA_FROM_DRIVER), 3);
+	EXPECT_EQ(list.subscribers(DATA_FROM_INSTRUMENT), 2);
+	EXPECT_EQ(list.subscribers(PORT_AGENT_STATUS), 2);
+	EXPECT_EQ(list.subscribers(PORT_AGENT_HEARTBEAT), 1);
+	EXPECT_EQ(list.subscribers(packet::UNKNOWN), 0);
+
+	// Replacing a unique publisher keeps one route to it
+	list.add(&publisherB);
+	EXPECT_EQ(list.subscribers(DATA_FROM_DRIVER), 3);
+
+	// Removing a type drops its routes too
+	list.removeByType(PUBLISHER_TCP);
+	EXPECT_EQ(list.size(), 2);
+	EXPECT_FALSE(list.searchByType(PUBLISHER_TCP));
+	EXPECT_EQ(list.subscribers(PORT_AGENT_HEARTBEAT), 0);
+	EXPECT_EQ(list.subscribers(DATA_FROM_DRIVER), 2);
+}
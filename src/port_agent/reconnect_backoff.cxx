@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * Class: ReconnectBackoff
+ * Filename: reconnect_backoff.cxx
+ * License: Apache 2.0
+ *
+ * Exponential backoff with jitter.  See reconnect_backoff.h for usage.
+ ******************************************************************************/
+
+#include "reconnect_backoff.h"
+#include "common/logger.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace logger;
+using namespace port_agent;
+
+/******************************************************************************
+ *   PUBLIC METHODS
+ ******************************************************************************/
+
+/******************************************************************************
+ * Method: Constructor
+ *
+ * Parameters:
+ *   minDelay - first delay in milliseconds
+ *   maxDelay - longest delay in milliseconds
+ *   jitter - percent each delay may be moved up or down, 0 - 100
+ ******************************************************************************/
+ReconnectBackoff::ReconnectBackoff(uint32_t minDelay, uint32_t maxDelay, uint32_t jitter) {
+    m_iSeed = time(NULL) ^ getpid();
+
+    setLimits(minDelay, maxDelay, jitter);
+    reset();
+}
+
+/******************************************************************************
+ * Method: setLimits
+ * Description: Change the backoff parameters.  The next delay is computed
+ * with the new limits, the attempt count is kept.
+ ******************************************************************************/
+void ReconnectBackoff::setLimits(uint32_t minDelay, uint32_t maxDelay, uint32_t jitter) {
+    m_iMinDelay = minDelay ? minDelay : 1;
+    m_iMaxDelay = maxDelay > m_iMinDelay ? maxDelay : m_iMinDelay;
+    m_iJitter = jitter > 100 ? 100 : jitter;
+}
+
+/******************************************************************************
+ * Method: nextDelay
+ * Description: Count a failed attempt and return how long to wait before
+ * the next one.
+ * Return:
+ *   delay in milliseconds, never 0.
+ ******************************************************************************/
+uint32_t ReconnectBackoff::nextDelay() {
+    uint64_t delay;
+    uint64_t range;
+
+    if(m_iAttempts == 0 || m_iDelay < m_iMinDelay)
+        m_iDelay = m_iMinDelay;
+    else if(m_iDelay < m_iMaxDelay / 2)
+        m_iDelay *= 2;
+    else
+        m_iDelay = m_iMaxDelay;
+
+    m_iAttempts++;
+
+    delay = m_iDelay;
+    range = delay * m_iJitter / 100;
+    if(range)
+        delay = delay - range + rand_r(&m_iSeed) % (2 * range + 1);
+
+    LOG(DEBUG2) << "reconnect attempt " << m_iAttempts << " delay: " << delay;
+    return delay ? delay : 1;
+}
+
+/******************************************************************************
+ * Method: reset
+ * Description: Start over from the min delay.
+ ******************************************************************************/
+void ReconnectBackoff::reset() {
+    m_iAttempts = 0;
+    m_iDelay = m_iMinDelay;
+}
@@ -0,0 +1,57 @@
+/*******************************************************************************
+ * Class: ReconnectBackoff
+ * Filename: reconnect_backoff.h
+ * License: Apache 2.0
+ *
+ * Exponential backoff with jitter for instrument reconnects.  The first delay
+ * is the min delay, each further failure doubles it up to the max delay.
+ * Every delay is then moved randomly by up to jitter percent so agents that
+ * lost the same instrument server don't all retry at the same moment.
+ *
+ * Usage:
+ *
+ * ReconnectBackoff backoff(1000, 60000, 25);
+ *
+ * // After a failed attempt, wait this many milliseconds
+ * uint32_t delay = backoff.nextDelay();
+ *
+ * // Once connected start over from the min delay
+ * backoff.reset();
+ ******************************************************************************/
+
+#ifndef __RECONNECT_BACKOFF_H_
+#define __RECONNECT_BACKOFF_H_
+
+#include <stdint.h>
+
+namespace port_agent {
+
+    class ReconnectBackoff {
+        public:
+            ReconnectBackoff(uint32_t minDelay, uint32_t maxDelay, uint32_t jitter);
+
+            void setLimits(uint32_t minDelay, uint32_t maxDelay, uint32_t jitter);
+
+            uint32_t minDelay() { return m_iMinDelay; }
+            uint32_t maxDelay() { return m_iMaxDelay; }
+            uint32_t jitter() { return m_iJitter; }
+
+            // Failed attempts since the last reset
+            uint32_t attempts() { return m_iAttempts; }
+
+            uint32_t nextDelay();
+            void reset();
+
+        private:
+            uint32_t m_iMinDelay;
+            uint32_t m_iMaxDelay;
+            uint32_t m_iJitter;
+
+            uint32_t m_iAttempts;
+            uint32_t m_iDelay;
+
+            unsigned int m_iSeed;
+    };
+}
+
+#endif //__RECONNECT_BACKOFF_H_
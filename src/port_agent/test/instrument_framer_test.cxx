@@ -0,0 +1,148 @@
+/*******************************************************************************
+ * Filename: instrument_framer_test.cxx
+ * License: Apache 2.0
+ *
+ * Unit tests for framing instrument data into records.
+ *
+ ******************************************************************************/
+
+#include "common/logger.h"
+#include "network/timer_queue.h"
+#include "port_agent/instrument_framer.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using namespace logger;
+using namespace std;
+using namespace network;
+using namespace port_agent;
+
+const char* TEST_LOG="/tmp/gtest.log";
+
+class InstrumentFramerTest : public testing::Test {
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile(TEST_LOG);
+            Logger::SetLogLevel("DEBUG3");
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "         Instrument Framer Test Start Up";
+            LOG(INFO) << "************************************************";
+        }
+
+        virtual void TearDown() {
+            release();
+        }
+
+        // Payloads of the records, releasing them
+        vector<string> payloads() {
+            vector<string> result;
+
+            for(uint32_t i = 0; i < m_oRecords.size(); i++)
+                result.push_back(string(m_oRecords[i]->payload(), m_oRecords[i]->payloadSize()));
+
+            release();
+            return result;
+        }
+
+        void release() {
+            for(uint32_t i = 0; i < m_oRecords.size(); i++)
+                m_oRecords[i]->release();
+            m_oRecords.clear();
+        }
+
+        vector<SharedPacket *> m_oRecords;
+};
+
+/* Framing is only on when there is something to frame on */
+TEST_F(InstrumentFramerTest, Required) {
+    EXPECT_FALSE(InstrumentFramer::required("", 0));
+    EXPECT_TRUE(InstrumentFramer::required("\r\n", 0));
+    EXPECT_TRUE(InstrumentFramer::required("", 100));
+
+    InstrumentFramer framer(1024, "\n", 0);
+    EXPECT_TRUE(framer.configuredFor(1024, "\n", 0));
+    EXPECT_FALSE(framer.configuredFor(512, "\n", 0));
+    EXPECT_FALSE(framer.configuredFor(1024, "\r\n", 0));
+    EXPECT_FALSE(framer.configuredFor(1024, "\n", 100));
+}
+
+/* Reads are cut into records on the sentinle whatever the read boundaries */
+TEST_F(InstrumentFramerTest, Sentinle) {
+    InstrumentFramer framer(1024, "\r\n", 0);
+    Timestamp first(1, 0);
+    Timestamp second(2, 0);
+    vector<string> records;
+
+    framer.add("rec", 3, first, m_oRecords);
+    EXPECT_EQ(m_oRecords.size(), 0);
+    EXPECT_TRUE(framer.pending());
+
+    framer.add("ord1\r", 5, second, m_oRecords);
+    EXPECT_EQ(m_oRecords.size(), 0);
+
+    framer.add("\nrecord2\r\nrec", 13, second, m_oRecords);
+    ASSERT_EQ(m_oRecords.size(), 2);
+
+    // Records are timestamped when they started
+    EXPECT_EQ(m_oRecords[0]->timestamp().seconds(), 1);
+    EXPECT_EQ(m_oRecords[1]->timestamp().seconds(), 2);
+    EXPECT_EQ(m_oRecords[0]->packetType(), DATA_FROM_INSTRUMENT);
+
+    records = payloads();
+    EXPECT_EQ(records[0], "record1\r\n");
+    EXPECT_EQ(records[1], "record2\r\n");
+    EXPECT_EQ(framer.records(), 2);
+
+    // The rest waits for a flush
+    EXPECT_TRUE(framer.pending());
+    SharedPacket *packet = framer.flush();
+    ASSERT_TRUE(packet != NULL);
+    EXPECT_EQ(string(packet->payload(), packet->payloadSize()), "rec");
+    packet->release();
+
+    EXPECT_FALSE(framer.pending());
+    EXPECT_TRUE(framer.flush() == NULL);
+    EXPECT_EQ(framer.flushes(), 1);
+}
+
+/* Long records are cut at the max size */
+TEST_F(InstrumentFramerTest, MaxSize) {
+    InstrumentFramer framer(4, "\n", 0);
+    vector<string> records;
+    Timestamp ts;
+
+    framer.add("abcdefghij\n", 11, ts, m_oRecords);
+    records = payloads();
+
+    ASSERT_EQ(records.size(), 3);
+    EXPECT_EQ(records[0], "abcd");
+    EXPECT_EQ(records[1], "efgh");
+    EXPECT_EQ(records[2], "ij\n");
+    EXPECT_FALSE(framer.pending());
+}
+
+/* The flush delay runs from the last read */
+TEST_F(InstrumentFramerTest, FlushDelay) {
+    InstrumentFramer quiescent(1024, "", 200);
+    InstrumentFramer sentinle(1024, "\n", 0);
+    uint64_t now;
+    Timestamp ts;
+
+    quiescent.add("abc", 3, ts, m_oRecords);
+    sentinle.add("abc", 3, ts, m_oRecords);
+    now = TimerQueue::now();
+
+    // No sentinle, nothing is finished until it goes quiet
+    EXPECT_EQ(m_oRecords.size(), 0);
+
+    EXPECT_LE(quiescent.flushDelay(now), 200 * USEC_PER_MSEC);
+    EXPECT_GT(quiescent.flushDelay(now), 100 * USEC_PER_MSEC);
+    EXPECT_EQ(quiescent.flushDelay(now + 200 * USEC_PER_MSEC), 0);
+
+    EXPECT_LE(sentinle.flushDelay(now), FRAMER_DEFAULT_FLUSH_TIME * USEC_PER_MSEC);
+    EXPECT_GT(sentinle.flushDelay(now), 200 * USEC_PER_MSEC);
+    EXPECT_EQ(sentinle.flushDelay(now + FRAMER_DEFAULT_FLUSH_TIME * USEC_PER_MSEC), 0);
+}
@@ -0,0 +1,154 @@
+/*******************************************************************************
+ * Filename: output_throttle_test.cxx
+ * License: Apache 2.0
+ *
+ * Unit tests for the instrument data output throttle.
+ *
+ ******************************************************************************/
+
+#include "common/logger.h"
+#include "network/timer_queue.h"
+#include "port_agent/output_throttle.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <string.h>
+#include <vector>
+
+using namespace logger;
+using namespace std;
+using namespace network;
+using namespace port_agent;
+
+const char* TEST_LOG="/tmp/gtest.log";
+
+// One packet every 100 ms
+#define TEST_RATE 10
+#define TEST_INTERVAL (100 * USEC_PER_MSEC)
+
+class OutputThrottleTest : public testing::Test {
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile(TEST_LOG);
+            Logger::SetLogLevel("DEBUG3");
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "          Output Throttle Test Start Up";
+            LOG(INFO) << "************************************************";
+        }
+
+        SharedPacket* chunk(const char *data, uint32_t seconds = 0) {
+            Timestamp ts(seconds, 0);
+            return SharedPacket::create(DATA_FROM_INSTRUMENT, ts, data, strlen(data));
+        }
+
+        // Payloads of the ready packets, releasing them
+        vector<string> payloads() {
+            vector<string> result;
+
+            for(uint32_t i = 0; i < m_oReady.size(); i++) {
+                result.push_back(string(m_oReady[i]->payload(), m_oReady[i]->payloadSize()));
+                m_oReady[i]->release();
+            }
+
+            m_oReady.clear();
+            return result;
+        }
+
+        vector<SharedPacket *> m_oReady;
+};
+
+/* Chunks arriving faster than the rate are coalesced */
+TEST_F(OutputThrottleTest, Coalesce) {
+    OutputThrottle throttle(TEST_RATE, 1000, 1024);
+    uint64_t now = 10 * USEC_PER_SEC;
+    vector<string> ready;
+
+    // The first one has a token
+    throttle.add(chunk("a"), now, m_oReady);
+    EXPECT_FALSE(throttle.pending());
+
+    throttle.add(chunk("b", 2), now + 10, m_oReady);
+    throttle.add(chunk("c", 3), now + 20, m_oReady);
+    EXPECT_TRUE(throttle.pending());
+    EXPECT_EQ(throttle.flushDelay(now + 20), TEST_INTERVAL - 20);
+
+    ready = payloads();
+    ASSERT_EQ(ready.size(), 1);
+    EXPECT_EQ(ready[0], "a");
+
+    // Nothing until the next token
+    throttle.poll(now + TEST_INTERVAL - 1, m_oReady);
+    EXPECT_EQ(m_oReady.size(), 0);
+
+    throttle.poll(now + TEST_INTERVAL, m_oReady);
+    ASSERT_EQ(m_oReady.size(), 1);
+    EXPECT_EQ(m_oReady[0]->timestamp().seconds(), 2);
+    ready = payloads();
+    EXPECT_EQ(ready[0], "bc");
+
+    EXPECT_FALSE(throttle.pending());
+    EXPECT_EQ(throttle.packetsIn(), 3);
+    EXPECT_EQ(throttle.packetsOut(), 2);
+}
+
+/* Held data never waits longer than the max hold time */
+TEST_F(OutputThrottleTest, MaxHoldTime) {
+    OutputThrottle throttle(1, 50, 1024);
+    uint64_t now = 10 * USEC_PER_SEC;
+    vector<string> ready;
+
+    throttle.add(chunk("a"), now, m_oReady);
+    throttle.add(chunk("b"), now + 10, m_oReady);
+    EXPECT_EQ(throttle.flushDelay(now + 10), 50 * USEC_PER_MSEC);
+
+    throttle.poll(now + 10 + 50 * USEC_PER_MSEC, m_oReady);
+    ready = payloads();
+    ASSERT_EQ(ready.size(), 2);
+    EXPECT_EQ(ready[1], "b");
+}
+
+/* A full held packet goes out rather than growing past the max size */
+TEST_F(OutputThrottleTest, MaxPacketSize) {
+    OutputThrottle throttle(TEST_RATE, 1000, 4);
+    uint64_t now = 10 * USEC_PER_SEC;
+    vector<string> ready;
+
+    throttle.add(chunk("a"), now, m_oReady);
+    throttle.add(chunk("bc"), now, m_oReady);
+    throttle.add(chunk("de"), now, m_oReady);
+    throttle.add(chunk("fg"), now, m_oReady);
+
+    ready = payloads();
+    ASSERT_EQ(ready.size(), 2);
+    EXPECT_EQ(ready[0], "a");
+    EXPECT_EQ(ready[1], "bcde");
+
+    SharedPacket *held = throttle.flush();
+    ASSERT_TRUE(held != NULL);
+    EXPECT_EQ(string(held->payload(), held->payloadSize()), "fg");
+    held->release();
+
+    EXPECT_TRUE(throttle.flush() == NULL);
+}
+
+/* Held data goes out ahead of a new chunk to keep the stream in order */
+TEST_F(OutputThrottleTest, Order) {
+    OutputThrottle throttle(TEST_RATE, 1000, 1024);
+    uint64_t now = 10 * USEC_PER_SEC;
+    vector<string> ready;
+
+    throttle.add(chunk("a"), now, m_oReady);
+    throttle.add(chunk("b"), now + 10, m_oReady);
+    throttle.add(chunk("c"), now + TEST_INTERVAL, m_oReady);
+
+    ready = payloads();
+    ASSERT_EQ(ready.size(), 2);
+    EXPECT_EQ(ready[0], "a");
+    EXPECT_EQ(ready[1], "b");
+
+    // c waits for the token after b's
+    EXPECT_TRUE(throttle.pending());
+    EXPECT_EQ(throttle.flushDelay(now + TEST_INTERVAL), TEST_INTERVAL);
+    throttle.flush()->release();
+}
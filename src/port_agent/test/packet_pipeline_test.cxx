@@ -0,0 +1,397 @@
+/*******************************************************************************
+ * Filename: packet_pipeline_test.cxx
+ * License: Apache 2.0
+ *
+ * Unit tests for the instrument data pipeline.  The instrument is one end of
+ * a socketpair and the packets are published to a data log we read back.
+ *
+ ******************************************************************************/
+
+#include "common/logger.h"
+#include "common/mutex.h"
+#include "common/util.h"
+#include "port_agent/packet_pipeline.h"
+#include "port_agent/publisher/log_publisher.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <string.h>
+#include <vector>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+using namespace logger;
+using namespace std;
+using namespace port_agent;
+
+const char* TEST_LOG="/tmp/gtest.log";
+
+#define PIPELINE_DATA_FILE "/tmp/gtest_pipeline.data"
+
+// How long to wait for the pipeline threads (ms)
+#define TEST_TIMEOUT 2000
+
+class PacketPipelineTest : public testing::Test {
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile(TEST_LOG);
+            Logger::SetLogLevel("DEBUG3");
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "          Packet Pipeline Test Start Up";
+            LOG(INFO) << "************************************************";
+
+            remove_file(PIPELINE_DATA_FILE);
+
+            LogPublisher publisher;
+            publisher.setFilename(PIPELINE_DATA_FILE);
+            m_oPublishers.add(&publisher);
+
+            ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, m_iInstrument), 0);
+        }
+
+        virtual void TearDown() {
+            close(m_iInstrument[0]);
+            close(m_iInstrument[1]);
+            remove_file(PIPELINE_DATA_FILE);
+        }
+
+        void send(int fd, const char *data) {
+            ASSERT_EQ(write(fd, data, strlen(data)), strlen(data));
+        }
+
+        // Wait for the reader to have handled this many reads
+        bool waitForReads(PacketPipeline &pipeline, uint64_t count) {
+            for(int i = 0; i < TEST_TIMEOUT; i++) {
+                PipelineStats stats = pipeline.stats();
+                if(stats.enqueued + stats.dropped >= count)
+                    return true;
+                usleep(1000);
+            }
+
+            return false;
+        }
+
+        bool waitForPublished(PacketPipeline &pipeline, uint64_t count) {
+            for(int i = 0; i < TEST_TIMEOUT; i++) {
+                if(pipeline.stats().published >= count)
+                    return true;
+                usleep(1000);
+            }
+
+            return false;
+        }
+
+        // Payloads of the packets in the data log
+        vector<string> payloads() {
+            vector<string> result;
+            string data;
+            size_t offset = 0;
+
+            {
+                MutexLock lock(m_oPublisherLock);
+                m_oPublishers.closeFiles();
+            }
+
+            data = read_file(PIPELINE_DATA_FILE);
+            while(offset + HEADER_SIZE <= data.length()) {
+                uint16_t size = ((uint8_t)data[offset + 4] << 8) | (uint8_t)data[offset + 5];
+                if(size < HEADER_SIZE || offset + size > data.length())
+                    break;
+
+                result.push_back(data.substr(offset + HEADER_SIZE, size - HEADER_SIZE));
+                offset += size;
+            }
+
+            return result;
+        }
+
+        static void * stopMain(void *arg) {
+            ((PacketPipeline *)arg)->stop();
+            return NULL;
+        }
+
+        PublisherList m_oPublishers;
+        Mutex m_oPublisherLock;
+        int m_iInstrument[2];
+};
+
+/* Each read is published as a packet */
+TEST_F(PacketPipelineTest, ReadAndPublish) {
+    PacketPipeline pipeline(m_oPublishers, m_oPublisherLock, 16, 1024);
+    vector<string> published;
+
+    ASSERT_TRUE(pipeline.start());
+    pipeline.setSource(m_iInstrument[0]);
+
+    send(m_iInstrument[1], "abc");
+    ASSERT_TRUE(waitForPublished(pipeline, 1));
+    send(m_iInstrument[1], "defg");
+    ASSERT_TRUE(waitForPublished(pipeline, 2));
+
+    pipeline.setSource(-1);
+    pipeline.stop();
+
+    published = payloads();
+    ASSERT_EQ(published.size(), 2);
+    EXPECT_EQ(published[0], "abc");
+    EXPECT_EQ(published[1], "defg");
+}
+
+/* A full ring drops new packets rather than waiting for the publisher */
+TEST_F(PacketPipelineTest, RingFull) {
+    PacketPipeline pipeline(m_oPublishers, m_oPublisherLock, 4, 1024);
+    uint32_t capacity = pipeline.capacity();
+    PipelineStats stats;
+
+    ASSERT_TRUE(pipeline.start());
+    pipeline.setSource(m_iInstrument[0]);
+
+    // The publisher can't drain while we hold its lock
+    m_oPublisherLock.lock();
+    for(uint32_t i = 0; i < capacity + 3; i++) {
+        send(m_iInstrument[1], "x");
+        ASSERT_TRUE(waitForReads(pipeline, i + 1));
+    }
+
+    stats = pipeline.stats();
+    EXPECT_EQ(stats.enqueued, capacity);
+    EXPECT_EQ(stats.dropped, 3);
+    EXPECT_EQ(stats.occupancy, capacity);
+    EXPECT_EQ(stats.highWater, capacity);
+    m_oPublisherLock.unlock();
+
+    ASSERT_TRUE(waitForPublished(pipeline, capacity));
+    pipeline.setSource(-1);
+    pipeline.stop();
+
+    stats = pipeline.stats();
+    EXPECT_EQ(stats.published, capacity);
+    EXPECT_EQ(stats.occupancy, 0);
+    EXPECT_EQ(payloads().size(), capacity);
+}
+
+/* The main loop is told when the instrument closes */
+TEST_F(PacketPipelineTest, SourceLost) {
+    PacketPipeline pipeline(m_oPublishers, m_oPublisherLock, 16, 1024);
+    struct pollfd fds[1];
+
+    ASSERT_TRUE(pipeline.start());
+    pipeline.setSource(m_iInstrument[0]);
+    EXPECT_FALSE(pipeline.sourceLost());
+
+    send(m_iInstrument[1], "last");
+    shutdown(m_iInstrument[1], SHUT_WR);
+
+    fds[0].fd = pipeline.notifyFD();
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    ASSERT_EQ(::poll(fds, 1, TEST_TIMEOUT), 1);
+
+    pipeline.clearNotify();
+    EXPECT_TRUE(pipeline.sourceLost());
+
+    // Cleared until there is something new to say
+    fds[0].revents = 0;
+    EXPECT_EQ(::poll(fds, 1, 0), 0);
+
+    // A new source is read again
+    pipeline.setSource(-1);
+    EXPECT_FALSE(pipeline.sourceLost());
+
+    pipeline.stop();
+
+    vector<string> published = payloads();
+    ASSERT_EQ(published.size(), 1);
+    EXPECT_EQ(published[0], "last");
+}
+
+/* Once setSource returns the old descriptor isn't read again */
+TEST_F(PacketPipelineTest, SwitchSource) {
+    PacketPipeline pipeline(m_oPublishers, m_oPublisherLock, 16, 1024);
+    int second[2];
+    char buffer[16];
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, second), 0);
+    ASSERT_TRUE(pipeline.start());
+
+    pipeline.setSource(m_iInstrument[0]);
+    send(m_iInstrument[1], "first");
+    ASSERT_TRUE(waitForPublished(pipeline, 1));
+
+    pipeline.setSource(second[0]);
+    send(m_iInstrument[1], "stale");
+    send(second[1], "second");
+    ASSERT_TRUE(waitForPublished(pipeline, 2));
+
+    pipeline.setSource(-1);
+    pipeline.stop();
+
+    vector<string> published = payloads();
+    ASSERT_EQ(published.size(), 2);
+    EXPECT_EQ(published[0], "first");
+    EXPECT_EQ(published[1], "second");
+
+    // Still waiting on the old descriptor
+    ASSERT_EQ(recv(m_iInstrument[0], buffer, sizeof(buffer), MSG_DONTWAIT), 5);
+    EXPECT_EQ(string(buffer, 5), "stale");
+
+    close(second[0]);
+    close(second[1]);
+}
+
+/* Packets queued when we stop are published before the threads exit */
+TEST_F(PacketPipelineTest, StopDrains) {
+    PacketPipeline pipeline(m_oPublishers, m_oPublisherLock, 16, 1024);
+    pthread_t stopper;
+
+    ASSERT_TRUE(pipeline.start());
+    pipeline.setSource(m_iInstrument[0]);
+
+    m_oPublisherLock.lock();
+    send(m_iInstrument[1], "one");
+    ASSERT_TRUE(waitForReads(pipeline, 1));
+    send(m_iInstrument[1], "two");
+    ASSERT_TRUE(waitForReads(pipeline, 2));
+    EXPECT_EQ(pipeline.stats().published, 0);
+
+    // Stop while the publisher is still waiting for the lock
+    pipeline.setSource(-1);
+    ASSERT_EQ(pthread_create(&stopper, NULL, stopMain, &pipeline), 0);
+    usleep(100 * 1000);
+    m_oPublisherLock.unlock();
+    pthread_join(stopper, NULL);
+
+    EXPECT_FALSE(pipeline.running());
+    EXPECT_EQ(pipeline.stats().published, 2);
+    EXPECT_EQ(pipeline.stats().occupancy, 0);
+
+    vector<string> published = payloads();
+    ASSERT_EQ(published.size(), 2);
+    EXPECT_EQ(published[0], "one");
+    EXPECT_EQ(published[1], "two");
+}
+
+/* With framing the reader queues records, not reads */
+TEST_F(PacketPipelineTest, Framed) {
+    PacketPipeline pipeline(m_oPublishers, m_oPublisherLock, 16, 1024);
+
+    pipeline.setFraming(1024, "\r\n", 0);
+    ASSERT_TRUE(pipeline.start());
+    pipeline.setSource(m_iInstrument[0]);
+
+    send(m_iInstrument[1], "ab");
+    send(m_iInstrument[1], "c\r\nde");
+    send(m_iInstrument[1], "f\r\ngh");
+    ASSERT_TRUE(waitForPublished(pipeline, 2));
+    EXPECT_EQ(pipeline.stats().enqueued, 2);
+
+    // The partial record goes out when the source changes
+    pipeline.setSource(-1);
+    ASSERT_TRUE(waitForPublished(pipeline, 3));
+    pipeline.stop();
+
+    vector<string> published = payloads();
+    ASSERT_EQ(published.size(), 3);
+    EXPECT_EQ(published[0], "abc\r\n");
+    EXPECT_EQ(published[1], "def\r\n");
+    EXPECT_EQ(published[2], "gh");
+}
+
+/* A partial record is sent once the instrument has been quiet */
+TEST_F(PacketPipelineTest, FramedQuiescent) {
+    PacketPipeline pipeline(m_oPublishers, m_oPublisherLock, 16, 1024);
+
+    pipeline.setFraming(1024, "", 50);
+    ASSERT_TRUE(pipeline.start());
+    pipeline.setSource(m_iInstrument[0]);
+
+    send(m_iInstrument[1], "abc");
+    ASSERT_TRUE(waitForPublished(pipeline, 1));
+
+    // Changing the framing sends the record in progress
+    send(m_iInstrument[1], "de");
+    usleep(10 * 1000);
+    pipeline.setFraming(1024, "", 0);
+    ASSERT_TRUE(waitForPublished(pipeline, 2));
+
+    pipeline.setSource(-1);
+    pipeline.stop();
+
+    vector<string> published = payloads();
+    ASSERT_EQ(published.size(), 2);
+    EXPECT_EQ(published[0], "abc");
+    EXPECT_EQ(published[1], "de");
+}
+
+/* The publisher holds data back to the throttle rate and sends what it
+ * holds when the pipeline stops */
+TEST_F(PacketPipelineTest, Throttled) {
+    PacketPipeline pipeline(m_oPublishers, m_oPublisherLock, 16, 1024);
+
+    {
+        MutexLock lock(m_oPublisherLock);
+        pipeline.setThrottle(1, 10000, 1024);
+    }
+
+    ASSERT_TRUE(pipeline.start());
+    pipeline.setSource(m_iInstrument[0]);
+
+    send(m_iInstrument[1], "a");
+    ASSERT_TRUE(waitForPublished(pipeline, 1));
+    send(m_iInstrument[1], "b");
+    ASSERT_TRUE(waitForPublished(pipeline, 2));
+    send(m_iInstrument[1], "c");
+    ASSERT_TRUE(waitForPublished(pipeline, 3));
+
+    {
+        MutexLock lock(m_oPublisherLock);
+        string stats = pipeline.statsAsString();
+        EXPECT_NE(stats.find("throttle_packets_in 3\n"), string::npos);
+        EXPECT_NE(stats.find("throttle_packets_out 1\n"), string::npos);
+    }
+
+    pipeline.setSource(-1);
+    pipeline.stop();
+
+    vector<string> published = payloads();
+    ASSERT_EQ(published.size(), 2);
+    EXPECT_EQ(published[0], "a");
+    EXPECT_EQ(published[1], "bc");
+}
+
+/* Held data goes out after the max hold time without more data arriving */
+TEST_F(PacketPipelineTest, ThrottleHoldTime) {
+    PacketPipeline pipeline(m_oPublishers, m_oPublisherLock, 16, 1024);
+    bool sent = false;
+
+    {
+        MutexLock lock(m_oPublisherLock);
+        pipeline.setThrottle(1, 50, 1024);
+    }
+
+    ASSERT_TRUE(pipeline.start());
+    pipeline.setSource(m_iInstrument[0]);
+
+    send(m_iInstrument[1], "a");
+    ASSERT_TRUE(waitForPublished(pipeline, 1));
+    send(m_iInstrument[1], "b");
+    ASSERT_TRUE(waitForPublished(pipeline, 2));
+
+    // Well before the publisher's idle wake up
+    for(int i = 0; i < PIPELINE_WAIT_TIMEOUT / 2 && !sent; i++) {
+        MutexLock lock(m_oPublisherLock);
+        sent = pipeline.statsAsString().find("throttle_packets_out 2\n") != string::npos;
+        usleep(1000);
+    }
+    EXPECT_TRUE(sent);
+
+    pipeline.setSource(-1);
+    pipeline.stop();
+
+    vector<string> published = payloads();
+    ASSERT_EQ(published.size(), 2);
+    EXPECT_EQ(published[1], "b");
+}
@@ -0,0 +1,88 @@
+/*******************************************************************************
+ * Filename: reconnect_backoff_test.cxx
+ * License: Apache 2.0
+ *
+ * Unit tests for the instrument reconnect backoff.
+ *
+ ******************************************************************************/
+
+#include "common/logger.h"
+#include "port_agent/reconnect_backoff.h"
+#include "gtest/gtest.h"
+
+using namespace logger;
+using namespace std;
+using namespace port_agent;
+
+const char* TEST_LOG="/tmp/gtest.log";
+
+class ReconnectBackoffTest : public testing::Test {
+    protected:
+        virtual void SetUp() {
+            Logger::SetLogFile(TEST_LOG);
+            Logger::SetLogLevel("DEBUG3");
+
+            LOG(INFO) << "************************************************";
+            LOG(INFO) << "         Reconnect Backoff Test Start Up";
+            LOG(INFO) << "************************************************";
+        }
+};
+
+/* Without jitter the delay doubles until it reaches the max */
+TEST_F(ReconnectBackoffTest, Exponential) {
+    ReconnectBackoff backoff(100, 1000, 0);
+
+    EXPECT_EQ(backoff.attempts(), 0);
+    EXPECT_EQ(backoff.nextDelay(), 100);
+    EXPECT_EQ(backoff.nextDelay(), 200);
+    EXPECT_EQ(backoff.nextDelay(), 400);
+    EXPECT_EQ(backoff.nextDelay(), 800);
+    EXPECT_EQ(backoff.nextDelay(), 1000);
+    EXPECT_EQ(backoff.nextDelay(), 1000);
+    EXPECT_EQ(backoff.attempts(), 6);
+
+    backoff.reset();
+    EXPECT_EQ(backoff.attempts(), 0);
+    EXPECT_EQ(backoff.nextDelay(), 100);
+}
+
+/* Jitter keeps each delay within the configured percent */
+TEST_F(ReconnectBackoffTest, Jitter) {
+    ReconnectBackoff backoff(1000, 1000, 20);
+    bool varied = false;
+    uint32_t first = backoff.nextDelay();
+
+    for(int i = 0; i < 100; i++) {
+        uint32_t delay = backoff.nextDelay();
+
+        EXPECT_GE(delay, 800);
+        EXPECT_LE(delay, 1200);
+
+        if(delay != first)
+            varied = true;
+    }
+
+    EXPECT_TRUE(varied);
+}
+
+/* Out of range limits are pulled back to something usable */
+TEST_F(ReconnectBackoffTest, Limits) {
+    ReconnectBackoff backoff(0, 0, 500);
+
+    EXPECT_EQ(backoff.minDelay(), 1);
+    EXPECT_EQ(backoff.maxDelay(), 1);
+    EXPECT_EQ(backoff.jitter(), 100);
+    EXPECT_GE(backoff.nextDelay(), 1);
+
+    // A max below the min is raised to the min
+    backoff.setLimits(500, 100, 0);
+    EXPECT_EQ(backoff.maxDelay(), 500);
+
+    // New limits apply to the next delay
+    backoff.reset();
+    backoff.setLimits(10, 40, 0);
+    EXPECT_EQ(backoff.nextDelay(), 10);
+    EXPECT_EQ(backoff.nextDelay(), 20);
+    backoff.setLimits(10, 25, 0);
+    EXPECT_EQ(backoff.nextDelay(), 25);
+}
@@ -1,8 +1,15 @@
 #!/usr/bin/env python
 
 # decode port_agent data log files
+#
+# usage: data_log_decoder.py file [start end]
+#
+# start and end are unix times.  When given, the time index written beside
+# the file (file.idx) is used to decode just that part of the file.  A file
+# compressed by the port agent (file.gz) is read through gzip, its index is
+# still file.idx and counts uncompressed bytes.
 
-import time, sys
+import time, sys, struct, bisect, gzip
 
 SYNC_BYTES = b'\xa3\x9d\x7a'
 
@@ -37,6 +44,52 @@ MessageTypeStr = ['Data From Instrument',
 # offset in seconds from 1/1/00 to 1/1/70
 DeltaOffset = 2208988800
 
+# time index entry, big endian NTP timestamp and byte offset
+INDEX_EXTENSION = '.idx'
+INDEX_ENTRY = '>QQ'
+LENGTH_INDEX_ENTRY = struct.calcsize(INDEX_ENTRY)
+
+COMPRESSED_EXTENSION = '.gz'
+
+def Unix_to_ntp (seconds):
+    return int((seconds + DeltaOffset) * pow(2,32))
+
+
+def Index_name (FileName):
+    # a compressed file keeps the index of the file it was made from
+    if FileName.endswith(COMPRESSED_EXTENSION):
+        FileName = FileName[:-len(COMPRESSED_EXTENSION)]
+    return FileName + INDEX_EXTENSION
+
+
+def Open_log (FileName):
+    # offsets are the same either way, gzip seeks in the uncompressed data
+    if FileName.endswith(COMPRESSED_EXTENSION):
+        return gzip.open (FileName, "rb")
+    return open (FileName, "rb")
+
+
+def Index_range (FileName, start, end):
+    # byte range holding the packets from start to end, end offset of None
+    # is the end of the file.  The whole file if there is no index.
+    try:
+        with open (Index_name(FileName), "rb") as f:
+            data = f.read()
+    except IOError:
+        print ("no index for %s, decoding the whole file" %FileName)
+        return 0, None
+
+    entries = [struct.unpack_from(INDEX_ENTRY, data, i)
+               for i in range(0, len(data) - LENGTH_INDEX_ENTRY + 1, LENGTH_INDEX_ENTRY)]
+    times = [entry[0] for entry in entries]
+
+    first = bisect.bisect_right(times, Unix_to_ntp(start))
+    last = bisect.bisect_right(times, Unix_to_ntp(end))
+
+    fromOffset = entries[first-1][1] if first else 0
+    toOffset = entries[last][1] if last < len(entries) else None
+    return fromOffset, toOffset
+
 def Convert_64_bit_hex_to_seconds (hexValue):
     # high double-word is seconds, low double-word is fraction of a second
     # returned value seconds is a floating point
@@ -87,15 +140,20 @@ def ProcesByte (Byte):
 if __name__ == '__main__':
     NumberOfBytesRead = 0
     
-    # check that there is only one parameter on the command line
-    if len(sys.argv) != 2:
-        print ("expecting one command line parameter (the name of the file to decode), got %d" %(len(sys.argv)-1))
+    # check for the file name and an optional time range
+    if len(sys.argv) not in (2, 4):
+        print ("expecting the name of the file to decode and optionally a start and end time, got %d parameters" %(len(sys.argv)-1))
         sys.exit(1)
     
     FileName = sys.argv[1]
+    StartOffset, EndOffset = 0, None
+
+    if len(sys.argv) == 4:
+        StartOffset, EndOffset = Index_range (FileName, float(sys.argv[2]), float(sys.argv[3]))
     
-    with open (FileName, "rb") as f:
-        while True:
+    with Open_log (FileName) as f:
+        f.seek(StartOffset)
+        while EndOffset is None or StartOffset + NumberOfBytesRead < EndOffset:
             ByteRead = f.read(1)
             if not ByteRead:
                 break